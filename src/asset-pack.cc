@@ -0,0 +1,102 @@
+/*
+ * asset-pack.cc - Convert original game data to preprocessed asset pack
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/command_line.h"
+#include "src/log.h"
+#include "src/version.h"
+#include "src/data-source-dos.h"
+#include "src/data-source-amiga.h"
+#include "src/data-source-custom.h"
+#include "src/data-source-pack.h"
+
+int
+main(int argc, char *argv[]) {
+  std::string data_dir = ".";
+  std::string pack_file;
+
+  CommandLine command_line;
+  command_line.add_option('d', "Set directory with original game data")
+                .add_parameter("DIR", [&data_dir](std::istream& s) {
+                  std::getline(s, data_dir);
+                  return true;
+                });
+  command_line.add_option('h', "Show this help text", [&command_line](){
+                  command_line.show_help();
+                  exit(EXIT_SUCCESS);
+                });
+  command_line.add_option('o', "Write pack to FILE instead of data directory")
+                .add_parameter("FILE", [&pack_file](std::istream& s) {
+                  std::getline(s, pack_file);
+                  return true;
+                });
+  command_line.set_comment("Please report bugs to <" PACKAGE_BUGREPORT ">");
+  if (!command_line.process(argc, argv)) {
+    return EXIT_FAILURE;
+  }
+
+  Log::Info["asset-pack"] << "starts " << FREESERF_VERSION;
+
+  // The pack itself is never a source, so do not use Data::load().
+  typedef std::function<Data::PSource(const std::string &)> SourceFactory;
+  std::vector<SourceFactory> sources_factories;
+  sources_factories.push_back([](const std::string &path)->Data::PSource{
+    return std::make_shared<DataSourceCustom>(path); });
+  sources_factories.push_back([](const std::string &path)->Data::PSource{
+    return std::make_shared<DataSourceDOS>(path); });
+  sources_factories.push_back([](const std::string &path)->Data::PSource{
+    return std::make_shared<DataSourceAmiga>(path); });
+
+  Data::PSource source;
+  for (const SourceFactory &factory : sources_factories) {
+    Data::PSource candidate = factory(data_dir);
+    if (candidate->check() && candidate->load()) {
+      source = std::move(candidate);
+      break;
+    }
+  }
+  if (!source) {
+    Log::Error["asset-pack"] << "No game data found in '" << data_dir << "'";
+    return EXIT_FAILURE;
+  }
+
+  if (pack_file.empty()) {
+    pack_file = data_dir + "/" + DataSourcePack::file_name;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  if (!DataSourcePack::create(source, pack_file)) {
+    Log::Error["asset-pack"] << "Failed to write '" << pack_file << "'";
+    return EXIT_FAILURE;
+  }
+  auto time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    std::chrono::steady_clock::now() - start);
+  Log::Info["asset-pack"] << "converted " << source->get_name() << " data in "
+                          << time.count() << " ms";
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,186 @@
+/*
+ * atlas-packer.cc - Placement of images on texture atlas pages
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/atlas-packer.h"
+
+AtlasPacker::AtlasPacker(int _page_size, int _padding)
+  : page_size(_page_size)
+  , padding(_padding) {
+}
+
+bool
+AtlasPacker::fits(int width, int height) const {
+  return (width + padding <= page_size) && (height + padding <= page_size);
+}
+
+/* Shelves much taller than the image are only used when there is no
+   room for a new shelf, or small images would take space of tall ones. */
+bool
+AtlasPacker::allocate(int width, int height, size_t *page, int *x, int *y) {
+  if (!fits(width, height)) {
+    return false;
+  }
+
+  int padded_width = width + padding;
+  int padded_height = height + padding;
+
+  Page *best_page = nullptr;
+  Shelf *best_shelf = nullptr;
+  for (int pass = 0; pass < 3 && best_shelf == nullptr; pass++) {
+    if (pass == 1) {
+      /* Open a new shelf at the bottom of the first page with room. */
+      for (Page &p : pages) {
+        if (p.top + padded_height <= page_size) {
+          Shelf shelf = { p.top, padded_height, 0, {}, 0 };
+          p.shelves.push_back(shelf);
+          p.top += padded_height;
+          best_page = &p;
+          best_shelf = &p.shelves.back();
+          break;
+        }
+      }
+      continue;
+    }
+
+    int best_waste = page_size;
+    for (Page &p : pages) {
+      for (Shelf &shelf : p.shelves) {
+        int waste = shelf.height - padded_height;
+        if ((waste < 0) || (waste >= best_waste) ||
+            ((pass == 0) && (2 * waste > padded_height))) {
+          continue;
+        }
+        bool room = (shelf.end + padded_width <= page_size);
+        for (const Span &span : shelf.free) {
+          room = room || (span.width >= padded_width);
+        }
+        if (room) {
+          best_waste = waste;
+          best_page = &p;
+          best_shelf = &shelf;
+        }
+      }
+    }
+  }
+
+  if (best_shelf == nullptr) {
+    return false;
+  }
+
+  place_on_shelf(best_shelf, padded_width, x);
+  *y = best_shelf->y;
+  *page = best_page - pages.data();
+  best_shelf->images++;
+  best_page->images++;
+  best_page->area += padded_width * padded_height;
+
+  return true;
+}
+
+/* Shelf is known to have room for width. */
+void
+AtlasPacker::place_on_shelf(Shelf *shelf, int width, int *x) {
+  for (size_t i = 0; i < shelf->free.size(); i++) {
+    Span &span = shelf->free[i];
+    if (span.width >= width) {
+      *x = span.x;
+      span.x += width;
+      span.width -= width;
+      if (span.width == 0) {
+        shelf->free.erase(shelf->free.begin() + i);
+      }
+      return;
+    }
+  }
+
+  *x = shelf->end;
+  shelf->end += width;
+}
+
+void
+AtlasPacker::release(size_t page, int x, int y, int width, int height) {
+  Page &p = pages[page];
+  std::vector<Shelf>::iterator shelf = p.shelves.begin();
+  while ((shelf != p.shelves.end()) && (shelf->y != y)) {
+    ++shelf;
+  }
+  if (shelf == p.shelves.end()) {
+    return;
+  }
+
+  release_span(&*shelf, x, width + padding);
+  shelf->images--;
+  p.images--;
+  p.area -= (width + padding) * (height + padding);
+
+  if (shelf->images == 0) {
+    shelf->end = 0;
+    shelf->free.clear();
+  }
+
+  /* Empty shelves at the bottom give their height back to the page. */
+  while (!p.shelves.empty() && (p.shelves.back().images == 0)) {
+    p.top = p.shelves.back().y;
+    p.shelves.pop_back();
+  }
+}
+
+/* Give span back to the shelf, merged with released neighbours. */
+void
+AtlasPacker::release_span(Shelf *shelf, int x, int width) {
+  std::vector<Span> &free = shelf->free;
+  std::vector<Span>::iterator next = free.begin();
+  while ((next != free.end()) && (next->x < x)) {
+    ++next;
+  }
+
+  Span span = { x, width };
+  if ((next != free.end()) && (next->x == x + width)) {
+    span.width += next->width;
+    next = free.erase(next);
+  }
+  if ((next != free.begin()) &&
+      ((next - 1)->x + (next - 1)->width == span.x)) {
+    --next;
+    span.x = next->x;
+    span.width += next->width;
+    next = free.erase(next);
+  }
+
+  if (span.x + span.width == shelf->end) {
+    shelf->end = span.x;
+  } else {
+    free.insert(next, span);
+  }
+}
+
+size_t
+AtlasPacker::add_page() {
+  Page page = { {}, 0, 0, 0 };
+  pages.push_back(page);
+  return pages.size() - 1;
+}
+
+double
+AtlasPacker::get_fill(size_t page) const {
+  return static_cast<double>(pages[page].area) /
+         (static_cast<double>(page_size) * page_size);
+}
@@ -0,0 +1,83 @@
+/*
+ * atlas-packer.h - Placement of images on texture atlas pages
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_ATLAS_PACKER_H_
+#define SRC_ATLAS_PACKER_H_
+
+#include <cstddef>
+#include <vector>
+
+/* Places images on square pages in shelves, rows of images as high as
+   their tallest one. Space of released images is kept per shelf and
+   given to later images that fit, a shelf emptied at the bottom of its
+   page is dropped, so pages do not fill up with holes when images come
+   and go. Images are kept padding pixels apart. */
+class AtlasPacker {
+ protected:
+  class Span {
+   public:
+    int x;
+    int width;
+  };
+
+  class Shelf {
+   public:
+    int y;
+    int height;
+    int end;                  /* Right edge of the images placed so far */
+    std::vector<Span> free;   /* Released space left of end, by x */
+    unsigned int images;
+  };
+
+  class Page {
+   public:
+    std::vector<Shelf> shelves;  /* By y */
+    int top;                     /* Bottom edge of the last shelf */
+    unsigned int images;
+    size_t area;                 /* Padded area of the images */
+  };
+
+  int page_size;
+  int padding;
+  std::vector<Page> pages;
+
+ public:
+  AtlasPacker(int page_size, int padding);
+
+  /* Find room for an image on the pages there are, false when the image
+     needs a new page or does not fit any page at all. */
+  bool allocate(int width, int height, size_t *page, int *x, int *y);
+  void release(size_t page, int x, int y, int width, int height);
+  size_t add_page();
+  bool fits(int width, int height) const;
+
+  int get_page_size() const { return page_size; }
+  size_t get_page_count() const { return pages.size(); }
+  unsigned int get_images(size_t page) const { return pages[page].images; }
+  /* Share of the page covered by images, padding included. */
+  double get_fill(size_t page) const;
+
+ protected:
+  void place_on_shelf(Shelf *shelf, int width, int *x);
+  static void release_span(Shelf *shelf, int x, int width);
+};
+
+#endif  // SRC_ATLAS_PACKER_H_
@@ -27,6 +27,15 @@
 
 #include "src/debug.h"
 
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 Buffer::Buffer(EndianessMode _endianess)
   : data(nullptr)
   , size(0)
@@ -63,26 +72,12 @@ Buffer::Buffer(PBuffer _parent, size_t start, size_t length,
 }
 
 Buffer::Buffer(const std::string &path, EndianessMode _endianess)
-  : owned(true)
+  : data(nullptr)
+  , size(0)
+  , owned(true)
+  , read(nullptr)
   , endianess(_endianess) {
-  std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
-  if (!file.good()) {
-    throw ExceptionFreeserf("Failed to open file '" + path + "'");
-  }
-
-  size = (size_t)file.tellg();
-
-  file.seekg(0, file.beg);
-
-  data = ::malloc(size);
-  if (data == nullptr) {
-    throw ExceptionFreeserf("Failed to allocate memory");
-  }
-
-  file.read(reinterpret_cast<char*>(data), size);
-  file.close();
-
-  read = reinterpret_cast<uint8_t*>(data);
+  load_file(path);
 }
 
 Buffer::~Buffer() {
@@ -142,6 +137,137 @@ Buffer::write(const std::string &path) {
   return true;
 }
 
+void
+Buffer::load_file(const std::string &path) {
+  std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+  if (!file.good()) {
+    throw ExceptionFreeserf("Failed to open file '" + path + "'");
+  }
+
+  size = (size_t)file.tellg();
+
+  file.seekg(0, file.beg);
+
+  data = ::malloc(size);
+  if (data == nullptr) {
+    throw ExceptionFreeserf("Failed to allocate memory");
+  }
+
+  file.read(reinterpret_cast<char*>(data), size);
+  file.close();
+
+  owned = true;
+  read = reinterpret_cast<uint8_t*>(data);
+}
+
+// MappedBuffer
+
+MappedBuffer::MappedBuffer(const std::string &path, EndianessMode _endianess)
+  : Buffer(_endianess)
+  , mapped(false) {
+  owned = false;
+  if (!map_file(path)) {
+    load_file(path);
+  }
+}
+
+MappedBuffer::~MappedBuffer() {
+  if (mapped && (data != nullptr)) {
+#ifdef _WIN32
+    ::UnmapViewOfFile(data);
+#else
+    ::munmap(data, size);
+#endif
+    data = nullptr;
+  }
+}
+
+void *
+MappedBuffer::unfix() {
+  if (!mapped) {
+    return Buffer::unfix();
+  }
+
+  // Mapped memory can not be handed over to free(), give away a copy.
+  void *result = ::malloc(size);
+  if (result == nullptr) {
+    throw std::bad_alloc();
+  }
+  std::copy(reinterpret_cast<uint8_t*>(data),
+            reinterpret_cast<uint8_t*>(data) + size,
+            reinterpret_cast<uint8_t*>(result));
+#ifdef _WIN32
+  ::UnmapViewOfFile(data);
+#else
+  ::munmap(data, size);
+#endif
+  data = nullptr;
+  size = 0;
+  mapped = false;
+  return result;
+}
+
+// Mapping is private, so in-place fixups (e.g. endianess conversion of the
+// animation table) only copy the touched pages and never reach the file.
+bool
+MappedBuffer::map_file(const std::string &path) {
+#ifdef _WIN32
+  HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!::GetFileSizeEx(file, &file_size) || (file_size.QuadPart == 0)) {
+    ::CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = ::CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0,
+                                        NULL);
+  ::CloseHandle(file);
+  if (mapping == NULL) {
+    return false;
+  }
+
+  void *view = ::MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  ::CloseHandle(mapping);
+  if (view == NULL) {
+    return false;
+  }
+
+  data = view;
+  size = static_cast<size_t>(file_size.QuadPart);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if ((::fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) || (st.st_size == 0)) {
+    ::close(fd);
+    return false;
+  }
+
+  void *view = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (view == MAP_FAILED) {
+    return false;
+  }
+
+  data = view;
+  size = static_cast<size_t>(st.st_size);
+#endif
+
+  mapped = true;
+  read = reinterpret_cast<uint8_t*>(data);
+  return true;
+}
+
 // MutableBuffer
 
 MutableBuffer::MutableBuffer(EndianessMode _endianess)
@@ -212,6 +338,14 @@ MutableBuffer::push(const void *_data, size_t _size) {
   size += _size;
 }
 
+void *
+MutableBuffer::append(size_t _size) {
+  check_size(size + _size);
+  void *result = offset(size);
+  size += _size;
+  return result;
+}
+
 void
 MutableBuffer::push(const std::string &str) {
   push((const void*)str.c_str(), str.size());
@@ -85,6 +85,29 @@ class Buffer : public std::enable_shared_from_this<Buffer> {
 
  protected:
   void *offset(size_t off) { return reinterpret_cast<char*>(data) + off; }
+  void load_file(const std::string &path);
+};
+
+// Buffer backed by a private (copy-on-write) memory mapping of a file.
+// Pages are shared with the page cache until written, so large data files
+// and saves do not have to be copied to the heap. Falls back to reading the
+// whole file when mapping is not possible.
+class MappedBuffer : public Buffer {
+ protected:
+  bool mapped;
+
+ public:
+  explicit MappedBuffer(const std::string &path,
+                        EndianessMode endianess = is_big_endian() ?
+                                                  EndianessBig :
+                                                  EndianessLittle);
+  virtual ~MappedBuffer();
+
+  bool is_mapped() const { return mapped; }
+  void *unfix();
+
+ protected:
+  bool map_file(const std::string &path);
 };
 
 class MutableBuffer : public Buffer {
@@ -106,6 +129,8 @@ class MutableBuffer : public Buffer {
   void push(void *buf, size_t len) { push((const void*)buf, len); }
   void push(const std::string &str);
   void push(const char *str) { push(std::string(str)); }
+  // Grow by size bytes and return them for writing in place.
+  void *append(size_t size);
   template<typename T> void push(T value, size_t count = 1) {
     check_size(size + (sizeof(T) * count));
     for (size_t i = 0; i < count; i++) {
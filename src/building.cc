@@ -1447,17 +1447,25 @@ operator >> (SaveReaderText &reader, Building &building) {
   reader.value("serf_index") >> building.first_knight;
   reader.value("progress") >> building.progress;
 
+  // Link to inventory is resolved later by load_links()
+  if (!reader.has_value("inventory")) {
+    if (building.burning) {
+      reader.value("tick") >> building.u.tick;
+    } else {
+      reader.value("level") >> building.u.level;
+    }
+  }
+
+  return reader;
+}
+
+void
+Building::load_links(SaveReaderText &reader) {
   if (reader.has_value("inventory")) {
     unsigned int inventory_index;
     reader.value("inventory") >> inventory_index;
-    building.inventory = building.game->create_inventory(inventory_index);
-  } else if (building.burning) {
-    reader.value("tick") >> building.u.tick;
-  } else {
-    reader.value("level") >> building.u.level;
+    inventory = game->create_inventory(inventory_index);
   }
-
-  return reader;
 }
 
 SaveWriterText&
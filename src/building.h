@@ -148,6 +148,7 @@ class Building : public GameObject {
   /* The threat level of the building. Higher values mean that
    the building is closer to the enemy. */
   size_t get_threat_level() const { return threat_level; }
+  void set_threat_level(size_t level) { threat_level = level; }
   /* Building is currently playing back a sound effect. */
   bool is_playing_sfx() const { return playing_sfx; }
   void start_playing_sfx() { playing_sfx = true; }
@@ -246,6 +247,9 @@ class Building : public GameObject {
     operator >> (SaveReaderBinary &reader, Building &building);
   friend SaveReaderText&
     operator >> (SaveReaderText &reader, Building &building);
+  // Resolve link to the inventory. Called after every object of the game
+  // has been created.
+  void load_links(SaveReaderText &reader);
   friend SaveWriterText&
     operator << (SaveWriterText &writer, Building &building);
 
@@ -32,6 +32,7 @@
 #include "src/freeserf_endian.h"
 #include "src/sfx2wav.h"
 #include "src/log.h"
+#include "src/thread-pool.h"
 
 uint8_t palette[] = {
   0x00, 0x00, 0x00,   // 0
@@ -269,34 +270,114 @@ DataSourceAmiga::check() {
   return true;
 }
 
+// Optional files are listed too, whether they are there or not.
+std::vector<std::string>
+DataSourceAmiga::get_files() const {
+  std::vector<std::string> files;
+  for (const char *file_name : { "gfxheader", "gfxfast", "gfxchip",
+                                 "gfxpics", "sounds", "music" }) {
+    files.push_back(path + '/' + file_name);
+  }
+  return files;
+}
+
 bool
 DataSourceAmiga::load() {
   try {
-    gfxfast = std::make_shared<Buffer>(path + "/gfxfast", Buffer::EndianessBig);
-    gfxfast = decode(gfxfast);
-    gfxfast = unpack(gfxfast);
-    Log::Debug["data"] << "Data file 'gfxfast' loaded (size = "
-                       << gfxfast->get_size() << ")";
+    gfxfast = std::make_shared<MappedBuffer>(path + "/gfxfast",
+                                            Buffer::EndianessBig);
   } catch (...) {
     Log::Error["data"] << "Failed to load 'gfxfast'";
     return false;
   }
 
   try {
-    gfxchip = std::make_shared<Buffer>(path + "/gfxchip", Buffer::EndianessBig);
-    gfxchip = decode(gfxchip);
-    gfxchip = unpack(gfxchip);
-    Log::Debug["data"] << "Data file 'gfxchip' loaded (size = "
-                       << gfxchip->get_size() << ")";
+    gfxchip = std::make_shared<MappedBuffer>(path + "/gfxchip",
+                                            Buffer::EndianessBig);
   } catch (...) {
     Log::Error["data"] << "Failed to load 'gfxchip'";
     return false;
   }
 
+  try {
+    sound = std::make_shared<MappedBuffer>(path + "/sounds");
+  } catch (...) {
+    Log::Warn["data"] << "Failed to load 'sounds'";
+    sound = nullptr;
+  }
+
+  size_t pics_size = 0;
+  try {
+    PBuffer gfxpics = std::make_shared<MappedBuffer>(path + "/gfxpics",
+                                                     Buffer::EndianessBig);
+    for (size_t i = 0; i < pics.size(); i++) {
+      uint32_t offset = gfxpics->pop<uint32_t>();
+      uint32_t size = gfxpics->pop<uint32_t>();
+      if (28*4 + offset + size > gfxpics->get_size()) {
+        throw ExceptionFreeserf("Picture out of file bounds");
+      }
+      pics[i] = gfxpics->get_subbuffer(28*4 + offset, size);
+    }
+    pics_size = gfxpics->get_size();
+  } catch (...) {
+    Log::Warn["data"] << "Failed to load 'gfxpics'";
+    pics.fill(nullptr);
+  }
+
+  // Files are scrambled and packed independently of each other, they are
+  // decoded in parallel. Sounds are not packed. Failed blocks are noted
+  // and reported here, only graphics in gfxfast and gfxchip are required.
+  std::vector<PBuffer*> blocks = { &gfxfast, &gfxchip, &sound };
+  for (PBuffer &pic : pics) {
+    blocks.push_back(&pic);
+  }
+  std::vector<char> failed(blocks.size(), 0);
+  ThreadPool::get_instance().parallel_for(blocks.size(), [&](size_t i) {
+    PBuffer &block = *blocks[i];
+    if (!block) {
+      return;
+    }
+    try {
+      block = decode(block);
+      if (&block != &sound) {
+        block = unpack(block);
+      }
+    } catch (...) {
+      block = nullptr;
+      failed[i] = 1;
+    }
+  });
+
+  if (failed[0]) {
+    Log::Error["data"] << "Failed to load 'gfxfast'";
+    return false;
+  }
+  if (failed[1]) {
+    Log::Error["data"] << "Failed to load 'gfxchip'";
+    return false;
+  }
+  if (failed[2]) {
+    Log::Warn["data"] << "Failed to load 'sounds'";
+  }
+  if (std::find(failed.begin() + 3, failed.end(), 1) != failed.end()) {
+    Log::Warn["data"] << "Failed to load 'gfxpics'";
+    pics.fill(nullptr);
+    pics_size = 0;
+  }
+
+  Log::Debug["data"] << "Data file 'gfxfast' loaded (size = "
+                     << gfxfast->get_size() << ")";
+  Log::Debug["data"] << "Data file 'gfxchip' loaded (size = "
+                     << gfxchip->get_size() << ")";
+  if (pics_size > 0) {
+    Log::Debug["data"] << "Data file 'gfxpics' loaded (size = "
+                       << pics_size << ")";
+  }
+
   PBuffer gfxheader;
   try {
-    gfxheader = std::make_shared<Buffer>(path + "/gfxheader",
-                                         Buffer::EndianessBig);
+    gfxheader = std::make_shared<MappedBuffer>(path + "/gfxheader",
+                                               Buffer::EndianessBig);
   } catch (...) {
     Log::Error["data"] << "Failed to load 'gfxheader'";
     return false;
@@ -343,30 +424,6 @@ DataSourceAmiga::load() {
     data_pointers[i] = data_pointers[i]->get_tail(black_offset);
   }
 
-  try {
-    sound = std::make_shared<Buffer>(path + "/sounds");
-    sound = decode(sound);
-  } catch (...) {
-    Log::Warn["data"] << "Failed to load 'sounds'";
-    sound = nullptr;
-  }
-
-  try {
-    PBuffer gfxpics = std::make_shared<Buffer>(path + "/gfxpics",
-                                               Buffer::EndianessBig);
-    for (size_t i = 0; i < 14; i++) {
-      uint32_t offset = gfxpics->pop<uint32_t>();
-      uint32_t size = gfxpics->pop<uint32_t>();
-      pics[i] = gfxpics->get_subbuffer(28*4 + offset, size);
-      pics[i] = decode(pics[i]);
-      pics[i] = unpack(pics[i]);
-    }
-    Log::Debug["data"] << "Data file 'gfxpics' loaded (size = "
-                       << gfxpics->get_size() << ")";
-  } catch (...) {
-    Log::Warn["data"] << "Failed to load 'gfxpics'";
-  }
-
   return load_animation_table(data_pointers[1]->get_subbuffer(0, 30528));
 }
 
@@ -733,7 +790,7 @@ DataSourceAmiga::get_music(size_t /*index*/) {
 
   PBuffer data;
   try {
-    data = std::make_shared<Buffer>(path + "/music");
+    data = std::make_shared<MappedBuffer>(path + "/music");
     data = decode(data);
     data = unpack(data);
   } catch (...) {
@@ -757,31 +814,54 @@ DataSourceAmiga::get_music(size_t /*index*/) {
 
 PBuffer
 DataSourceAmiga::decode(PBuffer data) {
-  PMutableBuffer result = std::make_shared<MutableBuffer>(data->get_size(),
+  size_t size = data->get_size();
+  const uint8_t *src = reinterpret_cast<const uint8_t*>(data->get_data());
+  PMutableBuffer result = std::make_shared<MutableBuffer>(size,
                                                           Buffer::EndianessBig);
-  for (size_t i = 0; i < data->get_size(); i++) {
-    result->push<uint8_t>(data->pop<uint8_t>() ^ static_cast<uint8_t>(i));
+  uint8_t *dst = reinterpret_cast<uint8_t*>(result->append(size));
+  for (size_t i = 0; i < size; i++) {
+    dst[i] = src[i] ^ static_cast<uint8_t>(i);
   }
   return result;
 }
 
+/* Runs are counted first, so that the result is allocated once. */
 PBuffer
 DataSourceAmiga::unpack(PBuffer data) {
+  size_t size = data->get_size();
+  const uint8_t *src = reinterpret_cast<const uint8_t*>(data->get_data());
   PMutableBuffer result = std::make_shared<MutableBuffer>(Buffer::EndianessBig);
-  uint8_t flag = data->pop<uint8_t>();
+  if (size == 0) {
+    return result;
+  }
 
-  while (data->readable()) {
-    uint8_t val = data->pop<uint8_t>();
+  uint8_t flag = src[0];
+  size_t res_size = 0;
+  for (size_t i = 1; i < size; i++) {
+    if (src[i] == flag) {
+      if (size - i < 3) {
+        throw ExceptionFreeserf("Run marker cut off by the end of data");
+      }
+      res_size += src[i + 1];
+      i += 2;
+    }
+    res_size++;
+  }
+
+  uint8_t *dst = reinterpret_cast<uint8_t*>(result->append(res_size));
+  uint8_t *dst_end = dst + res_size;
+  for (size_t i = 1; dst < dst_end; i++) {
+    uint8_t val = src[i];
     size_t count = 0;
 
     if (val == flag) {
-      count = data->pop<uint8_t>();
-      val = data->pop<uint8_t>();
+      count = src[i + 1];
+      val = src[i + 2];
+      i += 2;
     }
 
-    for (unsigned int i = 0; i < count + 1; i++) {
-      result->push<uint8_t>(val);
-    }
+    std::fill(dst, dst + count + 1, val);
+    dst += count + 1;
   }
 
   return result;
@@ -955,19 +1035,15 @@ DataSourceAmiga::decode_mask_sprite(PBuffer data, size_t width, size_t height) {
   PSpriteAmiga sprite = std::make_shared<SpriteAmiga>(width, height);
 
   size_t size = width/8 * height;
+  PBuffer bits = data->pop(size);
 
-  uint32_t *pixel = reinterpret_cast<uint32_t*>(sprite->get_data());
-  for (unsigned int i = 0 ; i < size ; i++) {
-    uint8_t byte = data->pop<uint8_t>();
-    for (unsigned int j = 0 ; j < 8; j++) {
-      if (((byte >> (7-j)) & 0x01) == 0x01) {
-        *pixel = 0xFFFFFFFF;
-      } else {
-        *pixel = 0x00000000;
-      }
-      pixel++;
-    }
-  }
+  static const Data::Sprite::Color colors[] = {
+    { 0x00, 0x00, 0x00, 0x00 }, { 0xFF, 0xFF, 0xFF, 0xFF }
+  };
+  const uint8_t *planes[] = { reinterpret_cast<uint8_t*>(bits->get_data()) };
+  const unsigned int shifts[] = { 0 };
+  planar_to_chunky(planes, shifts, 1, 0, colors, size,
+                   sprite->get_writable_data());
 
   return sprite;
 }
@@ -1154,6 +1230,81 @@ DataSourceAmiga::get_hud_sprite(size_t index) {
                                   hud_offsets[index * 4 + 3], 16, 0, palette2);
 }
 
+/* Bitplanes are converted eight pixels at once. Every byte of a plane is
+   spread by table to one bit in each byte of a 64 bit word, one byte per
+   pixel. Words of all planes, shifted to the bit of the color index that
+   the plane holds, are or-ed and the bytes looked up in the colors. */
+static const uint64_t *
+get_spread_table() {
+  static uint64_t table[256];
+  static bool initialized = [] {
+    for (unsigned int value = 0; value < 256; value++) {
+      uint64_t spread = 0;
+      for (unsigned int pixel = 0; pixel < 8; pixel++) {
+        spread |= static_cast<uint64_t>((value >> (7 - pixel)) & 0x01)
+                                                              << (pixel * 8);
+      }
+      table[value] = spread;
+    }
+    return true;
+  }();
+  (void)initialized;
+  return table;
+}
+
+void
+DataSourceAmiga::planar_to_chunky(const uint8_t **planes,
+                                  const unsigned int *shifts,
+                                  size_t plane_count, uint8_t constant,
+                                  const Data::Sprite::Color *colors,
+                                  size_t size, Data::Sprite::Color *res) {
+  const uint64_t *spread = get_spread_table();
+  const uint64_t base = 0x0101010101010101ull * constant;
+
+  for (size_t i = 0; i < size; i++) {
+    uint64_t indices = base;
+    for (size_t p = 0; p < plane_count; p++) {
+      indices |= spread[planes[p][i]] << shifts[p];
+    }
+    for (unsigned int pixel = 0; pixel < 8; pixel++) {
+      *res++ = colors[indices & 0xFF];
+      indices >>= 8;
+    }
+  }
+}
+
+/* Colors of the 5 bit indices, with index bits reversed if invert is set. */
+static void
+create_colors(const uint8_t *palette, bool invert,
+              Data::Sprite::Color *colors) {
+  for (uint8_t index = 0; index < 32; index++) {
+    uint8_t color = invert ? invert5bit(index) : index;
+    colors[index].red = palette[color*3+0];
+    colors[index].green = palette[color*3+1];
+    colors[index].blue = palette[color*3+2];
+    colors[index].alpha = 0xFF;
+  }
+}
+
+/* Planes present in the data and their bit of the color index, the bits of
+   compressed planes are set in constant according to filling. */
+static size_t
+get_plane_bits(uint8_t compression, uint8_t filling, unsigned int *shifts,
+               uint8_t *constant) {
+  size_t count = 0;
+  *constant = 0;
+  for (unsigned int b = 0; b < 5; b++) {
+    if ((compression >> b) & 0x01) {
+      if ((filling >> b) & 0x01) {
+        *constant |= 0x10 >> b;
+      }
+    } else {
+      shifts[count++] = 4 - b;
+    }
+  }
+  return count;
+}
+
 DataSourceAmiga::PSpriteAmiga
 DataSourceAmiga::decode_planned_sprite(PBuffer data, size_t width,
                                        size_t height,
@@ -1162,37 +1313,22 @@ DataSourceAmiga::decode_planned_sprite(PBuffer data, size_t width,
   PSpriteAmiga sprite = std::make_shared<SpriteAmiga>(width*8, height);
 
   uint8_t *src = reinterpret_cast<uint8_t*>(data->get_data());
-  Data::Sprite::Color *res = sprite->get_writable_data();
 
   size_t bps = width * height;  // bitplane size in bytes
 
-  for (size_t i = 0; i < bps; i++) {
-    for (int k = 7; k >= 0; k--) {
-      uint8_t color = 0;
-      int n = 0;
-      for (size_t b = 0; b < 5; b++) {
-        color = color << 1;
-        if ((compression >> b) & 0x01) {
-          if ((filling >> b) & 0x01) {
-            color |= 0x01;
-          }
-        } else {
-          color |= ((*(src+(n*bps)) >> k) & 0x01);
-          n++;
-        }
-      }
-      if (invert) {
-        color = invert5bit(color);
-      }
-      res->red = palette[color*3+0];    // R
-      res->green = palette[color*3+1];  // G
-      res->blue = palette[color*3+2];   // B
-      res->alpha = 0xFF;                // A
-      res++;
-    }
-    src++;
+  Data::Sprite::Color colors[32];
+  create_colors(palette, invert, colors);
+  unsigned int shifts[5];
+  uint8_t constant;
+  size_t count = get_plane_bits(compression, filling, shifts, &constant);
+  const uint8_t *planes[5];
+  for (size_t n = 0; n < count; n++) {
+    planes[n] = src + n*bps;
   }
 
+  planar_to_chunky(planes, shifts, count, constant, colors, bps,
+                   sprite->get_writable_data());
+
   return sprite;
 }
 
@@ -1208,34 +1344,21 @@ DataSourceAmiga::decode_interlased_sprite(PBuffer data, size_t width,
   uint8_t *src = reinterpret_cast<uint8_t*>(data->get_data());
   Data::Sprite::Color *res = sprite->get_writable_data();
 
+  Data::Sprite::Color colors[32];
+  create_colors(palette, true, colors);
+  unsigned int shifts[5];
+  uint8_t constant;
+  size_t count = get_plane_bits(compression, filling, shifts, &constant);
   size_t bpp = bitplane_count_from_compression(compression);
 
   for (size_t y = 0; y < height; y++) {
-    for (size_t i = 0; i < width; i++) {
-      for (int k = 7; k >= 0; k--) {
-        uint8_t color = 0;
-        int n = 0;
-        for (size_t b = 0; b < 5; b++) {
-          color = color << 1;
-          if ((compression >> b) & 0x01) {
-            if ((filling >> b) & 0x01) {
-              color |= 0x01;
-            }
-          } else {
-            color |= ((*(src+(n*width)+((skip_lines*width*y))) >> k) & 0x01);
-            n++;
-          }
-        }
-        color = invert5bit(color);
-        res->red = palette[color*3+0];    // R
-        res->green = palette[color*3+1];  // G
-        res->blue = palette[color*3+2];   // B
-        res->alpha = 0xFF;                // A
-        res++;
-      }
-      src++;
+    const uint8_t *planes[5];
+    for (size_t n = 0; n < count; n++) {
+      planes[n] = src + (n*width) + (skip_lines*width*y);
     }
-    src += (bpp-1) * width;
+    planar_to_chunky(planes, shifts, count, constant, colors, width, res);
+    res += width * 8;
+    src += bpp * width;
   }
 
   return sprite;
@@ -1251,26 +1374,16 @@ DataSourceAmiga::decode_amiga_sprite(PBuffer data, size_t width, size_t height,
   uint8_t *src_2 = src_1 + bp2s;
   Data::Sprite::Color *res = sprite->get_writable_data();
 
+  Data::Sprite::Color colors[32];
+  create_colors(palette, false, colors);
+  const unsigned int shifts[] = { 0, 1, 2, 3 };
+
   for (size_t y = 0; y < height; y++) {
-    for (size_t i = 0; i < width; i++) {
-      for (int k = 7; k >= 0; k--) {
-        uint8_t color = 0;
-        color |= (((*src_1) >> k) & 0x01) << 0;
-        color |= (((*(src_1 + width)) >> k) & 0x01) << 1;
-        color |= (((*src_2) >> k) & 0x01) << 2;
-        color |= (((*(src_2 + width)) >> k) & 0x01) << 3;
-        color |= 0x10;
-        res->red = palette[color*3+0];    // R
-        res->green = palette[color*3+1];  // G
-        res->blue = palette[color*3+2];   // B
-        res->alpha = 0xFF;                // A
-        res++;
-      }
-      src_1++;
-      src_2++;
-    }
-    src_1 += width;
-    src_2 += width;
+    const uint8_t *planes[] = { src_1, src_1 + width, src_2, src_2 + width };
+    planar_to_chunky(planes, shifts, 4, 0x10, colors, width, res);
+    res += width * 8;
+    src_1 += 2 * width;
+    src_2 += 2 * width;
   }
 
   return sprite;
@@ -63,6 +63,7 @@ class DataSourceAmiga : public DataSourceLegacy {
 
   virtual bool check();
   virtual bool load();
+  virtual std::vector<std::string> get_files() const;
 
   virtual Data::MaskImage get_sprite_parts(Data::Resource res, size_t index);
 
@@ -70,6 +71,14 @@ class DataSourceAmiga : public DataSourceLegacy {
   virtual Data::MusicFormat get_music_format() { return Data::MusicFormatMod; }
   virtual PBuffer get_music(size_t index);
 
+ protected:
+  PBuffer unpack(PBuffer data);
+  static void planar_to_chunky(const uint8_t **planes,
+                               const unsigned int *shifts, size_t plane_count,
+                               uint8_t constant,
+                               const Data::Sprite::Color *colors, size_t size,
+                               Data::Sprite::Color *res);
+
  private:
   PBuffer gfxfast;
   PBuffer gfxchip;
@@ -82,7 +91,6 @@ class DataSourceAmiga : public DataSourceLegacy {
   std::vector<size_t> icon_catalog;
 
   PBuffer decode(PBuffer data);
-  PBuffer unpack(PBuffer data);
 
   PBuffer get_data_from_catalog(size_t catalog, size_t index, PBuffer base);
 
@@ -21,6 +21,7 @@
 
 #include "src/data-source-custom.h"
 
+#include <fstream>
 #include <iomanip>
 #include <memory>
 #include <vector>
@@ -56,14 +57,66 @@ DataSourceCustom::load() {
   scale = meta_main->value("general", "scale", 1);
   name = meta_main->value("general", "name", "Unnamed");
 
+  for (int r = Data::AssetArtLandscape; r <= Data::AssetCursor; r++) {
+    Data::Resource res = static_cast<Data::Resource>(r);
+    ResInfo info = read_info(*meta_main, res);
+    if (info.meta) {
+      infos[res] = std::move(info);
+    }
+  }
+
   loaded = load_animation_table();
 
   return loaded;
 }
 
+// Every file the source reads: meta files, animation tables, sprite images
+// and masks, sounds and music. Works before load(), files named by the meta
+// files are listed whether they are there or not.
+std::vector<std::string>
+DataSourceCustom::get_files() const {
+  std::vector<std::string> files = { path + "/meta.ini" };
+
+  ConfigFile meta;
+  if (!meta.load(path + "/meta.ini")) {
+    return files;
+  }
+
+  for (int r = Data::AssetArtLandscape; r <= Data::AssetCursor; r++) {
+    Data::Resource res = static_cast<Data::Resource>(r);
+    ResInfo info = read_info(meta, res);
+    files.push_back(info.path + "/meta.ini");
+    if (!info.meta) {
+      continue;
+    }
+
+    for (size_t i = 0; i < Data::get_resource_count(res); i++) {
+      std::stringstream stream;
+      stream << std::setfill('0') << std::setw(3) << i;
+      std::string section = stream.str();
+      if (res == Data::AssetAnimation) {
+        files.push_back(info.path + "/" + section + ".ini");
+      } else if ((res == Data::AssetSound) || (res == Data::AssetMusic)) {
+        files.push_back(info.path + "/" +
+                        info.meta->value(section, "path", section));
+      } else {
+        for (const char *name : { "image_path", "mask_path" }) {
+          std::string file_name = info.meta->value(section, name,
+                                                   std::string());
+          if (!file_name.empty()) {
+            files.push_back(info.path + "/" + file_name);
+          }
+        }
+      }
+    }
+  }
+
+  return files;
+}
+
 Data::MaskImage
 DataSourceCustom::get_sprite_parts(Data::Resource res, size_t index) {
-  ResInfo *info = get_info(res);
+  const ResInfo *info = get_info(res);
   if (info == nullptr) {
     return std::make_tuple(nullptr, nullptr);
   }
@@ -110,7 +163,7 @@ DataSourceCustom::get_sprite_parts(Data::Resource res, size_t index) {
 
 PBuffer
 DataSourceCustom::get_sound(size_t index) {
-  ResInfo *info = get_info(Data::AssetSound);
+  const ResInfo *info = get_info(Data::AssetSound);
   if (info == nullptr) {
     return nullptr;
   }
@@ -130,7 +183,7 @@ DataSourceCustom::get_sound(size_t index) {
 
 PBuffer
 DataSourceCustom::get_music(size_t index) {
-  ResInfo *info = get_info(Data::AssetMusic);
+  const ResInfo *info = get_info(Data::AssetMusic);
   if (info == nullptr) {
     return nullptr;
   }
@@ -148,30 +201,37 @@ DataSourceCustom::get_music(size_t index) {
   }
 }
 
-DataSourceCustom::ResInfo *
-DataSourceCustom::get_info(Data::Resource res) {
-  if (infos.find(res) == infos.end()) {
-    std::string dir_name = meta_main->value("resources",
-                                            Data::get_resource_name(res),
-                                            Data::get_resource_name(res));
-    std::string dir_path = path + "/" + dir_name;
-
-    PConfigFile meta = std::make_shared<ConfigFile>();
-    if (!meta->load(dir_path + "/meta.ini")) {
-      return nullptr;
+// Locate the directory of a resource and read its meta file. The meta file
+// is left empty if there is none, sources may leave out resources.
+DataSourceCustom::ResInfo
+DataSourceCustom::read_info(const ConfigFile &meta, Data::Resource res) const {
+  std::string dir_name = meta.value("resources",
+                                    Data::get_resource_name(res),
+                                    Data::get_resource_name(res));
+  ResInfo info;
+  info.path = path + "/" + dir_name;
+  std::ifstream file(info.path + "/meta.ini");
+  if (file.is_open()) {
+    info.meta = std::make_shared<ConfigFile>();
+    if (!info.meta->read(&file)) {
+      info.meta = nullptr;
     }
-    ResInfo info;
-    info.meta = std::move(meta);
-    info.path = std::move(dir_path);
-    infos[res] = info;
   }
+  return info;
+}
 
-  return &infos[res];
+const DataSourceCustom::ResInfo *
+DataSourceCustom::get_info(Data::Resource res) const {
+  auto it = infos.find(res);
+  if (it == infos.end()) {
+    return nullptr;
+  }
+  return &it->second;
 }
 
 bool
 DataSourceCustom::load_animation_table() {
-  ResInfo *info = get_info(Data::AssetAnimation);
+  const ResInfo *info = get_info(Data::AssetAnimation);
   if (info == nullptr) {
     return false;
   }
@@ -24,6 +24,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "src/data-source.h"
 #include "src/configfile.h"
@@ -39,6 +40,8 @@ class DataSourceCustom : public DataSourceBase {
   PConfigFile meta_main;
   unsigned int scale;
   std::string name;
+  // Filled by load() and only read afterwards, so sprites can be loaded
+  // from several threads.
   std::map<Data::Resource, ResInfo> infos;
 
  public:
@@ -51,6 +54,7 @@ class DataSourceCustom : public DataSourceBase {
 
   virtual bool check();
   virtual bool load();
+  virtual std::vector<std::string> get_files() const;
 
   virtual Data::MaskImage get_sprite_parts(Data::Resource res, size_t index);
 
@@ -58,7 +62,8 @@ class DataSourceCustom : public DataSourceBase {
   virtual PBuffer get_music(size_t index);
 
  protected:
-  ResInfo *get_info(Data::Resource res);
+  ResInfo read_info(const ConfigFile &meta, Data::Resource res) const;
+  const ResInfo *get_info(Data::Resource res) const;
   bool load_animation_table();
 };
 
@@ -109,6 +109,7 @@ class DataSourceDOS : public DataSourceLegacy {
 
   virtual bool check();
   virtual bool load();
+  virtual std::vector<std::string> get_files() const { return { path }; }
 
   virtual Data::MaskImage get_sprite_parts(Data::Resource res, size_t index);
 
@@ -0,0 +1,408 @@
+/*
+ * data-source-pack.cc - Preprocessed asset pack data source
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/data-source-pack.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "src/buffer.h"
+#include "src/log.h"
+
+#define PACK_VERSION      2
+#define PACK_HEADER_SIZE  72
+#define PACK_NAME_SIZE    40
+#define PACK_ENTRY_SIZE   32
+#define PACK_ALIGNMENT    16
+
+const char *DataSourcePack::file_name = "freeserf.pack";
+
+DataSourcePack::SpritePack::SpritePack(PBuffer _pack, const Entry &entry)
+  : pack(_pack) {
+  delta_x = entry.delta_x;
+  delta_y = entry.delta_y;
+  offset_x = entry.offset_x;
+  offset_y = entry.offset_y;
+  width = entry.width;
+  height = entry.height;
+  data = reinterpret_cast<uint8_t*>(pack->get_data()) + entry.offset;
+}
+
+DataSourcePack::SpritePack::~SpritePack() {
+  if (pack) {
+    data = nullptr;
+  }
+}
+
+void
+DataSourcePack::SpritePack::detach() {
+  if (!pack) {
+    return;
+  }
+
+  uint8_t *pixels = data;
+  data = nullptr;
+  create(width, height);
+  std::copy(pixels, pixels + width * height * 4, data);
+  pack = nullptr;
+}
+
+void
+DataSourcePack::SpritePack::fill(Sprite::Color color) {
+  detach();
+  SpriteBase::fill(color);
+}
+
+void
+DataSourcePack::SpritePack::fill_masked(Sprite::Color color) {
+  detach();
+  SpriteBase::fill_masked(color);
+}
+
+void
+DataSourcePack::SpritePack::add(Data::PSprite other) {
+  detach();
+  SpriteBase::add(other);
+}
+
+void
+DataSourcePack::SpritePack::del(Data::PSprite other) {
+  detach();
+  SpriteBase::del(other);
+}
+
+void
+DataSourcePack::SpritePack::blend(Data::PSprite other) {
+  detach();
+  SpriteBase::blend(other);
+}
+
+void
+DataSourcePack::SpritePack::make_alpha_mask() {
+  detach();
+  SpriteBase::make_alpha_mask();
+}
+
+void
+DataSourcePack::SpritePack::stick(Data::PSprite sticker, unsigned int x,
+                                  unsigned int y) {
+  detach();
+  SpriteBase::stick(sticker, x, y);
+}
+
+DataSourcePack::DataSourcePack(const std::string &_path)
+  : DataSourceBase(_path)
+  , name("Pack")
+  , scale(1)
+  , bpp(32)
+  , music_format(Data::MusicFormatNone)
+  , source_stamp(0) {
+}
+
+DataSourcePack::~DataSourcePack() {
+}
+
+bool
+DataSourcePack::check() {
+  return check_file(path + "/" + file_name);
+}
+
+bool
+DataSourcePack::load() {
+  std::string file_path = path + "/" + file_name;
+  try {
+    pack = std::make_shared<MappedBuffer>(file_path, Buffer::EndianessLittle);
+  } catch (...) {
+    return false;
+  }
+
+  if (pack->get_size() < PACK_HEADER_SIZE) {
+    Log::Error["data"] << "Asset pack '" << file_path << "' is truncated";
+    return false;
+  }
+
+  std::string magic = *pack->get_subbuffer(0, 4);
+  if (magic != "FSPK") {
+    Log::Error["data"] << "'" << file_path << "' is not an asset pack";
+    return false;
+  }
+
+  PBuffer header = pack->get_subbuffer(4, PACK_HEADER_SIZE - 4);
+  unsigned int version = header->pop<uint32_t>();
+  if (version != PACK_VERSION) {
+    Log::Error["data"] << "Asset pack '" << file_path << "' has version "
+                       << version << ", expected " << PACK_VERSION;
+    return false;
+  }
+  scale = header->pop<uint32_t>();
+  bpp = header->pop<uint32_t>();
+  music_format = static_cast<Data::MusicFormat>(header->pop<uint32_t>());
+  size_t count = header->pop<uint32_t>();
+  name = *header->pop(PACK_NAME_SIZE);
+  name = name.substr(0, name.find('\0'));
+  source_stamp = header->pop<uint64_t>();
+
+  size_t index_end = PACK_HEADER_SIZE + count * PACK_ENTRY_SIZE;
+  if (pack->get_size() < index_end) {
+    Log::Error["data"] << "Asset pack '" << file_path << "' is truncated";
+    return false;
+  }
+  payload = pack->get_tail(index_end);
+
+  PBuffer index = pack->get_subbuffer(PACK_HEADER_SIZE,
+                                      count * PACK_ENTRY_SIZE);
+  entries.clear();
+  for (size_t i = 0; i < count; i++) {
+    Data::Resource res = static_cast<Data::Resource>(index->pop<uint16_t>());
+    Part part = static_cast<Part>(index->pop<uint16_t>());
+    size_t sprite_index = index->pop<uint32_t>();
+    Entry entry;
+    entry.delta_x = index->pop<int16_t>();
+    entry.delta_y = index->pop<int16_t>();
+    entry.offset_x = index->pop<int16_t>();
+    entry.offset_y = index->pop<int16_t>();
+    entry.width = index->pop<uint32_t>();
+    entry.height = index->pop<uint32_t>();
+    entry.offset = index->pop<uint32_t>();
+    entry.size = index->pop<uint32_t>();
+    if (entry.offset + entry.size > payload->get_size()) {
+      Log::Error["data"] << "Asset pack '" << file_path
+                         << "' has entry out of bounds";
+      return false;
+    }
+    entries[get_key(res, part, sprite_index)] = entry;
+  }
+
+  loaded = load_animation_table();
+
+  return loaded;
+}
+
+Data::MaskImage
+DataSourcePack::get_sprite_parts(Data::Resource res, size_t index) {
+  return std::make_tuple(get_sprite_part(res, PartMask, index),
+                         get_sprite_part(res, PartImage, index));
+}
+
+PBuffer
+DataSourcePack::get_sound(size_t index) {
+  return get_payload(Data::AssetSound, PartSound, index);
+}
+
+PBuffer
+DataSourcePack::get_music(size_t index) {
+  return get_payload(Data::AssetMusic, PartMusic, index);
+}
+
+uint64_t
+DataSourcePack::get_key(Data::Resource res, Part part, size_t index) {
+  return (static_cast<uint64_t>(res) << 48) |
+         (static_cast<uint64_t>(part) << 32) |
+         static_cast<uint64_t>(index);
+}
+
+const DataSourcePack::Entry *
+DataSourcePack::get_entry(Data::Resource res, Part part, size_t index) const {
+  auto it = entries.find(get_key(res, part, index));
+  if (it == entries.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+Data::PSprite
+DataSourcePack::get_sprite_part(Data::Resource res, Part part, size_t index) {
+  const Entry *entry = get_entry(res, part, index);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  return std::make_shared<SpritePack>(payload, *entry);
+}
+
+PBuffer
+DataSourcePack::get_payload(Data::Resource res, Part part, size_t index) {
+  const Entry *entry = get_entry(res, part, index);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  return payload->get_subbuffer(entry->offset, entry->size);
+}
+
+bool
+DataSourcePack::load_animation_table() {
+  animation_table.clear();
+  for (size_t i = 0; i < Data::get_resource_count(Data::AssetAnimation); i++) {
+    PBuffer data = get_payload(Data::AssetAnimation, PartAnimation, i);
+    if (!data) {
+      Log::Error["data"] << "Asset pack has no animation #" << i;
+      return false;
+    }
+    std::vector<Data::Animation> animations;
+    while (data->readable()) {
+      Data::Animation animation;
+      animation.sprite = data->pop<int32_t>();
+      animation.x = data->pop<int32_t>();
+      animation.y = data->pop<int32_t>();
+      animations.push_back(animation);
+    }
+    animation_table.push_back(animations);
+  }
+
+  return true;
+}
+
+bool
+DataSourcePack::create(Data::PSource source, const std::string &file_path) {
+  MutableBuffer index(Buffer::EndianessLittle);
+  MutableBuffer data(Buffer::EndianessLittle);
+  size_t count = 0;
+
+  auto add_entry = [&](Data::Resource res, Part part, size_t i,
+                       Data::PSprite sprite, PBuffer buffer) {
+    size_t padding = (PACK_ALIGNMENT - (data.get_size() % PACK_ALIGNMENT)) %
+                     PACK_ALIGNMENT;
+    data.push<uint8_t>(0, padding);
+    size_t offset = data.get_size();
+    if (sprite) {
+      data.push(static_cast<const void*>(sprite->get_data()),
+                sprite->get_width() * sprite->get_height() * 4);
+    } else {
+      data.push(buffer);
+    }
+
+    index.push<uint16_t>(res);
+    index.push<uint16_t>(part);
+    index.push<uint32_t>(static_cast<uint32_t>(i));
+    index.push<int16_t>(sprite ? sprite->get_delta_x() : 0);
+    index.push<int16_t>(sprite ? sprite->get_delta_y() : 0);
+    index.push<int16_t>(sprite ? sprite->get_offset_x() : 0);
+    index.push<int16_t>(sprite ? sprite->get_offset_y() : 0);
+    index.push<uint32_t>(sprite ? sprite->get_width() : 0);
+    index.push<uint32_t>(sprite ? sprite->get_height() : 0);
+    index.push<uint32_t>(static_cast<uint32_t>(offset));
+    index.push<uint32_t>(static_cast<uint32_t>(data.get_size() - offset));
+    count++;
+  };
+
+  for (int r = Data::AssetArtLandscape; r <= Data::AssetCursor; r++) {
+    Data::Resource res = static_cast<Data::Resource>(r);
+    for (size_t i = 0; i < Data::get_resource_count(res); i++) {
+      switch (Data::get_resource_type(res)) {
+        case Data::TypeSprite: {
+          Data::MaskImage parts = source->get_sprite_parts(res, i);
+          if (std::get<0>(parts)) {
+            add_entry(res, PartMask, i, std::get<0>(parts), nullptr);
+          }
+          if (std::get<1>(parts)) {
+            add_entry(res, PartImage, i, std::get<1>(parts), nullptr);
+          }
+          break;
+        }
+        case Data::TypeAnimation: {
+          MutableBuffer animations(Buffer::EndianessLittle);
+          for (size_t j = 0; j < source->get_animation_phase_count(i); j++) {
+            Data::Animation animation = source->get_animation(i, j);
+            animations.push<int32_t>(animation.sprite);
+            animations.push<int32_t>(animation.x);
+            animations.push<int32_t>(animation.y);
+          }
+          add_entry(res, PartAnimation, i, nullptr,
+                    std::make_shared<Buffer>(animations.get_data(),
+                                             animations.get_size()));
+          break;
+        }
+        case Data::TypeSound: {
+          PBuffer sound = source->get_sound(i);
+          if (sound) {
+            add_entry(res, PartSound, i, nullptr, sound);
+          }
+          break;
+        }
+        case Data::TypeMusic: {
+          PBuffer music = source->get_music(i);
+          if (music) {
+            add_entry(res, PartMusic, i, nullptr, music);
+          }
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+
+  std::string source_name = source->get_name();
+  source_name.resize(PACK_NAME_SIZE, '\0');
+
+  MutableBuffer file(Buffer::EndianessLittle);
+  file.push("FSPK");
+  file.push<uint32_t>(PACK_VERSION);
+  file.push<uint32_t>(source->get_scale());
+  file.push<uint32_t>(source->get_bpp());
+  file.push<uint32_t>(source->get_music_format());
+  file.push<uint32_t>(static_cast<uint32_t>(count));
+  file.push(source_name);
+  file.push<uint64_t>(get_stamp(source));
+  file.push(index.get_data(), index.get_size());
+  file.push(data.get_data(), data.get_size());
+
+  Log::Info["data"] << "Writing " << count << " entries, "
+                    << file.get_size() << " bytes to '" << file_path << "'";
+
+  return file.write(file_path);
+}
+
+bool
+DataSourcePack::is_built_from(Data::PSource source) const {
+  return (get_stamp(source) == source_stamp);
+}
+
+// FNV-1a hash of file names, sizes and modification times.
+uint64_t
+DataSourcePack::get_stamp(Data::PSource source) {
+  uint64_t stamp = 0xcbf29ce484222325ull;
+  auto mix = [&stamp](const void *data, size_t size) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+      stamp = (stamp ^ bytes[i]) * 0x100000001b3ull;
+    }
+  };
+
+  for (const std::string &file : source->get_files()) {
+    std::string base_name = file.substr(file.find_last_of("/\\") + 1);
+    mix(base_name.data(), base_name.size());
+
+    struct stat info;
+    int64_t values[2] = { -1, -1 };
+    if (stat(file.c_str(), &info) == 0) {
+      values[0] = static_cast<int64_t>(info.st_size);
+      values[1] = static_cast<int64_t>(info.st_mtime);
+    }
+    mix(values, sizeof(values));
+  }
+
+  return stamp;
+}
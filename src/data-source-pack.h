@@ -0,0 +1,142 @@
+/*
+ * data-source-pack.h - Preprocessed asset pack data source
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_DATA_SOURCE_PACK_H_
+#define SRC_DATA_SOURCE_PACK_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "src/data-source.h"
+
+// Game data already decoded by another data source and stored in a single
+// file, that is mapped into memory on load.
+//
+// The file is little endian and starts with a 72 byte header, followed by
+// the index table and the payload area:
+//
+//   header:  "FSPK", version, scale, bpp, music format, entry count (uint32),
+//            source name (40 chars, zero padded) and source stamp (uint64)
+//   entry:   resource (uint16), part (uint16), index (uint32),
+//            delta x, delta y, offset x, offset y (int16),
+//            width, height, payload offset, payload size (uint32)
+//
+// Sprites are stored as BGRA pixels with mask and image parts separated,
+// exactly as returned by get_sprite_parts() of the original source. Sounds
+// and music are stored converted, animations as (sprite, x, y) triples of
+// int32. Payload offsets are relative to the end of the index table and
+// aligned to 16 bytes.
+//
+// The source stamp identifies the files the pack was built from by their
+// names, sizes and modification times. A pack is only used in place of
+// data that is next to it when that data still has the same stamp.
+class DataSourcePack : public DataSourceBase {
+ public:
+  typedef enum Part {
+    PartImage = 0,
+    PartMask,
+    PartSound,
+    PartMusic,
+    PartAnimation,
+  } Part;
+
+  typedef struct Entry {
+    int delta_x;
+    int delta_y;
+    int offset_x;
+    int offset_y;
+    unsigned int width;
+    unsigned int height;
+    size_t offset;
+    size_t size;
+  } Entry;
+
+  // Sprite with pixels in the mapped pack. The pixels are copied on the
+  // first modification, so the pack is never written.
+  class SpritePack : public SpriteBase {
+   protected:
+    PBuffer pack;
+
+   public:
+    SpritePack(PBuffer pack, const Entry &entry);
+    virtual ~SpritePack();
+
+    virtual void fill(Sprite::Color color);
+    virtual void fill_masked(Sprite::Color color);
+    virtual void add(Data::PSprite other);
+    virtual void del(Data::PSprite other);
+    virtual void blend(Data::PSprite other);
+    virtual void make_alpha_mask();
+    virtual void stick(Data::PSprite sticker, unsigned int x, unsigned int y);
+
+   protected:
+    void detach();
+  };
+
+ protected:
+  std::string name;
+  unsigned int scale;
+  unsigned int bpp;
+  Data::MusicFormat music_format;
+  uint64_t source_stamp;
+  PBuffer pack;
+  PBuffer payload;
+  std::map<uint64_t, Entry> entries;
+
+ public:
+  explicit DataSourcePack(const std::string &path);
+  virtual ~DataSourcePack();
+
+  static const char *file_name;
+
+  virtual std::string get_name() const { return name; }
+  virtual unsigned int get_scale() const { return scale; }
+  virtual unsigned int get_bpp() const { return bpp; }
+
+  virtual bool check();
+  virtual bool load();
+  virtual std::vector<std::string> get_files() const {
+    return { path + "/" + file_name }; }
+
+  virtual Data::MaskImage get_sprite_parts(Data::Resource res, size_t index);
+
+  virtual PBuffer get_sound(size_t index);
+  virtual Data::MusicFormat get_music_format() { return music_format; }
+  virtual PBuffer get_music(size_t index);
+
+  // Decode every resource of loaded source and write it to a pack file.
+  static bool create(Data::PSource source, const std::string &file_path);
+
+  // Whether the pack was built from the files of source as they are now.
+  bool is_built_from(Data::PSource source) const;
+  static uint64_t get_stamp(Data::PSource source);
+
+ protected:
+  static uint64_t get_key(Data::Resource res, Part part, size_t index);
+  const Entry *get_entry(Data::Resource res, Part part, size_t index) const;
+  Data::PSprite get_sprite_part(Data::Resource res, Part part, size_t index);
+  PBuffer get_payload(Data::Resource res, Part part, size_t index);
+  bool load_animation_table();
+};
+
+#endif  // SRC_DATA_SOURCE_PACK_H_
@@ -25,10 +25,12 @@
 #include <sys/stat.h>
 
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 
 #include "src/freeserf_endian.h"
 #include "src/log.h"
+#include "src/pixel-kernels.h"
 #include "src/tpwm.h"
 #include "src/data.h"
 #include "src/sfx2wav.h"
@@ -122,14 +124,17 @@ SpriteBase::get_masked(Data::PSprite mask) {
 
   uint32_t *m_pos = reinterpret_cast<uint32_t*>(mask->get_data());
 
+  const PixelKernels &kernels = PixelKernels::get_instance();
+  size_t masked_width = masked->get_width();
   for (size_t y = 0; y < masked->get_height(); y++) {
-    for (size_t x = 0; x < masked->get_width(); x++) {
-      if (s_pos >= s_end) {
-        s_pos = s_beg;
-      }
-      *pos++ = *s_pos++ & *m_pos++;
+    // Only the start of a row can be past the end of the sprite.
+    if (s_pos >= s_end) {
+      s_pos = s_beg;
     }
-    s_pos += s_delta;
+    kernels.mask(pos, s_pos, m_pos, masked_width);
+    pos += masked_width;
+    m_pos += masked_width;
+    s_pos += masked_width + s_delta;
   }
 
   return masked;
@@ -147,13 +152,7 @@ SpriteBase::create_mask(Data::PSprite other) {
   uint32_t *src2 = reinterpret_cast<uint32_t*>(other->get_data());
   uint32_t *res = reinterpret_cast<uint32_t*>(result->get_data());
 
-  for (unsigned int i = 0; i < width * height; i++) {
-    if (*src1++ == *src2++) {
-      *res++ = 0x00000000;
-    } else {
-      *res++ = 0xFFFFFFFF;
-    }
-  }
+  PixelKernels::get_instance().compare(res, src1, src2, width * height);
 
   return result;
 }
@@ -168,14 +167,10 @@ SpriteBase::fill(Data::Sprite::Color color) {
 
 void
 SpriteBase::fill_masked(Data::Sprite::Color color) {
-  Data::Sprite::Color *res = reinterpret_cast<Data::Sprite::Color*>(data);
-
-  for (unsigned int i = 0; i < width * height; i++) {
-    if ((res->alpha & 0xFF) != 0x00) {
-      *res = color;
-    }
-    res++;
-  }
+  uint32_t value;
+  std::memcpy(&value, &color, sizeof(value));
+  PixelKernels::get_instance().fill_masked(reinterpret_cast<uint32_t*>(data),
+                                           value, width * height);
 }
 
 void
@@ -187,11 +182,7 @@ SpriteBase::add(Data::PSprite other) {
   uint32_t *src = reinterpret_cast<uint32_t*>(other->get_data());
   uint32_t *res = reinterpret_cast<uint32_t*>(data);
 
-  for (unsigned int i = 0; i < width * height; i++) {
-    *res++ += *src++;
-  }
-
-  return;
+  PixelKernels::get_instance().add(res, src, width * height);
 }
 
 void
@@ -203,14 +194,7 @@ SpriteBase::del(Data::PSprite other) {
   uint32_t *src = reinterpret_cast<uint32_t*>(other->get_data());
   uint32_t *res = reinterpret_cast<uint32_t*>(data);
 
-  for (unsigned int i = 0; i < width * height; i++) {
-    if (*src++ == 0xFFFFFFFF) {
-      *res = 0x00000000;
-    }
-    res++;
-  }
-
-  return;
+  PixelKernels::get_instance().del(res, src, width * height);
 }
 
 void
@@ -219,40 +203,10 @@ SpriteBase::blend(Data::PSprite other) {
     return;
   }
 
-#define UNMULTIPLY(color, a) ((0xFF * (color)) / (a))
-#define BLEND(back, front, a) (((front) * (a)) + ((back) * (0xFF - (a)))) / 0xFF
-
-  Color *c = reinterpret_cast<Color*>(data);
-  Color *o = reinterpret_cast<Color*>(other->get_data());
-  for (unsigned int i = 0; i < width * height; i++) {
-    const uint32_t alpha = o->alpha;
-
-    if (alpha == 0x00) {
-      c++;
-      o++;
-      continue;
-    }
-
-    if (alpha == 0xFF) {
-      *c++ = *o++;
-      continue;
-    }
-
-    const uint8_t backR = c->red;
-    const uint8_t backG = c->green;
-    const uint8_t backB = c->blue;
-
-    const uint8_t frontR = UNMULTIPLY(o->red, alpha);
-    const uint8_t frontG = UNMULTIPLY(o->green, alpha);
-    const uint8_t frontB = UNMULTIPLY(o->blue, alpha);
-
-    const uint32_t R = BLEND(backR, frontR, alpha);
-    const uint32_t G = BLEND(backG, frontG, alpha);
-    const uint32_t B = BLEND(backB, frontB, alpha);
+  uint32_t *src = reinterpret_cast<uint32_t*>(other->get_data());
+  uint32_t *res = reinterpret_cast<uint32_t*>(data);
 
-    *c++ = {(uint8_t)B, (uint8_t)G, (uint8_t)R, 0xFF};
-    o++;
-  }
+  PixelKernels::get_instance().blend(res, src, width * height);
 
   delta_x = other->get_delta_x();
   delta_y = other->get_delta_y();
@@ -260,28 +214,8 @@ SpriteBase::blend(Data::PSprite other) {
 
 void
 SpriteBase::make_alpha_mask() {
-  Color *c = reinterpret_cast<Color*>(data);
-  uint8_t min = 0xFF;
-  for (unsigned int i = 0; i < width * height; i++) {
-    if (c->alpha != 0x00) {
-      c->alpha = 0xff - static_cast<uint8_t>((0.21 * c->red) +
-                                             (0.72 * c->green) +
-                                             (0.07 * c->blue));
-      c->red = 0;
-      c->green = 0;
-      c->blue = 0;
-      min = std::min(min, c->alpha);
-    }
-    c++;
-  }
-
-  c = reinterpret_cast<Color*>(data);
-  for (unsigned int i = 0; i < width * height; i++) {
-    if (c->alpha != 0x00) {
-      c->alpha = c->alpha - min;
-    }
-    c++;
-  }
+  PixelKernels::get_instance().alpha_mask(reinterpret_cast<uint32_t*>(data),
+                                          width * height);
 }
 
 void
@@ -307,6 +241,63 @@ SpriteBase::stick(Data::PSprite sticker, unsigned int dx, unsigned int dy) {
   delta_y = sticker->get_delta_y();
 }
 
+static int
+floor_div(int value, int divisor) {
+  return (value >= 0) ? value / divisor : -((divisor - 1 - value) / divisor);
+}
+
+// Every pixel of the result is the average of a square of 2^level pixels,
+// weighted by their alpha, so that transparent pixels do not darken the
+// edges. Offsets and deltas are reduced to match.
+Data::PSprite
+SpriteBase::get_reduced(unsigned int level) {
+  size_t size = static_cast<size_t>(1) << level;
+  size_t w = (width + size - 1) >> level;
+  size_t h = (height + size - 1) >> level;
+  std::shared_ptr<SpriteBase> result = std::make_shared<SpriteBase>(
+                                                static_cast<unsigned int>(w),
+                                                static_cast<unsigned int>(h));
+  int divisor = 1 << level;
+  result->delta_x = floor_div(delta_x, divisor);
+  result->delta_y = floor_div(delta_y, divisor);
+  result->offset_x = floor_div(offset_x, divisor);
+  result->offset_y = floor_div(offset_y, divisor);
+
+  const Color *src = reinterpret_cast<const Color*>(data);
+  Color *dst = reinterpret_cast<Color*>(result->data);
+  for (size_t y = 0; y < h; y++) {
+    size_t y_end = std::min(height, (y + 1) << level);
+    for (size_t x = 0; x < w; x++) {
+      size_t x_end = std::min(width, (x + 1) << level);
+      unsigned int blue = 0;
+      unsigned int green = 0;
+      unsigned int red = 0;
+      unsigned int alpha = 0;
+      for (size_t sy = y << level; sy < y_end; sy++) {
+        const Color *pixel = src + sy * width + (x << level);
+        for (size_t sx = x << level; sx < x_end; sx++, pixel++) {
+          blue += pixel->blue * pixel->alpha;
+          green += pixel->green * pixel->alpha;
+          red += pixel->red * pixel->alpha;
+          alpha += pixel->alpha;
+        }
+      }
+      Color *out = dst + y * w + x;
+      if (alpha == 0) {
+        *out = {0, 0, 0, 0};
+        continue;
+      }
+      out->blue = static_cast<unsigned char>(blue / alpha);
+      out->green = static_cast<unsigned char>(green / alpha);
+      out->red = static_cast<unsigned char>(red / alpha);
+      // Pixels past the edge of the sprite count as transparent.
+      out->alpha = static_cast<unsigned char>(alpha >> (2 * level));
+    }
+  }
+
+  return result;
+}
+
 // Calculate hash of sprite identifier.
 uint64_t
 Data::Sprite::create_id(uint64_t resource, uint64_t index,
@@ -70,6 +70,8 @@ class SpriteBase : public Data::Sprite {
 
   virtual void stick(Data::PSprite sticker, unsigned int x, unsigned int y);
 
+  virtual Data::PSprite get_reduced(unsigned int level);
+
  protected:
   void create(size_t w, size_t h);
 };
@@ -95,6 +97,8 @@ class DataSourceBase : public Data::Source {
 
   virtual bool check() = 0;
   virtual bool load() = 0;
+  virtual std::vector<std::string> get_files() const {
+    return std::vector<std::string>(); }
 
   virtual Data::PSprite get_sprite(Data::Resource res, size_t index,
                                    const Data::Sprite::Color &color);
@@ -31,6 +31,7 @@
 #include "src/data-source-dos.h"
 #include "src/data-source-amiga.h"
 #include "src/data-source-custom.h"
+#include "src/data-source-pack.h"
 
 #ifdef _WIN32
 // need for GetModuleFileName
@@ -98,9 +99,11 @@ Data::~Data() {
 // given path is empty string.
 bool
 Data::load(const std::string &path) {
-  // If it is possible, prefer DOS game data.
+  // If it is possible, prefer preprocessed pack, then DOS game data.
   typedef std::function<Data::PSource(const std::string &)> SourceFactory;
   std::vector<SourceFactory> sources_factories;
+  sources_factories.push_back([](const std::string &path)->Data::PSource{
+    return std::make_shared<DataSourcePack>(path); });
   sources_factories.push_back([](const std::string &path)->Data::PSource{
     return std::make_shared<DataSourceCustom>(path); });
   sources_factories.push_back([](const std::string &path)->Data::PSource{
@@ -115,6 +118,31 @@ Data::load(const std::string &path) {
     search_paths.push_front(path);
   }
 
+  // A pack stands in for the data it was built from. When other data is
+  // next to it, the pack is only used if it was built from that data.
+  auto is_current = [&sources_factories](Data::PSource source)->bool {
+    auto pack = std::dynamic_pointer_cast<DataSourcePack>(source);
+    if (!pack) {
+      return true;
+    }
+    bool other_data = false;
+    for (size_t i = 1; i < sources_factories.size(); i++) {
+      Data::PSource other = sources_factories[i](pack->get_path());
+      if (other->check()) {
+        if (pack->is_built_from(other)) {
+          return true;
+        }
+        other_data = true;
+      }
+    }
+    if (other_data) {
+      Log::Warn["data"] << "Asset pack in '" << pack->get_path()
+                        << "' was not built from the data next to it, "
+                        << "ignoring it";
+    }
+    return !other_data;
+  };
+
   // Use each data source to try to find the data files in the search paths.
   for (const SourceFactory &factory : sources_factories) {
     for (const std::string &path : search_paths) {
@@ -122,7 +150,7 @@ Data::load(const std::string &path) {
       if (source->check()) {
         Log::Info["data"] << "Game data found in '" << source->get_path()
                           << "'...";
-        if (source->load()) {
+        if (source->load() && is_current(source)) {
           data_source = std::move(source);
           break;
         }
@@ -26,6 +26,7 @@
 #include <list>
 #include <memory>
 #include <tuple>
+#include <vector>
 
 class Buffer;
 typedef std::shared_ptr<Buffer> PBuffer;
@@ -121,6 +122,9 @@ class Data {
 
     virtual void stick(PSprite sticker, unsigned int x, unsigned int y) = 0;
 
+    // Copy reduced 2^level times in both directions, for far zoomed out views
+    virtual PSprite get_reduced(unsigned int level) = 0;
+
     static uint64_t create_id(uint64_t resource, uint64_t index,
                               uint64_t mask_resource, uint64_t mask_index,
                               const Color &color);
@@ -138,6 +142,8 @@ class Data {
 
     virtual bool check() = 0;
     virtual bool load() = 0;
+    /* Files the data is read from, known after check(). */
+    virtual std::vector<std::string> get_files() const = 0;
 
     virtual PSprite get_sprite(Resource res, size_t index,
                                const Sprite::Color &color) = 0;
@@ -0,0 +1,196 @@
+/*
+ * event_loop-headless.cc - Event loop without input devices
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/event_loop-headless.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include "src/freeserf.h"
+#include "src/gfx.h"
+
+class TimerHeadless : public Timer {
+ public:
+  std::chrono::steady_clock::time_point next;
+
+  TimerHeadless(unsigned int _id, unsigned int _interval,
+                Timer::Handler *_handler)
+    : Timer(_id, _interval, _handler) {}
+
+  virtual ~TimerHeadless() {
+    stop();
+  }
+
+  virtual void run() {
+    next = std::chrono::steady_clock::now() +
+           std::chrono::milliseconds(interval);
+    EventLoopHeadless *event_loop =
+                   static_cast<EventLoopHeadless*>(&EventLoop::get_instance());
+    event_loop->add_timer(this);
+  }
+
+  virtual void stop() {
+    EventLoopHeadless *event_loop =
+                   static_cast<EventLoopHeadless*>(&EventLoop::get_instance());
+    event_loop->del_timer(this);
+  }
+
+  void fire() {
+    next += std::chrono::milliseconds(interval);
+    if (handler != nullptr) {
+      handler->on_timer_fired(id);
+    }
+  }
+};
+
+Timer *
+Timer::create(unsigned int _id, unsigned int _interval,
+              Timer::Handler *_handler) {
+  return new TimerHeadless(_id, _interval, _handler);
+}
+
+EventLoop &
+EventLoop::get_instance() {
+  static EventLoopHeadless event_loop;
+  return event_loop;
+}
+
+EventLoopHeadless::EventLoopHeadless()
+  : running(false) {
+}
+
+void
+EventLoopHeadless::quit() {
+  std::unique_lock<std::mutex> lock(mutex);
+  running = false;
+}
+
+void
+EventLoopHeadless::deferred_call(DeferredCall call, void *data) {
+  std::unique_lock<std::mutex> lock(mutex);
+  deferred_calls.push_back(PendingCall(call, data));
+}
+
+void
+EventLoopHeadless::add_timer(TimerHeadless *timer) {
+  if (std::find(timers.begin(), timers.end(), timer) == timers.end()) {
+    timers.push_back(timer);
+  }
+}
+
+void
+EventLoopHeadless::del_timer(TimerHeadless *timer) {
+  timers.remove(timer);
+}
+
+void
+EventLoopHeadless::run_deferred_calls() {
+  std::list<PendingCall> calls;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    calls.swap(deferred_calls);
+  }
+  for (PendingCall &call : calls) {
+    call.first(call.second);
+  }
+}
+
+void
+EventLoopHeadless::fire_timers(Clock::time_point now) {
+  std::list<TimerHeadless*> due;
+  for (TimerHeadless *timer : timers) {
+    if (timer->next <= now) {
+      due.push_back(timer);
+    }
+  }
+  for (TimerHeadless *timer : due) {
+    timer->fire();
+  }
+}
+
+void
+EventLoopHeadless::run() {
+  const Clock::duration tick_length = std::chrono::milliseconds(TICK_LENGTH);
+  Clock::time_point next_update = Clock::now() + tick_length;
+  Clock::time_point next_frame = Clock::now();
+  Clock::time_point last_frame;
+  bool changed = true;
+
+  Graphics &gfx = Graphics::get_instance();
+  std::unique_ptr<Frame> screen;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    running = true;
+  }
+
+  while (true) {
+    Clock::time_point deadline = next_update;
+    if (changed) {
+      deadline = std::min(deadline, next_frame);
+    }
+    std::this_thread::sleep_until(deadline);
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!running) {
+        break;
+      }
+    }
+
+    run_deferred_calls();
+
+    Clock::time_point now = Clock::now();
+    fire_timers(now);
+
+    // Update the interface
+    if (now >= next_update) {
+      notify_update();
+      next_update = now + tick_length;
+      changed = true;
+    }
+
+    // Draw interface
+    now = Clock::now();
+    if (changed && (now >= next_frame)) {
+      if (!screen) {
+        screen.reset(gfx.get_screen_frame());
+      }
+      notify_draw(screen.get());
+      gfx.swap_buffers();
+
+      if (last_frame != Clock::time_point()) {
+        record_frame(static_cast<unsigned int>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                  now - last_frame).count()));
+      }
+      last_frame = now;
+      next_frame = now;
+      if (frame_rate > 0) {
+        next_frame += std::chrono::microseconds(1000000 / frame_rate);
+      }
+      changed = false;
+    }
+  }
+
+  log_statistics();
+}
@@ -0,0 +1,61 @@
+/*
+ * event_loop-headless.h - Event loop without input devices
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_EVENT_LOOP_HEADLESS_H_
+#define SRC_EVENT_LOOP_HEADLESS_H_
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <utility>
+
+#include "src/event_loop.h"
+
+class TimerHeadless;
+
+// Updates the interface and draws frames to the offscreen video on the
+// same schedule as the SDL loop, until quit. Timers fire from the loop.
+class EventLoopHeadless : public EventLoop {
+ protected:
+  typedef std::chrono::steady_clock Clock;
+  typedef std::pair<DeferredCall, void*> PendingCall;
+
+  std::mutex mutex;
+  std::list<PendingCall> deferred_calls;
+  bool running;
+  std::list<TimerHeadless*> timers;
+
+ public:
+  EventLoopHeadless();
+
+  virtual void quit();
+  virtual void run();
+  virtual void deferred_call(DeferredCall call, void *data);
+
+  void add_timer(TimerHeadless *timer);
+  void del_timer(TimerHeadless *timer);
+
+ protected:
+  void run_deferred_calls();
+  void fire_timers(Clock::time_point now);
+};
+
+#endif  // SRC_EVENT_LOOP_HEADLESS_H_
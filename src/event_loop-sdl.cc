@@ -23,6 +23,8 @@
 
 #include <SDL.h>
 
+#include <algorithm>
+
 #include "src/log.h"
 #include "src/gfx.h"
 #include "src/freeserf.h"
@@ -46,26 +48,6 @@ EventLoopSDL::EventLoopSDL()
   , screen_factor_x(1.f)
   , screen_factor_y(1.f) {
   SDL_InitSubSystem(SDL_INIT_EVENTS | SDL_INIT_TIMER);
-
-  eventUserTypeStep = SDL_RegisterEvents(2);
-  if (eventUserTypeStep == (Uint32)-1) {
-    throw ExceptionFreeserf("Failed to register SDL event");
-  }
-  eventUserTypeStep++;
-}
-
-Uint32
-EventLoopSDL::timer_callback(Uint32 interval, void *param) {
-  EventLoopSDL *eventLoop = static_cast<EventLoopSDL*>(param);
-  SDL_Event event;
-  event.type = eventLoop->eventUserTypeStep;
-  event.user.type = eventLoop->eventUserTypeStep;
-  event.user.code = 0;
-  event.user.data1 = 0;
-  event.user.data2 = 0;
-  SDL_PushEvent(&event);
-
-  return interval;
 }
 
 void
@@ -90,14 +72,19 @@ EventLoopSDL::deferred_call(DeferredCall call, void *data) {
   SDL_PushEvent(&event);
 }
 
-// event_loop() has been turned into a SDL based loop.
-// The code for one iteration of the original game_loop is in game_loop_iter.
+// The game ticks on the simulation thread, which keeps the game clock. The
+// loop updates the interface every TICK_LENGTH of the performance counter,
+// late updates are not made up for. Frames are drawn when an update or an
+// input event has changed something, at most frame_rate times per second.
 void
 EventLoopSDL::run() {
-  SDL_TimerID timer_id = SDL_AddTimer(TICK_LENGTH, timer_callback, this);
-  if (timer_id == 0) {
-    return;
-  }
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+  Uint64 tick_length = frequency * TICK_LENGTH / 1000;
+  Uint64 next_update = SDL_GetPerformanceCounter() + tick_length;
+  Uint64 next_frame = 0;
+  Uint64 last_frame = 0;
+  bool changed = true;
+  bool running = true;
 
   int drag_button = 0;
   int drag_x = 0;
@@ -113,10 +100,26 @@ EventLoopSDL::run() {
   Frame *screen = nullptr;
   gfx.get_screen_factor(&screen_factor_x, &screen_factor_y);
 
-  while (SDL_WaitEvent(&event)) {
+  while (running) {
+    Uint64 deadline = next_update;
+    if (changed) {
+      deadline = std::min(deadline, next_frame);
+    }
+    Uint64 now = SDL_GetPerformanceCounter();
+    int timeout = 0;
+    if (deadline > now) {
+      timeout = static_cast<int>(((deadline - now) * 1000 + frequency - 1) /
+                                 frequency);
+    }
+    if (!SDL_WaitEventTimeout(&event, timeout)) {
+      event.type = SDL_FIRSTEVENT;
+    }
+
     unsigned int current_ticks = SDL_GetTicks();
 
     switch (event.type) {
+      case SDL_FIRSTEVENT:
+        break;
       case SDL_MOUSEBUTTONUP:
         if (drag_button == event.button.button) {
           drag_button = 0;
@@ -263,12 +266,8 @@ EventLoopSDL::run() {
       case SDL_USEREVENT:
         switch (event.user.code) {
           case EventUserTypeQuit:
-            SDL_RemoveTimer(timer_id);
-            if (screen != nullptr) {
-              delete screen;
-              screen = nullptr;
-            }
-            return;
+            running = false;
+            break;
           case EventUserTypeCall: {
             while (!deferred_calls.empty()) {
               deferred_calls.front()(nullptr);
@@ -281,24 +280,50 @@ EventLoopSDL::run() {
         }
         break;
       default:
-        if (event.type == eventUserTypeStep) {
-          // Update and draw interface
-          notify_update();
+        break;
+    }
 
-          if (screen == nullptr) {
-            screen = gfx.get_screen_frame();
-          }
-          notify_draw(screen);
+    if (!running) {
+      break;
+    }
+    if (event.type != SDL_FIRSTEVENT) {
+      changed = true;
+    }
 
-          // Swap video buffers
-          gfx.swap_buffers();
+    // Update the interface
+    now = SDL_GetPerformanceCounter();
+    if (now >= next_update) {
+      notify_update();
+      next_update = now + tick_length;
+      changed = true;
+    }
 
-          SDL_FlushEvent(eventUserTypeStep);
-        }
+    // Draw interface
+    now = SDL_GetPerformanceCounter();
+    if (changed && (now >= next_frame)) {
+      if (screen == nullptr) {
+        screen = gfx.get_screen_frame();
+      }
+      notify_draw(screen);
+
+      // Swap video buffers
+      gfx.swap_buffers();
+
+      if (last_frame != 0) {
+        record_frame(static_cast<unsigned int>((now - last_frame) * 1000 /
+                                               frequency));
+      }
+      last_frame = now;
+      next_frame = now;
+      if (frame_rate > 0) {
+        next_frame += frequency / frame_rate;
+      }
+      changed = false;
     }
   }
 
-  SDL_RemoveTimer(timer_id);
+  log_statistics();
+
   if (screen != nullptr) {
     delete screen;
     screen = nullptr;
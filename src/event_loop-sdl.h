@@ -40,7 +40,6 @@ class EventLoopSDL : public EventLoop {
   float zoom_factor;
   float screen_factor_x;
   float screen_factor_y;
-  Uint32 eventUserTypeStep;
 
  public:
   EventLoopSDL();
@@ -51,7 +50,6 @@ class EventLoopSDL : public EventLoop {
 
  protected:
   void zoom(float delta);
-  static Uint32 timer_callback(Uint32 interval, void *param);
 };
 
 #endif  // SRC_EVENT_LOOP_SDL_H_
@@ -22,11 +22,51 @@
 #include "src/event_loop.h"
 
 #include <algorithm>
+#include <sstream>
+
+#include "src/freeserf.h"
+#include "src/log.h"
 
 EventLoop *
 EventLoop::instance = nullptr;
 
-EventLoop::EventLoop() {
+const unsigned int
+EventLoop::frame_time_bounds[] = { 10, 20, 33, 50, 100 };
+
+EventLoop::EventLoop()
+  : frame_rate(TICKS_PER_SEC)
+  , frame_count(0) {
+  frame_times.fill(0);
+}
+
+void
+EventLoop::record_frame(unsigned int time_ms) {
+  size_t bucket = 0;
+  while (bucket < frame_times.size() - 1 &&
+         time_ms > frame_time_bounds[bucket]) {
+    bucket++;
+  }
+  frame_times[bucket]++;
+  frame_count++;
+}
+
+void
+EventLoop::log_statistics() const {
+  Log::Info["event"] << frame_count << " frames drawn";
+
+  std::stringstream histogram;
+  for (size_t i = 0; i < frame_times.size(); i++) {
+    if (i < frame_times.size() - 1) {
+      histogram << "<=" << frame_time_bounds[i];
+    } else {
+      histogram << ">" << frame_time_bounds[i - 1];
+    }
+    histogram << " ms: " << frame_times[i];
+    if (i < frame_times.size() - 1) {
+      histogram << ", ";
+    }
+  }
+  Log::Info["event"] << "Frame times " << histogram.str();
 }
 
 void
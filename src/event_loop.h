@@ -22,6 +22,7 @@
 #ifndef SRC_EVENT_LOOP_H_
 #define SRC_EVENT_LOOP_H_
 
+#include <array>
 #include <list>
 #include <functional>
 
@@ -96,6 +97,16 @@ class EventLoop {
   Handlers removed;
   static EventLoop *instance;
 
+  /* Frames are drawn at most this often, zero means after every change */
+  unsigned int frame_rate;
+
+  /* Upper bounds of frame time histogram buckets in ms, the last bucket
+     takes the rest */
+  static const unsigned int frame_time_bounds[];
+  typedef std::array<unsigned int, 6> FrameTimes;
+  FrameTimes frame_times;
+  unsigned int frame_count;
+
  public:
   static EventLoop &get_instance();
   virtual ~EventLoop() {}
@@ -107,9 +118,19 @@ class EventLoop {
   void add_handler(Handler *handler);
   void del_handler(Handler *handler);
 
+  unsigned int get_frame_rate() const { return frame_rate; }
+  void set_frame_rate(unsigned int fps) { frame_rate = fps; }
+
+  unsigned int get_frame_count() const { return frame_count; }
+  const FrameTimes &get_frame_times() const { return frame_times; }
+  void log_statistics() const;
+
  protected:
   EventLoop();
 
+  /* Time between presented frames */
+  void record_frame(unsigned int time_ms);
+
   bool notify_handlers(Event *event);
 
   bool notify_click(int x, int y, Event::Button button);
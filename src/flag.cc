@@ -1130,22 +1130,12 @@ operator >> (SaveReaderText &reader, Flag &flag) {
   reader.value("endpoints") >> flag.endpoint;
   reader.value("transporter") >> flag.transporter;
 
+  // Links to other objects are resolved later by load_links()
   for (Direction i : cycle_directions_cw()) {
     int len;
     reader.value("length")[i] >> len;
     flag.length[i] = len;
-    unsigned int obj_index;
-    reader.value("other_endpoint")[i] >> obj_index;
-    if (flag.has_building() && (i == DirectionUpLeft)) {
-      flag.other_endpoint.b[DirectionUpLeft] =
-                                    flag.get_game()->create_building(obj_index);
-    } else {
-      Flag *other_flag = NULL;
-      if (obj_index != 0) {
-        other_flag = flag.get_game()->create_flag(obj_index);
-      }
-      flag.other_endpoint.f[i] = other_flag;
-    }
+    flag.other_endpoint.v[i] = NULL;
     reader.value("other_end_dir")[i] >> flag.other_end_dir[i];
   }
 
@@ -1161,6 +1151,23 @@ operator >> (SaveReaderText &reader, Flag &flag) {
   return reader;
 }
 
+void
+Flag::load_links(SaveReaderText &reader) {
+  for (Direction i : cycle_directions_cw()) {
+    unsigned int obj_index;
+    reader.value("other_endpoint")[i] >> obj_index;
+    if (has_building() && (i == DirectionUpLeft)) {
+      other_endpoint.b[DirectionUpLeft] = game->create_building(obj_index);
+    } else {
+      Flag *other_flag = NULL;
+      if (obj_index != 0) {
+        other_flag = game->create_flag(obj_index);
+      }
+      other_endpoint.f[i] = other_flag;
+    }
+  }
+}
+
 SaveWriterText&
 operator << (SaveWriterText &writer, Flag &flag) {
   writer.value("pos") << flag.game->get_map()->pos_col(flag.pos);
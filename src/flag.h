@@ -169,6 +169,9 @@ class Flag : public GameObject {
     operator >> (SaveReaderBinary &reader, Flag &flag);
   friend SaveReaderText&
     operator >> (SaveReaderText &reader, Flag &flag);
+  // Resolve links to other flags and to the building. Called after every
+  // object of the game has been created.
+  void load_links(SaveReaderText &reader);
   friend SaveWriterText&
     operator << (SaveWriterText &writer, Flag &flag);
 
@@ -21,8 +21,11 @@
 
 #include "src/freeserf.h"
 
+#include <chrono>
+#include <memory>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #include "src/log.h"
 #include "src/version.h"
@@ -30,6 +33,7 @@
 #include "src/audio.h"
 #include "src/gfx.h"
 #include "src/interface.h"
+#include "src/viewport.h"
 #include "src/game-manager.h"
 #include "src/command_line.h"
 
@@ -45,8 +49,12 @@ main(int argc, char *argv[]) {
   unsigned int screen_width = 0;
   unsigned int screen_height = 0;
   bool fullscreen = false;
+  bool warm_up = true;
+  unsigned int frame_rate = TICKS_PER_SEC;
 
   CommandLine command_line;
+  command_line.add_option('c', "Decode sprites on first use (cold start)",
+                          [&warm_up](){ warm_up = false; });
   command_line.add_option('d', "Set Debug output level")
                 .add_parameter("NUM", [](std::istream& s) {
                   int d;
@@ -72,6 +80,11 @@ main(int argc, char *argv[]) {
                   std::getline(s, save_file);
                   return true;
                 });
+  command_line.add_option('p', "Limit frame rate (0 draws on every change)")
+                .add_parameter("FPS", [&frame_rate](std::istream& s) {
+                  s >> frame_rate;
+                  return true;
+                });
   command_line.add_option('r', "Set display resolution (e.g. 800x600)")
                 .add_parameter("RES",
                               [&screen_width, &screen_height](std::istream& s) {
@@ -130,8 +143,40 @@ main(int argc, char *argv[]) {
     interface.open_game_init();
   }
 
+  if (warm_up) {
+    std::vector<Color> colors;
+    PGame game = game_manager.get_current_game();
+    for (unsigned int i = 0; i < GAME_MAX_PLAYER_COUNT; i++) {
+      Player *player = game->get_player(i);
+      if (player != nullptr) {
+        Player::Color color = player->get_color();
+        colors.push_back(Color(color.red, color.green, color.blue));
+      }
+    }
+    Graphics::MaskedSprites ground;
+    Viewport *viewport = interface.get_viewport();
+    if (viewport != nullptr) {
+      viewport->get_ground_sprites(&ground);
+    }
+    gfx.warm_up(colors, ground);
+  }
+
+  /* Draw the first frame ahead of the loop to report its time, which is
+     mostly decoding when sprites are not warmed up. */
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<Frame> screen(gfx.get_screen_frame());
+  {
+    Simulation::Lock lock(interface.get_simulation());
+    interface.draw(screen.get());
+  }
+  std::chrono::duration<double, std::milli> first_frame =
+                                      std::chrono::steady_clock::now() - start;
+  Log::Info["main"] << "First frame drawn in " << first_frame.count()
+                    << " ms (" << (warm_up ? "warmed up" : "cold") << ")";
+
   /* Init game loop */
   EventLoop &event_loop = EventLoop::get_instance();
+  event_loop.set_frame_rate(frame_rate);
   event_loop.add_handler(&interface);
 
   /* Start game loop */
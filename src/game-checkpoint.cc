@@ -0,0 +1,217 @@
+/*
+ * game-checkpoint.cc - In-memory game state checkpoints
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/game-checkpoint.h"
+
+#include <memory>
+#include <sstream>
+#include <utility>
+
+#include "src/savegame.h"
+#include "src/log.h"
+
+GameCheckpoints::GameCheckpoints(unsigned int _interval, size_t _memory_budget)
+  : interval(_interval)
+  , memory_budget(_memory_budget)
+  , memory_used(0)
+  , next_tick(0) {
+}
+
+bool
+GameCheckpoints::update(Game *game) {
+  if (game->get_tick() < next_tick) {
+    return false;
+  }
+
+  return capture(game);
+}
+
+bool
+GameCheckpoints::capture(Game *game) {
+  std::stringstream str;
+  if (!GameStore::get_instance().write(&str, game)) {
+    return false;
+  }
+
+  Sections sections;
+  split_sections(str.str(), &sections);
+
+  Checkpoint checkpoint;
+  checkpoint.tick = game->get_tick();
+
+  // Sections are compared in full, a matching hash alone could hide a change
+  // and make the checkpoint restore into a different game.
+  for (const auto &section : sections) {
+    Sections::const_iterator it = last_sections.find(section.first);
+    if (checkpoints.empty() || (it == last_sections.end()) ||
+        (it->second != section.second)) {
+      checkpoint.changed.insert(section);
+    }
+  }
+
+  if (!checkpoints.empty()) {
+    for (const auto &section : last_sections) {
+      if (sections.find(section.first) == sections.end()) {
+        checkpoint.removed.insert(section.first);
+      }
+    }
+  }
+
+  memory_used -= sections_size(last_sections);
+  last_sections = std::move(sections);
+  memory_used += sections_size(last_sections);
+
+  checkpoint.size = checkpoint_size(checkpoint);
+  memory_used += checkpoint.size;
+  checkpoints.push_back(std::move(checkpoint));
+
+  next_tick = game->get_tick() + interval;
+
+  enforce_budget();
+
+  return true;
+}
+
+void
+GameCheckpoints::clear() {
+  checkpoints.clear();
+  last_sections.clear();
+  memory_used = 0;
+  next_tick = 0;
+}
+
+void
+GameCheckpoints::set_memory_budget(size_t budget) {
+  memory_budget = budget;
+  enforce_budget();
+}
+
+PGame
+GameCheckpoints::restore(size_t index) const {
+  if (index >= checkpoints.size()) {
+    return nullptr;
+  }
+
+  Sections sections;
+  for (size_t i = 0; i <= index; i++) {
+    const Checkpoint &checkpoint = checkpoints[i];
+    for (const std::string &name : checkpoint.removed) {
+      sections.erase(name);
+    }
+    for (const auto &section : checkpoint.changed) {
+      sections[section.first] = section.second;
+    }
+  }
+
+  std::stringstream str;
+  for (const auto &section : sections) {
+    str << section.second;
+  }
+
+  PGame game = std::make_shared<Game>();
+  if (!GameStore::get_instance().read(&str, game.get())) {
+    Log::Error["checkpoint"] << "Failed to restore checkpoint at tick "
+                             << checkpoints[index].tick;
+    return nullptr;
+  }
+
+  return game;
+}
+
+PGame
+GameCheckpoints::restore_tick(unsigned int tick) const {
+  for (size_t i = checkpoints.size(); i > 0; i--) {
+    if (checkpoints[i - 1].tick <= tick) {
+      return restore(i - 1);
+    }
+  }
+
+  return nullptr;
+}
+
+// Each section starts with its "[name number]" header line.
+void
+GameCheckpoints::split_sections(const std::string &text,
+                                Sections *sections) {
+  size_t begin = 0;
+  while (begin < text.size()) {
+    size_t end = text.find("\n[", begin);
+    end = (end == std::string::npos) ? text.size() : end + 1;
+
+    size_t name_end = text.find(']', begin);
+    if ((text[begin] == '[') && (name_end != std::string::npos) &&
+        (name_end < end)) {
+      std::string name = text.substr(begin + 1, name_end - begin - 1);
+      (*sections)[name] = text.substr(begin, end - begin);
+    }
+
+    begin = end;
+  }
+}
+
+size_t
+GameCheckpoints::sections_size(const Sections &sections) {
+  size_t size = 0;
+  for (const auto &section : sections) {
+    size += section.first.size() + section.second.size();
+  }
+  return size;
+}
+
+size_t
+GameCheckpoints::checkpoint_size(const Checkpoint &checkpoint) {
+  size_t size = sizeof(Checkpoint) + sections_size(checkpoint.changed);
+  for (const std::string &name : checkpoint.removed) {
+    size += name.size();
+  }
+  return size;
+}
+
+// Fold the oldest checkpoint into its successor, making it the new base.
+void
+GameCheckpoints::drop_oldest() {
+  if (checkpoints.size() < 2) {
+    clear();
+    return;
+  }
+
+  Checkpoint &oldest = checkpoints[0];
+  Checkpoint &base = checkpoints[1];
+  memory_used -= oldest.size + base.size;
+
+  for (auto &section : oldest.changed) {
+    if (base.removed.find(section.first) == base.removed.end()) {
+      base.changed.emplace(section.first, std::move(section.second));
+    }
+  }
+  base.removed.clear();
+  base.size = checkpoint_size(base);
+  memory_used += base.size;
+
+  checkpoints.pop_front();
+}
+
+void
+GameCheckpoints::enforce_budget() {
+  while ((memory_used > memory_budget) && (checkpoints.size() > 1)) {
+    drop_oldest();
+  }
+}
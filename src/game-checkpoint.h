@@ -0,0 +1,100 @@
+/*
+ * game-checkpoint.h - In-memory game state checkpoints
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_GAME_CHECKPOINT_H_
+#define SRC_GAME_CHECKPOINT_H_
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+
+#include "src/game.h"
+
+// Ring of in-memory game snapshots for rewinding.
+//
+// Game state is captured in the save game format, which is split into
+// independent sections (map tiles of SAVE_MAP_TILE_SIZE, and one section
+// per player, flag, building, inventory and serf keyed by index). Only the
+// first checkpoint in the ring holds every section; each following one stores
+// just the sections that changed or disappeared since its predecessor.
+// The sections of the latest checkpoint are also kept in full to compare
+// the next one with, they count towards the memory budget too. When the
+// budget is exceeded the oldest checkpoint is folded into the next one,
+// which then becomes the new base.
+class GameCheckpoints {
+ public:
+  typedef std::map<std::string, std::string> Sections;
+
+ protected:
+
+  class Checkpoint {
+   public:
+    unsigned int tick;
+    Sections changed;
+    std::set<std::string> removed;
+    size_t size;
+  };
+
+  typedef std::deque<Checkpoint> Checkpoints;
+
+  unsigned int interval;
+  size_t memory_budget;
+  size_t memory_used;
+  unsigned int next_tick;
+  Checkpoints checkpoints;
+  Sections last_sections;   // Every section of the latest checkpoint
+
+ public:
+  GameCheckpoints(unsigned int interval, size_t memory_budget);
+  virtual ~GameCheckpoints() {}
+
+  // Capture a checkpoint when the game tick has passed the next interval.
+  // Intended to be called after every Game::update().
+  bool update(Game *game);
+  bool capture(Game *game);
+  void clear();
+
+  size_t get_count() const { return checkpoints.size(); }
+  unsigned int get_tick(size_t index) const {
+    return checkpoints[index].tick; }
+  size_t get_memory_used() const { return memory_used; }
+  size_t get_memory_budget() const { return memory_budget; }
+  void set_memory_budget(size_t budget);
+  unsigned int get_interval() const { return interval; }
+
+  // Recreate the game as it was at checkpoint with given index, or return
+  // nullptr when the index is out of range or the state can not be loaded.
+  PGame restore(size_t index) const;
+  // Restore the latest checkpoint not newer than given tick.
+  PGame restore_tick(unsigned int tick) const;
+
+  // Split save game text into sections keyed by "name number".
+  static void split_sections(const std::string &text, Sections *sections);
+
+ protected:
+  static size_t sections_size(const Sections &sections);
+  static size_t checkpoint_size(const Checkpoint &checkpoint);
+  void drop_oldest();
+  void enforce_budget();
+};
+
+#endif  // SRC_GAME_CHECKPOINT_H_
@@ -98,6 +98,7 @@ GameInitBox::GameInitBox(Interface *interface)
   game_mission = 0;
 
   set_size(360, 254);
+  set_retained(true);
 
   custom_mission = std::make_shared<GameInfo>(Random());
   custom_mission->remove_all_players();
@@ -27,9 +27,12 @@
 
 #include <string>
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <memory>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "src/savegame.h"
 #include "src/debug.h"
@@ -37,8 +40,10 @@
 #include "src/misc.h"
 #include "src/inventory.h"
 #include "src/map.h"
+#include "src/map-buildability.h"
 #include "src/map-generator.h"
 #include "src/map-geometry.h"
+#include "src/thread-pool.h"
 
 #define GROUND_ANALYSIS_RADIUS  25
 
@@ -107,6 +112,16 @@ Game::~Game() {
   players.clear();
 }
 
+/* Created together with the map, so that it is notified of map changes
+   before any handler that queries it. */
+MapBuildability *
+Game::get_buildability() {
+  if (!buildability || (buildability->get_map() != map)) {
+    buildability.reset(new MapBuildability(this));
+  }
+  return buildability.get();
+}
+
 /* Clear the serf request bit of all flags and buildings.
    This allows the flag or building to try and request a
    serf again. */
@@ -1698,11 +1713,23 @@ Game::surrender_land(MapPos pos) {
 /* Initialize land ownership for whole map. */
 void
 Game::init_land_ownership() {
+  /* Threat levels are part of the saved state, recalculating the
+   ownership must not change them. */
+  std::vector<std::pair<Building*, size_t>> threat_levels;
+  for (Building *building : buildings) {
+    threat_levels.push_back(std::make_pair(building,
+                                           building->get_threat_level()));
+  }
+
   for (Building *building : buildings) {
     if (building->is_military()) {
       update_land_ownership(building->get_position());
     }
   }
+
+  for (auto &threat_level : threat_levels) {
+    threat_level.first->set_threat_level(threat_level.second);
+  }
 }
 
 /* Update land ownership around map position. */
@@ -2004,6 +2031,7 @@ Game::init(unsigned int map_size, const Random &random) {
   init_map_rnd = random;
 
   map.reset(new Map(MapGeometry(map_size)));
+  buildability.reset(new MapBuildability(this));
   ClassicMissionMapGenerator generator(*map, init_map_rnd);
   generator.init();
   generator.generate();
@@ -2251,18 +2279,36 @@ Game::clear_search_id() {
 
 SaveReaderBinary&
 operator >> (SaveReaderBinary &reader, Game &game) {
+  SaveLayoutBinary layout;
+  if (!game.load_legacy(&reader, &layout)) {
+    throw ExceptionFreeserf(layout.get_error_message());
+  }
+  return reader;
+}
+
+bool
+Game::load_legacy(SaveReaderBinary *reader_ptr, SaveLayoutBinary *layout) {
+  SaveReaderBinary &reader = *reader_ptr;
+
+  /* Check extents of all sections up front, fields are read unchecked
+     afterwards. */
+  if (!layout->validate(reader)) {
+    return false;
+  }
+  reader.set_checked(false);
+
   /* Load these first so map dimensions can be reconstructed.
    This is necessary to load map positions. */
 
   reader.skip(74);
   uint16_t v16;
   reader >> v16;  // 74
-  game.game_type = v16;
+  game_type = v16;
   reader >> v16;  // 76
   reader >> v16;  // 78
-  game.tick = v16;
-  game.game_stats_counter = 0;
-  game.history_counter = 0;
+  tick = v16;
+  game_stats_counter = 0;
+  history_counter = 0;
 
   reader.skip(4);
 
@@ -2270,7 +2316,7 @@ operator >> (SaveReaderBinary &reader, Game &game) {
   reader >> r1;  // 84
   reader >> r2;  // 86
   reader >> r3;  // 88
-  game.rnd = Random(r1, r2, r3);
+  rnd = Random(r1, r2, r3);
 
   reader >> v16;  // 90
   int max_flag_index = v16;
@@ -2280,24 +2326,24 @@ operator >> (SaveReaderBinary &reader, Game &game) {
   int max_serf_index = v16;
 
   reader >> v16;  // 96
-  game.next_index = v16;
+  next_index = v16;
   reader >> v16;  // 98
-  game.flag_search_counter = v16;
+  flag_search_counter = v16;
 
   reader.skip(4);
 
   for (int i = 0; i < 4; i++) {
     reader >> v16;  // 104 + i*2
-    game.player_history_index[i] = v16;
+    player_history_index[i] = v16;
   }
 
   for (int i = 0; i < 3; i++) {
     reader >> v16;  // 112 + i*2
-    game.player_history_counter[i] = v16;
+    player_history_counter[i] = v16;
   }
 
   reader >> v16;  // 118
-  game.resource_history_index = v16;
+  resource_history_index = v16;
 
 //  if (0/*game.Gameype == GameYPE_TUTORIAL*/) {
 //    game.tutorial_level = *reinterpret_cast<uint16_t*>(&data[122]);
@@ -2312,59 +2358,75 @@ operator >> (SaveReaderBinary &reader, Game &game) {
 
   reader.skip(4);
   reader >> v16;  // 180
-  game.max_next_index = v16;
+  max_next_index = v16;
 
   reader.skip(8);
   reader >> v16;  // 190
   int map_size = v16;
 
-  // Avoid allocating a huge map if the input file is invalid
-  if (map_size < 3 || map_size > 10) {
-    throw ExceptionFreeserf("Invalid map size in file");
-  }
-
-  game.map.reset(new Map(MapGeometry(map_size)));
+  map.reset(new Map(MapGeometry(map_size)));
+  buildability.reset(new MapBuildability(this));
 
   reader.skip(8);
   reader >> v16;  // 200
-  game.map_gold_morale_factor = v16;
+  map_gold_morale_factor = v16;
   reader.skip(2);
   uint8_t v8;
   reader >> v8;  // 204
-  game.player_score_leader = v8;
+  player_score_leader = v8;
 
   reader.skip(45);
 
   /* Load players state from save game. */
   for (int i = 0; i < 4; i++) {
-    SaveReaderBinary player_reader = reader.extract(8628);
+    SaveReaderBinary player_reader =
+                                reader.extract(SaveLayoutBinary::player_size);
     player_reader.skip(130);
     player_reader >> v8;
     if (BIT_TEST(v8, 6)) {
       player_reader.reset();
-      Player *player = game.players.get_or_insert(i);
+      Player *player = players.get_or_insert(i);
       player_reader >> *player;
     }
   }
 
   /* Load map state from save game. */
-  unsigned int tile_count = game.map->get_cols() * game.map->get_rows();
-  SaveReaderBinary map_reader = reader.extract(8 * tile_count);
-  map_reader >> *(game.map);
-
-  game.load_serfs(&reader, max_serf_index);
-  game.load_flags(&reader, max_flag_index);
-  game.load_buildings(&reader, max_building_index);
-  game.load_inventories(&reader, max_inventory_index);
+  unsigned int tile_count = map->get_cols() * map->get_rows();
+  SaveReaderBinary map_reader =
+                  reader.extract(SaveLayoutBinary::map_tile_size * tile_count);
+  map_reader >> *map;
+
+  size_t offset = reader.get_offset();
+  if (!load_serfs(&reader, max_serf_index)) {
+    layout->set_error(SaveLayoutBinary::ErrorInvalidObject, "serfs", offset);
+    return false;
+  }
+  offset = reader.get_offset();
+  if (!load_flags(&reader, max_flag_index)) {
+    layout->set_error(SaveLayoutBinary::ErrorInvalidObject, "flags", offset);
+    return false;
+  }
+  offset = reader.get_offset();
+  if (!load_buildings(&reader, max_building_index)) {
+    layout->set_error(SaveLayoutBinary::ErrorInvalidObject, "buildings",
+                      offset);
+    return false;
+  }
+  offset = reader.get_offset();
+  if (!load_inventories(&reader, max_inventory_index)) {
+    layout->set_error(SaveLayoutBinary::ErrorInvalidObject, "inventories",
+                      offset);
+    return false;
+  }
 
-  game.game_speed = 0;
-  game.game_speed_save = DEFAULT_GAME_SPEED;
+  game_speed = 0;
+  game_speed_save = DEFAULT_GAME_SPEED;
 
-  game.init_land_ownership();
+  init_land_ownership();
 
-  game.gold_total = game.map->get_gold_deposit();
+  gold_total = map->get_gold_deposit();
 
-  return reader;
+  return true;
 }
 
 /* Load serf state from save game. */
@@ -2377,7 +2439,8 @@ Game::load_serfs(SaveReaderBinary *reader, int max_serf_index) {
 
   /* Load serf data. */
   for (int i = 0; i < max_serf_index; i++) {
-    SaveReaderBinary serf_reader = reader->extract(16);
+    SaveReaderBinary serf_reader =
+                             reader->extract(SaveLayoutBinary::serf_size);
     if (BIT_TEST(bitmap[(i)>>3], 7-((i)&7))) {
       Serf *serf = serfs.get_or_insert(i);
       serf_reader >> *serf;
@@ -2397,7 +2460,8 @@ Game::load_flags(SaveReaderBinary *reader, int max_flag_index) {
 
   /* Load flag data. */
   for (int i = 0; i < max_flag_index; i++) {
-    SaveReaderBinary flag_reader = reader->extract(70);
+    SaveReaderBinary flag_reader =
+                             reader->extract(SaveLayoutBinary::flag_size);
     if (BIT_TEST(bitmap[(i)>>3], 7-((i)&7))) {
       Flag *flag = flags.get_or_insert(i);
       flag_reader >> *flag;
@@ -2408,6 +2472,9 @@ Game::load_flags(SaveReaderBinary *reader, int max_flag_index) {
   for (MapPos pos : map->geom()) {
     if (map->get_obj(pos) == Map::ObjectFlag) {
       Flag *flag = flags[map->get_obj_index(pos)];
+      if (flag == nullptr) {
+        return false;
+      }
       flag->set_position(pos);
     }
   }
@@ -2425,7 +2492,8 @@ Game::load_buildings(SaveReaderBinary *reader, int max_building_index) {
 
   /* Load building data. */
   for (int i = 0; i < max_building_index; i++) {
-    SaveReaderBinary building_reader = reader->extract(18);
+    SaveReaderBinary building_reader =
+                             reader->extract(SaveLayoutBinary::building_size);
     if (BIT_TEST(bitmap[(i)>>3], 7-((i)&7))) {
       Building *building = buildings.get_or_insert(i);
       building_reader >> *building;
@@ -2455,7 +2523,8 @@ Game::load_inventories(SaveReaderBinary *reader, int max_inventory_index) {
 
   /* Load inventory data. */
   for (int i = 0; i < max_inventory_index; i++) {
-    SaveReaderBinary inventory_reader = reader->extract(120);
+    SaveReaderBinary inventory_reader =
+                             reader->extract(SaveLayoutBinary::inventory_size);
     if (BIT_TEST(bitmap[(i)>>3], 7-((i)&7))) {
       Inventory *inventory = inventories.get_or_insert(i);
       inventory_reader >> *inventory;
@@ -2509,11 +2578,17 @@ operator >> (SaveReaderText &reader, Game &game) {
     size = (col_size + row_size) - 9;
   }
 
-  /* Initialize remaining map dimensions. */
+  ThreadPool &pool = ThreadPool::get_instance();
+
+  /* Initialize remaining map dimensions. Every map section covers its own
+   tiles, so sections are decoded in parallel. */
   game.map.reset(new Map(MapGeometry(size)));
-  for (SaveReaderText* subreader : reader.get_sections("map")) {
-    *subreader >> *game.map;
-  }
+  game.buildability.reset(new MapBuildability(&game));
+  sections = reader.get_sections("map");
+  std::vector<SaveReaderText*> map_readers(sections.begin(), sections.end());
+  pool.parallel_for(map_readers.size(), [&game, &map_readers](size_t i) {
+    *map_readers[i] >> *game.map;
+  });
 
 //  std::string version;
 //  reader.value("version") >> version;
@@ -2564,30 +2639,47 @@ operator >> (SaveReaderText &reader, Game &game) {
   update_state.initial_pos = game.map->pos(x, y);
   game.map->set_update_state(update_state);
 
+  /* Create all objects first, then decode their sections in parallel. Each
+   section only writes to its own object, references between objects are
+   resolved afterwards. */
+  std::vector<std::function<void()>> loaders;
   for (SaveReaderText* subreader : reader.get_sections("player")) {
     Player *p = game.players.get_or_insert(subreader->get_number());
-    *subreader >> *p;
+    loaders.push_back([subreader, p]() { *subreader >> *p; });
   }
 
+  std::vector<std::pair<SaveReaderText*, Flag*>> flag_links;
   for (SaveReaderText* subreader : reader.get_sections("flag")) {
     Flag *p = game.flags.get_or_insert(subreader->get_number());
-    *subreader >> *p;
+    loaders.push_back([subreader, p]() { *subreader >> *p; });
+    flag_links.push_back(std::make_pair(subreader, p));
   }
 
-  sections = reader.get_sections("building");
+  std::vector<std::pair<SaveReaderText*, Building*>> building_links;
   for (SaveReaderText* subreader : reader.get_sections("building")) {
     Building *p = game.buildings.get_or_insert(subreader->get_number());
-    *subreader >> *p;
+    loaders.push_back([subreader, p]() { *subreader >> *p; });
+    building_links.push_back(std::make_pair(subreader, p));
   }
 
   for (SaveReaderText* subreader : reader.get_sections("inventory")) {
     Inventory *p = game.inventories.get_or_insert(subreader->get_number());
-    *subreader >> *p;
+    loaders.push_back([subreader, p]() { *subreader >> *p; });
   }
 
   for (SaveReaderText* subreader : reader.get_sections("serf")) {
     Serf *p = game.serfs.get_or_insert(subreader->get_number());
-    *subreader >> *p;
+    loaders.push_back([subreader, p]() { *subreader >> *p; });
+  }
+
+  pool.parallel_for(loaders.size(), [&loaders](size_t i) { loaders[i](); });
+
+  for (auto &link : flag_links) {
+    link.second->load_links(*link.first);
+  }
+
+  for (auto &link : building_links) {
+    link.second->load_links(*link.first);
   }
 
   /* Restore idle serf flag */
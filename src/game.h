@@ -41,8 +41,10 @@
 #define GAME_MAX_PLAYER_COUNT  4
 
 class SaveReaderBinary;
+class SaveLayoutBinary;
 class SaveReaderText;
 class SaveWriterText;
+class MapBuildability;
 
 class Game {
  public:
@@ -58,6 +60,7 @@ class Game {
   typedef Collection<Player, 5> Players;
 
   PMap map;
+  std::unique_ptr<MapBuildability> buildability;
 
   typedef std::map<unsigned int, unsigned int> Values;
   int map_gold_morale_factor;
@@ -107,6 +110,8 @@ class Game {
   virtual ~Game();
 
   PMap get_map() { return map; }
+  // Build possibilities of the current map, created on first use.
+  MapBuildability *get_buildability();
 
   unsigned int get_tick() const { return tick; }
   unsigned int get_const_tick() const { return const_tick; }
@@ -246,6 +251,10 @@ class Game {
   friend SaveWriterText&
     operator << (SaveWriterText &writer, Game &game);
 
+  /* Load legacy save game. Returns false and leaves the reason, section and
+   offset of the failure in layout if the data is broken. */
+  bool load_legacy(SaveReaderBinary *reader, SaveLayoutBinary *layout);
+
  protected:
   bool load_serfs(SaveReaderBinary *reader, int max_serf_index);
   bool load_flags(SaveReaderBinary *reader, int max_flag_index);
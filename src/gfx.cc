@@ -23,10 +23,20 @@
 
 #include <utility>
 #include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
 
 #include "src/log.h"
 #include "src/data.h"
+#include "src/data-source.h"
 #include "src/video.h"
+#include "src/thread-pool.h"
+
+/* Default memory budget of the image cache in bytes */
+#define IMAGE_CACHE_MEMORY  (64*1024*1024)
+/* Default memory budget of the text cache in bytes */
+#define TEXT_CACHE_MEMORY  (4*1024*1024)
 
 const Color Color::black = Color(0x00, 0x00, 0x00);
 const Color Color::white = Color(0xff, 0xff, 0xff);
@@ -65,6 +75,13 @@ ExceptionGFX::ExceptionGFX(const std::string &description)
 ExceptionGFX::~ExceptionGFX() {
 }
 
+/* Color of sprite data for a color of graphics */
+static Data::Sprite::Color
+get_sprite_color(const Color &color) {
+  return {color.get_blue(), color.get_green(), color.get_red(),
+          color.get_alpha()};
+}
+
 Image::Image(Video *_video, Data::PSprite sprite) {
   video = _video;
   width = static_cast<unsigned int>(sprite->get_width());
@@ -76,6 +93,11 @@ Image::Image(Video *_video, Data::PSprite sprite) {
   video_image = video->create_image(sprite->get_data(), width, height);
 }
 
+void
+Image::update(Data::PSprite sprite) {
+  video->update_image(video_image, sprite->get_data());
+}
+
 Image::~Image() {
   if (video_image != nullptr) {
     video->destroy_image(video_image);
@@ -84,36 +106,11 @@ Image::~Image() {
   video = nullptr;
 }
 
-/* Sprite cache hash table */
-Image::ImageCache Image::image_cache;
-
-void
-Image::cache_image(uint64_t id, Image *image) {
-  image_cache[id] = image;
-}
-
-/* Return a pointer to the sprite pointer associated with id. */
-Image *
-Image::get_cached_image(uint64_t id) {
-  ImageCache::iterator result = image_cache.find(id);
-  if (result == image_cache.end()) {
-    return nullptr;
-  }
-  return result->second;
-}
-
-void
-Image::clear_cache() {
-  while (!image_cache.empty()) {
-    Image *image = image_cache.begin()->second;
-    image_cache.erase(image_cache.begin());
-    delete image;
-  }
-}
-
 Graphics *Graphics::instance = nullptr;
 
-Graphics::Graphics() {
+Graphics::Graphics()
+  : image_cache(IMAGE_CACHE_MEMORY)
+  , text_cache(TEXT_CACHE_MEMORY) {
   if (instance != nullptr) {
     throw ExceptionGFX("Unable to create second instance.");
   }
@@ -135,8 +132,124 @@ Graphics::Graphics() {
   Graphics::instance = this;
 }
 
+/* Decode the sprites that the first views are made of ahead of use. Sprites
+   are decoded by the thread pool, the images are then created here, as the
+   video backend is not to be used from other threads. Serf torsos are
+   decoded in each of the colors, masked sprites are masked by the pool
+   too. */
+void
+Graphics::warm_up(const std::vector<Color> &colors,
+                  const MaskedSprites &masked) {
+  class Item {
+   public:
+    Data::Resource res;
+    unsigned int index;
+    Data::Resource mask_res;
+    unsigned int mask_index;
+    Color color;
+    Data::PSprite sprite;
+  };
+
+  const struct {
+    Data::Resource res;
+    bool colored;
+  } resources[] = {
+    { Data::AssetMapObject, false },
+    { Data::AssetMapShadow, false },
+    { Data::AssetGameObject, false },
+    { Data::AssetMapBorder, false },
+    { Data::AssetMapWaves, false },
+    { Data::AssetSerfShadow, false },
+    { Data::AssetSerfHead, false },
+    { Data::AssetSerfTorso, true },
+    { Data::AssetIcon, false },
+    { Data::AssetPanelButton, false },
+    { Data::AssetFrameTop, false },
+    { Data::AssetFrameBottom, false },
+    { Data::AssetFrameSplit, false },
+    { Data::AssetFramePopup, false },
+  };
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<Item> items;
+  auto add = [this, &items](Data::Resource res, const Color &color) {
+    for (unsigned int i = 0; i < Data::get_resource_count(res); i++) {
+      uint64_t id = Data::Sprite::create_id(res, i, 0, 0,
+                                            get_sprite_color(color));
+      if (!image_cache.contains(id)) {
+        items.push_back({res, i, Data::AssetNone, 0, color, nullptr});
+      }
+    }
+  };
+  for (const auto &resource : resources) {
+    if (resource.colored) {
+      for (const Color &color : colors) {
+        add(resource.res, color);
+      }
+    } else {
+      add(resource.res, Color::transparent);
+    }
+  }
+  for (const MaskedSprite &sprite : masked) {
+    uint64_t id = Data::Sprite::create_id(sprite.res, sprite.index,
+                                          sprite.mask_res, sprite.mask_index,
+                                          {0, 0, 0, 0});
+    if (!image_cache.contains(id)) {
+      items.push_back({sprite.res, sprite.index, sprite.mask_res,
+                       sprite.mask_index, Color::transparent, nullptr});
+    }
+  }
+
+  Data::PSource data_source = Data::get_instance().get_data_source();
+  ThreadPool &pool = ThreadPool::get_instance();
+  pool.parallel_for(items.size(), [&items, &data_source](size_t i) {
+    Item &item = items[i];
+    item.sprite = data_source->get_sprite(item.res, item.index,
+                                          get_sprite_color(item.color));
+    if (item.sprite && (item.mask_res != Data::AssetNone)) {
+      Data::PSprite mask = data_source->get_sprite(item.mask_res,
+                                                   item.mask_index,
+                                                   {0, 0, 0, 0});
+      item.sprite = mask ? item.sprite->get_masked(mask) : nullptr;
+    }
+  });
+
+  std::chrono::duration<double, std::milli> decoded =
+                                      std::chrono::steady_clock::now() - start;
+
+  size_t count = 0;
+  for (Item &item : items) {
+    if (!item.sprite) continue;
+    uint64_t id = Data::Sprite::create_id(item.res, item.index,
+                                          item.mask_res, item.mask_index,
+                                          get_sprite_color(item.color));
+    std::unique_ptr<Image> image(new Image(video, item.sprite));
+    size_t size = image->get_size();
+    image_cache.insert(id, std::move(image), size);
+    count++;
+  }
+
+  std::chrono::duration<double, std::milli> elapsed =
+                                      std::chrono::steady_clock::now() - start;
+  Log::Info["graphics"] << "Warmed up " << count << " images in "
+                        << elapsed.count() << " ms (decoding "
+                        << decoded.count() << " ms on " << pool.get_size()
+                        << " threads), "
+                        << image_cache.get_memory_used() / 1024 << " KB";
+}
+
 Graphics::~Graphics() {
-  Image::clear_cache();
+  Log::Verbose["graphics"] << "Image cache: " << image_cache.get_hits()
+                           << " hits, " << image_cache.get_misses()
+                           << " misses, " << image_cache.get_evictions()
+                           << " evictions";
+  Log::Verbose["graphics"] << "Text cache: " << text_cache.get_hits()
+                           << " hits, " << text_cache.get_misses()
+                           << " misses, " << text_cache.get_evictions()
+                           << " evictions";
+  image_cache.clear();
+  text_cache.clear();
 }
 
 Graphics &
@@ -152,25 +265,99 @@ Frame::draw_sprite(int x, int y, Data::Resource res, unsigned int index) {
   draw_sprite(x, y, res, index, false, Color::transparent, 1.f);
 }
 
-void
-Frame::draw_sprite(int x, int y, Data::Resource res, unsigned int index,
-                   bool use_off, const Color &color, float progress) {
-  Data::Sprite::Color pc = {color.get_blue(),
-                            color.get_green(),
-                            color.get_red(),
-                            color.get_alpha()};
-  uint64_t id = Data::Sprite::create_id(res, index, 0, 0, pc);
-  Image *image = Image::get_cached_image(id);
+/* Reduced images are cached apart from the full ones, in the two top bits
+   of the id that resource numbers never reach. */
+static uint64_t
+get_level_id(unsigned int level) {
+  return static_cast<uint64_t>(level & 0x3) << 62;
+}
+
+/* Return image of sprite from the image cache, decoding it on first use.
+   Returns nullptr if the sprite can not be decoded. */
+Image *
+Frame::get_sprite_image(Data::Resource res, unsigned int index,
+                        const Color &color, unsigned int level) {
+  Data::Sprite::Color pc = get_sprite_color(color);
+  uint64_t id = Data::Sprite::create_id(res, index, 0, 0, pc) |
+                get_level_id(level);
+  Image *image = image_cache->get(id);
   if (image == nullptr) {
     Data::PSprite s = data_source->get_sprite(res, index, pc);
     if (!s) {
       Log::Warn["graphics"] << "Failed to decode sprite #"
                             << Data::get_resource_name(res) << ":" << index;
-      return;
+      return nullptr;
+    }
+
+    if (level > 0) {
+      s = s->get_reduced(level);
     }
 
     image = new Image(video, s);
-    Image::cache_image(id, image);
+    image_cache->insert(id, std::unique_ptr<Image>(image), image->get_size());
+  }
+
+  return image;
+}
+
+/* Return image of sprite cut out by mask, the whole sprite when mask_res is
+   AssetNone. Returns nullptr if the sprites can not be decoded. */
+Image *
+Frame::get_masked_image(Data::Resource mask_res, unsigned int mask_index,
+                        Data::Resource res, unsigned int index,
+                        unsigned int level) {
+  uint64_t id = Data::Sprite::create_id(res, index, mask_res, mask_index,
+                                        {0, 0, 0, 0}) | get_level_id(level);
+  Image *image = image_cache->get(id);
+  if (image == nullptr) {
+    Data::PSprite s = data_source->get_sprite(res, index, {0, 0, 0, 0});
+    if (!s) {
+      Log::Warn["graphics"] << "Failed to decode sprite #"
+                            << Data::get_resource_name(res) << ":" << index;
+      return nullptr;
+    }
+
+    if (mask_res > 0) {
+      Data::PSprite m = data_source->get_sprite(mask_res, mask_index,
+                                                {0, 0, 0, 0});
+      if (!m) {
+        Log::Warn["graphics"] << "Failed to decode sprite #"
+                              << Data::get_resource_name(mask_res)
+                              << ":" << mask_index;
+        return nullptr;
+      }
+
+      Data::PSprite masked = s->get_masked(m);
+      if (!masked) {
+        Log::Warn["graphics"] << "Failed to apply mask #"
+                              << Data::get_resource_name(mask_res)
+                              << ":" << mask_index
+                              << " to sprite #"
+                              << Data::get_resource_name(res) << ":" << index;
+        return nullptr;
+      }
+
+      s = std::move(masked);
+    }
+
+    if (level > 0) {
+      s = s->get_reduced(level);
+    }
+
+    image = new Image(video, s);
+    image_cache->insert(id, std::unique_ptr<Image>(image), image->get_size());
+  }
+
+  return image;
+}
+
+void
+Frame::draw_sprite(int x, int y, Data::Resource res, unsigned int index,
+                   bool use_off, const Color &color, float progress,
+                   unsigned int level) {
+  Image *image = get_sprite_image(res, index, color, level);
+  if (image == nullptr) {
+    return;
   }
 
   if (use_off) {
@@ -182,7 +369,6 @@ Frame::draw_sprite(int x, int y, Data::Resource res, unsigned int index,
   video->draw_image(image->get_video_image(), x, y, y_off, video_frame);
 }
 
-
 void
 Frame::draw_sprite(int x, int y, Data::Resource res, unsigned int index,
                    bool use_off) {
@@ -206,60 +392,40 @@ Frame::draw_sprite_relatively(int x, int y, Data::Resource res,
                               unsigned int index,
                               Data::Resource relative_to_res,
                               unsigned int relative_to_index) {
-  Data::PSprite s = data_source->get_sprite(relative_to_res, relative_to_index,
-                                            {0, 0, 0, 0});
-  if (s == nullptr) {
-    Log::Warn["graphics"] << "Failed to decode sprite #"
-                          << Data::get_resource_name(res) << ":" << index;
+  Image *relative_to = get_sprite_image(relative_to_res, relative_to_index,
+                                        Color::transparent);
+  if (relative_to == nullptr) {
     return;
   }
 
-  x += s->get_delta_x();
-  y += s->get_delta_y();
+  x += relative_to->get_delta_x();
+  y += relative_to->get_delta_y();
 
   draw_sprite(x, y, res, index, true, Color::transparent, 1.f);
 }
 
+/* Draw sprite that is not part of data source. */
+void
+Frame::draw_sprite(int x, int y, Data::PSprite sprite) {
+  Image image(video, sprite);
+  video->draw_image(image.get_video_image(), x, y, 0, video_frame);
+}
+
+/* Draw image kept by the caller, without offsets. */
+void
+Frame::draw_image(int x, int y, const Image *image) {
+  video->draw_image(image->get_video_image(), x, y, 0, video_frame);
+}
+
 /* Draw the masked sprite with given mask and sprite
    indices at x, y in dest frame. */
 void
 Frame::draw_masked_sprite(int x, int y, Data::Resource mask_res,
                           unsigned int mask_index, Data::Resource res,
-                          unsigned int index) {
-  uint64_t id = Data::Sprite::create_id(res, index, mask_res, mask_index,
-                                        {0, 0, 0, 0});
-  Image *image = Image::get_cached_image(id);
+                          unsigned int index, unsigned int level) {
+  Image *image = get_masked_image(mask_res, mask_index, res, index, level);
   if (image == nullptr) {
-    Data::PSprite s = data_source->get_sprite(res, index, {0, 0, 0, 0});
-    if (!s) {
-      Log::Warn["graphics"] << "Failed to decode sprite #"
-                            << Data::get_resource_name(res) << ":" << index;
-      return;
-    }
-
-    Data::PSprite m = data_source->get_sprite(mask_res, mask_index,
-                                              {0, 0, 0, 0});
-    if (!m) {
-      Log::Warn["graphics"] << "Failed to decode sprite #"
-                            << Data::get_resource_name(mask_res)
-                            << ":" << mask_index;
-      return;
-    }
-
-    Data::PSprite masked = s->get_masked(m);
-    if (!masked) {
-      Log::Warn["graphics"] << "Failed to apply mask #"
-                            << Data::get_resource_name(mask_res)
-                            << ":" << mask_index
-                            << " to sprite #"
-                            << Data::get_resource_name(res) << ":" << index;
-      return;
-    }
-
-    s = std::move(masked);
-
-    image = new Image(video, s);
-    Image::cache_image(id, image);
+    return;
   }
 
   x += image->get_offset_x();
@@ -273,53 +439,12 @@ void
 Frame::draw_waves_sprite(int x, int y, Data::Resource mask_res,
                          unsigned int mask_index, Data::Resource res,
                          unsigned int index) {
-  uint64_t id = Data::Sprite::create_id(res, index, mask_res, mask_index,
-                                        {0, 0, 0, 0});
-  Image *image = Image::get_cached_image(id);
-  if (image == nullptr) {
-    Data::PSprite s = data_source->get_sprite(res, index, {0, 0, 0, 0});
-    if (!s) {
-      Log::Warn["graphics"] << "Failed to decode sprite #"
-                            << Data::get_resource_name(res) << ":" << index;
-      return;
-    }
-
-    if (mask_res > 0) {
-      Data::PSprite m = data_source->get_sprite(mask_res, mask_index,
-                                                {0, 0, 0, 0});
-      if (!m) {
-        Log::Warn["graphics"] << "Failed to decode sprite #"
-                              << Data::get_resource_name(mask_res)
-                              << ":" << mask_index;
-        return;
-      }
-
-      Data::PSprite masked = s->get_masked(m);
-      if (!masked) {
-        Log::Warn["graphics"] << "Failed to apply mask #"
-                              << Data::get_resource_name(mask_res)
-                              << ":" << mask_index
-                              << " to sprite #"
-                              << Data::get_resource_name(res) << ":" << index;
-        return;
-      }
-
-      s = std::move(masked);
-    }
-
-    image = new Image(video, s);
-    Image::cache_image(id, image);
-  }
-
-  x += image->get_offset_x();
-  y += image->get_offset_y();
-  video->draw_image(image->get_video_image(), x, y, 0, video_frame);
+  draw_masked_sprite(x, y, mask_res, mask_index, res, index);
 }
 
-/* Draw a character at x, y in the dest frame. */
-void
-Frame::draw_char_sprite(int x, int y, unsigned char c, const Color &color,
-                        const Color &shadow) {
+/* Index of the font sprite of a character, -1 if there is none. */
+static int
+get_font_index(unsigned char c) {
   static const int sprite_offset_from_ascii[] = {
     -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1,
@@ -356,58 +481,158 @@ Frame::draw_char_sprite(int x, int y, unsigned char c, const Color &color,
     -1, -1, -1, -1, -1, -1, -1, -1,
   };
 
-  int s = sprite_offset_from_ascii[c];
-  if (s < 0) return;
-
-  if (shadow != Color::transparent) {
-    draw_sprite(x, y, Data::AssetFontShadow, s, false, shadow);
+  return sprite_offset_from_ascii[c];
+}
+
+/* Product of two 8 bit values scaled back to 8 bits, rounded as the video
+   blends images. */
+static inline unsigned int
+mul_255(unsigned int a, unsigned int b) {
+  unsigned int v = a * b + 0x80;
+  return (v + (v >> 8)) >> 8;
+}
+
+/* Blend glyph over the pixels of text at x, y. Where text is opaque or
+   either pixel is opaque or clear, the result is exactly what drawing the
+   glyph over the text in a frame gives. */
+static void
+blend_glyph(Data::PSprite text, Data::PSprite glyph, int x, int y) {
+  int width = static_cast<int>(text->get_width());
+  int g_width = static_cast<int>(glyph->get_width());
+  int g_height = static_cast<int>(glyph->get_height());
+  Data::Sprite::Color *dest =
+                   reinterpret_cast<Data::Sprite::Color*>(text->get_data());
+  const Data::Sprite::Color *src =
+                   reinterpret_cast<Data::Sprite::Color*>(glyph->get_data());
+
+  for (int gy = 0; gy < g_height; gy++) {
+    for (int gx = 0; gx < g_width; gx++) {
+      const Data::Sprite::Color &s = src[gy*g_width + gx];
+      Data::Sprite::Color &d = dest[(y + gy)*width + x + gx];
+      unsigned int inverse = 0xff - s.alpha;
+      if (s.alpha == 0xff || d.alpha == 0) {
+        d = s;
+      } else if (s.alpha == 0) {
+        continue;
+      } else if (d.alpha == 0xff) {
+        d.blue = mul_255(s.blue, s.alpha) + mul_255(d.blue, inverse);
+        d.green = mul_255(s.green, s.alpha) + mul_255(d.green, inverse);
+        d.red = mul_255(s.red, s.alpha) + mul_255(d.red, inverse);
+      } else {
+        /* Over a translucent pixel, as it will be drawn over the frame */
+        unsigned int da = mul_255(d.alpha, inverse);
+        unsigned int a = s.alpha + da;
+        d.blue = (s.blue*s.alpha + d.blue*da + a/2) / a;
+        d.green = (s.green*s.alpha + d.green*da + a/2) / a;
+        d.red = (s.red*s.alpha + d.red*da + a/2) / a;
+        d.alpha = a;
+      }
+    }
   }
-  draw_sprite(x, y, Data::AssetFont, s, false, color);
 }
 
-/* Draw the string str at x, y in the dest frame. */
-void
-Frame::draw_string(int x, int y, const std::string &str, const Color &color,
+/* Draw the string to memory glyph by glyph, each over its shadow, with
+   tabs and new lines as the game lays out text. */
+Data::PSprite
+Frame::render_text(const std::string &str, const Color &color,
                    const Color &shadow) {
-  int cx = x;
+  class Glyph {
+   public:
+    Data::PSprite sprite;
+    int x, y;
+  };
+  std::vector<Glyph> glyphs;
+  int width = 0;
+  int height = 0;
+
+  auto add = [&](Data::Resource res, int index, const Color &c, int x,
+                 int y) {
+    Data::PSprite sprite = data_source->get_sprite(res, index,
+                                                   get_sprite_color(c));
+    if (!sprite) return;
+    width = std::max(width, x + static_cast<int>(sprite->get_width()));
+    height = std::max(height, y + static_cast<int>(sprite->get_height()));
+    glyphs.push_back({sprite, x, y});
+  };
 
+  int cx = 0;
+  int cy = 0;
   for (char c : str) {
     if (c == '\t') {
       cx += 8 * 2;
     } else if (c == '\n') {
-      y += 8;
-      cx = x;
+      cy += 8;
+      cx = 0;
     } else {
-      draw_char_sprite(cx, y, c, color, shadow);
+      int index = get_font_index(c);
+      if (index >= 0) {
+        if (shadow != Color::transparent) {
+          add(Data::AssetFontShadow, index, shadow, cx, cy);
+        }
+        add(Data::AssetFont, index, color, cx, cy);
+      }
       cx += 8;
     }
   }
-}
 
-/* Draw the number n at x, y in the dest frame. */
-void
-Frame::draw_number(int x, int y, int value, const Color &color,
-                   const Color &shadow) {
-  if (value < 0) {
-    draw_char_sprite(x, y, '-', color, shadow);
-    x += 8;
-    value *= -1;
+  if (glyphs.empty()) {
+    return nullptr;
   }
 
-  if (value == 0) {
-    draw_char_sprite(x, y, '0', color, shadow);
-    return;
+  Data::PSprite text = std::make_shared<SpriteBase>(width, height);
+  text->fill({0, 0, 0, 0});
+  for (const Glyph &glyph : glyphs) {
+    blend_glyph(text, glyph.sprite, glyph.x, glyph.y);
+  }
+  return text;
+}
+
+/* Return image of the string from the text cache, rendering it on first
+   use. Strings are drawn with one image instead of one or two for each
+   character. */
+Image *
+Frame::get_text_image(const std::string &str, const Color &color,
+                      const Color &shadow) {
+  std::string key = {
+    static_cast<char>(color.get_red()), static_cast<char>(color.get_green()),
+    static_cast<char>(color.get_blue()), static_cast<char>(color.get_alpha()),
+    static_cast<char>(shadow.get_red()), static_cast<char>(shadow.get_green()),
+    static_cast<char>(shadow.get_blue()),
+    static_cast<char>(shadow.get_alpha())
+  };
+  key += str;
+
+  Image *image = text_cache->get(key);
+  if (image == nullptr) {
+    Data::PSprite text = render_text(str, color, shadow);
+    if (!text) {
+      return nullptr;
+    }
+
+    image = new Image(video, text);
+    text_cache->insert(key, std::unique_ptr<Image>(image), image->get_size());
   }
 
-  int digits = 0;
-  for (int i = value; i > 0; i /= 10) digits += 1;
+  return image;
+}
 
-  for (int i = digits-1; i >= 0; i--) {
-    draw_char_sprite(x+8*i, y, '0'+(value % 10), color, shadow);
-    value /= 10;
+/* Draw the string str at x, y in the dest frame. */
+void
+Frame::draw_string(int x, int y, const std::string &str, const Color &color,
+                   const Color &shadow) {
+  Image *image = get_text_image(str, color, shadow);
+  if (image != nullptr) {
+    video->draw_image(image->get_video_image(), x, y, 0, video_frame);
   }
 }
 
+/* Draw the number n at x, y in the dest frame. */
+void
+Frame::draw_number(int x, int y, int value, const Color &color,
+                   const Color &shadow) {
+  draw_string(x, y, std::to_string(value), color, shadow);
+}
+
 /* Draw a rectangle with color at x, y in the dest frame. */
 void
 Frame::draw_rect(int x, int y, int width, int height, const Color &color) {
@@ -431,15 +656,21 @@ Frame::fill_rect(int x, int y, int width, int height, const Color &color) {
 /* Initialize new graphics frame. If dest is NULL a new
    backing surface is created, otherwise the same surface
    as dest is used. */
-Frame::Frame(Video *video_, unsigned int width, unsigned int height) {
+Frame::Frame(Video *video_, ImageCache *image_cache_, TextCache *text_cache_,
+             unsigned int width, unsigned int height) {
   video = video_;
+  image_cache = image_cache_;
+  text_cache = text_cache_;
   video_frame = video->create_frame(width, height);
   owner = true;
   data_source = Data::get_instance().get_data_source();
 }
 
-Frame::Frame(Video *video_, Video::Frame *video_frame_) {
+Frame::Frame(Video *video_, ImageCache *image_cache_, TextCache *text_cache_,
+             Video::Frame *video_frame_) {
   video = video_;
+  image_cache = image_cache_;
+  text_cache = text_cache_;
   video_frame = video_frame_;
   owner = false;
   data_source = Data::get_instance().get_data_source();
@@ -460,6 +691,14 @@ Frame::draw_frame(int dx, int dy, int sx, int sy, Frame *src, int w, int h) {
   video->draw_frame(dx, dy, video_frame, sx, sy, src->video_frame, w, h);
 }
 
+/* Draw source frame rectangle enlarged scale times. */
+void
+Frame::draw_frame_scaled(int dx, int dy, int sx, int sy, Frame *src, int w,
+                         int h, unsigned int scale) {
+  video->draw_frame_scaled(dx, dy, video_frame, sx, sy, src->video_frame,
+                           w, h, scale);
+}
+
 void
 Frame::draw_line(int x, int y, int x1, int y1, const Color &color) {
   Video::Color c = {color.get_red(),
@@ -471,7 +710,12 @@ Frame::draw_line(int x, int y, int x1, int y1, const Color &color) {
 
 Frame *
 Graphics::create_frame(unsigned int width, unsigned int height) {
-  return new Frame(video, width, height);
+  return new Frame(video, &image_cache, &text_cache, width, height);
+}
+
+Image *
+Graphics::create_image(Data::PSprite sprite) {
+  return new Image(video, sprite);
 }
 
 /* Enable or disable fullscreen mode */
@@ -488,7 +732,8 @@ Graphics::is_fullscreen() {
 
 Frame *
 Graphics::get_screen_frame() {
-  return new Frame(video, video->get_screen_frame());
+  return new Frame(video, &image_cache, &text_cache,
+                   video->get_screen_frame());
 }
 
 void
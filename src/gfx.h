@@ -22,12 +22,13 @@
 #ifndef SRC_GFX_H_
 #define SRC_GFX_H_
 
-#include <map>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "src/data.h"
 #include "src/debug.h"
+#include "src/lru-cache.h"
 #include "src/video.h"
 
 class ExceptionGFX : public ExceptionFreeserf {
@@ -89,9 +90,6 @@ class Image {
   Video *video;
   Video::Image *video_image;
 
-  typedef std::map<uint64_t, Image*> ImageCache;
-  static ImageCache image_cache;
-
  public:
   Image(Video *video, Data::PSprite sprite);
   virtual ~Image();
@@ -106,13 +104,21 @@ class Image {
   void set_offset(int x, int y) { offset_x = x; offset_y = y; }
   void set_delta(int x, int y) { delta_x = x; delta_y = y; }
 
-  static void cache_image(uint64_t id, Image *image);
-  static Image *get_cached_image(uint64_t id);
-  static void clear_cache();
+  /* Memory taken by the pixels of the image */
+  size_t get_size() const { return width * height * 4; }
 
   Video::Image *get_video_image() const { return video_image; }
+
+  /* Replace pixels with those of a sprite of the same size */
+  void update(Data::PSprite sprite);
 };
 
+/* Decoded images by sprite id */
+typedef LruCache<uint64_t, Image> ImageCache;
+
+/* Rendered strings by colors and text */
+typedef LruCache<std::string, Image> TextCache;
+
 /* Frame. Keeps track of a specific rectangular area of a surface.
    Multiple frames can refer to the same surface. */
 class Frame {
@@ -121,10 +127,14 @@ class Frame {
   Video::Frame *video_frame;
   bool owner;
   Data::PSource data_source;
+  ImageCache *image_cache;
+  TextCache *text_cache;
 
  public:
-  Frame(Video *video, unsigned int width, unsigned int height);
-  Frame(Video *video, Video::Frame *video_frame);
+  Frame(Video *video, ImageCache *image_cache, TextCache *text_cache,
+        unsigned int width, unsigned int height);
+  Frame(Video *video, ImageCache *image_cache, TextCache *text_cache,
+        Video::Frame *video_frame);
   virtual ~Frame();
 
   /* Sprite functions */
@@ -135,13 +145,18 @@ class Frame {
                    bool use_off, float progress);
   void draw_sprite(int x, int y, Data::Resource res, unsigned int index,
                    bool use_off, const Color &color);
+  void draw_sprite(int x, int y, Data::Resource res, unsigned int index,
+                   bool use_off, const Color &color, float progress,
+                   unsigned int level = 0);
   void draw_sprite_relatively(int x, int y, Data::Resource res,
                               unsigned int index,
                               Data::Resource relative_to_res,
                               unsigned int relative_to_index);
+  void draw_sprite(int x, int y, Data::PSprite sprite);
+  void draw_image(int x, int y, const Image *image);
   void draw_masked_sprite(int x, int y, Data::Resource mask_res,
                           unsigned int mask_index, Data::Resource res,
-                          unsigned int index);
+                          unsigned int index, unsigned int level = 0);
   void draw_waves_sprite(int x, int y, Data::Resource mask_res,
                          unsigned int mask_index, Data::Resource res,
                          unsigned int index);
@@ -159,18 +174,31 @@ class Frame {
 
   /* Frame functions */
   void draw_frame(int dx, int dy, int sx, int sy, Frame *src, int w, int h);
+  void draw_frame_scaled(int dx, int dy, int sx, int sy, Frame *src, int w,
+                         int h, unsigned int scale);
+
+  /* Cached images of sprites, nullptr if they can not be decoded.
+     Level above 0 gives the sprite reduced 2^level times, up to 3. */
+  Image *get_sprite_image(Data::Resource res, unsigned int index,
+                          const Color &color, unsigned int level = 0);
+  Image *get_masked_image(Data::Resource mask_res, unsigned int mask_index,
+                          Data::Resource res, unsigned int index,
+                          unsigned int level = 0);
 
  protected:
-  void draw_char_sprite(int x, int y, unsigned char c, const Color &color,
+  /* Cached image of the whole string, nullptr if nothing of it shows */
+  Image *get_text_image(const std::string &str, const Color &color,
                         const Color &shadow);
-  void draw_sprite(int x, int y, Data::Resource res, unsigned int index,
-                   bool use_off, const Color &color, float progress);
+  Data::PSprite render_text(const std::string &str, const Color &color,
+                            const Color &shadow);
 };
 
 class Graphics {
  protected:
   static Graphics *instance;
   Video *video;
+  ImageCache image_cache;
+  TextCache text_cache;
 
   Graphics();
 
@@ -182,6 +210,34 @@ class Graphics {
   /* Frame functions */
   Frame *create_frame(unsigned int width, unsigned int height);
 
+  /* Image of a sprite that is not part of data source, owned by caller */
+  Image *create_image(Data::PSprite sprite);
+
+  /* Sprite drawn through a mask, as landscape tiles draw the ground */
+  class MaskedSprite {
+   public:
+    Data::Resource mask_res;
+    unsigned int mask_index;
+    Data::Resource res;
+    unsigned int index;
+  };
+  typedef std::vector<MaskedSprite> MaskedSprites;
+
+  /* Decode images of frequently drawn sprites in advance, serf torsos in
+     each of colors and the masked ground sprites of the first view */
+  void warm_up(const std::vector<Color> &colors,
+               const MaskedSprites &masked = MaskedSprites());
+
+  /* Images of sprites shared by all frames */
+  const ImageCache &get_image_cache() const { return image_cache; }
+  void set_image_cache_budget(size_t budget) {
+    image_cache.set_memory_budget(budget); }
+
+  /* Images of strings shared by all frames */
+  const TextCache &get_text_cache() const { return text_cache; }
+  void set_text_cache_budget(size_t budget) {
+    text_cache.set_memory_budget(budget); }
+
   /* Screen functions */
   Frame *get_screen_frame();
   void set_resolution(unsigned int width, unsigned int height, bool fullscreen);
@@ -22,10 +22,14 @@
 #include "src/gui.h"
 
 #include <algorithm>
+#include <utility>
 
 #include "src/misc.h"
 #include "src/audio.h"
 
+/* Frames a redrawn object stays outlined with debug redraws on. */
+#define REDRAW_FLASH_FRAMES  8
+
 /* Get the resulting value from a click on a slider bar. */
 int
 gui_get_slider_click_value(int x) {
@@ -37,6 +41,7 @@ GuiObject::layout() {
 }
 
 GuiObject *GuiObject::focused_object = nullptr;
+bool GuiObject::debug_redraws = false;
 
 GuiObject::GuiObject() {
   x = 0;
@@ -46,8 +51,12 @@ GuiObject::GuiObject() {
   displayed = false;
   enabled = true;
   redraw = true;
+  recompose = true;
+  retained = false;
   parent = nullptr;
   frame = nullptr;
+  layer = nullptr;
+  redraw_flash = 0;
   focused = false;
 }
 
@@ -64,6 +73,20 @@ GuiObject::delete_frame() {
     delete frame;
     frame = nullptr;
   }
+  if (layer != nullptr) {
+    delete layer;
+    layer = nullptr;
+  }
+}
+
+/* A retained object renders its own content into a separate layer and
+   keeps it when only its floats change, the frame is then composed from
+   the layer and the floats. The content has to cover the whole object. */
+void
+GuiObject::set_retained(bool retained) {
+  this->retained = retained;
+  delete_frame();
+  set_redraw();
 }
 
 void
@@ -76,16 +99,44 @@ GuiObject::draw(Frame *_frame) {
     frame = Graphics::get_instance().create_frame(width, height);
   }
 
-  if (redraw) {
-    internal_draw();
+  if (redraw || recompose) {
+    if (!retained) {
+      internal_draw();
+      redraw_flash = REDRAW_FLASH_FRAMES;
+    } else {
+      if (layer == nullptr) {
+        layer = Graphics::get_instance().create_frame(width, height);
+        redraw = true;
+      }
+      if (redraw) {
+        std::swap(frame, layer);
+        internal_draw();
+        std::swap(frame, layer);
+        redraw_flash = REDRAW_FLASH_FRAMES;
+      }
+      frame->draw_frame(0, 0, 0, 0, layer, width, height);
+    }
+
+    /* Floats may mark this object again while they are drawn. */
+    redraw = false;
+    recompose = false;
 
     for (GuiObject *float_window : floats) {
       float_window->draw(frame);
     }
-
-    redraw = false;
   }
   _frame->draw_frame(x, y, 0, 0, frame, width, height);
+
+  if (redraw_flash > 0) {
+    redraw_flash--;
+    if (debug_redraws) {
+      _frame->draw_rect(x, y, width, height, Color::green);
+      /* Compose the parent again to fade the outline out. */
+      if (parent != nullptr) {
+        parent->set_recompose();
+      }
+    }
+  }
 }
 
 bool
@@ -220,7 +271,15 @@ void
 GuiObject::set_redraw() {
   redraw = true;
   if (parent != nullptr) {
-    parent->set_redraw();
+    parent->set_recompose();
+  }
+}
+
+void
+GuiObject::set_recompose() {
+  recompose = true;
+  if (parent != nullptr) {
+    parent->set_recompose();
   }
 }
 
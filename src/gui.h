@@ -37,9 +37,14 @@ class GuiObject : public EventLoop::Handler {
   int width, height;
   bool displayed;
   bool enabled;
-  bool redraw;
+  bool redraw;          // Own content has to be rendered again
+  bool recompose;       // Only floats changed, content is still valid
+  bool retained;
   GuiObject *parent;
   Frame *frame;
+  Frame *layer;         // Own content of retained object, without floats
+  unsigned int redraw_flash;
+  static bool debug_redraws;
   static GuiObject *focused_object;
   bool focused;
 
@@ -54,6 +59,8 @@ class GuiObject : public EventLoop::Handler {
   virtual bool handle_focus_loose() { return false; }
 
   void delete_frame();
+  void set_retained(bool retained);
+  void set_recompose();
 
  public:
   GuiObject();
@@ -80,6 +87,10 @@ class GuiObject : public EventLoop::Handler {
   virtual bool handle_event(const Event *event);
 
   void play_sound(int sound);
+
+  // Outline every object for a few frames after its content was rendered.
+  static void set_debug_redraws(bool enable) { debug_redraws = enable; }
+  static bool get_debug_redraws() { return debug_redraws; }
 };
 
 int gui_get_slider_click_value(int x);
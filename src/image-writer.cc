@@ -0,0 +1,227 @@
+/*
+ * image-writer.cc - Images written to file row by row
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/image-writer.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "src/buffer.h"
+
+// Largest stored deflate block
+#define DEFLATE_BLOCK_MAX  0xFFFF
+
+ImageWriter::ImageWriter(const std::string &path, unsigned int _width,
+                         unsigned int _height)
+  : file(path.c_str(), std::ios::binary | std::ios::trunc)
+  , width(_width)
+  , height(_height)
+  , rows_written(0) {
+}
+
+bool
+ImageWriter::write_rows(const uint8_t *data, unsigned int rows) {
+  if (rows > height - rows_written) {
+    return false;
+  }
+  if (rows == 0) {
+    return true;
+  }
+  rows_written += rows;
+  return write_data(data, rows) && file.good();
+}
+
+bool
+ImageWriter::finish() {
+  if (rows_written != height) {
+    return false;
+  }
+  bool result = write_footer();
+  file.close();
+  return result && !file.fail();
+}
+
+// PNG without compression, the pixels go to stored deflate blocks. This
+// needs no zlib and leaves the file as large as raw pixels.
+class ImageWriterPNG : public ImageWriter {
+ protected:
+  uint32_t crc_table[256];
+  uint32_t adler_a;
+  uint32_t adler_b;
+  uint64_t data_left;  // Bytes of filtered rows still to come
+  std::vector<uint8_t> rows_data;
+
+ public:
+  ImageWriterPNG(const std::string &path, unsigned int _width,
+                 unsigned int _height)
+    : ImageWriter(path, _width, _height)
+    , adler_a(1)
+    , adler_b(0)
+    , data_left(static_cast<uint64_t>(_height) * (3*_width + 1)) {
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+      }
+      crc_table[n] = c;
+    }
+  }
+
+ protected:
+  uint32_t crc(const uint8_t *data, size_t size) const {
+    uint32_t c = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+      c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFF;
+  }
+
+  void adler(const uint8_t *data, size_t size) {
+    while (size > 0) {
+      // Largest run before the sums have to be reduced
+      size_t run = std::min<size_t>(size, 5552);
+      for (size_t i = 0; i < run; i++) {
+        adler_a += data[i];
+        adler_b += adler_a;
+      }
+      adler_a %= 65521;
+      adler_b %= 65521;
+      data += run;
+      size -= run;
+    }
+  }
+
+  bool write_chunk(const char *type, const MutableBuffer &content) {
+    MutableBuffer chunk(Buffer::EndianessBig);
+    chunk.push<uint32_t>(static_cast<uint32_t>(content.get_size()));
+    chunk.push(std::string(type, 4));
+    if (content.get_size() > 0) {
+      chunk.push(content.get_data(), content.get_size());
+    }
+    const uint8_t *data = reinterpret_cast<uint8_t*>(chunk.get_data());
+    chunk.push<uint32_t>(crc(data + 4, chunk.get_size() - 4));
+    file.write(reinterpret_cast<char*>(chunk.get_data()), chunk.get_size());
+    return file.good();
+  }
+
+  virtual bool write_header() {
+    static const uint8_t signature[] = {
+      0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+    };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    MutableBuffer header(Buffer::EndianessBig);
+    header.push<uint32_t>(width);
+    header.push<uint32_t>(height);
+    header.push<uint8_t>(8);  // Bits per sample
+    header.push<uint8_t>(2);  // RGB
+    header.push<uint8_t>(0);  // Deflate
+    header.push<uint8_t>(0);  // Adaptive filtering
+    header.push<uint8_t>(0);  // No interlace
+    return write_chunk("IHDR", header);
+  }
+
+  // One IDAT chunk for each call, the zlib header goes with the first.
+  virtual bool write_data(const uint8_t *data, unsigned int rows) {
+    size_t row_size = 3*width;
+    rows_data.resize(rows * (row_size + 1));
+    for (unsigned int row = 0; row < rows; row++) {
+      uint8_t *dest = &rows_data[row * (row_size + 1)];
+      *dest++ = 0;  // No filter
+      std::copy(data + row * row_size, data + (row + 1) * row_size, dest);
+    }
+    adler(rows_data.data(), rows_data.size());
+
+    MutableBuffer content(Buffer::EndianessLittle);
+    if (rows_written == rows) {
+      content.push<uint8_t>(0x78);
+      content.push<uint8_t>(0x01);
+    }
+    size_t offset = 0;
+    while (offset < rows_data.size()) {
+      size_t size = std::min<size_t>(rows_data.size() - offset,
+                                     DEFLATE_BLOCK_MAX);
+      data_left -= size;
+      content.push<uint8_t>((data_left == 0) ? 1 : 0);
+      content.push<uint16_t>(static_cast<uint16_t>(size));
+      content.push<uint16_t>(static_cast<uint16_t>(~size));
+      content.push(static_cast<const void*>(&rows_data[offset]), size);
+      offset += size;
+    }
+    if (data_left == 0) {
+      uint32_t sum = (adler_b << 16) | adler_a;
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        content.push<uint8_t>(static_cast<uint8_t>(sum >> shift));
+      }
+    }
+    return write_chunk("IDAT", content);
+  }
+
+  virtual bool write_footer() {
+    return write_chunk("IEND", MutableBuffer(Buffer::EndianessBig));
+  }
+};
+
+// Binary portable pixmap, a text header followed by the raw pixels.
+class ImageWriterPPM : public ImageWriter {
+ public:
+  ImageWriterPPM(const std::string &path, unsigned int _width,
+                 unsigned int _height)
+    : ImageWriter(path, _width, _height) {
+  }
+
+ protected:
+  virtual bool write_header() {
+    std::stringstream header;
+    header << "P6\n" << width << " " << height << "\n255\n";
+    file << header.str();
+    return file.good();
+  }
+
+  virtual bool write_data(const uint8_t *data, unsigned int rows) {
+    file.write(reinterpret_cast<const char*>(data),
+               static_cast<std::streamsize>(rows) * 3 * width);
+    return file.good();
+  }
+
+  virtual bool write_footer() {
+    return true;
+  }
+};
+
+std::unique_ptr<ImageWriter>
+ImageWriter::create(Format format, const std::string &path,
+                    unsigned int width, unsigned int height) {
+  std::unique_ptr<ImageWriter> writer;
+  switch (format) {
+    case FormatPNG:
+      writer.reset(new ImageWriterPNG(path, width, height));
+      break;
+    case FormatPPM:
+      writer.reset(new ImageWriterPPM(path, width, height));
+      break;
+  }
+  if (!writer || !writer->file.good() || !writer->write_header()) {
+    return nullptr;
+  }
+  return writer;
+}
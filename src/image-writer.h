@@ -0,0 +1,72 @@
+/*
+ * image-writer.h - Images written to file row by row
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_IMAGE_WRITER_H_
+#define SRC_IMAGE_WRITER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+// Writes an image of 8 bit RGB pixels to file as rows arrive, top to
+// bottom, so that images larger than memory can be written.
+class ImageWriter {
+ public:
+  typedef enum Format {
+    FormatPNG,
+    FormatPPM,  // Raw pixels behind a minimal header
+  } Format;
+
+ protected:
+  std::ofstream file;
+  unsigned int width;
+  unsigned int height;
+  unsigned int rows_written;
+
+ public:
+  virtual ~ImageWriter() {}
+
+  // Nullptr when the file can not be created.
+  static std::unique_ptr<ImageWriter> create(Format format,
+                                             const std::string &path,
+                                             unsigned int width,
+                                             unsigned int height);
+
+  unsigned int get_width() const { return width; }
+  unsigned int get_height() const { return height; }
+
+  // Append rows of 3*width bytes each. False when writing failed or there
+  // are more rows than the image has.
+  bool write_rows(const uint8_t *data, unsigned int rows);
+  // Write whatever follows the last row. False when rows are missing.
+  bool finish();
+
+ protected:
+  ImageWriter(const std::string &path, unsigned int width,
+              unsigned int height);
+
+  virtual bool write_header() = 0;
+  virtual bool write_data(const uint8_t *data, unsigned int rows) = 0;
+  virtual bool write_footer() = 0;
+};
+
+#endif  // SRC_IMAGE_WRITER_H_
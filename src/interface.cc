@@ -26,6 +26,7 @@
 #include <utility>
 
 #include "src/misc.h"
+#include "src/map-buildability.h"
 #include "src/debug.h"
 #include "src/data.h"
 #include "src/audio.h"
@@ -253,29 +254,8 @@ Interface::get_map_cursor_type(const Player *player_, MapPos pos,
     return;
   }
 
-  if (game->can_build_castle(pos, player_)) {
-    *bld_possibility = BuildPossibilityCastle;
-  } else if (game->can_player_build(pos, player_) &&
-       Map::map_space_from_obj[map->get_obj(pos)] ==
-         Map::SpaceOpen &&
-       (game->can_build_flag(map->move_down_right(pos), player_) ||
-         map->has_flag(map->move_down_right(pos)))) {
-    if (game->can_build_mine(pos)) {
-      *bld_possibility = BuildPossibilityMine;
-    } else if (game->can_build_large(pos)) {
-      *bld_possibility = BuildPossibilityLarge;
-    } else if (game->can_build_small(pos)) {
-      *bld_possibility = BuildPossibilitySmall;
-    } else if (game->can_build_flag(pos, player_)) {
-      *bld_possibility = BuildPossibilityFlag;
-    } else {
-      *bld_possibility = BuildPossibilityNone;
-    }
-  } else if (game->can_build_flag(pos, player_)) {
-    *bld_possibility = BuildPossibilityFlag;
-  } else {
-    *bld_possibility = BuildPossibilityNone;
-  }
+  *bld_possibility = static_cast<BuildPossibility>(
+                         game->get_buildability()->get(pos, player_));
 
   if (map->get_obj(pos) == Map::ObjectFlag &&
     map->get_owner(pos) == player_->get_index()) {
@@ -436,6 +416,11 @@ Interface::update_interface() {
 
 void
 Interface::set_game(PGame new_game) {
+  if (simulation) {
+    simulation->stop();
+    simulation.reset();
+  }
+
   if (viewport != nullptr) {
     del_float(viewport);
     delete viewport;
@@ -448,6 +433,10 @@ Interface::set_game(PGame new_game) {
     viewport = new Viewport(this, game->get_map());
     viewport->set_displayed(true);
     add_float(viewport, 0, 0);
+
+    /* Started by the first update, when the interface is set up. */
+    simulation = std::make_shared<Simulation>(game);
+    simulation->add_handler(viewport);
   }
 
   layout();
@@ -765,7 +754,7 @@ Interface::update() {
     return;
   }
 
-  game->update();
+  simulation->start();
 
   int tick_diff = game->get_const_tick() - last_const_tick;
   last_const_tick = game->get_const_tick();
@@ -841,19 +830,19 @@ Interface::handle_key_pressed(char key, int modifier) {
 
     /* Game speed */
     case '+': {
-      game->speed_increase();
+      simulation->post([this]() { game->speed_increase(); });
       break;
     }
     case '-': {
-      game->speed_decrease();
+      simulation->post([this]() { game->speed_decrease(); });
       break;
     }
     case '0': {
-      game->speed_reset();
+      simulation->post([this]() { game->speed_reset(); });
       break;
     }
     case 'p': {
-      game->pause();
+      simulation->post([this]() { game->pause(); });
       break;
     }
 
@@ -880,6 +869,10 @@ Interface::handle_key_pressed(char key, int modifier) {
       viewport->switch_layer(Viewport::LayerGrid);
       break;
     }
+    case 'r': {
+      GuiObject::set_debug_redraws(!GuiObject::get_debug_redraws());
+      break;
+    }
 
     /* Game control */
     case 'b': {
@@ -917,6 +910,9 @@ Interface::handle_key_pressed(char key, int modifier) {
 
 bool
 Interface::handle_event(const Event *event) {
+  /* The game is not updated while the interface is looking at it. */
+  Simulation::Lock lock(simulation);
+
   switch (event->type) {
     case Event::TypeResize:
       set_size(event->dx, event->dy);
@@ -929,6 +925,10 @@ Interface::handle_event(const Event *event) {
       break;
 
     default:
+      /* Objects shown are recorded again, in case input changed them. */
+      if (viewport != nullptr) {
+        viewport->invalidate_objects();
+      }
       return GuiObject::handle_event(event);
       break;
   }
@@ -29,6 +29,7 @@
 #include "src/building.h"
 #include "src/gui.h"
 #include "src/game-manager.h"
+#include "src/simulation.h"
 
 static const unsigned int map_building_sprite[] = {
   0, 0xa7, 0xa8, 0xae, 0xa9,
@@ -73,6 +74,7 @@ class Interface : public GuiObject, public GameManager::Handler {
 
  protected:
   PGame game;
+  PSimulation simulation;
 
   Random random;
 
@@ -114,6 +116,7 @@ class Interface : public GuiObject, public GameManager::Handler {
 
   PGame get_game() { return game; }
   void set_game(PGame game);
+  PSimulation get_simulation() { return simulation; }
 
   Color get_player_color(unsigned int player_index);
 
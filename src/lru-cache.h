@@ -0,0 +1,254 @@
+/*
+ * lru-cache.h - Memory budgeted least recently used cache
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_LRU_CACHE_H_
+#define SRC_LRU_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/* Owns values keyed by Key. Every value is accounted with the size given on
+   insertion; when the sum exceeds the budget the least recently used values
+   are dropped. The value inserted last is never dropped, so a single value
+   larger than the budget is still cached.
+
+   Keys are found in an open addressing table with linear probing that holds
+   indices of nodes, and nodes are linked in the order of use by index. The
+   node vector reallocates as it grows, so only indices of nodes are kept,
+   never pointers into them. Values live apart from their nodes and stay in
+   place until they are dropped. */
+template <typename Key, typename Value>
+class LruCache {
+ protected:
+  static const size_t none = std::numeric_limits<size_t>::max();
+
+  class Node {
+   public:
+    Key key;
+    std::unique_ptr<Value> value;
+    size_t size;
+    size_t prev;  /* More recently used */
+    size_t next;  /* Less recently used */
+  };
+
+  std::vector<Node> nodes;
+  std::vector<size_t> free_nodes;
+  std::vector<size_t> slots;  /* Node index or none */
+  size_t count;
+  size_t first;  /* Most recently used */
+  size_t last;   /* Least recently used */
+  size_t memory_budget;
+  size_t memory_used;
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+
+ public:
+  explicit LruCache(size_t budget)
+    : slots(16, none)
+    , count(0)
+    , first(none)
+    , last(none)
+    , memory_budget(budget)
+    , memory_used(0)
+    , hits(0)
+    , misses(0)
+    , evictions(0) {
+  }
+
+  /* Return value and mark it as most recently used, nullptr if not cached. */
+  Value *get(const Key &key) {
+    size_t slot = find_slot(key);
+    if (slots[slot] == none) {
+      misses++;
+      return nullptr;
+    }
+    hits++;
+    size_t index = slots[slot];
+    unlink(index);
+    link_first(index);
+    return nodes[index].value.get();
+  }
+
+  /* Return value without changing the usage order or the counters. */
+  Value *peek(const Key &key) const {
+    size_t index = slots[find_slot(key)];
+    return (index == none) ? nullptr : nodes[index].value.get();
+  }
+
+  bool contains(const Key &key) const {
+    return (slots[find_slot(key)] != none);
+  }
+
+  Value *insert(const Key &key, std::unique_ptr<Value> value, size_t size) {
+    erase(key);
+
+    if ((count + 1) * 4 > slots.size() * 3) {
+      rehash(slots.size() * 2);
+    }
+
+    size_t index;
+    if (free_nodes.empty()) {
+      index = nodes.size();
+      nodes.push_back(Node());
+    } else {
+      index = free_nodes.back();
+      free_nodes.pop_back();
+    }
+
+    Node &node = nodes[index];
+    node.key = key;
+    node.value = std::move(value);
+    node.size = size;
+    slots[find_slot(key)] = index;
+    link_first(index);
+    count++;
+    memory_used += size;
+
+    enforce_budget();
+
+    return nodes[index].value.get();
+  }
+
+  void erase(const Key &key) {
+    size_t slot = find_slot(key);
+    if (slots[slot] != none) {
+      remove(slot);
+    }
+  }
+
+  void clear() {
+    nodes.clear();
+    free_nodes.clear();
+    slots.assign(16, none);
+    count = 0;
+    first = none;
+    last = none;
+    memory_used = 0;
+  }
+
+  size_t get_count() const { return count; }
+  size_t get_memory_used() const { return memory_used; }
+  size_t get_memory_budget() const { return memory_budget; }
+  void set_memory_budget(size_t budget) {
+    memory_budget = budget;
+    enforce_budget();
+  }
+
+  size_t get_hits() const { return hits; }
+  size_t get_misses() const { return misses; }
+  size_t get_evictions() const { return evictions; }
+
+ protected:
+  size_t get_home(const Key &key) const {
+    uint64_t hash = static_cast<uint64_t>(std::hash<Key>()(key));
+    /* Mix, as standard hashes of integers are the identity. */
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return static_cast<size_t>(hash) & (slots.size() - 1);
+  }
+
+  /* Slot holding the key, or the empty slot where it belongs. */
+  size_t find_slot(const Key &key) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = get_home(key);
+    while (slots[slot] != none && !(nodes[slots[slot]].key == key)) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  /* Free the node in slot and shift following nodes of the probe sequence
+     back, so that lookups do not stop at the emptied slot. */
+  void remove(size_t slot) {
+    size_t index = slots[slot];
+    unlink(index);
+    memory_used -= nodes[index].size;
+    nodes[index].value.reset();
+    free_nodes.push_back(index);
+    count--;
+
+    size_t mask = slots.size() - 1;
+    size_t hole = slot;
+    size_t next = slot;
+    while (true) {
+      next = (next + 1) & mask;
+      if (slots[next] == none) break;
+      size_t home = get_home(nodes[slots[next]].key);
+      bool stays = (hole <= next) ? (hole < home && home <= next)
+                                  : (hole < home || home <= next);
+      if (stays) continue;
+      slots[hole] = slots[next];
+      hole = next;
+    }
+    slots[hole] = none;
+  }
+
+  void rehash(size_t slot_count) {
+    slots.assign(slot_count, none);
+    for (size_t index = first; index != none; index = nodes[index].next) {
+      slots[find_slot(nodes[index].key)] = index;
+    }
+  }
+
+  void unlink(size_t index) {
+    Node &node = nodes[index];
+    if (node.prev != none) {
+      nodes[node.prev].next = node.next;
+    } else {
+      first = node.next;
+    }
+    if (node.next != none) {
+      nodes[node.next].prev = node.prev;
+    } else {
+      last = node.prev;
+    }
+  }
+
+  void link_first(size_t index) {
+    Node &node = nodes[index];
+    node.prev = none;
+    node.next = first;
+    if (first != none) {
+      nodes[first].prev = index;
+    } else {
+      last = index;
+    }
+    first = index;
+  }
+
+  void enforce_budget() {
+    while ((memory_used > memory_budget) && (count > 1)) {
+      remove(find_slot(nodes[last].key));
+      evictions++;
+    }
+  }
+};
+
+template <typename Key, typename Value>
+const size_t LruCache<Key, Value>::none;
+
+#endif  // SRC_LRU_CACHE_H_
@@ -0,0 +1,127 @@
+/*
+ * map-buildability.cc - Incrementally maintained map of build possibilities
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/map-buildability.h"
+
+#include <algorithm>
+
+#include "src/game.h"
+#include "src/player.h"
+
+/* Value of positions that need to be calculated again. */
+static const uint8_t stale = 0xff;
+
+MapBuildability::MapBuildability(Game *_game)
+  : game(_game)
+  , map(_game->get_map()) {
+  map->add_change_handler(this);
+}
+
+MapBuildability::~MapBuildability() {
+  map->del_change_handler(this);
+}
+
+MapBuildability::Buildability
+MapBuildability::get(MapPos pos, const Player *player) {
+  Plane &plane = get_plane(player);
+  uint8_t &value = plane.values[pos];
+  if (value == stale) {
+    value = calculate(pos, player);
+  }
+  return static_cast<Buildability>(value);
+}
+
+MapBuildability::Buildability
+MapBuildability::calculate(MapPos pos, const Player *player) const {
+  if (game->can_build_castle(pos, player)) {
+    return BuildabilityCastle;
+  }
+
+  MapPos flag_pos = map->move_down_right(pos);
+  if (game->can_player_build(pos, player) &&
+      Map::map_space_from_obj[map->get_obj(pos)] == Map::SpaceOpen &&
+      (game->can_build_flag(flag_pos, player) || map->has_flag(flag_pos))) {
+    if (game->can_build_mine(pos)) {
+      return BuildabilityMine;
+    } else if (game->can_build_large(pos)) {
+      return BuildabilityLarge;
+    } else if (game->can_build_small(pos)) {
+      return BuildabilitySmall;
+    }
+  }
+
+  if (game->can_build_flag(pos, player)) {
+    return BuildabilityFlag;
+  }
+
+  return BuildabilityNone;
+}
+
+void
+MapBuildability::invalidate() {
+  for (Plane &plane : planes) {
+    std::fill(plane.values.begin(), plane.values.end(), stale);
+  }
+}
+
+/* Height and object changes are reported for the positions around the
+   change, the values depending on them are within three shells. */
+void
+MapBuildability::on_height_changed(MapPos pos) {
+  invalidate_around(pos, 1+6+12+18);
+}
+
+void
+MapBuildability::on_object_changed(MapPos pos) {
+  invalidate_around(pos, 1+6+12+18);
+}
+
+/* Ownership is only checked in the first shell of a position. */
+void
+MapBuildability::on_owner_changed(MapPos pos) {
+  invalidate_around(pos, 1+6);
+}
+
+MapBuildability::Plane &
+MapBuildability::get_plane(const Player *player) {
+  size_t index = player->get_index();
+  if (index >= planes.size()) {
+    planes.resize(index + 1);
+  }
+
+  Plane &plane = planes[index];
+  if (plane.values.empty() || (plane.has_castle != player->has_castle())) {
+    plane.values.assign(map->get_cols() * map->get_rows(), stale);
+    plane.has_castle = player->has_castle();
+  }
+
+  return plane;
+}
+
+void
+MapBuildability::invalidate_around(MapPos pos, unsigned int spiral_count) {
+  for (Plane &plane : planes) {
+    if (plane.values.empty()) continue;
+    for (unsigned int i = 0; i < spiral_count; i++) {
+      plane.values[map->pos_add_spirally(pos, i)] = stale;
+    }
+  }
+}
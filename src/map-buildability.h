@@ -0,0 +1,85 @@
+/*
+ * map-buildability.h - Incrementally maintained map of build possibilities
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_MAP_BUILDABILITY_H_
+#define SRC_MAP_BUILDABILITY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "src/map.h"
+
+class Game;
+class Player;
+
+// Per player plane with what can be built at every map position.
+//
+// Every value depends only on the map within three tiles of its position,
+// so on a change notification from the map the surrounding values are only
+// marked stale and recalculated on the next query. A change of castle state
+// of the player invalidates the whole plane of that player.
+class MapBuildability : public Map::Handler {
+ public:
+  // Same order as Interface::BuildPossibility.
+  typedef enum Buildability {
+    BuildabilityNone = 0,
+    BuildabilityFlag,
+    BuildabilityMine,
+    BuildabilitySmall,
+    BuildabilityLarge,
+    BuildabilityCastle,
+  } Buildability;
+
+ protected:
+  class Plane {
+   public:
+    std::vector<uint8_t> values;
+    bool has_castle;
+  };
+
+  Game *game;
+  PMap map;
+  std::vector<Plane> planes;
+
+ public:
+  explicit MapBuildability(Game *game);
+  virtual ~MapBuildability();
+
+  const PMap &get_map() const { return map; }
+
+  Buildability get(MapPos pos, const Player *player);
+  // Calculate value from scratch, bypassing the plane.
+  Buildability calculate(MapPos pos, const Player *player) const;
+
+  // Mark all values stale.
+  void invalidate();
+
+  // Map::Handler
+  virtual void on_height_changed(MapPos pos);
+  virtual void on_object_changed(MapPos pos);
+  virtual void on_owner_changed(MapPos pos);
+
+ protected:
+  Plane &get_plane(const Player *player);
+  void invalidate_around(MapPos pos, unsigned int spiral_count);
+};
+
+#endif  // SRC_MAP_BUILDABILITY_H_
@@ -0,0 +1,171 @@
+/*
+ * map-render.cc - Image of the whole map of a saved game
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/command_line.h"
+#include "src/log.h"
+#include "src/version.h"
+#include "src/data.h"
+#include "src/interface.h"
+#include "src/viewport.h"
+#include "src/game-manager.h"
+#include "src/image-writer.h"
+
+/* Size of map tiles in the image, as the viewport draws them. */
+#define TILE_WIDTH   32
+#define TILE_HEIGHT  20
+
+/* Rows of the image drawn at once, one row of landscape tiles of the
+   viewport. Memory use is bounded by a band of the full map width. */
+#define BAND_HEIGHT  (16*TILE_HEIGHT)
+
+static bool
+has_suffix(const std::string &str, const std::string &suffix) {
+  return (str.size() >= suffix.size()) &&
+         (str.compare(str.size() - suffix.size(), suffix.size(),
+                      suffix) == 0);
+}
+
+int
+main(int argc, char *argv[]) {
+  std::string data_dir;
+  std::string save_file;
+  std::string image_file = "map.png";
+  std::string format_name;
+  unsigned int layers = Viewport::LayerLandscape | Viewport::LayerPaths |
+                        Viewport::LayerObjects;
+
+  CommandLine command_line;
+  command_line.add_option('d', "Set Debug output level")
+                .add_parameter("NUM", [](std::istream& s) {
+                  int d;
+                  s >> d;
+                  if (d >= 0 && d < Log::LevelMax) {
+                    Log::set_level(static_cast<Log::Level>(d));
+                  }
+                  return true;
+                });
+  command_line.add_option('f', "Image format, png or ppm (by file name)")
+                .add_parameter("FORMAT", [&format_name](std::istream& s) {
+                  s >> format_name;
+                  return (format_name == "png") || (format_name == "ppm");
+                });
+  command_line.add_option('g', "Use specified data directory")
+                .add_parameter("DATA-PATH", [&data_dir](std::istream& s) {
+                  s >> data_dir;
+                  return true;
+                });
+  command_line.add_option('h', "Show this help text", [&command_line](){
+                  command_line.show_help();
+                  exit(EXIT_SUCCESS);
+                });
+  command_line.add_option('l', "Load saved game")
+                .add_parameter("FILE", [&save_file](std::istream& s) {
+                  std::getline(s, save_file);
+                  return true;
+                });
+  command_line.add_option('o', "Write image to file (map.png)")
+                .add_parameter("FILE", [&image_file](std::istream& s) {
+                  std::getline(s, image_file);
+                  return true;
+                });
+  command_line.add_option('s', "Draw serfs",
+                          [&layers](){ layers |= Viewport::LayerSerfs; });
+  command_line.set_comment("Please report bugs to <" PACKAGE_BUGREPORT ">");
+  if (!command_line.process(argc, argv) || save_file.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  if (format_name.empty()) {
+    format_name = has_suffix(image_file, ".ppm") ? "ppm" : "png";
+  }
+  ImageWriter::Format format = (format_name == "ppm") ?
+                               ImageWriter::FormatPPM : ImageWriter::FormatPNG;
+
+  Log::Info["map-render"] << "starts " << FREESERF_VERSION;
+
+  Data &data = Data::get_instance();
+  if (!data.load(data_dir)) {
+    Log::Error["map-render"] << "Could not load game data.";
+    return EXIT_FAILURE;
+  }
+
+  GameManager &game_manager = GameManager::get_instance();
+  if (!game_manager.load_game(save_file)) {
+    return EXIT_FAILURE;
+  }
+  PMap map = game_manager.get_current_game()->get_map();
+
+  Interface interface;
+  Viewport *viewport = interface.get_viewport();
+
+  unsigned int width = map->get_cols() * TILE_WIDTH;
+  unsigned int height = map->get_rows() * TILE_HEIGHT;
+  std::unique_ptr<ImageWriter> writer = ImageWriter::create(format,
+                                                            image_file,
+                                                            width, height);
+  if (!writer) {
+    Log::Error["map-render"] << "Could not create '" << image_file << "'.";
+    return EXIT_FAILURE;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint8_t> rows;
+  for (unsigned int y = 0; y < height; y += BAND_HEIGHT) {
+    unsigned int band_height = std::min<unsigned int>(BAND_HEIGHT,
+                                                      height - y);
+    Data::PSprite band = viewport->render_area(0, y, width, band_height,
+                                               layers);
+
+    const Data::Sprite::Color *pixels =
+                 reinterpret_cast<Data::Sprite::Color*>(band->get_data());
+    rows.resize(3 * width * band_height);
+    for (size_t i = 0; i < width * band_height; i++) {
+      rows[3*i] = pixels[i].red;
+      rows[3*i + 1] = pixels[i].green;
+      rows[3*i + 2] = pixels[i].blue;
+    }
+    if (!writer->write_rows(rows.data(), band_height)) {
+      Log::Error["map-render"] << "Could not write '" << image_file << "'.";
+      return EXIT_FAILURE;
+    }
+    Log::Verbose["map-render"] << "rows " << y + band_height << " of "
+                               << height;
+  }
+  if (!writer->finish()) {
+    Log::Error["map-render"] << "Could not write '" << image_file << "'.";
+    return EXIT_FAILURE;
+  }
+
+  auto time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    std::chrono::steady_clock::now() - start);
+  Log::Info["map-render"] << "wrote " << width << "x" << height
+                          << " image '" << image_file << "' in "
+                          << time.count() << " ms";
+
+  return EXIT_SUCCESS;
+}
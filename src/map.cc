@@ -412,6 +412,34 @@ Map::set_object(MapPos pos, Object obj, int index) {
   }
 }
 
+void
+Map::set_owner(MapPos pos, unsigned int _owner) {
+  if (game_tiles[pos].owner == _owner + 1) return;
+  game_tiles[pos].owner = _owner + 1;
+
+  for (Handler *handler : change_handlers) {
+    handler->on_owner_changed(pos);
+  }
+}
+
+void
+Map::del_owner(MapPos pos) {
+  if (game_tiles[pos].owner == 0) return;
+  game_tiles[pos].owner = 0;
+
+  for (Handler *handler : change_handlers) {
+    handler->on_owner_changed(pos);
+  }
+}
+
+/* Roads are reported to handlers as object changes at the position. */
+void
+Map::notify_paths_changed(MapPos pos) {
+  for (Handler *handler : change_handlers) {
+    handler->on_object_changed(pos);
+  }
+}
+
 /* Remove resources from the ground at a map position. */
 void
 Map::remove_ground_deposit(MapPos pos, int amount) {
@@ -611,6 +639,8 @@ Map::place_road_segments(const Road &road) {
 
         game_tiles[pos_].paths &= ~BIT(dir);
         game_tiles[move(pos_, dir)].paths &= ~BIT(rev_dir);
+        notify_paths_changed(pos_);
+        notify_paths_changed(move(pos_, dir));
 
         pos_ = move(pos_, dir);
       }
@@ -620,6 +650,8 @@ Map::place_road_segments(const Road &road) {
 
     game_tiles[pos_].paths |= BIT(*it);
     game_tiles[move(pos_, *it)].paths |= BIT(rev_dir);
+    notify_paths_changed(pos_);
+    notify_paths_changed(move(pos_, *it));
 
     pos_ = move(pos_, *it);
   }
@@ -634,6 +666,7 @@ Map::remove_road_backref_until_flag(MapPos pos_, Direction dir) {
 
     /* Clear backreference */
     game_tiles[pos_].paths &= ~BIT(reverse_direction(dir));
+    notify_paths_changed(pos_);
 
     if (get_obj(pos_) == ObjectFlag) break;
 
@@ -688,10 +721,12 @@ Direction
 Map::remove_road_segment(MapPos *pos, Direction dir) {
   /* Clear forward reference. */
   game_tiles[*pos].paths &= ~BIT(dir);
+  notify_paths_changed(*pos);
   *pos = move(*pos, dir);
 
   /* Clear backreference. */
   game_tiles[*pos].paths &= ~BIT(reverse_direction(dir));
+  notify_paths_changed(*pos);
 
   /* Find next direction of path. */
   dir = DirectionNone;
@@ -232,6 +232,7 @@ class Map {
     virtual ~Handler() {}
     virtual void on_height_changed(MapPos pos) = 0;
     virtual void on_object_changed(MapPos pos) = 0;
+    virtual void on_owner_changed(MapPos pos) = 0;
   };
 
   typedef struct LandscapeTile {
@@ -366,16 +367,17 @@ class Map {
   bool has_path(MapPos pos, Direction dir) const {
     return (BIT_TEST(game_tiles[pos].paths, dir) != 0); }
   void add_path(MapPos pos, Direction dir) {
-    game_tiles[pos].paths |= BIT(dir); }
+    game_tiles[pos].paths |= BIT(dir);
+    notify_paths_changed(pos); }
   void del_path(MapPos pos, Direction dir) {
-    game_tiles[pos].paths &= ~BIT(dir); }
+    game_tiles[pos].paths &= ~BIT(dir);
+    notify_paths_changed(pos); }
 
   bool has_owner(MapPos pos) const { return (game_tiles[pos].owner != 0); }
   unsigned int get_owner(MapPos pos) const {
     return game_tiles[pos].owner - 1; }
-  void set_owner(MapPos pos, unsigned int _owner) {
-    game_tiles[pos].owner = _owner + 1; }
-  void del_owner(MapPos pos) { game_tiles[pos].owner = 0; }
+  void set_owner(MapPos pos, unsigned int _owner);
+  void del_owner(MapPos pos);
   unsigned int get_height(MapPos pos) const {
     return landscape_tiles[pos].height; }
 
@@ -465,6 +467,7 @@ class Map {
 
  protected:
   void init_spiral_pos_pattern();
+  void notify_paths_changed(MapPos pos);
 
   void update_public(MapPos pos, Random *rnd);
   void update_hidden(MapPos pos, Random *rnd);
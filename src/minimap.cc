@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <utility>
 
+#include "src/data-source.h"
 #include "src/game.h"
 #include "src/interface.h"
 #include "src/viewport.h"
@@ -37,19 +38,41 @@ Minimap::Minimap(PMap _map) {
   scale = 1;
 
   draw_grid = false;
+  view_dirty = true;
 
   set_map(_map);
 }
 
+Minimap::~Minimap() {
+  if (map) {
+    map->del_change_handler(this);
+  }
+}
+
 void
 Minimap::set_draw_grid(bool _draw_grid) {
   draw_grid = _draw_grid;
+  view_dirty = true;
   set_redraw();
 }
 
 /* Initialize minimap data. */
 void
 Minimap::init_minimap() {
+  if (map == NULL) {
+    return;
+  }
+
+  minimap.resize(map->geom().size());
+  for (MapPos pos : map->geom()) {
+    update_terrain(pos);
+  }
+  update_pixels();
+}
+
+/* Set terrain color of map position from its type and slope. */
+void
+Minimap::update_terrain(MapPos pos) {
   static const int color_offset[] = {
     0, 85, 102, 119, 17, 17, 17, 17,
     34, 34, 34, 51, 51, 51, 68, 68
@@ -104,26 +127,61 @@ Minimap::init_minimap() {
     Color(0x13, 0x13, 0xbb)
   };
 
+  int type_off = color_offset[map->type_up(pos)];
+
+  MapPos right = map->move_right(pos);
+  int h1 = map->get_height(right);
+
+  MapPos down = map->move_left(map->move_down(right));
+  int h2 = map->get_height(down);
+
+  int h_off = h2 - h1 + 8;
+  minimap[pos] = colors[type_off + h_off];
+}
+
+/* Compose color of map position from the layers. */
+Color
+Minimap::get_pixel(MapPos pos) {
+  return minimap[pos];
+}
+
+void
+Minimap::update_pixel(MapPos pos) {
+  Color color = get_pixel(pos);
+  pixels[pos] = { color.get_blue(), color.get_green(), color.get_red(),
+                  color.get_alpha() };
+  view_dirty = true;
+}
+
+void
+Minimap::update_pixels() {
   if (map == NULL) {
     return;
   }
 
-  minimap.clear();
-
+  pixels.resize(map->geom().size());
   for (MapPos pos : map->geom()) {
-    int type_off = color_offset[map->type_up(pos)];
+    update_pixel(pos);
+  }
+}
 
-    pos = map->move_right(pos);
-    int h1 = map->get_height(pos);
+/* Slope colors depend on heights around the position, handler is called
+   for every neighbour of the changed one. */
+void
+Minimap::on_height_changed(MapPos pos) {
+  update_terrain(pos);
+  update_pixel(pos);
+}
 
-    pos = map->move_left(map->move_down(pos));
-    int h2 = map->get_height(pos);
+void
+Minimap::on_object_changed(MapPos /*pos*/) {
+}
 
-    int h_off = h2 - h1 + 8;
-    minimap.push_back(colors[type_off + h_off]);
-  }
+void
+Minimap::on_owner_changed(MapPos /*pos*/) {
 }
 
+/* Plot point of map pixel coordinates into the view. */
 void
 Minimap::draw_minimap_point(int col, int row, const Color &color, int density) {
   int map_width = map->get_cols() * scale;
@@ -133,6 +191,11 @@ Minimap::draw_minimap_point(int col, int row, const Color &color, int density) {
     return;
   }
 
+  Data::Sprite::Color pixel = { color.get_blue(), color.get_green(),
+                                color.get_red(), color.get_alpha() };
+  Data::Sprite::Color *view_data =
+                       reinterpret_cast<Data::Sprite::Color*>(view->get_data());
+
   int mm_y = row * scale - offset_y;
   col -= (map->get_rows()/2) * static_cast<int>(mm_y / map_height);
   mm_y = mm_y % map_height;
@@ -143,7 +206,13 @@ Minimap::draw_minimap_point(int col, int row, const Color &color, int density) {
       mm_x = mm_x % map_width;
       while (mm_x < width) {
         if (mm_x >= -density) {
-          frame->fill_rect(mm_x, mm_y, density, density, color);
+          int y_end = std::min(mm_y + density, height);
+          int x_end = std::min(mm_x + density, width);
+          for (int y = std::max(mm_y, 0); y < y_end; y++) {
+            for (int x = std::max(mm_x, 0); x < x_end; x++) {
+              view_data[y * width + x] = pixel;
+            }
+          }
         }
         mm_x += map_width;
       }
@@ -153,85 +222,28 @@ Minimap::draw_minimap_point(int col, int row, const Color &color, int density) {
   }
 }
 
+/* Fill the view from the composed pixels. Every view pixel is taken from
+   the map position drawn there, with the same shear and wrapping as
+   draw_minimap_point() uses. */
 void
 Minimap::draw_minimap_map() {
-  Color *color_data = &minimap[0];
-  for (unsigned int row = 0; row < map->get_rows(); row++) {
-    for (unsigned int col = 0; col < map->get_cols(); col++) {
-      Color color = *(color_data++);
-      draw_minimap_point(col, row, color, scale);
-    }
-  }
-}
-
-void
-MinimapGame::draw_minimap_ownership(int density) {
-  for (unsigned int row = 0; row < map->get_rows(); row += density) {
-    for (unsigned int col = 0; col < map->get_cols(); col += density) {
-      MapPos pos = map->pos(col, row);
-      if (map->has_owner(pos)) {
-        Color color = interface->get_player_color(map->get_owner(pos));
-        draw_minimap_point(col, row, color, scale);
-      }
-    }
-  }
-}
-
-void
-MinimapGame::draw_minimap_roads() {
-  for (unsigned int row = 0; row < map->get_rows(); row++) {
-    for (unsigned int col = 0; col < map->get_cols(); col++) {
-      int pos = map->pos(col, row);
-      if (map->paths(pos)) {
-        draw_minimap_point(col, row, Color::black, scale);
-      }
-    }
-  }
-}
-
-void
-MinimapGame::draw_minimap_buildings() {
-  const int building_remap[] = {
-    Building::TypeCastle,
-    Building::TypeStock, Building::TypeTower, Building::TypeHut,
-    Building::TypeFortress, Building::TypeToolMaker, Building::TypeSawmill,
-    Building::TypeWeaponSmith, Building::TypeStonecutter,
-    Building::TypeBoatbuilder, Building::TypeForester, Building::TypeLumberjack,
-    Building::TypePigFarm, Building::TypeFarm, Building::TypeFisher,
-    Building::TypeMill, Building::TypeButcher, Building::TypeBaker,
-    Building::TypeStoneMine, Building::TypeCoalMine, Building::TypeIronMine,
-    Building::TypeGoldMine, Building::TypeSteelSmelter,
-    Building::TypeGoldSmelter
-  };
-
-  for (unsigned int row = 0; row < map->get_rows(); row++) {
-    for (unsigned int col = 0; col < map->get_cols(); col++) {
-      int pos = map->pos(col, row);
-      int obj = map->get_obj(pos);
-      if (obj > Map::ObjectFlag && obj <= Map::ObjectCastle) {
-        Color color = interface->get_player_color(map->get_owner(pos));
-        if (advanced > 0) {
-          Building *bld = interface->get_game()->get_building_at_pos(pos);
-          if (bld->get_type() == building_remap[advanced]) {
-            draw_minimap_point(col, row, color, scale);
-          }
-        } else {
-          draw_minimap_point(col, row, color, scale);
-        }
-      }
-    }
+  int map_height = map->get_rows() * scale;
+  if (0 == map_height) {
+    return;
   }
-}
 
-void
-MinimapGame::draw_minimap_traffic() {
-  for (unsigned int row = 0; row < map->get_rows(); row++) {
-    for (unsigned int col = 0; col < map->get_cols(); col++) {
-      int pos = map->pos(col, row);
-      if (map->get_idle_serf(pos)) {
-        Color color = interface->get_player_color(map->get_owner(pos));
-        draw_minimap_point(col, row, color, scale);
-      }
+  Data::Sprite::Color *view_data =
+                       reinterpret_cast<Data::Sprite::Color*>(view->get_data());
+  unsigned int col_mask = map->get_col_mask();
+
+  for (int y = 0; y < height; y++) {
+    int my = y + offset_y;
+    unsigned int col_shift = (map->get_rows()/2) * (my / map_height);
+    unsigned int row = (my % map_height) / scale;
+    int mx = offset_x + (row * scale) / 2;
+    for (int x = 0; x < width; x++) {
+      unsigned int col = ((mx + x) / scale + col_shift) & col_mask;
+      *(view_data++) = pixels[map->pos(col, row)];
     }
   }
 }
@@ -249,6 +261,33 @@ Minimap::draw_minimap_grid() {
   }
 }
 
+/* Upload the view when it has changed and draw it as a single image. */
+void
+Minimap::draw_minimap_view() {
+  if (!view || view->get_width() != static_cast<size_t>(width) ||
+      view->get_height() != static_cast<size_t>(height)) {
+    view = std::make_shared<SpriteBase>(width, height);
+    view_image.reset();
+    view_dirty = true;
+  }
+
+  if (view_dirty) {
+    draw_minimap_map();
+    if (draw_grid) {
+      draw_minimap_grid();
+    }
+
+    if (view_image) {
+      view_image->update(view);
+    } else {
+      view_image.reset(Graphics::get_instance().create_image(view));
+    }
+    view_dirty = false;
+  }
+
+  frame->draw_image(0, 0, view_image.get());
+}
+
 void
 Minimap::draw_minimap_rect() {
   int px = width / 2;
@@ -263,11 +302,7 @@ Minimap::internal_draw() {
     return;
   }
 
-  draw_minimap_map();
-
-  if (draw_grid) {
-    draw_minimap_grid();
-  }
+  draw_minimap_view();
 }
 
 int
@@ -296,8 +331,15 @@ Minimap::handle_drag(int dx, int dy) {
 
 void
 Minimap::set_map(PMap _map) {
+  if (map) {
+    map->del_change_handler(this);
+  }
   map = std::move(_map);
+  if (map) {
+    map->add_change_handler(this);
+  }
   init_minimap();
+  view_dirty = true;
   set_redraw();
 }
 
@@ -307,6 +349,7 @@ Minimap::set_scale(int scale) {
   MapPos pos = get_current_map_pos();
   this->scale = scale;
   move_to_map_pos(pos);
+  view_dirty = true;
 
   set_redraw();
 }
@@ -389,6 +432,7 @@ Minimap::move_to_map_pos(MapPos pos) {
   offset_x = mx;
   offset_y = my;
 
+  view_dirty = true;
   set_redraw();
 }
 
@@ -411,6 +455,7 @@ Minimap::move_by_pixels(int dx, int dy) {
   if (offset_x >= pwidth) offset_x -= pwidth;
   else if (offset_x < 0) offset_x += pwidth;
 
+  view_dirty = true;
   set_redraw();
 }
 
@@ -422,58 +467,175 @@ MinimapGame::MinimapGame(Interface *_interface, PGame _game)
   , draw_roads(false)
   , draw_buildings(true)
   , ownership_mode(OwnershipModeNone) {
+  init_layers();
 }
 
 void
-MinimapGame::set_ownership_mode(OwnershipMode _ownership_mode) {
-  ownership_mode = _ownership_mode;
-  set_redraw();
+MinimapGame::init_layers() {
+  ownership.assign(map->geom().size(), Color::transparent);
+  roads.assign(map->geom().size(), Color::transparent);
+  buildings.assign(map->geom().size(), Color::transparent);
+  traffic.assign(map->geom().size(), Color::transparent);
+
+  for (MapPos pos : map->geom()) {
+    update_ownership(pos);
+    update_roads(pos);
+    update_buildings(pos);
+  }
+  update_pixels();
 }
 
 void
-MinimapGame::set_draw_roads(bool _draw_roads) {
-  draw_roads = _draw_roads;
-  set_redraw();
+MinimapGame::update_ownership(MapPos pos) {
+  if (map->has_owner(pos)) {
+    ownership[pos] = interface->get_player_color(map->get_owner(pos));
+  } else {
+    ownership[pos] = Color::transparent;
+  }
 }
 
 void
-MinimapGame::set_draw_buildings(bool _draw_buildings) {
-  draw_buildings = _draw_buildings;
-  set_redraw();
+MinimapGame::update_roads(MapPos pos) {
+  roads[pos] = map->paths(pos) ? Color::black : Color::transparent;
 }
 
 void
-MinimapGame::internal_draw() {
+MinimapGame::update_buildings(MapPos pos) {
+  const int building_remap[] = {
+    Building::TypeCastle,
+    Building::TypeStock, Building::TypeTower, Building::TypeHut,
+    Building::TypeFortress, Building::TypeToolMaker, Building::TypeSawmill,
+    Building::TypeWeaponSmith, Building::TypeStonecutter,
+    Building::TypeBoatbuilder, Building::TypeForester, Building::TypeLumberjack,
+    Building::TypePigFarm, Building::TypeFarm, Building::TypeFisher,
+    Building::TypeMill, Building::TypeButcher, Building::TypeBaker,
+    Building::TypeStoneMine, Building::TypeCoalMine, Building::TypeIronMine,
+    Building::TypeGoldMine, Building::TypeSteelSmelter,
+    Building::TypeGoldSmelter
+  };
+
+  buildings[pos] = Color::transparent;
+
+  int obj = map->get_obj(pos);
+  if (obj > Map::ObjectFlag && obj <= Map::ObjectCastle) {
+    if (advanced > 0) {
+      Building *bld = game->get_building_at_pos(pos);
+      if (bld == nullptr || bld->get_type() != building_remap[advanced]) {
+        return;
+      }
+    }
+    buildings[pos] = interface->get_player_color(map->get_owner(pos));
+  }
+}
+
+/* Idle serfs are not reported by map change events, their layer is
+   compared with the map on every redraw while it is shown. */
+void
+MinimapGame::update_traffic() {
+  for (MapPos pos : map->geom()) {
+    Color color = Color::transparent;
+    if (map->get_idle_serf(pos)) {
+      color = interface->get_player_color(map->get_owner(pos));
+    }
+    if (traffic[pos] != color) {
+      traffic[pos] = color;
+      update_pixel(pos);
+    }
+  }
+}
+
+Color
+MinimapGame::get_pixel(MapPos pos) {
+  Color color = minimap[pos];
+
   switch (ownership_mode) {
     case OwnershipModeNone:
-      draw_minimap_map();
       break;
     case OwnershipModeMixed:
-      draw_minimap_map();
-      draw_minimap_ownership(2);
+      if (((map->pos_col(pos) | map->pos_row(pos)) & 1) == 0 &&
+          ownership[pos] != Color::transparent) {
+        color = ownership[pos];
+      }
       break;
     case OwnershipModeSolid:
-      frame->fill_rect(0, 0, 128, 128, Color::black);
-      draw_minimap_ownership(1);
+      if (ownership[pos] != Color::transparent) {
+        color = ownership[pos];
+      } else {
+        color = Color::black;
+      }
       break;
   }
 
-  if (draw_roads) {
-    draw_minimap_roads();
+  if (draw_roads && roads[pos] != Color::transparent) {
+    color = roads[pos];
   }
 
-  if (draw_buildings) {
-    draw_minimap_buildings();
+  if (draw_buildings && buildings[pos] != Color::transparent) {
+    color = buildings[pos];
   }
 
-  if (draw_grid) {
-    draw_minimap_grid();
+  if (advanced > 0 && traffic[pos] != Color::transparent) {
+    color = traffic[pos];
   }
 
+  return color;
+}
+
+void
+MinimapGame::on_object_changed(MapPos pos) {
+  update_roads(pos);
+  update_buildings(pos);
+  update_pixel(pos);
+}
+
+void
+MinimapGame::on_owner_changed(MapPos pos) {
+  update_ownership(pos);
+  update_buildings(pos);
+  update_pixel(pos);
+}
+
+void
+MinimapGame::set_advanced(int _advanced) {
+  advanced = _advanced;
+  for (MapPos pos : map->geom()) {
+    update_buildings(pos);
+  }
+  if (advanced <= 0) {
+    traffic.assign(map->geom().size(), Color::transparent);
+  }
+  update_pixels();
+  set_redraw();
+}
+
+void
+MinimapGame::set_ownership_mode(OwnershipMode _ownership_mode) {
+  ownership_mode = _ownership_mode;
+  update_pixels();
+  set_redraw();
+}
+
+void
+MinimapGame::set_draw_roads(bool _draw_roads) {
+  draw_roads = _draw_roads;
+  update_pixels();
+  set_redraw();
+}
+
+void
+MinimapGame::set_draw_buildings(bool _draw_buildings) {
+  draw_buildings = _draw_buildings;
+  update_pixels();
+  set_redraw();
+}
+
+void
+MinimapGame::internal_draw() {
   if (advanced > 0) {
-    draw_minimap_traffic();
+    update_traffic();
   }
 
+  draw_minimap_view();
   draw_minimap_rect();
 }
 
@@ -22,6 +22,7 @@
 #ifndef SRC_MINIMAP_H_
 #define SRC_MINIMAP_H_
 
+#include <memory>
 #include <vector>
 
 #include "src/gui.h"
@@ -30,7 +31,10 @@
 
 class Interface;
 
-class Minimap : public GuiObject {
+/* Minimap keeps one pixel per map position, updated from map change
+   events. The visible part is scaled and sheared from those pixels into
+   a single image, which is uploaded only when something has changed. */
+class Minimap : public GuiObject, public Map::Handler {
  protected:
   PMap map;
 
@@ -39,10 +43,15 @@ class Minimap : public GuiObject {
 
   bool draw_grid;
 
-  std::vector<Color> minimap;
+  std::vector<Color> minimap;  /* Terrain color of map positions */
+  std::vector<Data::Sprite::Color> pixels;  /* Composed color of positions */
+  Data::PSprite view;
+  std::unique_ptr<Image> view_image;
+  bool view_dirty;
 
  public:
   explicit Minimap(PMap map);
+  virtual ~Minimap();
 
   void set_map(PMap map);
 
@@ -58,14 +67,24 @@ class Minimap : public GuiObject {
   void screen_pix_from_map_pos(MapPos pos, int *sx, int *sy);
   MapPos map_pos_from_screen_pix(int x, int y);
 
+  /* Map::Handler */
+  virtual void on_height_changed(MapPos pos);
+  virtual void on_object_changed(MapPos pos);
+  virtual void on_owner_changed(MapPos pos);
+
  protected:
   static const int max_scale;
 
   void init_minimap();
+  void update_terrain(MapPos pos);
+  void update_pixel(MapPos pos);
+  void update_pixels();
+  virtual Color get_pixel(MapPos pos);
 
   void draw_minimap_point(int col, int row, const Color &color, int density);
   void draw_minimap_map();
   void draw_minimap_grid();
+  void draw_minimap_view();
   void draw_minimap_rect();
   int handle_scroll(int up);
   void screen_pix_from_map_pix(int mx, int my, int *sx, int *sy);
@@ -94,11 +113,17 @@ class MinimapGame : public Minimap {
   bool draw_buildings;
   OwnershipMode ownership_mode;
 
+  /* Layers of map position colors, transparent where there is nothing */
+  std::vector<Color> ownership;
+  std::vector<Color> roads;
+  std::vector<Color> buildings;
+  std::vector<Color> traffic;
+
  public:
   MinimapGame(Interface *interface, PGame game);
 
   int get_advanced() const { return advanced; }
-  void set_advanced(int advanced) { this->advanced = advanced; }
+  void set_advanced(int advanced);
   bool get_draw_roads() const { return draw_roads; }
   void set_draw_roads(bool draw_roads);
   bool get_draw_buildings() const { return draw_buildings; }
@@ -106,11 +131,16 @@ class MinimapGame : public Minimap {
   OwnershipMode get_ownership_mode() { return ownership_mode; }
   void set_ownership_mode(OwnershipMode _ownership_mode);
 
+  virtual void on_object_changed(MapPos pos);
+  virtual void on_owner_changed(MapPos pos);
+
  protected:
-  void draw_minimap_ownership(int density);
-  void draw_minimap_roads();
-  void draw_minimap_buildings();
-  void draw_minimap_traffic();
+  void init_layers();
+  void update_ownership(MapPos pos);
+  void update_roads(MapPos pos);
+  void update_buildings(MapPos pos);
+  void update_traffic();
+  virtual Color get_pixel(MapPos pos);
 
   virtual void internal_draw();
   virtual bool handle_click_left(int x, int y);
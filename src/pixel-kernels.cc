@@ -0,0 +1,632 @@
+/*
+ * pixel-kernels.cc - Pixel loops of sprite composition
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/pixel-kernels.h"
+
+#include <algorithm>
+
+#include "src/data.h"
+
+/* SIMD implementations handle the alpha channel as the highest byte of the
+   pixel, so they are limited to little endian targets. AVX2 code is built
+   with function level target attributes and used only after a check of the
+   processor, this needs GCC or Clang. */
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PIXEL_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PIXEL_KERNELS_SSE2) && defined(__GNUC__)
+#define PIXEL_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__BYTE_ORDER__) && \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define PIXEL_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+typedef Data::Sprite::Color Color;
+
+/* Scalar */
+
+static void
+mask_scalar(uint32_t *dst, const uint32_t *src1, const uint32_t *src2,
+            size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = src1[i] & src2[i];
+  }
+}
+
+static void
+compare_scalar(uint32_t *dst, const uint32_t *src1, const uint32_t *src2,
+               size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = (src1[i] == src2[i]) ? 0x00000000 : 0xFFFFFFFF;
+  }
+}
+
+static void
+fill_masked_scalar(uint32_t *dst, uint32_t color, size_t count) {
+  Color *res = reinterpret_cast<Color*>(dst);
+  for (size_t i = 0; i < count; i++) {
+    if ((res->alpha & 0xFF) != 0x00) {
+      *reinterpret_cast<uint32_t*>(res) = color;
+    }
+    res++;
+  }
+}
+
+static void
+add_scalar(uint32_t *dst, const uint32_t *src, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] += src[i];
+  }
+}
+
+static void
+del_scalar(uint32_t *dst, const uint32_t *src, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (src[i] == 0xFFFFFFFF) {
+      dst[i] = 0x00000000;
+    }
+  }
+}
+
+#define UNMULTIPLY(color, a) ((0xFF * (color)) / (a))
+#define BLEND(back, front, a) (((front) * (a)) + ((back) * (0xFF - (a)))) / 0xFF
+
+static void
+blend_scalar(uint32_t *dst, const uint32_t *src, size_t count) {
+  Color *c = reinterpret_cast<Color*>(dst);
+  const Color *o = reinterpret_cast<const Color*>(src);
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t alpha = o->alpha;
+
+    if (alpha == 0x00) {
+      c++;
+      o++;
+      continue;
+    }
+
+    if (alpha == 0xFF) {
+      *c++ = *o++;
+      continue;
+    }
+
+    const uint8_t backR = c->red;
+    const uint8_t backG = c->green;
+    const uint8_t backB = c->blue;
+
+    const uint8_t frontR = UNMULTIPLY(o->red, alpha);
+    const uint8_t frontG = UNMULTIPLY(o->green, alpha);
+    const uint8_t frontB = UNMULTIPLY(o->blue, alpha);
+
+    const uint32_t R = BLEND(backR, frontR, alpha);
+    const uint32_t G = BLEND(backG, frontG, alpha);
+    const uint32_t B = BLEND(backB, frontB, alpha);
+
+    *c++ = {(uint8_t)B, (uint8_t)G, (uint8_t)R, 0xFF};
+    o++;
+  }
+}
+
+/* First pass of alpha mask, return the lowest alpha of visible pixels
+   or min if it is lower. */
+static uint8_t
+alpha_mask_range(uint32_t *dst, size_t count, uint8_t min) {
+  Color *c = reinterpret_cast<Color*>(dst);
+  for (size_t i = 0; i < count; i++) {
+    if (c->alpha != 0x00) {
+      c->alpha = 0xff - static_cast<uint8_t>((0.21 * c->red) +
+                                             (0.72 * c->green) +
+                                             (0.07 * c->blue));
+      c->red = 0;
+      c->green = 0;
+      c->blue = 0;
+      min = std::min(min, c->alpha);
+    }
+    c++;
+  }
+  return min;
+}
+
+static void
+alpha_shift_range(uint32_t *dst, size_t count, uint8_t min) {
+  Color *c = reinterpret_cast<Color*>(dst);
+  for (size_t i = 0; i < count; i++) {
+    if (c->alpha != 0x00) {
+      c->alpha = c->alpha - min;
+    }
+    c++;
+  }
+}
+
+static void
+alpha_mask_scalar(uint32_t *dst, size_t count) {
+  uint8_t min = alpha_mask_range(dst, count, 0xFF);
+  alpha_shift_range(dst, count, min);
+}
+
+static const PixelKernels kernels_scalar = {
+  "scalar",
+  mask_scalar,
+  compare_scalar,
+  fill_masked_scalar,
+  add_scalar,
+  del_scalar,
+  blend_scalar,
+  alpha_mask_scalar
+};
+
+/* SSE2 */
+
+#ifdef PIXEL_KERNELS_SSE2
+
+#define LOAD_128(ptr) _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr))
+#define STORE_128(ptr, v) _mm_storeu_si128(reinterpret_cast<__m128i*>(ptr), v)
+
+static void
+mask_sse2(uint32_t *dst, const uint32_t *src1, const uint32_t *src2,
+          size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    STORE_128(dst + i, _mm_and_si128(LOAD_128(src1 + i), LOAD_128(src2 + i)));
+  }
+  mask_scalar(dst + i, src1 + i, src2 + i, count - i);
+}
+
+static void
+compare_sse2(uint32_t *dst, const uint32_t *src1, const uint32_t *src2,
+             size_t count) {
+  const __m128i ones = _mm_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i equal = _mm_cmpeq_epi32(LOAD_128(src1 + i), LOAD_128(src2 + i));
+    STORE_128(dst + i, _mm_xor_si128(equal, ones));
+  }
+  compare_scalar(dst + i, src1 + i, src2 + i, count - i);
+}
+
+static void
+fill_masked_sse2(uint32_t *dst, uint32_t color, size_t count) {
+  const __m128i alpha_bits = _mm_set1_epi32(0xFF000000);
+  const __m128i fill = _mm_set1_epi32(color);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i p = LOAD_128(dst + i);
+    __m128i hidden = _mm_cmpeq_epi32(_mm_and_si128(p, alpha_bits),
+                                     _mm_setzero_si128());
+    STORE_128(dst + i, _mm_or_si128(_mm_and_si128(hidden, p),
+                                    _mm_andnot_si128(hidden, fill)));
+  }
+  fill_masked_scalar(dst + i, color, count - i);
+}
+
+static void
+add_sse2(uint32_t *dst, const uint32_t *src, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    STORE_128(dst + i, _mm_add_epi32(LOAD_128(dst + i), LOAD_128(src + i)));
+  }
+  add_scalar(dst + i, src + i, count - i);
+}
+
+static void
+del_sse2(uint32_t *dst, const uint32_t *src, size_t count) {
+  const __m128i ones = _mm_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i full = _mm_cmpeq_epi32(LOAD_128(src + i), ones);
+    STORE_128(dst + i, _mm_andnot_si128(full, LOAD_128(dst + i)));
+  }
+  del_scalar(dst + i, src + i, count - i);
+}
+
+/* Unmultiply and blend four translucent pixels. Products of the integer
+   channels are exact in floats and the quotients are far enough from the
+   next integer, so truncation gives the same values as integer division. */
+static __m128i
+blend_translucent_sse2(__m128i c, __m128i o, __m128i alpha) {
+  const __m128i byte = _mm_set1_epi32(0xFF);
+  const __m128 full = _mm_set1_ps(255.f);
+  __m128 a = _mm_cvtepi32_ps(alpha);
+  __m128 rest = _mm_cvtepi32_ps(_mm_sub_epi32(byte, alpha));
+  __m128i result = _mm_set1_epi32(0xFF000000);
+  for (int shift = 0; shift < 24; shift += 8) {
+    __m128i count = _mm_cvtsi32_si128(shift);
+    __m128 back = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(c, count),
+                                                byte));
+    __m128 front = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(o, count),
+                                                 byte));
+    front = _mm_cvtepi32_ps(_mm_and_si128(
+                  _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(full, front), a)),
+                  byte));
+    __m128 mix = _mm_add_ps(_mm_mul_ps(front, a), _mm_mul_ps(back, rest));
+    __m128i value = _mm_cvttps_epi32(_mm_div_ps(mix, full));
+    result = _mm_or_si128(result, _mm_sll_epi32(value, count));
+  }
+  return result;
+}
+
+/* Sprites are mostly fully opaque or transparent, such groups of pixels are
+   selected without any arithmetic. */
+static void
+blend_sse2(uint32_t *dst, const uint32_t *src, size_t count) {
+  const __m128i opaque_alpha = _mm_set1_epi32(0xFF);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i o = LOAD_128(src + i);
+    __m128i c = LOAD_128(dst + i);
+    __m128i alpha = _mm_srli_epi32(o, 24);
+    __m128i opaque = _mm_cmpeq_epi32(alpha, opaque_alpha);
+    __m128i transparent = _mm_cmpeq_epi32(alpha, _mm_setzero_si128());
+    __m128i result = _mm_or_si128(_mm_and_si128(opaque, o),
+                                  _mm_andnot_si128(opaque, c));
+    __m128i keep = _mm_or_si128(opaque, transparent);
+    if (_mm_movemask_epi8(keep) != 0xFFFF) {
+      __m128i mixed = blend_translucent_sse2(c, o, alpha);
+      result = _mm_or_si128(_mm_and_si128(keep, result),
+                            _mm_andnot_si128(keep, mixed));
+    }
+    STORE_128(dst + i, result);
+  }
+  blend_scalar(dst + i, src + i, count - i);
+}
+
+/* Luminance of four pixels, computed in doubles in the same order as the
+   scalar code to get the same truncated values. */
+static __m128i
+luminance_sse2(__m128i p) {
+  const __m128i byte = _mm_set1_epi32(0xFF);
+  __m128i b = _mm_and_si128(p, byte);
+  __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), byte);
+  __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), byte);
+
+  const __m128d kr = _mm_set1_pd(0.21);
+  const __m128d kg = _mm_set1_pd(0.72);
+  const __m128d kb = _mm_set1_pd(0.07);
+  __m128i result[2];
+  for (int half = 0; half < 2; half++) {
+    __m128d rd = _mm_cvtepi32_pd(r);
+    __m128d gd = _mm_cvtepi32_pd(g);
+    __m128d bd = _mm_cvtepi32_pd(b);
+    __m128d lum = _mm_add_pd(_mm_add_pd(_mm_mul_pd(kr, rd),
+                                        _mm_mul_pd(kg, gd)),
+                             _mm_mul_pd(kb, bd));
+    result[half] = _mm_cvttpd_epi32(lum);
+    r = _mm_shuffle_epi32(r, _MM_SHUFFLE(1, 0, 3, 2));
+    g = _mm_shuffle_epi32(g, _MM_SHUFFLE(1, 0, 3, 2));
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2));
+  }
+  return _mm_unpacklo_epi64(result[0], result[1]);
+}
+
+static void
+alpha_mask_sse2(uint32_t *dst, size_t count) {
+  const __m128i alpha_bits = _mm_set1_epi32(0xFF000000);
+  const __m128i byte = _mm_set1_epi32(0xFF);
+  __m128i lowest = byte;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i p = LOAD_128(dst + i);
+    __m128i hidden = _mm_cmpeq_epi32(_mm_and_si128(p, alpha_bits),
+                                     _mm_setzero_si128());
+    __m128i alpha = _mm_sub_epi32(byte, luminance_sse2(p));
+    STORE_128(dst + i, _mm_or_si128(_mm_and_si128(hidden, p),
+                                    _mm_andnot_si128(hidden,
+                                                  _mm_slli_epi32(alpha, 24))));
+    // Values fit in the low 16 bits of the lanes, so the 16 bit minimum
+    // works for 32 bit lanes.
+    lowest = _mm_min_epi16(lowest, _mm_or_si128(_mm_and_si128(hidden, byte),
+                                               _mm_andnot_si128(hidden,
+                                                                alpha)));
+  }
+  uint32_t lanes[4];
+  STORE_128(lanes, lowest);
+  uint8_t min = static_cast<uint8_t>(std::min(std::min(lanes[0], lanes[1]),
+                                              std::min(lanes[2], lanes[3])));
+  min = alpha_mask_range(dst + i, count - i, min);
+
+  const __m128i shift = _mm_set1_epi32(static_cast<uint32_t>(min) << 24);
+  i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i p = LOAD_128(dst + i);
+    __m128i hidden = _mm_cmpeq_epi32(_mm_and_si128(p, alpha_bits),
+                                     _mm_setzero_si128());
+    STORE_128(dst + i, _mm_sub_epi32(p, _mm_andnot_si128(hidden, shift)));
+  }
+  alpha_shift_range(dst + i, count - i, min);
+}
+
+static const PixelKernels kernels_sse2 = {
+  "sse2",
+  mask_sse2,
+  compare_sse2,
+  fill_masked_sse2,
+  add_sse2,
+  del_sse2,
+  blend_sse2,
+  alpha_mask_sse2
+};
+
+#endif  // PIXEL_KERNELS_SSE2
+
+/* AVX2 */
+
+#ifdef PIXEL_KERNELS_AVX2
+
+#define AVX2 __attribute__((target("avx2")))
+#define LOAD_256(ptr) \
+  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr))
+#define STORE_256(ptr, v) \
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr), v)
+
+AVX2 static void
+mask_avx2(uint32_t *dst, const uint32_t *src1, const uint32_t *src2,
+          size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    STORE_256(dst + i, _mm256_and_si256(LOAD_256(src1 + i),
+                                        LOAD_256(src2 + i)));
+  }
+  mask_scalar(dst + i, src1 + i, src2 + i, count - i);
+}
+
+AVX2 static void
+compare_avx2(uint32_t *dst, const uint32_t *src1, const uint32_t *src2,
+             size_t count) {
+  const __m256i ones = _mm256_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i equal = _mm256_cmpeq_epi32(LOAD_256(src1 + i),
+                                       LOAD_256(src2 + i));
+    STORE_256(dst + i, _mm256_xor_si256(equal, ones));
+  }
+  compare_scalar(dst + i, src1 + i, src2 + i, count - i);
+}
+
+AVX2 static void
+fill_masked_avx2(uint32_t *dst, uint32_t color, size_t count) {
+  const __m256i alpha_bits = _mm256_set1_epi32(0xFF000000);
+  const __m256i fill = _mm256_set1_epi32(color);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i p = LOAD_256(dst + i);
+    __m256i hidden = _mm256_cmpeq_epi32(_mm256_and_si256(p, alpha_bits),
+                                        _mm256_setzero_si256());
+    STORE_256(dst + i, _mm256_blendv_epi8(fill, p, hidden));
+  }
+  fill_masked_scalar(dst + i, color, count - i);
+}
+
+AVX2 static void
+add_avx2(uint32_t *dst, const uint32_t *src, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    STORE_256(dst + i, _mm256_add_epi32(LOAD_256(dst + i),
+                                        LOAD_256(src + i)));
+  }
+  add_scalar(dst + i, src + i, count - i);
+}
+
+AVX2 static void
+del_avx2(uint32_t *dst, const uint32_t *src, size_t count) {
+  const __m256i ones = _mm256_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i full = _mm256_cmpeq_epi32(LOAD_256(src + i), ones);
+    STORE_256(dst + i, _mm256_andnot_si256(full, LOAD_256(dst + i)));
+  }
+  del_scalar(dst + i, src + i, count - i);
+}
+
+AVX2 static __m256i
+blend_translucent_avx2(__m256i c, __m256i o, __m256i alpha) {
+  const __m256i byte = _mm256_set1_epi32(0xFF);
+  const __m256 full = _mm256_set1_ps(255.f);
+  __m256 a = _mm256_cvtepi32_ps(alpha);
+  __m256 rest = _mm256_cvtepi32_ps(_mm256_sub_epi32(byte, alpha));
+  __m256i result = _mm256_set1_epi32(0xFF000000);
+  for (int shift = 0; shift < 24; shift += 8) {
+    __m128i count = _mm_cvtsi32_si128(shift);
+    __m256 back = _mm256_cvtepi32_ps(
+                      _mm256_and_si256(_mm256_srl_epi32(c, count), byte));
+    __m256 front = _mm256_cvtepi32_ps(
+                      _mm256_and_si256(_mm256_srl_epi32(o, count), byte));
+    front = _mm256_cvtepi32_ps(_mm256_and_si256(
+          _mm256_cvttps_epi32(_mm256_div_ps(_mm256_mul_ps(full, front), a)),
+          byte));
+    __m256 mix = _mm256_add_ps(_mm256_mul_ps(front, a),
+                               _mm256_mul_ps(back, rest));
+    __m256i value = _mm256_cvttps_epi32(_mm256_div_ps(mix, full));
+    result = _mm256_or_si256(result, _mm256_sll_epi32(value, count));
+  }
+  return result;
+}
+
+AVX2 static void
+blend_avx2(uint32_t *dst, const uint32_t *src, size_t count) {
+  const __m256i opaque_alpha = _mm256_set1_epi32(0xFF);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i o = LOAD_256(src + i);
+    __m256i c = LOAD_256(dst + i);
+    __m256i alpha = _mm256_srli_epi32(o, 24);
+    __m256i opaque = _mm256_cmpeq_epi32(alpha, opaque_alpha);
+    __m256i transparent = _mm256_cmpeq_epi32(alpha, _mm256_setzero_si256());
+    __m256i result = _mm256_blendv_epi8(c, o, opaque);
+    __m256i keep = _mm256_or_si256(opaque, transparent);
+    if (_mm256_movemask_epi8(keep) != -1) {
+      result = _mm256_blendv_epi8(blend_translucent_avx2(c, o, alpha), result,
+                                  keep);
+    }
+    STORE_256(dst + i, result);
+  }
+  blend_scalar(dst + i, src + i, count - i);
+}
+
+static const PixelKernels kernels_avx2 = {
+  "avx2",
+  mask_avx2,
+  compare_avx2,
+  fill_masked_avx2,
+  add_avx2,
+  del_avx2,
+  blend_avx2,
+  alpha_mask_sse2
+};
+
+static bool
+is_avx2_supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif  // PIXEL_KERNELS_AVX2
+
+/* NEON */
+
+#ifdef PIXEL_KERNELS_NEON
+
+static bool
+is_all_set(uint32x4_t mask) {
+  uint32x2_t half = vand_u32(vget_low_u32(mask), vget_high_u32(mask));
+  return (vget_lane_u32(half, 0) & vget_lane_u32(half, 1)) == 0xFFFFFFFF;
+}
+
+static void
+mask_neon(uint32_t *dst, const uint32_t *src1, const uint32_t *src2,
+          size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_u32(dst + i, vandq_u32(vld1q_u32(src1 + i), vld1q_u32(src2 + i)));
+  }
+  mask_scalar(dst + i, src1 + i, src2 + i, count - i);
+}
+
+static void
+compare_neon(uint32_t *dst, const uint32_t *src1, const uint32_t *src2,
+             size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    uint32x4_t equal = vceqq_u32(vld1q_u32(src1 + i), vld1q_u32(src2 + i));
+    vst1q_u32(dst + i, vmvnq_u32(equal));
+  }
+  compare_scalar(dst + i, src1 + i, src2 + i, count - i);
+}
+
+static void
+fill_masked_neon(uint32_t *dst, uint32_t color, size_t count) {
+  const uint32x4_t alpha_bits = vdupq_n_u32(0xFF000000);
+  const uint32x4_t fill = vdupq_n_u32(color);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    uint32x4_t p = vld1q_u32(dst + i);
+    uint32x4_t visible = vtstq_u32(p, alpha_bits);
+    vst1q_u32(dst + i, vbslq_u32(visible, fill, p));
+  }
+  fill_masked_scalar(dst + i, color, count - i);
+}
+
+static void
+add_neon(uint32_t *dst, const uint32_t *src, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_u32(dst + i, vaddq_u32(vld1q_u32(dst + i), vld1q_u32(src + i)));
+  }
+  add_scalar(dst + i, src + i, count - i);
+}
+
+static void
+del_neon(uint32_t *dst, const uint32_t *src, size_t count) {
+  const uint32x4_t ones = vdupq_n_u32(0xFFFFFFFF);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    uint32x4_t full = vceqq_u32(vld1q_u32(src + i), ones);
+    vst1q_u32(dst + i, vbicq_u32(vld1q_u32(dst + i), full));
+  }
+  del_scalar(dst + i, src + i, count - i);
+}
+
+static void
+blend_neon(uint32_t *dst, const uint32_t *src, size_t count) {
+  const uint32x4_t opaque_alpha = vdupq_n_u32(0xFF);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    uint32x4_t o = vld1q_u32(src + i);
+    uint32x4_t alpha = vshrq_n_u32(o, 24);
+    uint32x4_t opaque = vceqq_u32(alpha, opaque_alpha);
+    uint32x4_t transparent = vceqq_u32(alpha, vdupq_n_u32(0));
+    if (!is_all_set(vorrq_u32(opaque, transparent))) {
+      blend_scalar(dst + i, src + i, 4);
+      continue;
+    }
+    vst1q_u32(dst + i, vbslq_u32(opaque, o, vld1q_u32(dst + i)));
+  }
+  blend_scalar(dst + i, src + i, count - i);
+}
+
+/* Luminance is left scalar, the compiler may fuse the scalar multiply-add
+   on ARM and vector code would not round the same. */
+static const PixelKernels kernels_neon = {
+  "neon",
+  mask_neon,
+  compare_neon,
+  fill_masked_neon,
+  add_neon,
+  del_neon,
+  blend_neon,
+  alpha_mask_scalar
+};
+
+#endif  // PIXEL_KERNELS_NEON
+
+std::vector<const PixelKernels*>
+PixelKernels::get_available() {
+  std::vector<const PixelKernels*> available;
+  available.push_back(&kernels_scalar);
+#ifdef PIXEL_KERNELS_SSE2
+  available.push_back(&kernels_sse2);
+#endif
+#ifdef PIXEL_KERNELS_AVX2
+  if (is_avx2_supported()) {
+    available.push_back(&kernels_avx2);
+  }
+#endif
+#ifdef PIXEL_KERNELS_NEON
+  available.push_back(&kernels_neon);
+#endif
+  return available;
+}
+
+const PixelKernels &
+PixelKernels::get_instance() {
+  static const PixelKernels *instance = get_available().back();
+  return *instance;
+}
+
+const PixelKernels &
+PixelKernels::get_scalar() {
+  return kernels_scalar;
+}
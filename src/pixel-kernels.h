@@ -0,0 +1,59 @@
+/*
+ * pixel-kernels.h - Pixel loops of sprite composition
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_PIXEL_KERNELS_H_
+#define SRC_PIXEL_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Loops over BGRA pixels used by SpriteBase, each pixel is handled as one
+// uint32_t. There is an implementation for every instruction set the build
+// and the processor support, the best one is chosen on first use. All of
+// them give results identical to the scalar implementation.
+class PixelKernels {
+ public:
+  typedef void (*Binary)(uint32_t *dst, const uint32_t *src, size_t count);
+  typedef void (*Ternary)(uint32_t *dst, const uint32_t *src1,
+                          const uint32_t *src2, size_t count);
+  typedef void (*Fill)(uint32_t *dst, uint32_t color, size_t count);
+  typedef void (*Unary)(uint32_t *dst, size_t count);
+
+  const char *name;
+
+  Ternary mask;         // dst = src1 & src2
+  Ternary compare;      // dst = (src1 == src2) ? 0 : ~0
+  Fill fill_masked;     // dst = color, where alpha of dst is not 0
+  Binary add;           // dst += src
+  Binary del;           // dst = 0, where src is ~0
+  Binary blend;         // Unmultiply src and blend it over dst
+  Unary alpha_mask;     // Replace visible pixels with black of luminance
+                        // based alpha, stretched to start at 0
+
+  static const PixelKernels &get_instance();
+  static const PixelKernels &get_scalar();
+
+  // All implementations usable on this processor, the scalar one first.
+  static std::vector<const PixelKernels*> get_available();
+};
+
+#endif  // SRC_PIXEL_KERNELS_H_
@@ -292,7 +292,8 @@ PopupBox::PopupBox(Interface *_interface)
   : minimap(new MinimapGame(_interface, _interface->get_game()))
   , file_list(new ListSavedFiles())
   , file_field(new TextInput())
-  , box(TypeNone) {
+  , box(TypeNone)
+  , chart_max(0) {
   interface = _interface;
 
   current_sett_5_item = 8;
@@ -300,6 +301,9 @@ PopupBox::PopupBox(Interface *_interface)
   current_stat_7_item = 7;
   current_stat_8_mode = 0;
 
+  /* Keep the box content while only the floats change. */
+  set_retained(true);
+
   /* Initialize minimap */
   minimap->set_displayed(false);
   minimap->set_parent(this);
@@ -860,9 +864,28 @@ PopupBox::draw_stat_bld_4_box() {
   draw_popup_icon(14, 128, 60); /* exit */
 }
 
+/* Frame to draw the chart for key in, nullptr while the chart drawn last
+   is still the one for key. */
+Frame *
+PopupBox::get_chart_target(const ChartKey &key) {
+  if (chart && (chart_key == key)) {
+    return nullptr;
+  }
+
+  chart.reset(Graphics::get_instance().create_frame(width, height));
+  chart_key = key;
+  return chart.get();
+}
+
+/* Draw the cached chart over the popup. */
+void
+PopupBox::draw_chart() {
+  frame->draw_frame(0, 0, 0, 0, chart.get(), width, height);
+}
+
 void
 PopupBox::draw_player_stat_chart(const int *data, int index,
-                                 const Color &color) {
+                                 const Color &color, Frame *target) {
   int lx = 8;
   int ly = 9;
   int lw = 112;
@@ -878,19 +901,19 @@ PopupBox::draw_player_stat_chart(const int *data, int index,
       if (value > prev_value) {
         int diff = value - prev_value;
         int h = diff/2;
-        frame->fill_rect(lx + lw - i, ly + lh - h - prev_value, 1, h,
-                         color);
+        target->fill_rect(lx + lw - i, ly + lh - h - prev_value, 1, h,
+                          color);
         diff -= h;
-        frame->fill_rect(lx + lw - i - 1, ly + lh - value, 1, diff, color);
+        target->fill_rect(lx + lw - i - 1, ly + lh - value, 1, diff, color);
       } else if (value == prev_value) {
-        frame->fill_rect(lx + lw - i - 1, ly + lh - value, 2, 1, color);
+        target->fill_rect(lx + lw - i - 1, ly + lh - value, 2, 1, color);
       } else {
         int diff = prev_value - value;
         int h = diff/2;
-        frame->fill_rect(lx + lw - i, ly + lh - prev_value, 1, h, color);
+        target->fill_rect(lx + lw - i, ly + lh - prev_value, 1, h, color);
         diff -= h;
-        frame->fill_rect(lx + lw - i - 1, ly + lh - value - diff, 1, diff,
-                         color);
+        target->fill_rect(lx + lw - i - 1, ly + lh - value - diff, 1, diff,
+                          color);
       }
     }
 
@@ -951,14 +974,18 @@ PopupBox::draw_stat_8_box() {
   /* Draw chart */
   PGame game = interface->get_game();
   int index = game->get_player_history_index(scale);
-  for (int i = 0; i < GAME_MAX_PLAYER_COUNT; i++) {
-    if (game->get_player(GAME_MAX_PLAYER_COUNT-i-1) != nullptr) {
-      Player *player = game->get_player(GAME_MAX_PLAYER_COUNT-i-1);
-      Color color = interface->get_player_color(GAME_MAX_PLAYER_COUNT-i-1);
-      draw_player_stat_chart(player->get_player_stat_history(mode), index,
-                             color);
+  Frame *target = get_chart_target(ChartKey(box, mode, index, -1));
+  if (target != nullptr) {
+    for (int i = 0; i < GAME_MAX_PLAYER_COUNT; i++) {
+      if (game->get_player(GAME_MAX_PLAYER_COUNT-i-1) != nullptr) {
+        Player *player = game->get_player(GAME_MAX_PLAYER_COUNT-i-1);
+        Color color = interface->get_player_color(GAME_MAX_PLAYER_COUNT-i-1);
+        draw_player_stat_chart(player->get_player_stat_history(mode), index,
+                               color, target);
+      }
     }
   }
+  draw_chart();
 }
 
 void
@@ -1020,26 +1047,32 @@ PopupBox::draw_stat_7_box() {
 
   const int sample_weights[] = { 4, 6, 8, 9, 10, 9, 8, 6, 4 };
 
-  /* Create array of historical counts */
+  /* Create array of historical counts, unless the chart of them is drawn */
   int historical_data[112];
-  int max_val = 0;
   int index = interface->get_game()->get_resource_history_index();
+  Player *player = interface->get_player();
+  Frame *target = get_chart_target(ChartKey(box, item, index,
+                                            player->get_index()));
+
+  if (target != nullptr) {
+    chart_max = 0;
+    for (int i = 0; i < 112; i++) {
+      historical_data[i] = 0;
+      int j = index;
+      for (int k = 0; k < 9; k++) {
+        historical_data[i] += sample_weights[k]*
+                              player->get_resource_count_history(item)[j];
+        j = j > 0 ? j-1 : 119;
+      }
 
-  for (int i = 0; i < 112; i++) {
-    historical_data[i] = 0;
-    int j = index;
-    for (int k = 0; k < 9; k++) {
-      historical_data[i] += sample_weights[k]*interface->
-                              get_player()->get_resource_count_history(item)[j];
-      j = j > 0 ? j-1 : 119;
-    }
+      if (historical_data[i] > chart_max) {
+        chart_max = historical_data[i];
+      }
 
-    if (historical_data[i] > max_val) {
-      max_val = historical_data[i];
+      index = index > 0 ? index-1 : 119;
     }
-
-    index = index > 0 ? index-1 : 119;
   }
+  int max_val = chart_max;
 
   const int axis_icons_1[] = { 110, 109, 108, 107 };
   const int axis_icons_2[] = { 112, 111, 110, 108 };
@@ -1087,12 +1120,16 @@ PopupBox::draw_stat_7_box() {
   }
 
   /* Draw chart */
-  for (int i = 0; i < 112; i++) {
-    int value = std::min((historical_data[i]*multiplier) >> 16, 64);
-    if (value > 0) {
-      frame->fill_rect(119 - i, 73 - value, 1, value, Color(0xcf, 0x63, 0x63));
+  if (target != nullptr) {
+    for (int i = 0; i < 112; i++) {
+      int value = std::min((historical_data[i]*multiplier) >> 16, 64);
+      if (value > 0) {
+        target->fill_rect(119 - i, 73 - value, 1, value,
+                          Color(0xcf, 0x63, 0x63));
+      }
     }
   }
+  draw_chart();
 }
 
 void
@@ -4350,6 +4387,7 @@ void PopupBox::hide() {
 void
 PopupBox::set_box(Type box_) {
   box = box_;
+  chart.reset();
   if (box == TypeMap) {
     minimap->set_displayed(true);
   } else {
@@ -23,6 +23,7 @@
 #define SRC_POPUP_H_
 
 #include <string>
+#include <tuple>
 #include <vector>
 #include <memory>
 
@@ -153,6 +154,13 @@ class PopupBox : public GuiObject {
   int current_stat_7_item;
   int current_stat_8_mode;
 
+  /* Chart of the statistics popups as drawn last, kept until the history
+     it shows moves on: box, mode or item, history index and player. */
+  typedef std::tuple<Type, int, int, int> ChartKey;
+  std::unique_ptr<Frame> chart;
+  ChartKey chart_key;
+  int chart_max;
+
  public:
   explicit PopupBox(Interface *interface);
   virtual ~PopupBox();
@@ -192,7 +200,10 @@ class PopupBox : public GuiObject {
   void draw_stat_bld_2_box();
   void draw_stat_bld_3_box();
   void draw_stat_bld_4_box();
-  void draw_player_stat_chart(const int *data, int index, const Color &color);
+  Frame *get_chart_target(const ChartKey &key);
+  void draw_chart();
+  void draw_player_stat_chart(const int *data, int index, const Color &color,
+                              Frame *target);
   void draw_stat_8_box();
   void draw_stat_7_box();
   void draw_gauge_balance(int x, int y, unsigned int value, unsigned int count);
@@ -21,8 +21,10 @@
 
 #include "src/profiler.h"
 
+#include <algorithm>
 #include <string>
 #include <istream>
+#include <chrono>
 
 #include "src/command_line.h"
 #include "src/log.h"
@@ -32,6 +34,7 @@
 int
 main(int argc, char *argv[]) {
   std::string save_file;
+  unsigned int load_count = 0;
 
   CommandLine command_line;
   command_line.add_option('h', "Show this help text", [&command_line](){
@@ -43,6 +46,12 @@ main(int argc, char *argv[]) {
                   std::getline(s, save_file);
                   return true;
                 });
+  command_line.add_option('n', "Only load the game NUM times and report "
+                               "the load times")
+                .add_parameter("NUM", [&load_count](std::istream& s) {
+                  s >> load_count;
+                  return true;
+                });
   command_line.set_comment("Please report bugs to <" PACKAGE_BUGREPORT ">");
   if (!command_line.process(argc, argv) || save_file.empty()) {
     return EXIT_FAILURE;
@@ -52,10 +61,38 @@ main(int argc, char *argv[]) {
 
   GameManager &game_manager = GameManager::get_instance();
 
+  if (load_count > 0) {
+    // Repeat the load to get figures that can be compared between builds
+    std::chrono::milliseconds total(0);
+    std::chrono::milliseconds fastest = std::chrono::milliseconds::max();
+    std::chrono::milliseconds slowest(0);
+    for (unsigned int i = 0; i < load_count; i++) {
+      auto load_start = std::chrono::steady_clock::now();
+      if (!game_manager.load_game(save_file)) {
+        return EXIT_FAILURE;
+      }
+      auto load_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::steady_clock::now() - load_start);
+      total += load_time;
+      fastest = std::min(fastest, load_time);
+      slowest = std::max(slowest, load_time);
+    }
+    Log::Info["profiler"] << "loaded game '" << save_file << "' "
+                          << load_count << " times: min "
+                          << fastest.count() << " ms, avg "
+                          << total.count() / load_count << " ms, max "
+                          << slowest.count() << " ms";
+    return EXIT_SUCCESS;
+  }
+
+  auto load_start = std::chrono::steady_clock::now();
   if (!game_manager.load_game(save_file)) {
     return EXIT_FAILURE;
   }
-  Log::Info["profiler"] << "loaded game '" << save_file << "'";
+  auto load_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::steady_clock::now() - load_start);
+  Log::Info["profiler"] << "loaded game '" << save_file << "' in "
+                        << load_time.count() << " ms";
 
   PGame game = game_manager.get_current_game();
   while (true) {
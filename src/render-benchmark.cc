@@ -0,0 +1,262 @@
+/*
+ * render-benchmark.cc - Viewport drawing benchmark on the offscreen video
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/command_line.h"
+#include "src/log.h"
+#include "src/version.h"
+#include "src/data.h"
+#include "src/gfx.h"
+#include "src/interface.h"
+#include "src/viewport.h"
+#include "src/game-manager.h"
+
+/* Size of map tiles on screen, as the viewport draws them. */
+#define TILE_WIDTH   32
+#define TILE_HEIGHT  20
+
+/* Candidate view centres are this many tiles apart. */
+#define SAMPLE_STEP  8
+
+/* Scroll distance in pixels for each frame of the scroll test. */
+#define SCROLL_STEP  16
+
+typedef std::vector<std::pair<MapPos, unsigned int>> Positions;
+
+// Rank view centres by the number of map objects and serfs a view of the
+// given size shows around them, densest first.
+static Positions
+find_dense_positions(PMap map, unsigned int width, unsigned int height,
+                     size_t count) {
+  int cols = width / TILE_WIDTH + 1;
+  int rows = height / TILE_HEIGHT + 1;
+
+  Positions positions;
+  for (unsigned int y = 0; y < map->get_rows(); y += SAMPLE_STEP) {
+    for (unsigned int x = 0; x < map->get_cols(); x += SAMPLE_STEP) {
+      MapPos centre = map->pos(x, y);
+      unsigned int density = 0;
+      for (int dy = -rows / 2; dy < rows / 2; dy++) {
+        for (int dx = -cols / 2; dx < cols / 2; dx++) {
+          MapPos pos = map->pos_add(centre, dx, dy);
+          if (map->get_obj(pos) != Map::ObjectNone) density++;
+          if (map->has_serf(pos)) density++;
+        }
+      }
+      positions.push_back(std::make_pair(centre, density));
+    }
+  }
+
+  std::stable_sort(positions.begin(), positions.end(),
+                   [](const std::pair<MapPos, unsigned int> &a,
+                      const std::pair<MapPos, unsigned int> &b) {
+                     return a.second > b.second;
+                   });
+  if (positions.size() > count) {
+    positions.resize(count);
+  }
+  return positions;
+}
+
+// Draw frames the way the event loop does and return the average time of
+// one frame in ms. Only drawing is timed, not the preparation of a frame.
+static double
+measure(Interface *interface, Frame *screen, unsigned int frames,
+        std::function<void(unsigned int)> prepare) {
+  Graphics &gfx = Graphics::get_instance();
+  Viewport *viewport = interface->get_viewport();
+
+  std::chrono::duration<double, std::milli> elapsed(0);
+  for (unsigned int i = 0; i < frames; i++) {
+    prepare(i);
+    viewport->set_redraw();
+    Simulation::Lock lock(interface->get_simulation());
+    auto start = std::chrono::steady_clock::now();
+    interface->draw(screen);
+    gfx.swap_buffers();
+    elapsed += std::chrono::steady_clock::now() - start;
+  }
+  return elapsed.count() / std::max(frames, 1u);
+}
+
+int
+main(int argc, char *argv[]) {
+  std::string data_dir;
+  std::string save_file;
+  unsigned int screen_width = 800;
+  unsigned int screen_height = 600;
+  unsigned int frames = 200;
+  unsigned int position_count = 3;
+  float zoom = 1.f;
+
+  CommandLine command_line;
+  command_line.add_option('d', "Set Debug output level")
+                .add_parameter("NUM", [](std::istream& s) {
+                  int d;
+                  s >> d;
+                  if (d >= 0 && d < Log::LevelMax) {
+                    Log::set_level(static_cast<Log::Level>(d));
+                  }
+                  return true;
+                });
+  command_line.add_option('g', "Use specified data directory")
+                .add_parameter("DATA-PATH", [&data_dir](std::istream& s) {
+                  s >> data_dir;
+                  return true;
+                });
+  command_line.add_option('h', "Show this help text", [&command_line](){
+                  command_line.show_help();
+                  exit(EXIT_SUCCESS);
+                });
+  command_line.add_option('l', "Load saved game")
+                .add_parameter("FILE", [&save_file](std::istream& s) {
+                  std::getline(s, save_file);
+                  return true;
+                });
+  command_line.add_option('n', "Frames drawn for each measurement")
+                .add_parameter("NUM", [&frames](std::istream& s) {
+                  s >> frames;
+                  return true;
+                });
+  command_line.add_option('p', "Number of view positions to measure")
+                .add_parameter("NUM", [&position_count](std::istream& s) {
+                  s >> position_count;
+                  return true;
+                });
+  command_line.add_option('r', "Set display resolution (e.g. 800x600)")
+                .add_parameter("RES",
+                              [&screen_width, &screen_height](std::istream& s) {
+                  s >> screen_width;
+                  char c; s >> c;
+                  s >> screen_height;
+                  return true;
+                });
+  command_line.add_option('z', "Zoom factor, above 1 to zoom out")
+                .add_parameter("FACTOR", [&zoom](std::istream& s) {
+                  s >> zoom;
+                  return true;
+                });
+  command_line.set_comment("Please report bugs to <" PACKAGE_BUGREPORT ">");
+  if (!command_line.process(argc, argv)) {
+    return EXIT_FAILURE;
+  }
+
+  Log::Info["render-benchmark"] << "starts " << FREESERF_VERSION;
+
+  Data &data = Data::get_instance();
+  if (!data.load(data_dir)) {
+    Log::Error["render-benchmark"] << "Could not load game data.";
+    return EXIT_FAILURE;
+  }
+
+  Graphics &gfx = Graphics::get_instance();
+  gfx.set_resolution(screen_width, screen_height, false);
+  if (!gfx.set_zoom_factor(zoom)) {
+    Log::Error["render-benchmark"] << "Zoom factor " << zoom
+                                   << " is out of range.";
+    return EXIT_FAILURE;
+  }
+  unsigned int view_width = static_cast<unsigned int>(screen_width * zoom);
+  unsigned int view_height = static_cast<unsigned int>(screen_height * zoom);
+
+  GameManager &game_manager = GameManager::get_instance();
+  if (!save_file.empty()) {
+    if (!game_manager.load_game(save_file)) {
+      return EXIT_FAILURE;
+    }
+  } else {
+    if (!game_manager.start_random_game()) {
+      return EXIT_FAILURE;
+    }
+  }
+  PGame game = game_manager.get_current_game();
+
+  Interface interface;
+  interface.set_size(view_width, view_height);
+  interface.set_displayed(true);
+  Viewport *viewport = interface.get_viewport();
+
+  std::unique_ptr<Frame> screen(gfx.get_screen_frame());
+
+  const std::pair<Viewport::Layer, const char*> layers[] = {
+    { Viewport::LayerLandscape, "landscape" },
+    { Viewport::LayerPaths, "paths" },
+    { Viewport::LayerObjects, "objects" },
+    { Viewport::LayerSerfs, "serfs" },
+    { Viewport::LayerCursor, "cursor" }
+  };
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << screen_width << "x" << screen_height << " at zoom " << zoom
+            << ", " << frames << " frames per measurement" << std::endl;
+
+  Positions positions = find_dense_positions(game->get_map(), view_width,
+                                             view_height, position_count);
+  for (const auto &position : positions) {
+    PMap map = game->get_map();
+    viewport->move_to_map_pos(position.first);
+
+    // Warm up caches before measuring
+    measure(&interface, screen.get(), 2, [](unsigned int) {});
+
+    double animate = measure(&interface, screen.get(), frames,
+                             [&game](unsigned int) { game->update(); });
+    double scroll = measure(&interface, screen.get(), frames,
+                            [viewport](unsigned int i) {
+      int step = (i % 2 == 0) ? SCROLL_STEP : -SCROLL_STEP;
+      viewport->move_by_pixels(step, step);
+    });
+
+    std::cout << "position " << map->pos_col(position.first) << ","
+              << map->pos_row(position.first) << " (" << position.second
+              << " objects and serfs)" << std::endl;
+    std::cout << std::setprecision(3)
+              << "  animate: " << std::setw(8) << animate << " ms/frame "
+              << std::setprecision(1) << std::setw(8) << 1000. / animate
+              << " fps" << std::endl;
+    std::cout << std::setprecision(3)
+              << "  scroll:  " << std::setw(8) << scroll << " ms/frame "
+              << std::setprecision(1) << std::setw(8) << 1000. / scroll
+              << " fps" << std::endl;
+
+    for (const auto &layer : layers) {
+      viewport->switch_layer(layer.first);
+      double without = measure(&interface, screen.get(), frames,
+                               [&game](unsigned int) { game->update(); });
+      viewport->switch_layer(layer.first);
+      std::cout << "  " << std::left << std::setw(10) << layer.second
+                << std::right << " " << std::setprecision(3) << std::setw(8)
+                << animate - without << " ms/frame" << std::endl;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
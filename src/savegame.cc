@@ -35,6 +35,8 @@
 #include "src/log.h"
 #include "src/debug.h"
 #include "src/configfile.h"
+#include "src/buffer.h"
+#include "src/thread-pool.h"
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -201,11 +203,22 @@ class SaveReaderTextFile : public SaveReaderText {
       throw ExceptionFreeserf("Wrong config file format.");
     }
 
+    // Sections are independent, so their values are parsed in parallel.
     auto sects = file.get_sections();
-    for (std::string name : sects) {
-      SaveReaderTextSection *section = new SaveReaderTextSection(&file, name);
-      sections.push_back(section);
+    std::vector<std::string> names(sects.begin(), sects.end());
+    std::vector<SaveReaderTextSection*> parsed(names.size(), nullptr);
+    try {
+      ThreadPool::get_instance().parallel_for(names.size(),
+                                          [&file, &names, &parsed](size_t i) {
+        parsed[i] = new SaveReaderTextSection(&file, names[i]);
+      });
+    } catch (...) {
+      for (SaveReaderTextSection *section : parsed) {
+        delete section;
+      }
+      throw;
     }
+    sections.assign(parsed.begin(), parsed.end());
 
     auto vals = file.get_values("main");
     for (std::string vname : vals) {
@@ -266,16 +279,20 @@ SaveReaderBinary::SaveReaderBinary(const SaveReaderBinary &reader) {
   start = reader.start;
   current = reader.current;
   end = reader.end;
+  checked = reader.checked;
 }
 
 SaveReaderBinary::SaveReaderBinary(void *data, size_t size) {
   start = current = reinterpret_cast<uint8_t*>(data);
   end = start + size;
+  checked = true;
 }
 
 SaveReaderBinary&
 SaveReaderBinary::operator >> (uint8_t &val) {
-  if (!has_data_left(1)) throw ExceptionFreeserf("Invalid read past end.");
+  if (checked && !has_data_left(1)) {
+    throw ExceptionFreeserf("Invalid read past end.");
+  }
   val = *current;
   current++;
   return *this;
@@ -283,7 +300,9 @@ SaveReaderBinary::operator >> (uint8_t &val) {
 
 SaveReaderBinary&
 SaveReaderBinary::operator >> (uint16_t &val) {
-  if (!has_data_left(2)) throw ExceptionFreeserf("Invalid read past end.");
+  if (checked && !has_data_left(2)) {
+    throw ExceptionFreeserf("Invalid read past end.");
+  }
   val = *reinterpret_cast<uint16_t*>(current);
   current += 2;
   return *this;
@@ -291,7 +310,9 @@ SaveReaderBinary::operator >> (uint16_t &val) {
 
 SaveReaderBinary&
 SaveReaderBinary::operator >> (uint32_t &val) {
-  if (!has_data_left(4)) throw ExceptionFreeserf("Invalid read past end.");
+  if (checked && !has_data_left(4)) {
+    throw ExceptionFreeserf("Invalid read past end.");
+  }
   val = *reinterpret_cast<uint32_t*>(current);
   current += 4;
   return *this;
@@ -302,28 +323,134 @@ SaveReaderBinary::operator = (const SaveReaderBinary& other) {
   start = other.start;
   current = other.current;
   end = other.end;
+  checked = other.checked;
   return *this;
 }
 
 SaveReaderBinary
 SaveReaderBinary::extract(size_t size) {
-  if (!has_data_left(size)) {
+  if (checked && !has_data_left(size)) {
     throw ExceptionFreeserf("Invalid extract past end.");
   }
 
   SaveReaderBinary new_reader(current, size);
+  new_reader.checked = checked;
   current += size;
   return new_reader;
 }
 
 uint8_t *
 SaveReaderBinary::read(size_t size) {
-  if (!has_data_left(size)) throw ExceptionFreeserf("Invalid read past end.");
+  if (checked && !has_data_left(size)) {
+    throw ExceptionFreeserf("Invalid read past end.");
+  }
   uint8_t *data = current;
   current += size;
   return data;
 }
 
+SaveLayoutBinary::SaveLayoutBinary()
+  : error(ErrorNone)
+  , error_offset(0)
+  , expected_size(0)
+  , available_size(0)
+  , map_size(0)
+  , max_serf_index(0)
+  , max_flag_index(0)
+  , max_building_index(0)
+  , max_inventory_index(0) {
+}
+
+bool
+SaveLayoutBinary::validate(const SaveReaderBinary &reader) {
+  available_size = reader.get_size();
+
+  expected_size = header_size;
+  if (available_size < expected_size) {
+    set_error(ErrorTruncated, "header", 0);
+    return false;
+  }
+
+  SaveReaderBinary header(reader);
+  header.reset();
+  header.set_checked(true);
+  uint16_t v16;
+  header.skip(90);
+  header >> v16;  // 90
+  max_flag_index = v16;
+  header >> v16;  // 92
+  max_building_index = v16;
+  header >> v16;  // 94
+  max_serf_index = v16;
+  header.skip(78);
+  header >> v16;  // 174
+  max_inventory_index = v16;
+  header.skip(14);
+  header >> v16;  // 190
+  map_size = v16;
+
+  // Avoid allocating a huge map if the input file is invalid
+  if (map_size < 3 || map_size > 10) {
+    set_error(ErrorInvalidMapSize, "header", 190);
+    return false;
+  }
+
+  MapGeometry geom(map_size);
+  struct {
+    const char *name;
+    size_t size;
+  } sections[] = {
+    { "players", 4 * player_size },
+    { "map", map_tile_size * geom.cols() * geom.rows() },
+    { "serfs", get_objects_size(max_serf_index, serf_size) },
+    { "flags", get_objects_size(max_flag_index, flag_size) },
+    { "buildings", get_objects_size(max_building_index, building_size) },
+    { "inventories", get_objects_size(max_inventory_index, inventory_size) }
+  };
+
+  for (auto &section : sections) {
+    size_t offset = expected_size;
+    expected_size += section.size;
+    if (available_size < expected_size) {
+      set_error(ErrorTruncated, section.name, offset);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void
+SaveLayoutBinary::set_error(Error _error, const std::string &section,
+                            size_t offset) {
+  error = _error;
+  error_section = section;
+  error_offset = offset;
+}
+
+std::string
+SaveLayoutBinary::get_error_message() const {
+  std::ostringstream str;
+  switch (error) {
+    case ErrorNone:
+      return std::string();
+    case ErrorTruncated:
+      str << "Data truncated in section \"" << error_section
+          << "\" at offset " << error_offset << " (need " << expected_size
+          << " bytes, have " << available_size << ")";
+      break;
+    case ErrorInvalidMapSize:
+      str << "Invalid map size " << map_size << " at offset "
+          << error_offset;
+      break;
+    case ErrorInvalidObject:
+      str << "Invalid object data in section \"" << error_section
+          << "\" at offset " << error_offset;
+      break;
+  }
+  return str.str();
+}
+
 SaveReaderTextValue::SaveReaderTextValue(const std::string &_value)
   : value(_value) {
   if (value.find(',') != std::string::npos) {
@@ -744,12 +871,15 @@ GameStore::load(const std::string &path, Game *game) {
     file.close();
     Log::Warn["savegame"] << "Unable to load save game: " << e.what();
     Log::Warn["savegame"] << "Trying compatability mode...";
-    std::ifstream input(path.c_str(), std::ios::binary);
-    std::vector<char> buffer((std::istreambuf_iterator<char>(input)),
-                             (std::istreambuf_iterator<char>()));
-    SaveReaderBinary reader(&buffer[0], buffer.size());
     try {
-      reader >> *game;
+      MappedBuffer buffer(path);
+      SaveReaderBinary reader(buffer.get_data(), buffer.get_size());
+      SaveLayoutBinary layout;
+      if (!game->load_legacy(&reader, &layout)) {
+        Log::Error["savegame"] << "Failed to load save game: "
+                               << layout.get_error_message();
+        return false;
+      }
     } catch (ExceptionFreeserf& e) {
       Log::Error["savegame"] << "Failed to load save game: " << e.what();
       return false;
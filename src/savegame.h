@@ -40,6 +40,7 @@ class SaveReaderBinary {
   uint8_t *start;
   uint8_t *current;
   uint8_t *end;
+  bool checked;
 
  public:
   SaveReaderBinary(const SaveReaderBinary &reader);
@@ -55,6 +56,62 @@ class SaveReaderBinary {
   SaveReaderBinary extract(size_t size);
   uint8_t *read(size_t size);
   bool has_data_left(size_t size) const { return current + size <= end; }
+  size_t get_size() const { return end - start; }
+  size_t get_offset() const { return current - start; }
+
+  /* Per-field bounds checks can be turned off once the extent of the data
+   has been validated against the save game layout. Readers extracted
+   afterwards inherit the setting. */
+  void set_checked(bool _checked) { checked = _checked; }
+};
+
+/* Section extents of a legacy (binary) save game. They are derived from the
+ header and checked against the data size before any object is loaded, so
+ a broken file is reported up front instead of failing halfway. A failed
+ load leaves the reason, the section and its byte offset in the layout. */
+class SaveLayoutBinary {
+ public:
+  typedef enum Error {
+    ErrorNone = 0,
+    ErrorTruncated,
+    ErrorInvalidMapSize,
+    ErrorInvalidObject
+  } Error;
+
+  static const size_t header_size = 250;
+  static const size_t player_size = 8628;
+  static const size_t map_tile_size = 8;
+  static const size_t serf_size = 16;
+  static const size_t flag_size = 70;
+  static const size_t building_size = 18;
+  static const size_t inventory_size = 120;
+
+ protected:
+  Error error;
+  std::string error_section;
+  size_t error_offset;
+  size_t expected_size;
+  size_t available_size;
+
+ public:
+  unsigned int map_size;
+  unsigned int max_serf_index;
+  unsigned int max_flag_index;
+  unsigned int max_building_index;
+  unsigned int max_inventory_index;
+
+  SaveLayoutBinary();
+
+  bool validate(const SaveReaderBinary &reader);
+  void set_error(Error error, const std::string &section, size_t offset);
+
+  Error get_error() const { return error; }
+  const std::string &get_error_section() const { return error_section; }
+  size_t get_error_offset() const { return error_offset; }
+  std::string get_error_message() const;
+
+  static size_t get_objects_size(unsigned int max_index, size_t object_size) {
+    return 4 * ((max_index + 31) / 32) + max_index * object_size; }
 };
 
 class SaveReaderTextValue {
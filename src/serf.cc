@@ -2041,6 +2041,9 @@ Serf::handle_serf_digging_state() {
         Building *building =
                         game->get_building(game->get_map()->get_obj_index(pos));
         building->done_leveling();
+        /* Leveling state limits what can be built around, notify map
+           handlers even though the object itself is unchanged. */
+        game->get_map()->set_object(pos, game->get_map()->get_obj(pos), -1);
         set_state(StateReadyToLeave);
         s.leaving_building.dest = 0;
         s.leaving_building.field_B = -2;
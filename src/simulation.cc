@@ -0,0 +1,180 @@
+/*
+ * simulation.cc - Game updates on a dedicated thread
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/simulation.h"
+
+#include <chrono>
+#include <utility>
+
+#include "src/freeserf.h"
+#include "src/log.h"
+
+// Ticks run late at once before the rest is dropped
+#define MAX_CATCH_UP_TICKS  10
+
+Simulation::Lock::Lock(std::shared_ptr<Simulation> _simulation)
+  : simulation(std::move(_simulation)) {
+  if (simulation) {
+    simulation->lock();
+  }
+}
+
+Simulation::Lock::~Lock() {
+  if (simulation) {
+    simulation->unlock();
+  }
+}
+
+Simulation::Unlock::Unlock(std::shared_ptr<Simulation> _simulation)
+  : simulation(std::move(_simulation)) {
+  if (simulation) {
+    simulation->unlock();
+  }
+}
+
+Simulation::Unlock::~Unlock() {
+  if (simulation) {
+    simulation->lock();
+  }
+}
+
+Simulation::Simulation(PGame _game)
+  : game(std::move(_game))
+  , running(false)
+  , ticking(false)
+  , locks(0)
+  , dropped_ticks(0) {
+}
+
+Simulation::~Simulation() {
+  stop();
+}
+
+void
+Simulation::start() {
+  if (thread.joinable()) {
+    return;
+  }
+
+  running = true;
+  thread = std::thread(&Simulation::run, this);
+}
+
+void
+Simulation::stop() {
+  if (!thread.joinable()) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    running = false;
+  }
+  changed.notify_all();
+  thread.join();
+
+  if (dropped_ticks > 0) {
+    Log::Info["simulation"] << "dropped " << dropped_ticks << " ticks";
+  }
+}
+
+void
+Simulation::add_handler(Handler *handler) {
+  handlers.push_back(handler);
+}
+
+void
+Simulation::del_handler(Handler *handler) {
+  handlers.remove(handler);
+}
+
+void
+Simulation::post(Command command) {
+  std::unique_lock<std::mutex> lock(mutex);
+  commands.push_back(std::move(command));
+}
+
+/* Wait for the tick in progress, no other one starts until unlock(). */
+void
+Simulation::lock() {
+  std::unique_lock<std::mutex> lock(mutex);
+  locks++;
+  changed.wait(lock, [this]() { return !ticking; });
+}
+
+void
+Simulation::unlock() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    locks--;
+  }
+  changed.notify_all();
+}
+
+void
+Simulation::run() {
+  typedef std::chrono::steady_clock Clock;
+  const Clock::duration tick_length = std::chrono::milliseconds(TICK_LENGTH);
+  Clock::time_point next_tick = Clock::now() + tick_length;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    changed.wait_until(lock, next_tick, [this]() { return !running; });
+    changed.wait(lock, [this]() { return !running || (locks == 0); });
+    if (!running) {
+      break;
+    }
+
+    tick(&lock);
+    next_tick += tick_length;
+
+    Clock::time_point now = Clock::now();
+    if (now - next_tick > MAX_CATCH_UP_TICKS * tick_length) {
+      unsigned int missed = static_cast<unsigned int>((now - next_tick) /
+                                                      tick_length);
+      dropped_ticks += missed;
+      next_tick += missed * tick_length;
+    }
+  }
+}
+
+/* Run one tick without holding the mutex, it is locked on entry and exit. */
+void
+Simulation::tick(std::unique_lock<std::mutex> *lock) {
+  ticking = true;
+  std::list<Command> pending;
+  pending.swap(commands);
+  lock->unlock();
+
+  for (Command &command : pending) {
+    command();
+  }
+
+  game->update();
+
+  for (Handler *handler : handlers) {
+    handler->on_game_updated();
+  }
+
+  lock->lock();
+  ticking = false;
+  changed.notify_all();
+}
@@ -0,0 +1,108 @@
+/*
+ * simulation.h - Game updates on a dedicated thread
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_SIMULATION_H_
+#define SRC_SIMULATION_H_
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "src/game.h"
+
+// Runs the game ticks on its own thread at the game tick rate. Between
+// ticks the user interface may take exclusive access to the game with a
+// Lock, ticks wait while it is held. Handlers are called on the simulation
+// thread at the end of every tick, while the game is not changing, to take
+// whatever they need for drawing. Commands posted by the interface are run
+// on the simulation thread before the next tick.
+class Simulation {
+ public:
+  class Handler {
+   public:
+    virtual ~Handler() {}
+    virtual void on_game_updated() = 0;
+  };
+
+  typedef std::function<void()> Command;
+
+  class Lock {
+   protected:
+    std::shared_ptr<Simulation> simulation;
+
+   public:
+    explicit Lock(std::shared_ptr<Simulation> simulation);
+    ~Lock();
+  };
+
+  // Gives the access of an enclosing Lock back to the simulation for a
+  // while, the game must not be touched until it is destroyed.
+  class Unlock {
+   protected:
+    std::shared_ptr<Simulation> simulation;
+
+   public:
+    explicit Unlock(std::shared_ptr<Simulation> simulation);
+    ~Unlock();
+  };
+
+ protected:
+  PGame game;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool running;
+  bool ticking;
+  unsigned int locks;
+  std::list<Command> commands;
+  std::list<Handler*> handlers;
+  unsigned int dropped_ticks;
+
+ public:
+  explicit Simulation(PGame game);
+  virtual ~Simulation();
+
+  void start();
+  void stop();
+  bool is_running() const { return thread.joinable(); }
+
+  // Handlers are only changed while the simulation is not running.
+  void add_handler(Handler *handler);
+  void del_handler(Handler *handler);
+
+  void post(Command command);
+
+  // Ticks skipped because the simulation could not keep up
+  unsigned int get_dropped_ticks() const { return dropped_ticks; }
+
+ protected:
+  void lock();
+  void unlock();
+  void run();
+  void tick(std::unique_lock<std::mutex> *lock);
+};
+
+typedef std::shared_ptr<Simulation> PSimulation;
+
+#endif  // SRC_SIMULATION_H_
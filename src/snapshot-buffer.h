@@ -0,0 +1,64 @@
+/*
+ * snapshot-buffer.h - Lock-free hand over of snapshots between threads
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_SNAPSHOT_BUFFER_H_
+#define SRC_SNAPSHOT_BUFFER_H_
+
+#include <atomic>
+
+// Passes the latest of a series of values from one writer thread to one
+// reader thread without locking. The writer fills the back value and
+// publishes it, the reader takes the most recently published one as its
+// front value. Besides the two there is a third value in between, so
+// neither side ever waits for the other and values are never written while
+// they are read. Values the reader did not take in time are overwritten.
+template <typename T>
+class SnapshotBuffer {
+ protected:
+  static const unsigned int fresh = 4;  // Flag of a not yet taken value
+
+  T values[3];
+  std::atomic<unsigned int> middle;
+  unsigned int front;
+  unsigned int back;
+
+ public:
+  SnapshotBuffer() : middle(1), front(0), back(2) {}
+
+  // Writer side
+  T *get_back() { return &values[back]; }
+  void publish() {
+    back = middle.exchange(back | fresh, std::memory_order_acq_rel) & ~fresh;
+  }
+
+  // Reader side, the front value is owned by the reader until next take().
+  // Returns false when nothing was published since the last take().
+  bool take() {
+    if ((middle.load(std::memory_order_relaxed) & fresh) == 0) {
+      return false;
+    }
+    front = middle.exchange(front, std::memory_order_acq_rel) & ~fresh;
+    return true;
+  }
+  T *get_front() { return &values[front]; }
+};
+
+#endif  // SRC_SNAPSHOT_BUFFER_H_
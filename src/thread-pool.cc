@@ -0,0 +1,205 @@
+/*
+ * thread-pool.cc - Pool of worker threads
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/thread-pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+ThreadPool::ThreadPool(size_t thread_count)
+  : active(0)
+  , stopping(false) {
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (size_t i = 0; i < thread_count; i++) {
+    workers.emplace_back(&ThreadPool::worker, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  task_available.notify_all();
+
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+}
+
+ThreadPool &
+ThreadPool::get_instance() {
+  static ThreadPool thread_pool;
+  return thread_pool;
+}
+
+void
+ThreadPool::run(Task task) {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  task_available.notify_one();
+}
+
+void
+ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  task_done.wait(lock, [this]() { return tasks.empty() && (active == 0); });
+
+  if (error) {
+    std::exception_ptr e = error;
+    error = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+namespace {
+
+// Shared between the caller of parallel_for() and its helper tasks. Helpers
+// that start after the caller finished find the state closed and return.
+class ParallelForState {
+ public:
+  ThreadPool::IndexTask task;
+  size_t count;
+  size_t batch;
+  std::atomic<size_t> next;
+  std::atomic<bool> failed;
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable finished;
+  size_t running;
+  bool closed;
+
+  ParallelForState(ThreadPool::IndexTask _task, size_t _count, size_t _batch)
+    : task(std::move(_task))
+    , count(_count)
+    , batch(_batch)
+    , next(0)
+    , failed(false)
+    , running(0)
+    , closed(false) {
+  }
+
+  void process() {
+    while (!failed) {
+      size_t begin = next.fetch_add(batch);
+      if (begin >= count) {
+        break;
+      }
+      size_t end = std::min(begin + batch, count);
+      try {
+        for (size_t i = begin; i < end; i++) {
+          task(i);
+        }
+      } catch (...) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    }
+  }
+};
+
+}  // namespace
+
+void
+ThreadPool::parallel_for(size_t count, IndexTask task) {
+  if (count == 0) {
+    return;
+  }
+
+  // Indexes are handed out in small batches so that uneven work is
+  // balanced without taking a lock per index.
+  size_t batch = std::max<size_t>(1, count / ((workers.size() + 1) * 8));
+  auto state = std::make_shared<ParallelForState>(std::move(task), count,
+                                                  batch);
+
+  size_t helpers = std::min(workers.size(), (count + batch - 1) / batch - 1);
+  for (size_t i = 0; i < helpers; i++) {
+    run([state]() {
+      {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        if (state->closed) {
+          return;
+        }
+        state->running++;
+      }
+      state->process();
+      {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->running--;
+      }
+      state->finished.notify_all();
+    });
+  }
+
+  state->process();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->closed = true;
+  state->finished.wait(lock, [&state]() { return state->running == 0; });
+
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+void
+ThreadPool::worker() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      task_available.wait(lock, [this]() {
+        return stopping || !tasks.empty();
+      });
+      if (stopping && tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+      active++;
+    }
+
+    try {
+      task();
+    } catch (...) {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      active--;
+    }
+    task_done.notify_all();
+  }
+}
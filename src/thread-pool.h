@@ -0,0 +1,72 @@
+/*
+ * thread-pool.h - Pool of worker threads
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_THREAD_POOL_H_
+#define SRC_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+ public:
+  typedef std::function<void()> Task;
+  typedef std::function<void(size_t index)> IndexTask;
+
+ protected:
+  std::vector<std::thread> workers;
+  std::list<Task> tasks;
+  std::mutex mutex;
+  std::condition_variable task_available;
+  std::condition_variable task_done;
+  size_t active;
+  bool stopping;
+  std::exception_ptr error;
+
+ public:
+  // Zero thread count means one worker per hardware thread.
+  explicit ThreadPool(size_t thread_count = 0);
+  virtual ~ThreadPool();
+
+  static ThreadPool &get_instance();
+
+  size_t get_size() const { return workers.size(); }
+
+  // Queue task for execution on one of the workers.
+  void run(Task task);
+  // Block until all queued tasks are done. Rethrows the first exception
+  // thrown by any of the tasks.
+  void wait();
+
+  // Call task for every index in [0, count) spread over the workers and
+  // wait for completion. The calling thread takes part in the work, so it is
+  // safe to call from inside a pool task. Rethrows the first exception.
+  void parallel_for(size_t count, IndexTask task);
+
+ protected:
+  void worker();
+};
+
+#endif  // SRC_THREAD_POOL_H_
@@ -27,6 +27,8 @@
 #include "src/freeserf_endian.h"
 #include "src/debug.h"
 
+#define TPWM_STAMP_SIZE_MAX  (0x0F + 3)
+
 UnpackerTPWM::UnpackerTPWM(PBuffer _buffer) : Convertor(_buffer) {
   if (buffer->get_size() < 8) {
     throw ExceptionFreeserf("Data is not TPWM archive");
@@ -38,36 +40,57 @@ UnpackerTPWM::UnpackerTPWM(PBuffer _buffer) : Convertor(_buffer) {
   }
 }
 
+/* Output size is known from the header, so the result is allocated once
+   and stamps are copied within it. A stamp may be longer than its offset,
+   then it repeats bytes it has just written and must be copied forwards
+   byte by byte. */
 PBuffer
 UnpackerTPWM::convert() {
   size_t res_size = buffer->pop<uint16_t>();
-  PMutableBuffer result = std::make_shared<MutableBuffer>(Buffer::EndianessBig);
+  PBuffer input = buffer->pop_tail();
+  const uint8_t *src = reinterpret_cast<const uint8_t*>(input->get_data());
+  const uint8_t *src_end = src + input->get_size();
+
+  PMutableBuffer result = std::make_shared<MutableBuffer>(res_size,
+                                                          Buffer::EndianessBig);
+  uint8_t *dst = reinterpret_cast<uint8_t*>(result->append(res_size));
+  uint8_t *dst_begin = dst;
+  uint8_t *dst_end = dst + res_size;
 
-  try {
-    while (buffer->readable()) {
-      size_t flag = buffer->pop<uint8_t>();
-      for (int i = 0 ; i < 8 ; i++) {
-        flag <<= 1;
-        if (flag & ~0xFF) {
-          flag &= 0xFF;
-          size_t temp = buffer->pop<uint8_t>();
-          size_t stamp_size = (temp & 0x0F) + 3;
-          size_t stamp_offset = buffer->pop<uint8_t>();
-          stamp_offset |= ((temp << 4) & 0x0F00);
-          PBuffer stamp = result->get_subbuffer(result->get_size() -
-                                                stamp_offset, stamp_size);
-          result->push(stamp);
-        } else {
-          result->push<uint8_t>(buffer->pop<uint8_t>());
+  while (dst < dst_end) {
+    if (src == src_end) {
+      throw ExceptionFreeserf("TPWM source data corrupted");
+    }
+    unsigned int flag = *src++;
+    /* Only the last groups of items may run past the end of input or
+       output, others are not checked item by item. */
+    bool check = (src_end - src < 8 * 2) ||
+                 (dst_end - dst < 8 * TPWM_STAMP_SIZE_MAX);
+    for (int i = 0; (i < 8) && (dst < dst_end); i++, flag <<= 1) {
+      if (flag & 0x80) {
+        if (check && (src_end - src < 2)) {
+          throw ExceptionFreeserf("TPWM source data corrupted");
+        }
+        size_t temp = *src++;
+        size_t stamp_size = (temp & 0x0F) + 3;
+        size_t stamp_offset = *src++;
+        stamp_offset |= ((temp << 4) & 0x0F00);
+        if (stamp_offset == 0 ||
+            stamp_offset > static_cast<size_t>(dst - dst_begin) ||
+            (check && (stamp_size > static_cast<size_t>(dst_end - dst)))) {
+          throw ExceptionFreeserf("TPWM source data corrupted");
         }
+        const uint8_t *stamp = dst - stamp_offset;
+        for (size_t j = 0; j < stamp_size; j++) {
+          *dst++ = *stamp++;
+        }
+      } else {
+        if (check && (src == src_end)) {
+          throw ExceptionFreeserf("TPWM source data corrupted");
+        }
+        *dst++ = *src++;
       }
     }
-  } catch (...) {
-    throw ExceptionFreeserf("TPWM source data corrupted");
-  }
-
-  if (result->get_size() != res_size) {
-    throw ExceptionFreeserf("TPWM source data corrupted");
   }
 
   return result;
@@ -0,0 +1,319 @@
+/*
+ * video-headless.cc - Offscreen software graphics rendering
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/video-headless.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "src/log.h"
+
+/* Size of the screen before any resolution is set, as the SDL window */
+#define HEADLESS_DEFAULT_WIDTH  800
+#define HEADLESS_DEFAULT_HEIGHT  600
+
+Video &
+Video::get_instance() {
+  static VideoHeadless instance;
+  return instance;
+}
+
+/* Product of two 8 bit values scaled back to 8 bits, rounded. */
+static inline uint32_t
+mul_255(uint32_t a, uint32_t b) {
+  uint32_t v = a * b + 0x80;
+  return (v + (v >> 8)) >> 8;
+}
+
+static inline uint32_t
+blend_pixel(uint32_t src, uint32_t dst) {
+  uint32_t alpha = src >> 24;
+  if (alpha == 0xFF) return src;
+  if (alpha == 0x00) return dst;
+
+  uint32_t inverse = 0xFF - alpha;
+  uint32_t result = (alpha + mul_255(dst >> 24, inverse)) << 24;
+  for (int shift = 0; shift < 24; shift += 8) {
+    uint32_t s = (src >> shift) & 0xFF;
+    uint32_t d = (dst >> shift) & 0xFF;
+    result |= (mul_255(s, alpha) + mul_255(d, inverse)) << shift;
+  }
+  return result;
+}
+
+static inline uint32_t
+pack_color(const Video::Color &color) {
+  return (0xFFu << 24) | (color.r << 16) | (color.g << 8) | color.b;
+}
+
+VideoHeadless::VideoHeadless()
+  : screen(nullptr)
+  , fullscreen(false)
+  , zoom_factor(1.f)
+  , output_width(HEADLESS_DEFAULT_WIDTH)
+  , output_height(HEADLESS_DEFAULT_HEIGHT)
+  , frames_presented(0) {
+  Log::Info["video"] << "Initializing \"headless\".";
+  set_resolution(output_width, output_height, fullscreen);
+}
+
+VideoHeadless::~VideoHeadless() {
+  delete screen;
+  screen = nullptr;
+}
+
+void
+VideoHeadless::set_resolution(unsigned int width, unsigned int height,
+                              bool fs) {
+  /* Screen is the output scaled by zoom, as the logical size of SDL. */
+  output_width = static_cast<unsigned int>(width / zoom_factor + .5f);
+  output_height = static_cast<unsigned int>(height / zoom_factor + .5f);
+
+  if (screen == nullptr) {
+    screen = new Video::Frame(width, height);
+  } else {
+    screen->width = width;
+    screen->height = height;
+    screen->pixels.assign(width * height, 0);
+  }
+  fullscreen = fs;
+}
+
+void
+VideoHeadless::get_resolution(unsigned int *width, unsigned int *height) {
+  if (width != nullptr) {
+    *width = output_width;
+  }
+  if (height != nullptr) {
+    *height = output_height;
+  }
+}
+
+void
+VideoHeadless::set_fullscreen(bool enable) {
+  fullscreen = enable;
+}
+
+bool
+VideoHeadless::is_fullscreen() {
+  return fullscreen;
+}
+
+Video::Frame *
+VideoHeadless::get_screen_frame() {
+  return screen;
+}
+
+Video::Frame *
+VideoHeadless::create_frame(unsigned int width, unsigned int height) {
+  return new Video::Frame(width, height);
+}
+
+void
+VideoHeadless::destroy_frame(Video::Frame *frame) {
+  delete frame;
+}
+
+Video::Image *
+VideoHeadless::create_image(void *data, unsigned int width,
+                            unsigned int height) {
+  Video::Image *image = new Video::Image(width, height);
+  update_image(image, data);
+  return image;
+}
+
+void
+VideoHeadless::destroy_image(Video::Image *image) {
+  delete image;
+}
+
+void
+VideoHeadless::update_image(Video::Image *image, void *data) {
+  std::memcpy(image->pixels.data(), data,
+              image->pixels.size() * sizeof(uint32_t));
+}
+
+/* Blend area of src at sx,sy over dest at dx,dy, clipped to both. */
+void
+VideoHeadless::blend(const std::vector<uint32_t> &src,
+                     unsigned int src_width, unsigned int src_height,
+                     int sx, int sy, Video::Frame *dest, int dx, int dy,
+                     int w, int h) {
+  if (sx < 0) { w += sx; dx -= sx; sx = 0; }
+  if (sy < 0) { h += sy; dy -= sy; sy = 0; }
+  if (dx < 0) { w += dx; sx -= dx; dx = 0; }
+  if (dy < 0) { h += dy; sy -= dy; dy = 0; }
+  w = std::min(w, std::min(static_cast<int>(src_width) - sx,
+                           static_cast<int>(dest->width) - dx));
+  h = std::min(h, std::min(static_cast<int>(src_height) - sy,
+                           static_cast<int>(dest->height) - dy));
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  for (int row = 0; row < h; row++) {
+    const uint32_t *s = &src[(sy + row) * src_width + sx];
+    uint32_t *d = &dest->pixels[(dy + row) * dest->width + dx];
+    for (int col = 0; col < w; col++) {
+      d[col] = blend_pixel(s[col], d[col]);
+    }
+  }
+}
+
+void
+VideoHeadless::draw_image(const Video::Image *image, int x, int y,
+                          int y_offset, Video::Frame *dest) {
+  blend(image->pixels, image->width, image->height, 0, y_offset, dest,
+        x, y + y_offset, image->width, image->height - y_offset);
+}
+
+void
+VideoHeadless::draw_frame(int dx, int dy, Video::Frame *dest, int sx, int sy,
+                          Video::Frame *src, int w, int h) {
+  if (src == dest) {
+    /* Areas may overlap, blend from a copy. */
+    std::vector<uint32_t> pixels = src->pixels;
+    blend(pixels, src->width, src->height, sx, sy, dest, dx, dy, w, h);
+  } else {
+    blend(src->pixels, src->width, src->height, sx, sy, dest, dx, dy, w, h);
+  }
+}
+
+/* Copy the area of src enlarged scale times, nearest pixel. */
+void
+VideoHeadless::draw_frame_scaled(int dx, int dy, Video::Frame *dest,
+                                 int sx, int sy, Video::Frame *src,
+                                 int w, int h, unsigned int scale) {
+  int s = static_cast<int>(scale);
+  if (sx < 0) { w += sx; dx -= sx * s; sx = 0; }
+  if (sy < 0) { h += sy; dy -= sy * s; sy = 0; }
+  w = std::min(w, static_cast<int>(src->width) - sx);
+  h = std::min(h, static_cast<int>(src->height) - sy);
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  /* Every enlarged row is blended scale times. */
+  std::vector<uint32_t> row(w * s);
+  for (int y = 0; y < h; y++) {
+    const uint32_t *line = &src->pixels[(sy + y) * src->width + sx];
+    for (int x = 0; x < w * s; x++) {
+      row[x] = line[x / s];
+    }
+    for (int i = 0; i < s; i++) {
+      blend(row, w * s, 1, 0, 0, dest, dx, dy + y * s + i, w * s, 1);
+    }
+  }
+}
+
+void
+VideoHeadless::draw_rect(int x, int y, unsigned int width,
+                         unsigned int height, const Video::Color color,
+                         Video::Frame *dest) {
+  /* Draw rectangle. */
+  fill_rect(x, y, width, 1, color, dest);
+  fill_rect(x, y+height-1, width, 1, color, dest);
+  fill_rect(x, y, 1, height, color, dest);
+  fill_rect(x+width-1, y, 1, height, color, dest);
+}
+
+void
+VideoHeadless::fill_rect(int x, int y, unsigned int width,
+                         unsigned int height, const Video::Color color,
+                         Video::Frame *dest) {
+  int left = std::max(x, 0);
+  int top = std::max(y, 0);
+  int right = std::min(x + static_cast<int>(width),
+                       static_cast<int>(dest->width));
+  int bottom = std::min(y + static_cast<int>(height),
+                        static_cast<int>(dest->height));
+  if (left >= right || top >= bottom) {
+    return;
+  }
+
+  uint32_t pixel = pack_color(color);
+  for (int row = top; row < bottom; row++) {
+    uint32_t *d = &dest->pixels[row * dest->width];
+    std::fill(d + left, d + right, pixel);
+  }
+}
+
+void
+VideoHeadless::draw_line(int x, int y, int x1, int y1,
+                         const Video::Color color, Video::Frame *dest) {
+  uint32_t pixel = pack_color(color);
+  int dx = std::abs(x1 - x);
+  int dy = -std::abs(y1 - y);
+  int step_x = (x < x1) ? 1 : -1;
+  int step_y = (y < y1) ? 1 : -1;
+  int error = dx + dy;
+
+  while (true) {
+    if (x >= 0 && y >= 0 && x < static_cast<int>(dest->width) &&
+        y < static_cast<int>(dest->height)) {
+      dest->pixels[y * dest->width + x] = pixel;
+    }
+    if (x == x1 && y == y1) {
+      break;
+    }
+    int error2 = 2 * error;
+    if (error2 >= dy) {
+      error += dy;
+      x += step_x;
+    }
+    if (error2 <= dx) {
+      error += dx;
+      y += step_y;
+    }
+  }
+}
+
+void
+VideoHeadless::swap_buffers() {
+  frames_presented++;
+}
+
+bool
+VideoHeadless::set_zoom_factor(float factor) {
+  if ((factor < 0.2f) || (factor > 4.f)) {
+    return false;
+  }
+
+  unsigned int width = output_width;
+  unsigned int height = output_height;
+  zoom_factor = factor;
+  set_resolution(static_cast<unsigned int>(width * zoom_factor),
+                 static_cast<unsigned int>(height * zoom_factor),
+                 fullscreen);
+
+  return true;
+}
+
+void
+VideoHeadless::get_screen_factor(float *fx, float *fy) {
+  if (fx != nullptr) {
+    *fx = 1.f;
+  }
+  if (fy != nullptr) {
+    *fy = 1.f;
+  }
+}
@@ -0,0 +1,114 @@
+/*
+ * video-headless.h - Offscreen software graphics rendering
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_VIDEO_HEADLESS_H_
+#define SRC_VIDEO_HEADLESS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "src/video.h"
+
+/* Frames and images are plain memory surfaces of 32 bit pixels with alpha
+   in the top byte, red, green and blue below, as sprites are decoded.
+   Drawing blends the same way SDL does with SDL_BLENDMODE_BLEND. */
+class Video::Frame {
+ public:
+  unsigned int width;
+  unsigned int height;
+  std::vector<uint32_t> pixels;
+
+  Frame(unsigned int _width, unsigned int _height)
+    : width(_width), height(_height), pixels(_width * _height, 0) {}
+};
+
+class Video::Image {
+ public:
+  unsigned int width;
+  unsigned int height;
+  std::vector<uint32_t> pixels;
+
+  Image(unsigned int _width, unsigned int _height)
+    : width(_width), height(_height), pixels(_width * _height, 0) {}
+};
+
+class VideoHeadless : public Video {
+ protected:
+  Video::Frame *screen;
+  bool fullscreen;
+  float zoom_factor;
+  unsigned int output_width;
+  unsigned int output_height;
+  unsigned int frames_presented;
+
+ public:
+  VideoHeadless();
+  virtual ~VideoHeadless();
+
+  virtual void set_resolution(unsigned int width, unsigned int height,
+                              bool fullscreen);
+  virtual void get_resolution(unsigned int *width, unsigned int *height);
+  virtual void set_fullscreen(bool enable);
+  virtual bool is_fullscreen();
+
+  virtual Video::Frame *get_screen_frame();
+  virtual Video::Frame *create_frame(unsigned int width, unsigned int height);
+  virtual void destroy_frame(Video::Frame *frame);
+
+  virtual Video::Image *create_image(void *data, unsigned int width,
+                                     unsigned int height);
+  virtual void destroy_image(Video::Image *image);
+  virtual void update_image(Video::Image *image, void *data);
+
+  virtual void warp_mouse(int /*x*/, int /*y*/) {}
+
+  virtual void draw_image(const Video::Image *image, int x, int y,
+                          int y_offset, Video::Frame *dest);
+  virtual void draw_frame(int dx, int dy, Video::Frame *dest, int sx, int sy,
+                          Video::Frame *src, int w, int h);
+  virtual void draw_frame_scaled(int dx, int dy, Video::Frame *dest,
+                                 int sx, int sy, Video::Frame *src,
+                                 int w, int h, unsigned int scale);
+  virtual void draw_rect(int x, int y, unsigned int width, unsigned int height,
+                         const Video::Color color, Video::Frame *dest);
+  virtual void fill_rect(int x, int y, unsigned int width, unsigned int height,
+                         const Video::Color color, Video::Frame *dest);
+  virtual void draw_line(int x, int y, int x1, int y1,
+                         const Video::Color color, Video::Frame *dest);
+
+  virtual void swap_buffers();
+
+  virtual void set_cursor(void * /*data*/, unsigned int /*width*/,
+                          unsigned int /*height*/) {}
+
+  virtual float get_zoom_factor() { return zoom_factor; }
+  virtual bool set_zoom_factor(float factor);
+  virtual void get_screen_factor(float *fx, float *fy);
+
+  unsigned int get_frames_presented() const { return frames_presented; }
+
+ protected:
+  void blend(const std::vector<uint32_t> &src, unsigned int src_width,
+             unsigned int src_height, int sx, int sy, Video::Frame *dest,
+             int dx, int dy, int w, int h);
+};
+
+#endif  // SRC_VIDEO_HEADLESS_H_
@@ -21,10 +21,16 @@
 
 #include "src/video-sdl.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include <SDL.h>
 
+/* Size of the textures that small images are packed into */
+#define ATLAS_PAGE_SIZE  1024
+/* Images larger than this in any direction get a texture of their own */
+#define ATLAS_MAX_IMAGE_SIZE  256
+
 ExceptionSDL::ExceptionSDL(const std::string &description) throw()
   : ExceptionVideo(description) {
   sdl_error = SDL_GetError();
@@ -38,11 +44,16 @@ Uint32 VideoSDL::Bmask = 0xFF000000;
 Uint32 VideoSDL::Amask = 0x000000FF;
 Uint32 VideoSDL::pixel_format = SDL_PIXELFORMAT_RGBA8888;
 
-VideoSDL::VideoSDL() {
+VideoSDL::VideoSDL()
+  : atlas(ATLAS_PAGE_SIZE, 1) {
   screen = nullptr;
   cursor = nullptr;
   fullscreen = false;
   zoom_factor = 1.f;
+  batch_dest = nullptr;
+  batch_texture = nullptr;
+  images_drawn = 0;
+  batches_drawn = 0;
 
   Log::Info["video"] << "Initializing \"sdl\".";
   Log::Info["video"] << "Available drivers:";
@@ -95,6 +106,17 @@ VideoSDL::VideoSDL() {
   SDL_PixelFormatEnumToMasks(pixel_format, &bpp,
                              &Rmask, &Gmask, &Bmask, &Amask);
 
+  int atlas_page_size = ATLAS_PAGE_SIZE;
+  if (render_info.max_texture_width > 0) {
+    atlas_page_size = std::min(atlas_page_size,
+                               render_info.max_texture_width);
+  }
+  if (render_info.max_texture_height > 0) {
+    atlas_page_size = std::min(atlas_page_size,
+                               render_info.max_texture_height);
+  }
+  atlas = AtlasPacker(atlas_page_size, 1);
+
   /* Set scaling mode */
   SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
 
@@ -105,6 +127,11 @@ VideoSDL::VideoSDL() {
 }
 
 VideoSDL::~VideoSDL() {
+  batch.clear();
+  for (SDL_Texture *texture : atlas_textures) {
+    SDL_DestroyTexture(texture);
+  }
+  atlas_textures.clear();
   if (screen != nullptr) {
     delete screen;
     screen = nullptr;
@@ -139,6 +166,8 @@ VideoSDL::set_resolution(unsigned int width, unsigned int height, bool fs) {
     throw ExceptionSDL("Unable to set window fullscreen");
   }
 
+  flush_batch();
+
   if (screen == nullptr) {
     screen = new Video::Frame();
   }
@@ -198,25 +227,130 @@ VideoSDL::create_frame(unsigned int width, unsigned int height) {
 
 void
 VideoSDL::destroy_frame(Video::Frame *frame) {
+  if (frame == batch_dest) {
+    flush_batch();
+  }
   SDL_DestroyTexture(frame->texture);
   delete frame;
 }
 
 Video::Image *
 VideoSDL::create_image(void *data, unsigned int width, unsigned int height) {
+  SDL_Surface *surf = create_surface_from_data(data, width, height);
+
   Video::Image *image = new Video::Image();
   image->w = width;
   image->h = height;
-  image->texture = create_texture_from_data(data, width, height);
+  if (!add_to_atlas(image, surf)) {
+    image->texture = SDL_CreateTextureFromSurface(renderer, surf);
+    if (image->texture == nullptr) {
+      SDL_FreeSurface(surf);
+      delete image;
+      throw ExceptionSDL("Unable to create SDL texture from data");
+    }
+    image->rect = { 0, 0, static_cast<int>(width),
+                    static_cast<int>(height) };
+  }
+  SDL_FreeSurface(surf);
+
   return image;
 }
 
 void
 VideoSDL::destroy_image(Video::Image *image) {
-  SDL_DestroyTexture(image->texture);
+  if (image->texture == batch_texture) {
+    flush_batch();
+  }
+
+  if (image->page < 0) {
+    SDL_DestroyTexture(image->texture);
+  } else {
+    atlas.release(image->page, image->rect.x, image->rect.y,
+                  image->rect.w, image->rect.h);
+  }
   delete image;
 }
 
+/* Replace pixels of the image with data of the same size, in place. */
+void
+VideoSDL::update_image(Video::Image *image, void *data) {
+  SDL_Surface *surf = create_surface_from_data(data, image->w, image->h);
+
+  Uint32 format = pixel_format;
+  SDL_QueryTexture(image->texture, &format, nullptr, nullptr, nullptr);
+  if (format != pixel_format) {
+    SDL_Surface *surf_texture = SDL_ConvertSurfaceFormat(surf, format, 0);
+    SDL_FreeSurface(surf);
+    if (surf_texture == nullptr) {
+      throw ExceptionSDL("Unable to convert image surface");
+    }
+    surf = surf_texture;
+  }
+
+  if (image->texture == batch_texture) {
+    flush_batch();
+  }
+  int result = SDL_UpdateTexture(image->texture, &image->rect, surf->pixels,
+                                 surf->pitch);
+  SDL_FreeSurface(surf);
+  if (result < 0) {
+    throw ExceptionSDL("Unable to update image texture");
+  }
+}
+
+/* Copy image to free space of an atlas page, adding a new page when all
+   are full. Space of released images is used again, so the padding right
+   and below the image is cleared of what was there before. */
+bool
+VideoSDL::add_to_atlas(Video::Image *image, SDL_Surface *surf) {
+  int w = static_cast<int>(image->w);
+  int h = static_cast<int>(image->h);
+  if (w > ATLAS_MAX_IMAGE_SIZE || h > ATLAS_MAX_IMAGE_SIZE ||
+      !atlas.fits(w, h)) {
+    return false;
+  }
+
+  size_t index = 0;
+  SDL_Rect rect = { 0, 0, w, h };
+  if (!atlas.allocate(w, h, &index, &rect.x, &rect.y)) {
+    int page_size = atlas.get_page_size();
+    SDL_Texture *texture = SDL_CreateTexture(renderer, pixel_format,
+                                             SDL_TEXTUREACCESS_STATIC,
+                                             page_size, page_size);
+    if (texture == nullptr) {
+      return false;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    atlas_textures.push_back(texture);
+    atlas.add_page();
+    atlas.allocate(w, h, &index, &rect.x, &rect.y);
+
+    Log::Verbose["video"] << "Atlas page " << index << " added ("
+                          << page_size << "x" << page_size << ")";
+  }
+
+  SDL_Texture *texture = atlas_textures[index];
+  if (texture == batch_texture) {
+    flush_batch();
+  }
+  if (SDL_UpdateTexture(texture, &rect, surf->pixels, surf->pitch) < 0) {
+    throw ExceptionSDL("Unable to update atlas texture");
+  }
+
+  atlas_padding.resize(ATLAS_MAX_IMAGE_SIZE + 1, 0);
+  SDL_Rect right = { rect.x + w, rect.y, 1, h + 1 };
+  SDL_Rect below = { rect.x, rect.y + h, w, 1 };
+  SDL_UpdateTexture(texture, &right, atlas_padding.data(), sizeof(Uint32));
+  SDL_UpdateTexture(texture, &below, atlas_padding.data(),
+                    w * sizeof(Uint32));
+
+  image->texture = texture;
+  image->rect = rect;
+  image->page = static_cast<int>(index);
+
+  return true;
+}
+
 void
 VideoSDL::warp_mouse(int x, int y) {
   SDL_WarpMouseInWindow(nullptr, x, y);
@@ -246,6 +380,8 @@ VideoSDL::create_surface_from_data(void *data, int width, int height) {
 
 SDL_Texture *
 VideoSDL::create_texture(int width, int height) {
+  flush_batch();
+
   SDL_Texture *texture = SDL_CreateTexture(renderer, pixel_format,
                                            SDL_TEXTUREACCESS_TARGET,
                                            width, height);
@@ -262,33 +398,79 @@ VideoSDL::create_texture(int width, int height) {
   return texture;
 }
 
-SDL_Texture *
-VideoSDL::create_texture_from_data(void *data, int width, int height) {
-  SDL_Surface *surf = create_surface_from_data(data, width, height);
-  SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surf);
-  if (texture == nullptr) {
-    throw ExceptionSDL("Unable to create SDL texture from data");
+void
+VideoSDL::draw_image(const Video::Image *image, int x, int y, int y_offset,
+                        Video::Frame *dest) {
+  if (dest != batch_dest || image->texture != batch_texture) {
+    flush_batch();
+    batch_dest = dest;
+    batch_texture = image->texture;
   }
 
-  SDL_FreeSurface(surf);
-
-  return texture;
+  BatchQuad quad;
+  quad.dest = { x, y + y_offset,
+                static_cast<int>(image->w),
+                static_cast<int>(image->h - y_offset) };
+  quad.src = { image->rect.x, image->rect.y + y_offset,
+               static_cast<int>(image->w),
+               static_cast<int>(image->h - y_offset) };
+  batch.push_back(quad);
+  images_drawn++;
 }
 
+/* Submit the images collected since the last change of texture or
+   frame. */
 void
-VideoSDL::draw_image(const Video::Image *image, int x, int y, int y_offset,
-                        Video::Frame *dest) {
-  SDL_Rect dest_rect = { x, y + y_offset,
-                         static_cast<int>(image->w),
-                         static_cast<int>(image->h - y_offset) };
-  SDL_Rect src_rect = { 0, y_offset,
-                        static_cast<int>(image->w),
-                        static_cast<int>(image->h - y_offset) };
-
-  /* Blit sprite */
-  SDL_SetRenderTarget(renderer, dest->texture);
+VideoSDL::flush_batch() {
+  if (batch.empty()) {
+    return;
+  }
+
+  SDL_SetRenderTarget(renderer, batch_dest->texture);
   SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-  int r = SDL_RenderCopy(renderer, image->texture, &src_rect, &dest_rect);
+
+  int r = 0;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  int tw = 0;
+  int th = 0;
+  SDL_QueryTexture(batch_texture, nullptr, nullptr, &tw, &th);
+  float sx = 1.f / static_cast<float>(tw);
+  float sy = 1.f / static_cast<float>(th);
+
+  static std::vector<SDL_Vertex> vertices;
+  static std::vector<int> indices;
+  vertices.clear();
+  indices.clear();
+  for (const BatchQuad &quad : batch) {
+    int base = static_cast<int>(vertices.size());
+    for (int corner = 0; corner < 4; corner++) {
+      int cx = (corner & 1) ? quad.dest.w : 0;
+      int cy = (corner & 2) ? quad.dest.h : 0;
+      SDL_Vertex vertex;
+      vertex.position.x = static_cast<float>(quad.dest.x + cx);
+      vertex.position.y = static_cast<float>(quad.dest.y + cy);
+      vertex.color = { 0xff, 0xff, 0xff, 0xff };
+      vertex.tex_coord.x = static_cast<float>(quad.src.x + cx) * sx;
+      vertex.tex_coord.y = static_cast<float>(quad.src.y + cy) * sy;
+      vertices.push_back(vertex);
+    }
+    for (int index : { 0, 1, 2, 2, 1, 3 }) {
+      indices.push_back(base + index);
+    }
+  }
+  r = SDL_RenderGeometry(renderer, batch_texture,
+                         vertices.data(), static_cast<int>(vertices.size()),
+                         indices.data(), static_cast<int>(indices.size()));
+#else
+  for (const BatchQuad &quad : batch) {
+    r = SDL_RenderCopy(renderer, batch_texture, &quad.src, &quad.dest);
+    if (r < 0) break;
+  }
+#endif
+
+  batch.clear();
+  batches_drawn++;
+
   if (r < 0) {
     throw ExceptionSDL("RenderCopy error");
   }
@@ -300,6 +482,26 @@ VideoSDL::draw_frame(int dx, int dy, Video::Frame *dest, int sx, int sy,
   SDL_Rect dest_rect = { dx, dy, w, h };
   SDL_Rect src_rect = { sx, sy, w, h };
 
+  flush_batch();
+  SDL_SetRenderTarget(renderer, dest->texture);
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+  int r = SDL_RenderCopy(renderer, src->texture, &src_rect, &dest_rect);
+  if (r < 0) {
+    throw ExceptionSDL("RenderCopy error");
+  }
+}
+
+/* Copy the area of src enlarged scale times, as for a far zoomed out
+   view drawn at a fraction of its size. */
+void
+VideoSDL::draw_frame_scaled(int dx, int dy, Video::Frame *dest, int sx,
+                            int sy, Video::Frame *src, int w, int h,
+                            unsigned int scale) {
+  int s = static_cast<int>(scale);
+  SDL_Rect dest_rect = { dx, dy, w * s, h * s };
+  SDL_Rect src_rect = { sx, sy, w, h };
+
+  flush_batch();
   SDL_SetRenderTarget(renderer, dest->texture);
   SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
   int r = SDL_RenderCopy(renderer, src->texture, &src_rect, &dest_rect);
@@ -324,6 +526,7 @@ VideoSDL::fill_rect(int x, int y, unsigned int width, unsigned int height,
   SDL_Rect rect = { x, y, static_cast<int>(width), static_cast<int>(height) };
 
   /* Fill rectangle */
+  flush_batch();
   SDL_SetRenderTarget(renderer, dest->texture);
   SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 0xff);
   int r = SDL_RenderFillRect(renderer, &rect);
@@ -335,6 +538,7 @@ VideoSDL::fill_rect(int x, int y, unsigned int width, unsigned int height,
 void
 VideoSDL::draw_line(int x, int y, int x1, int y1, const Video::Color color,
                     Video::Frame *dest) {
+  flush_batch();
   SDL_SetRenderTarget(renderer, dest->texture);
   SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 0xff);
   SDL_RenderDrawLine(renderer, x, y, x1, y1);
@@ -342,6 +546,13 @@ VideoSDL::draw_line(int x, int y, int x1, int y1, const Video::Color color,
 
 void
 VideoSDL::swap_buffers() {
+  flush_batch();
+
+  Log::Verbose["video"] << images_drawn << " images drawn in "
+                        << batches_drawn << " batches";
+  images_drawn = 0;
+  batches_drawn = 0;
+
   SDL_SetRenderTarget(renderer, nullptr);
   SDL_RenderCopy(renderer, screen->texture, nullptr, nullptr);
   SDL_RenderPresent(renderer);
@@ -366,7 +577,8 @@ VideoSDL::set_cursor(void *data, unsigned int width, unsigned int height) {
 
 bool
 VideoSDL::set_zoom_factor(float factor) {
-  if ((factor < 0.2f) || (factor > 1.f)) {
+  /* Above 1 the screen is larger than the window and SDL reduces it. */
+  if ((factor < 0.2f) || (factor > 4.f)) {
     return false;
   }
 
@@ -24,10 +24,12 @@
 
 #include <exception>
 #include <string>
+#include <vector>
 
 #include <SDL.h>
 
 #include "src/video.h"
+#include "src/atlas-packer.h"
 
 class Video::Frame {
  public:
@@ -41,8 +43,10 @@ class Video::Image {
   unsigned int w;
   unsigned int h;
   SDL_Texture *texture;
+  SDL_Rect rect;  /* Area of texture with the image */
+  int page;  /* Index of atlas page holding the image, -1 if it owns texture */
 
-  Image() : w(0), h(0), texture(NULL) {}
+  Image() : w(0), h(0), texture(NULL), rect(), page(-1) {}
 };
 
 class ExceptionSDL : public ExceptionVideo {
@@ -72,6 +76,25 @@ class VideoSDL : public Video {
   SDL_Cursor *cursor;
   float zoom_factor;
 
+  /* Small images are packed into shelves of a few large textures, so that
+     consecutive sprites are drawn from the same texture. */
+  AtlasPacker atlas;
+  std::vector<SDL_Texture*> atlas_textures;
+  std::vector<Uint32> atlas_padding;
+
+  /* Images drawn one after another from the same texture to the same frame
+     are submitted together. */
+  class BatchQuad {
+   public:
+    SDL_Rect src;
+    SDL_Rect dest;
+  };
+  std::vector<BatchQuad> batch;
+  Video::Frame *batch_dest;
+  SDL_Texture *batch_texture;
+  unsigned int images_drawn;
+  unsigned int batches_drawn;
+
  public:
   VideoSDL();
   virtual ~VideoSDL();
@@ -89,6 +112,7 @@ class VideoSDL : public Video {
   virtual Video::Image *create_image(void *data, unsigned int width,
                                      unsigned int height);
   virtual void destroy_image(Video::Image *image);
+  virtual void update_image(Video::Image *image, void *data);
 
   virtual void warp_mouse(int x, int y);
 
@@ -96,6 +120,9 @@ class VideoSDL : public Video {
                            int y_offset, Video::Frame *dest);
   virtual void draw_frame(int dx, int dy, Video::Frame *dest, int sx, int sy,
                           Video::Frame *src, int w, int h);
+  virtual void draw_frame_scaled(int dx, int dy, Video::Frame *dest,
+                                 int sx, int sy, Video::Frame *src,
+                                 int w, int h, unsigned int scale);
   virtual void draw_rect(int x, int y, unsigned int width, unsigned int height,
                          const Video::Color color, Video::Frame *dest);
   virtual void fill_rect(int x, int y, unsigned int width, unsigned int height,
@@ -115,7 +142,8 @@ class VideoSDL : public Video {
   SDL_Surface *create_surface(int width, int height);
   SDL_Surface *create_surface_from_data(void *data, int width, int height);
   SDL_Texture *create_texture(int width, int height);
-  SDL_Texture *create_texture_from_data(void *data, int width, int height);
+  bool add_to_atlas(Video::Image *image, SDL_Surface *surf);
+  void flush_batch();
 };
 
 #endif  // SRC_VIDEO_SDL_H_
@@ -71,6 +71,7 @@ class Video {
   virtual Image *create_image(void *data, unsigned int width,
                                       unsigned int height) = 0;
   virtual void destroy_image(Image *image) = 0;
+  virtual void update_image(Image *image, void *data) = 0;
 
   virtual void warp_mouse(int x, int y) = 0;
 
@@ -78,6 +79,9 @@ class Video {
                           int y_offset, Frame *dest) = 0;
   virtual void draw_frame(int dx, int dy, Frame *dest, int sx, int sy,
                           Frame *src, int w, int h) = 0;
+  virtual void draw_frame_scaled(int dx, int dy, Frame *dest, int sx, int sy,
+                                 Frame *src, int w, int h,
+                                 unsigned int scale) = 0;
   virtual void draw_rect(int x, int y, unsigned int width, unsigned int height,
                          const Video::Color color, Frame *dest) = 0;
   virtual void fill_rect(int x, int y, unsigned int width, unsigned int height,
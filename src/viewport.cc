@@ -22,20 +22,30 @@
 #include "src/viewport.h"
 
 #include <algorithm>
+#include <chrono>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <utility>
 #include <sstream>
+#include <tuple>
+#include <vector>
 
 #include "src/misc.h"
+#include "src/map-buildability.h"
 #include "src/game.h"
 #include "src/log.h"
 #include "src/debug.h"
 #include "src/data.h"
+#include "src/data-source.h"
 #include "src/audio.h"
 #include "src/gfx.h"
 #include "src/interface.h"
 #include "src/popup.h"
 #include "src/pathfinder.h"
+#include "src/thread-pool.h"
 
 #define MAP_TILE_WIDTH   32
 #define MAP_TILE_HEIGHT  20
@@ -47,6 +57,30 @@
 #define MAP_TILE_COLS  16
 #define MAP_TILE_ROWS  16
 
+#define MAP_MAX_HEIGHT  31
+
+/* Memory budget of the landscape tile cache in bytes */
+#define LANDSCAPE_TILES_MEMORY  (64*1024*1024)
+/* Most tiles being prefetched at once */
+#define LANDSCAPE_PREFETCH_MAX  8
+/* Time per frame to spend on turning prefetched tiles into frames */
+#define LANDSCAPE_UPLOAD_BUDGET_US  2000
+
+/* Zoom factor from which views are drawn reduced, the reduction doubles
+   with every doubling of the zoom factor up to the last level. */
+#define LOD_ZOOM_THRESHOLD  2.f
+#define LOD_MAX_LEVEL  2
+/* Memory budget of reduced landscape tiles */
+#define LOD_TILES_MEMORY  (32*1024*1024)
+
+/* Size of the screen cells that are composed again when anything drawn in
+   them changes */
+#define DIRTY_CELL_SIZE  32
+/* Extra area drawn around parts of the background that are drawn again, so
+   that sprites and rows cut at the edge of the part are complete inside */
+#define BACKGROUND_MARGIN_X  (2*MAP_TILE_WIDTH)
+#define BACKGROUND_MARGIN_Y  (4*MAP_MAX_HEIGHT + 2*MAP_TILE_HEIGHT)
+
 static const uint8_t tri_spr[] = {
   32, 32, 32, 32, 32, 32, 32, 32,
   32, 32, 32, 32, 32, 32, 32, 32,
@@ -66,9 +100,10 @@ static const uint8_t tri_spr[] = {
   16, 17, 18, 19, 20, 21, 22, 23
 };
 
-void
-Viewport::draw_triangle_up(int lx, int ly, int m, int left, int right,
-                           MapPos pos, Frame *tile) {
+template <typename Landscape, typename Canvas>
+static void
+draw_triangle_up(const Landscape &map, int lx, int ly, int m, int left,
+                 int right, MapPos pos, Canvas *tile) {
   static const int8_t tri_mask[] = {
      0,  1,  3,  6,  7, -1, -1, -1, -1,
      0,  1,  2,  5,  6,  7, -1, -1, -1,
@@ -93,7 +128,7 @@ Viewport::draw_triangle_up(int lx, int ly, int m, int left, int right,
     throw ExceptionFreeserf("Failed to draw triangle up (3).");
   }
 
-  Map::Terrain type = map->type_up(map->move_up(pos));
+  Map::Terrain type = map.type_up(map.move_up(pos));
   int index = (type << 3) | tri_mask[mask];
   if (index >= 128) {
     throw ExceptionFreeserf("Failed to draw triangle up (4).");
@@ -105,9 +140,10 @@ Viewport::draw_triangle_up(int lx, int ly, int m, int left, int right,
                             Data::AssetMapGround, sprite);
 }
 
-void
-Viewport::draw_triangle_down(int lx, int ly, int m, int left, int right,
-                             MapPos pos, Frame *tile) {
+template <typename Landscape, typename Canvas>
+static void
+draw_triangle_down(const Landscape &map, int lx, int ly, int m, int left,
+                   int right, MapPos pos, Canvas *tile) {
   static const int8_t tri_mask[] = {
      0,  0,  0,  0,  0, -1, -1, -1, -1,
      1,  1,  1,  1,  1,  0, -1, -1, -1,
@@ -132,7 +168,7 @@ Viewport::draw_triangle_down(int lx, int ly, int m, int left, int right,
     throw ExceptionFreeserf("Failed to draw triangle down (3).");
   }
 
-  int type = map->type_down(map->move_up_left(pos));
+  int type = map.type_down(map.move_up_left(pos));
   int index = (type << 3) | tri_mask[mask];
   if (index >= 128) {
     throw ExceptionFreeserf("Failed to draw triangle down (4).");
@@ -145,34 +181,37 @@ Viewport::draw_triangle_down(int lx, int ly, int m, int left, int right,
                             Data::AssetMapGround, sprite);
 }
 
-/* Draw a column (vertical) of tiles, starting at an up pointing tile. */
-void
-Viewport::draw_up_tile_col(MapPos pos, int x_base, int y_base, int max_y,
-                           Frame *tile) {
-  int m = map->get_height(pos);
+/* Draw a column (vertical) of tiles, starting at an up pointing tile.
+   Tiles are skipped until one reaches below min_y, tiles that are
+   completely above the frame are not drawn. */
+template <typename Landscape, typename Canvas>
+static void
+draw_up_tile_col(const Landscape &map, MapPos pos, int x_base, int y_base,
+                 int min_y, int max_y, Canvas *tile) {
+  int m = map.get_height(pos);
   int left, right;
 
   /* Loop until a tile is inside the frame (y >= 0). */
   while (1) {
     /* move down */
-    pos = map->move_down(pos);
+    pos = map.move_down(pos);
 
-    left = map->get_height(pos);
-    right = map->get_height(map->move_right(pos));
+    left = map.get_height(pos);
+    right = map.get_height(map.move_right(pos));
 
     int t = std::min(left, right);
     /*if (left == right) t -= 1;*/ /* TODO ? */
 
-    if (y_base + MAP_TILE_HEIGHT - 4*t >= 0) break;
+    if (y_base + MAP_TILE_HEIGHT - 4*t >= min_y) break;
 
     y_base += MAP_TILE_HEIGHT;
 
     /* move down right */
-    pos = map->move_down_right(pos);
+    pos = map.move_down_right(pos);
 
-    m = map->get_height(pos);
+    m = map.get_height(pos);
 
-    if (y_base + MAP_TILE_HEIGHT - 4*m >= 0) goto down;
+    if (y_base + MAP_TILE_HEIGHT - 4*m >= min_y) goto down;
 
     y_base += MAP_TILE_HEIGHT;
   }
@@ -181,58 +220,63 @@ Viewport::draw_up_tile_col(MapPos pos, int x_base, int y_base, int max_y,
   while (1) {
     if (y_base - 2*MAP_TILE_HEIGHT - 4*m >= max_y) break;
 
-    draw_triangle_up(x_base, y_base - 4*m, m, left, right, pos, tile);
+    if (y_base + 2*MAP_TILE_HEIGHT >= 0) {
+      draw_triangle_up(map, x_base, y_base - 4*m, m, left, right, pos, tile);
+    }
 
     y_base += MAP_TILE_HEIGHT;
 
     /* move down right */
-    pos = map->move_down_right(pos);
-    m = map->get_height(pos);
+    pos = map.move_down_right(pos);
+    m = map.get_height(pos);
 
     if (y_base - 2*MAP_TILE_HEIGHT - 4*std::max(left, right) >= max_y) break;
 
   down:
-    draw_triangle_down(x_base, y_base - 4*m, m, left, right, pos, tile);
+    if (y_base + 2*MAP_TILE_HEIGHT >= 0) {
+      draw_triangle_down(map, x_base, y_base - 4*m, m, left, right, pos, tile);
+    }
 
     y_base += MAP_TILE_HEIGHT;
 
     /* move down */
-    pos = map->move_down(pos);
+    pos = map.move_down(pos);
 
-    left = map->get_height(pos);
-    right = map->get_height(map->move_right(pos));
+    left = map.get_height(pos);
+    right = map.get_height(map.move_right(pos));
   }
 }
 
 /* Draw a column (vertical) of tiles, starting at a down pointing tile. */
-void
-Viewport::draw_down_tile_col(MapPos pos, int x_base, int y_base,
-                             int max_y, Frame *tile) {
-  int left = map->get_height(pos);
-  int right = map->get_height(map->move_right(pos));
+template <typename Landscape, typename Canvas>
+static void
+draw_down_tile_col(const Landscape &map, MapPos pos, int x_base, int y_base,
+                   int min_y, int max_y, Canvas *tile) {
+  int left = map.get_height(pos);
+  int right = map.get_height(map.move_right(pos));
   int m;
 
   /* Loop until a tile is inside the frame (y >= 0). */
   while (true) {
     /* move down right */
-    pos = map->move_down_right(pos);
+    pos = map.move_down_right(pos);
 
-    m = map->get_height(pos);
+    m = map.get_height(pos);
 
-    if (y_base + MAP_TILE_HEIGHT - 4*m >= 0) goto down;
+    if (y_base + MAP_TILE_HEIGHT - 4*m >= min_y) goto down;
 
     y_base += MAP_TILE_HEIGHT;
 
     /* move down */
-    pos = map->move_down(pos);
+    pos = map.move_down(pos);
 
-    left = map->get_height(pos);
-    right = map->get_height(map->move_right(pos));
+    left = map.get_height(pos);
+    right = map.get_height(map.move_right(pos));
 
     int t = std::min(left, right);
     /*if (left == right) t -= 1;*/ /* TODO ? */
 
-    if (y_base + MAP_TILE_HEIGHT - 4*t >= 0) break;
+    if (y_base + MAP_TILE_HEIGHT - 4*t >= min_y) break;
 
     y_base += MAP_TILE_HEIGHT;
   }
@@ -241,85 +285,415 @@ Viewport::draw_down_tile_col(MapPos pos, int x_base, int y_base,
   while (1) {
     if (y_base - 2*MAP_TILE_HEIGHT - 4*m >= max_y) break;
 
-    draw_triangle_up(x_base, y_base - 4*m, m, left, right, pos, tile);
+    if (y_base + 2*MAP_TILE_HEIGHT >= 0) {
+      draw_triangle_up(map, x_base, y_base - 4*m, m, left, right, pos, tile);
+    }
 
     y_base += MAP_TILE_HEIGHT;
 
     /* move down right */
-    pos = map->move_down_right(pos);
-    m = map->get_height(pos);
+    pos = map.move_down_right(pos);
+    m = map.get_height(pos);
 
     if (y_base - 2*MAP_TILE_HEIGHT - 4*std::max(left, right) >= max_y) break;
 
   down:
-    draw_triangle_down(x_base, y_base - 4*m, m, left, right, pos, tile);
+    if (y_base + 2*MAP_TILE_HEIGHT >= 0) {
+      draw_triangle_down(map, x_base, y_base - 4*m, m, left, right, pos, tile);
+    }
 
     y_base += MAP_TILE_HEIGHT;
 
     /* move down */
-    pos = map->move_down(pos);
+    pos = map.move_down(pos);
 
-    left = map->get_height(pos);
-    right = map->get_height(map->move_right(pos));
+    left = map.get_height(pos);
+    right = map.get_height(map.move_right(pos));
   }
 }
 
-void
-Viewport::layout() {
-  landscape_tiles.clear();
+/* Draw the part of landscape tile with given first position, starting at
+   left,top of tile pixels, to the top left corner of canvas. */
+template <typename Landscape, typename Canvas>
+static void
+draw_landscape_tile(const Landscape &map, MapPos pos, int left, int top,
+                    int w, int h, Canvas *tile) {
+  tile->fill_rect(0, 0, w, h, Color::black);
+
+  int x_base = -(MAP_TILE_WIDTH/2) - left;
+
+  /* Draw one extra column as half a column will be outside the
+   map tile on both right and left side.. */
+  for (int col = 0; col < MAP_TILE_COLS+1; col++) {
+    /* Up and down columns together span one and a half tile width. */
+    if ((x_base + 3*MAP_TILE_WIDTH/2 > 0) && (x_base < w)) {
+      draw_up_tile_col(map, pos, x_base, -top, -top, h, tile);
+      draw_down_tile_col(map, pos, x_base + MAP_TILE_WIDTH/2, -top, -top, h,
+                         tile);
+    }
+
+    pos = map.move_right(pos);
+    x_base += MAP_TILE_WIDTH;
+  }
 }
 
+/* Copy of the heights and terrain of the map positions needed to draw one
+   landscape tile, so that it can be drawn away from the game thread.
+   Positions are local to the copy, rows of SNAPSHOT_COLS positions. */
+#define SNAPSHOT_MARGIN  2
+#define SNAPSHOT_COLS  (2*MAP_TILE_COLS + 2*SNAPSHOT_MARGIN + 2)
+#define SNAPSHOT_ROWS  (MAP_TILE_ROWS + 2*SNAPSHOT_MARGIN + 12)
+
+class LandscapeSnapshot {
+ protected:
+  class Tile {
+   public:
+    uint8_t height;
+    Map::Terrain type_up;
+    Map::Terrain type_down;
+  };
+
+  std::vector<Tile> tiles;
+
+ public:
+  LandscapeSnapshot(const Map &map, MapPos first)
+    : tiles(SNAPSHOT_COLS*SNAPSHOT_ROWS) {
+    for (int y = 0; y < SNAPSHOT_ROWS; y++) {
+      for (int x = 0; x < SNAPSHOT_COLS; x++) {
+        MapPos pos = map.pos_add(first, x - SNAPSHOT_MARGIN,
+                                 y - SNAPSHOT_MARGIN);
+        Tile &tile = tiles[y*SNAPSHOT_COLS + x];
+        tile.height = map.get_height(pos);
+        tile.type_up = map.type_up(pos);
+        tile.type_down = map.type_down(pos);
+      }
+    }
+  }
+
+  MapPos get_first_pos() const {
+    return SNAPSHOT_MARGIN*SNAPSHOT_COLS + SNAPSHOT_MARGIN; }
+
+  MapPos move_right(MapPos pos) const { return pos + 1; }
+  MapPos move_left(MapPos pos) const { return pos - 1; }
+  MapPos move_down(MapPos pos) const { return pos + SNAPSHOT_COLS; }
+  MapPos move_down_right(MapPos pos) const { return pos + SNAPSHOT_COLS + 1; }
+  MapPos move_up(MapPos pos) const { return pos - SNAPSHOT_COLS; }
+  MapPos move_up_left(MapPos pos) const { return pos - SNAPSHOT_COLS - 1; }
+
+  unsigned int get_height(MapPos pos) const { return get(pos).height; }
+  Map::Terrain type_up(MapPos pos) const { return get(pos).type_up; }
+  Map::Terrain type_down(MapPos pos) const { return get(pos).type_down; }
+
+ protected:
+  const Tile &get(MapPos pos) const {
+    if (pos >= tiles.size()) {
+      throw ExceptionFreeserf("Landscape snapshot is too small.");
+    }
+    return tiles[pos];
+  }
+};
+
+/* Canvas that only lists the masked sprites a landscape tile is drawn
+   from. */
+class GroundSpriteList {
+ protected:
+  Graphics::MaskedSprites *sprites;
+  std::set<uint64_t> ids;
+
+ public:
+  explicit GroundSpriteList(Graphics::MaskedSprites *_sprites)
+    : sprites(_sprites) {
+  }
+
+  void fill_rect(int /*x*/, int /*y*/, int /*w*/, int /*h*/,
+                 const Color & /*color*/) {}
+
+  void draw_masked_sprite(int /*x*/, int /*y*/, Data::Resource mask_res,
+                          unsigned int mask_index, Data::Resource res,
+                          unsigned int index) {
+    uint64_t id = Data::Sprite::create_id(res, index, mask_res, mask_index,
+                                          {0, 0, 0, 0});
+    if (ids.insert(id).second) {
+      sprites->push_back({mask_res, mask_index, res, index});
+    }
+  }
+};
+
+/* Shared between the viewport and the tasks that prefetch its tiles. */
+class LandscapePrefetch {
+ public:
+  class Tile {
+   public:
+    unsigned int tid;
+    unsigned int generation;
+    Data::PSprite pixels;  // Empty when drawing failed
+  };
+
+  Data::PSource data_source;
+  std::mutex mutex;
+  std::list<Tile> ready;
+  std::map<uint64_t, Data::PSprite> sprites;
+
+  explicit LandscapePrefetch(Data::PSource _data_source)
+    : data_source(_data_source) {
+  }
+
+  /* Masked ground sprite, created on first use. */
+  Data::PSprite get_masked_sprite(Data::Resource mask_res,
+                                  unsigned int mask_index,
+                                  Data::Resource res, unsigned int index) {
+    uint64_t id = Data::Sprite::create_id(res, index, mask_res, mask_index,
+                                          {0, 0, 0, 0});
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = sprites.find(id);
+    if (it != sprites.end()) {
+      return it->second;
+    }
+
+    Data::PSprite s = data_source->get_sprite(res, index, {0, 0, 0, 0});
+    Data::PSprite m = data_source->get_sprite(mask_res, mask_index,
+                                              {0, 0, 0, 0});
+    if (!s || !m) {
+      throw ExceptionFreeserf("Failed to decode landscape sprite.");
+    }
+
+    Data::PSprite masked = s->get_masked(m);
+    sprites[id] = masked;
+    return masked;
+  }
+
+  /* Sprite in player color, created on first use. Empty when it can not
+     be decoded. */
+  Data::PSprite get_sprite(Data::Resource res, unsigned int index,
+                           const Data::Sprite::Color &color) {
+    uint64_t id = Data::Sprite::create_id(res, index, 0, 0, color);
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = sprites.find(id);
+    if (it != sprites.end()) {
+      return it->second;
+    }
+
+    Data::PSprite s = data_source->get_sprite(res, index, color);
+    sprites[id] = s;
+    return s;
+  }
+};
+
+/* Landscape tile or any other part of the map drawn to memory, same format
+   as sprites. */
+class LandscapeCanvas {
+ protected:
+  LandscapePrefetch *prefetch;
+  Data::PSprite pixels;
+
+ public:
+  LandscapeCanvas(LandscapePrefetch *_prefetch, unsigned int width,
+                  unsigned int height)
+    : prefetch(_prefetch)
+    , pixels(std::make_shared<SpriteBase>(width, height)) {
+  }
+
+  Data::PSprite get_pixels() const { return pixels; }
+
+  void fill_rect(int x, int y, int w, int h, const Color &color) {
+    Data::Sprite::Color c = {color.get_blue(), color.get_green(),
+                             color.get_red(), color.get_alpha()};
+    int width = static_cast<int>(pixels->get_width());
+    int height = static_cast<int>(pixels->get_height());
+    Data::Sprite::Color *dest =
+              reinterpret_cast<Data::Sprite::Color*>(pixels->get_data());
+    for (int ly = std::max(0, y); ly < std::min(y + h, height); ly++) {
+      for (int lx = std::max(0, x); lx < std::min(x + w, width); lx++) {
+        dest[ly*width + lx] = c;
+      }
+    }
+  }
+
+  void draw_masked_sprite(int x, int y, Data::Resource mask_res,
+                          unsigned int mask_index, Data::Resource res,
+                          unsigned int index) {
+    Data::PSprite sprite = prefetch->get_masked_sprite(mask_res, mask_index,
+                                                       res, index);
+    draw_sprite(x + sprite->get_offset_x(), y + sprite->get_offset_y(),
+                sprite, 0);
+  }
+
+  /* Blend sprite at x,y, without its rows above y_off. */
+  void draw_sprite(int x, int y, Data::PSprite sprite, int y_off) {
+    int width = static_cast<int>(pixels->get_width());
+    int height = static_cast<int>(pixels->get_height());
+    int s_width = static_cast<int>(sprite->get_width());
+    int s_height = static_cast<int>(sprite->get_height());
+
+    Data::Sprite::Color *dest =
+              reinterpret_cast<Data::Sprite::Color*>(pixels->get_data());
+    const Data::Sprite::Color *src =
+              reinterpret_cast<Data::Sprite::Color*>(sprite->get_data());
+
+    for (int sy = std::max(y_off, -y); sy < std::min(s_height, height - y);
+         sy++) {
+      for (int sx = std::max(0, -x); sx < std::min(s_width, width - x);
+           sx++) {
+        const Data::Sprite::Color &s = src[sy*s_width + sx];
+        Data::Sprite::Color &d = dest[(y + sy)*width + x + sx];
+        if (s.alpha == 0xff) {
+          d = s;
+        } else if (s.alpha != 0) {
+          d.blue = (s.blue*s.alpha + d.blue*(0xff - s.alpha)) / 0xff;
+          d.green = (s.green*s.alpha + d.green*(0xff - s.alpha)) / 0xff;
+          d.red = (s.red*s.alpha + d.red*(0xff - s.alpha)) / 0xff;
+          d.alpha = 0xff;
+        }
+      }
+    }
+  }
+};
+
+
+/* Mark the landscape around a map position for drawing again. */
 void
 Viewport::redraw_map_pos(MapPos pos) {
-  int mx, my;
-  map_pix_from_map_coord(pos, map->get_height(pos), &mx, &my);
+  /* Triangles sharing the vertex at any of the possible heights. */
+  int mx = MAP_TILE_WIDTH * map->pos_col(pos) -
+           (MAP_TILE_WIDTH/2) * map->pos_row(pos);
+  int my = MAP_TILE_HEIGHT * map->pos_row(pos);
+
+  mark_tiles_dirty(mx - MAP_TILE_WIDTH, my - 2*MAP_TILE_HEIGHT -
+                   4*MAP_MAX_HEIGHT, mx + MAP_TILE_WIDTH,
+                   my + 2*MAP_TILE_HEIGHT);
+  mark_background_dirty(pos);
+}
 
+/* Add area given in map pixels to the dirty areas of cached tiles. The area
+   may extend beyond the map in any direction and is wrapped around. */
+void
+Viewport::mark_tiles_dirty(int left, int top, int right, int bottom) {
   int horiz_tiles = map->get_cols()/MAP_TILE_COLS;
-  int vert_tiles = map->get_rows()/MAP_TILE_ROWS;
 
   int tile_width = MAP_TILE_COLS*MAP_TILE_WIDTH;
   int tile_height = MAP_TILE_ROWS*MAP_TILE_HEIGHT;
 
-  int tc = (mx / tile_width) % horiz_tiles;
-  int tr = (my / tile_height) % vert_tiles;
-  int tid = tc + horiz_tiles*tr;
+  int map_width = map->get_cols()*MAP_TILE_WIDTH;
+  int map_height = map->get_rows()*MAP_TILE_HEIGHT;
+  int wrap_shift = (map->get_rows()*MAP_TILE_WIDTH)/2;
+
+  /* Parts above and below the map continue on the other side, shifted
+     horizontally. */
+  if (top < 0) {
+    mark_tiles_dirty(left - wrap_shift, top + map_height,
+                     right - wrap_shift, std::min(bottom, 0) + map_height);
+    if (bottom <= 0) return;
+    top = 0;
+  }
+  if (bottom > map_height) {
+    mark_tiles_dirty(left + wrap_shift, std::max(top, map_height) - map_height,
+                     right + wrap_shift, bottom - map_height);
+    if (top >= map_height) return;
+    bottom = map_height;
+  }
+
+  int wrap = left / map_width - ((left % map_width < 0) ? 1 : 0);
+  left -= wrap*map_width;
+  right -= wrap*map_width;
+
+  for (int ty = top / tile_height; ty*tile_height < bottom; ty++) {
+    for (int tx = left / tile_width; tx*tile_width < right; tx++) {
+      unsigned int tid = (tx % horiz_tiles) + horiz_tiles*ty;
+      prefetch_pending.erase(tid);
+      for (unsigned int level = 1; level <= LOD_MAX_LEVEL; level++) {
+        lod_tiles.erase(tid | (level << 24));
+      }
+      if (!landscape_tiles.contains(tid)) continue;
 
-  TilesMap::iterator it = landscape_tiles.find(tid);
-  if (it != landscape_tiles.end()) {
-    landscape_tiles.erase(tid);
+      DirtyArea area;
+      area.left = std::max(left - tx*tile_width, 0);
+      area.top = std::max(top - ty*tile_height, 0);
+      area.right = std::min(right - tx*tile_width, tile_width);
+      area.bottom = std::min(bottom - ty*tile_height, tile_height);
+
+      DirtyTiles::iterator it = dirty_tiles.find(tid);
+      if (it == dirty_tiles.end()) {
+        dirty_tiles[tid] = area;
+      } else {
+        it->second.left = std::min(it->second.left, area.left);
+        it->second.top = std::min(it->second.top, area.top);
+        it->second.right = std::max(it->second.right, area.right);
+        it->second.bottom = std::max(it->second.bottom, area.bottom);
+      }
+    }
   }
 }
 
-Frame *
-Viewport::get_tile_frame(unsigned int tid, int tc, int tr) {
-  TilesMap::iterator it = landscape_tiles.find(tid);
-  if (it != landscape_tiles.end()) {
-    return it->second.get();
-  }
+/* Render the dirty parts of cached tiles again. Only triangles that reach
+   into the dirty area are drawn, clipped by a patch frame that is then
+   copied onto the tile. */
+void
+Viewport::redraw_dirty_tiles() {
+  if (dirty_tiles.empty()) return;
+
+  int horiz_tiles = map->get_cols()/MAP_TILE_COLS;
 
   int tile_width = MAP_TILE_COLS*MAP_TILE_WIDTH;
   int tile_height = MAP_TILE_ROWS*MAP_TILE_HEIGHT;
 
-  std::unique_ptr<Frame> tile_frame(
-    Graphics::get_instance().create_frame(tile_width, tile_height));
-  tile_frame->fill_rect(0, 0, tile_width, tile_height, Color::black);
+  for (const auto &dirty : dirty_tiles) {
+    Frame *tile_frame = landscape_tiles.peek(dirty.first);
+    if (tile_frame == nullptr) continue;
+
+    const DirtyArea &area = dirty.second;
+    int w = area.right - area.left;
+    int h = area.bottom - area.top;
+
+    /* Drawing most of the tile is cheaper in one go. */
+    if (2*w*h > tile_width*tile_height) {
+      landscape_tiles.erase(dirty.first);
+      continue;
+    }
+
+    if (!patch_frame) {
+      patch_frame.reset(
+        Graphics::get_instance().create_frame(tile_width, tile_height));
+    }
+
+    int tc = dirty.first % horiz_tiles;
+    int tr = dirty.first / horiz_tiles;
+    draw_tile(tc, tr, area.left, area.top, w, h, patch_frame.get());
+    tile_frame->draw_frame(area.left, area.top, 0, 0, patch_frame.get(),
+                           w, h);
+  }
+
+  dirty_tiles.clear();
+}
 
+/* Draw the part of landscape tile starting at left,top of tile pixels to
+   the top left corner of frame. */
+void
+Viewport::draw_tile(int tc, int tr, int left, int top, int w, int h,
+                    Frame *tile) {
+  draw_landscape_tile(*map, get_tile_pos(tc, tr), left, top, w, h, tile);
+}
+
+/* First map position of the landscape tile. */
+MapPos
+Viewport::get_tile_pos(int tc, int tr) {
   int col = (tc*MAP_TILE_COLS + (tr*MAP_TILE_ROWS)/2) % map->get_cols();
   int row = tr*MAP_TILE_ROWS;
-  MapPos pos = map->pos(col, row);
+  return map->pos(col, row);
+}
 
-  int x_base = -(MAP_TILE_WIDTH/2);
+Frame *
+Viewport::get_tile_frame(unsigned int tid, int tc, int tr) {
+  Frame *cached_frame = landscape_tiles.get(tid);
+  if (cached_frame != nullptr) {
+    return cached_frame;
+  }
 
-  /* Draw one extra column as half a column will be outside the
-   map tile on both right and left side.. */
-  for (int col = 0; col < MAP_TILE_COLS+1; col++) {
-    draw_up_tile_col(pos, x_base, 0, tile_height, tile_frame.get());
-    draw_down_tile_col(pos, x_base + MAP_TILE_WIDTH/2, 0, tile_height,
-                       tile_frame.get());
+  int tile_width = MAP_TILE_COLS*MAP_TILE_WIDTH;
+  int tile_height = MAP_TILE_ROWS*MAP_TILE_HEIGHT;
 
-    pos = map->move_right(pos);
-    x_base += MAP_TILE_WIDTH;
-  }
+  std::unique_ptr<Frame> tile_frame(
+    Graphics::get_instance().create_frame(tile_width, tile_height));
+  draw_tile(tc, tr, 0, 0, tile_width, tile_height, tile_frame.get());
 
 #if 0
   /* Draw a border around the tile for debug. */
@@ -332,13 +706,18 @@ Viewport::get_tile_frame(unsigned int tid, int tc, int tr) {
                            << ", tc,tr: " << tc << "," << tr << ", tw,th: "
                            << tile_width << "," << tile_height;
 
-  landscape_tiles[tid] = std::move(tile_frame);
+  dirty_tiles.erase(tid);
 
-  return landscape_tiles[tid].get();
+  /* Frames hold 32 bit pixels. */
+  return landscape_tiles.insert(tid, std::move(tile_frame),
+                                tile_width*tile_height*4);
 }
 
 void
 Viewport::draw_landscape() {
+  redraw_dirty_tiles();
+  upload_prefetched_tiles();
+
   int horiz_tiles = map->get_cols()/MAP_TILE_COLS;
   int vert_tiles = map->get_rows()/MAP_TILE_ROWS;
 
@@ -351,45 +730,584 @@ Viewport::draw_landscape() {
   int my = offset_y;
   int ly = 0;
   int x_base = 0;
-  while (ly < height) {
+  while (ly < height) {
+    while (my >= map_height) {
+      my -= map_height;
+      x_base += (map->get_rows()*MAP_TILE_WIDTH)/2;
+    }
+
+    int ty = my % tile_height;
+
+    int lx = 0;
+    int mx = (offset_x + x_base) % map_width;
+    while (lx < width) {
+      int tx = mx % tile_width;
+
+      int tc = (mx / tile_width) % horiz_tiles;
+      int tr = (my / tile_height) % vert_tiles;
+      int tid = tc + horiz_tiles*tr;
+
+      Frame *tile_frame = get_tile_frame(tid, tc, tr);
+
+      int w = tile_width - tx;
+      if (lx+w > width) {
+        w = width - lx;
+      }
+      int h = tile_height - ty;
+      if (ly+h > height) {
+        h = height - ly;
+      }
+
+      frame->draw_frame(lx, ly, tx, ty, tile_frame, w, h);
+      lx += tile_width - tx;
+      mx += tile_width - tx;
+    }
+
+    ly += tile_height - ty;
+    my += tile_height - ty;
+  }
+}
+
+/* Level of reduction for the zoom factor, 0 to draw at full size. */
+unsigned int
+Viewport::get_lod_level() const {
+  float factor = Graphics::get_instance().get_zoom_factor();
+  unsigned int level = 0;
+  while ((level < LOD_MAX_LEVEL) &&
+         (factor >= LOD_ZOOM_THRESHOLD * static_cast<float>(1 << level))) {
+    level++;
+  }
+  return level;
+}
+
+/* Draw the landscape reduced 2^level times to the LOD background, as
+   draw_landscape() does at full size. Reduced tiles that are missing are
+   drawn to memory at full size by the thread pool and reduced there, only
+   the reduced tiles are kept. */
+void
+Viewport::draw_landscape_lod(unsigned int level, int lod_width,
+                             int lod_height) {
+  int horiz_tiles = map->get_cols()/MAP_TILE_COLS;
+  int vert_tiles = map->get_rows()/MAP_TILE_ROWS;
+
+  int full_width = MAP_TILE_COLS*MAP_TILE_WIDTH;
+  int full_height = MAP_TILE_ROWS*MAP_TILE_HEIGHT;
+  int tile_width = full_width >> level;
+  int tile_height = full_height >> level;
+
+  int map_width = (map->get_cols()*MAP_TILE_WIDTH) >> level;
+  int map_height = (map->get_rows()*MAP_TILE_HEIGHT) >> level;
+  int wrap_shift = ((map->get_rows()*MAP_TILE_WIDTH)/2) >> level;
+
+  class Piece {
+   public:
+    int lx, ly;
+    int tx, ty;
+    int w, h;
+    unsigned int key;
+  };
+  std::vector<Piece> pieces;
+  std::vector<unsigned int> missing;
+
+  int my = offset_y >> level;
+  int ly = 0;
+  int x_base = 0;
+  while (ly < lod_height) {
+    while (my >= map_height) {
+      my -= map_height;
+      x_base += wrap_shift;
+    }
+
+    int lx = 0;
+    int mx = ((offset_x >> level) + x_base) % map_width;
+    while (lx < lod_width) {
+      Piece piece;
+      piece.lx = lx;
+      piece.ly = ly;
+      piece.tx = mx % tile_width;
+      piece.ty = my % tile_height;
+      piece.w = std::min(tile_width - piece.tx, lod_width - lx);
+      piece.h = std::min(tile_height - piece.ty, lod_height - ly);
+
+      int tc = (mx / tile_width) % horiz_tiles;
+      int tr = (my / tile_height) % vert_tiles;
+      piece.key = (tc + horiz_tiles*tr) | (level << 24);
+      if (!lod_tiles.contains(piece.key) &&
+          (std::find(missing.begin(), missing.end(), piece.key) ==
+           missing.end())) {
+        missing.push_back(piece.key);
+      }
+      pieces.push_back(piece);
+
+      lx += tile_width - piece.tx;
+      mx += tile_width - piece.tx;
+    }
+
+    ly += tile_height - (my % tile_height);
+    my += tile_height - (my % tile_height);
+  }
+
+  if (!missing.empty()) {
+    if (!prefetch) {
+      prefetch = std::make_shared<LandscapePrefetch>(data_source);
+    }
+
+    std::vector<std::shared_ptr<LandscapeSnapshot>> snapshots;
+    for (unsigned int key : missing) {
+      unsigned int tid = key & 0xffffff;
+      snapshots.push_back(std::make_shared<LandscapeSnapshot>(
+                     *map, get_tile_pos(tid % horiz_tiles, tid / horiz_tiles)));
+    }
+
+    std::vector<Data::PSprite> reduced(missing.size());
+    LandscapePrefetch *state = prefetch.get();
+    ThreadPool::get_instance().parallel_for(missing.size(), [&](size_t i) {
+      try {
+        LandscapeCanvas canvas(state, full_width, full_height);
+        draw_landscape_tile(*snapshots[i], snapshots[i]->get_first_pos(),
+                            0, 0, full_width, full_height, &canvas);
+        reduced[i] = canvas.get_pixels()->get_reduced(level);
+      } catch (...) {
+        /* Left black */
+      }
+    });
+
+    for (size_t i = 0; i < missing.size(); i++) {
+      std::unique_ptr<Frame> tile_frame(
+        Graphics::get_instance().create_frame(tile_width, tile_height));
+      if (reduced[i]) {
+        tile_frame->draw_sprite(0, 0, reduced[i]);
+      } else {
+        tile_frame->fill_rect(0, 0, tile_width, tile_height, Color::black);
+      }
+      lod_tiles.insert(missing[i], std::move(tile_frame),
+                       tile_width*tile_height*4);
+    }
+  }
+
+  for (const Piece &piece : pieces) {
+    Frame *tile_frame = lod_tiles.get(piece.key);
+    if (tile_frame == nullptr) continue;
+    lod_background->draw_frame(piece.lx, piece.ly, piece.tx, piece.ty,
+                               tile_frame, piece.w, piece.h);
+  }
+}
+
+/* Draw the view reduced 2^level times and enlarge it to the frame. There
+   are fewer pixels to fill and the reduced sprites are drawn by the same
+   number of calls, however many of them are visible. As at full size, the
+   reduced landscape and paths are kept in a background and only the cells
+   where sprites changed are composed and enlarged again. */
+void
+Viewport::draw_lod(unsigned int level) {
+  int scale = 1 << level;
+  int lod_width = (width + scale - 1) >> level;
+  int lod_height = (height + scale - 1) >> level;
+  if (!lod_frame || (lod_level != level)) {
+    Graphics &gfx = Graphics::get_instance();
+    lod_background.reset(gfx.create_frame(lod_width, lod_height));
+    lod_frame.reset(gfx.create_frame(lod_width, lod_height));
+    lod_level = level;
+    background_valid = false;
+    draw_list.clear();
+  }
+
+  int cols = (lod_width + DIRTY_CELL_SIZE - 1) / DIRTY_CELL_SIZE;
+  int rows = (lod_height + DIRTY_CELL_SIZE - 1) / DIRTY_CELL_SIZE;
+  dirty_cells.resize(cols*rows, false);
+
+  /* The reduced background is cheap to draw from reduced tiles, it is drawn
+     again as a whole when any part of it changed. */
+  bool whole = !background_valid;
+  DirtyArea &area = background_dirty;
+  if (whole || area.left < area.right) {
+    draw_landscape_lod(level, lod_width, lod_height);
+    if (layers & LayerPaths) {
+      DrawList paths;
+      recording = &paths;
+      draw_paths_and_borders();
+      recording = nullptr;
+      for (const DrawCommand &command : paths) {
+        play(command, lod_background.get(), 0, 0, level);
+      }
+    }
+    if (!whole) {
+      mark_screen_dirty(area.left, area.top, area.right, area.bottom, level);
+    }
+  }
+  background_valid = true;
+  area = DirtyArea();
+
+  DrawList commands;
+  recording = &commands;
+  if (layers & LayerPaths) {
+    draw_building_road();
+  }
+  recording = nullptr;
+  measure(&commands);
+
+  const DrawList &objects_commands = get_objects()->commands;
+  commands.insert(commands.end(), objects_commands.begin(),
+                  objects_commands.end());
+
+  if (layers & LayerCursor) {
+    DrawList cursor;
+    recording = &cursor;
+    draw_map_cursor();
+    recording = nullptr;
+    measure(&cursor);
+    commands.insert(commands.end(), cursor.begin(), cursor.end());
+  }
+
+  {
+    Simulation::Unlock unlock(interface->get_simulation());
+    compose(&commands, whole, level);
+  }
+}
+
+/* Collect ids of the landscape tiles covering the viewport at map pixel
+   offset x,y. */
+void
+Viewport::get_tiles_in_view(int x, int y, std::vector<unsigned int> *tiles) {
+  int horiz_tiles = map->get_cols()/MAP_TILE_COLS;
+  int vert_tiles = map->get_rows()/MAP_TILE_ROWS;
+
+  int tile_width = MAP_TILE_COLS*MAP_TILE_WIDTH;
+  int tile_height = MAP_TILE_ROWS*MAP_TILE_HEIGHT;
+
+  int map_width = map->get_cols()*MAP_TILE_WIDTH;
+  int map_height = map->get_rows()*MAP_TILE_HEIGHT;
+  int wrap_shift = (map->get_rows()*MAP_TILE_WIDTH)/2;
+
+  while (y < 0) {
+    y += map_height;
+    x -= wrap_shift;
+  }
+
+  int my = y;
+  int ly = 0;
+  int x_base = 0;
+  while (ly < height) {
+    while (my >= map_height) {
+      my -= map_height;
+      x_base += wrap_shift;
+    }
+
+    int mx = ((x + x_base) % map_width + map_width) % map_width;
+    int lx = 0;
+    while (lx < width) {
+      int tc = (mx / tile_width) % horiz_tiles;
+      int tr = (my / tile_height) % vert_tiles;
+      tiles->push_back(tc + horiz_tiles*tr);
+
+      lx += tile_width - (mx % tile_width);
+      mx += tile_width - (mx % tile_width);
+    }
+
+    ly += tile_height - (my % tile_height);
+    my += tile_height - (my % tile_height);
+  }
+}
+
+void
+Viewport::get_ground_sprites(Graphics::MaskedSprites *sprites) {
+  std::vector<unsigned int> tiles;
+  get_tiles_in_view(offset_x, offset_y, &tiles);
+
+  int horiz_tiles = map->get_cols()/MAP_TILE_COLS;
+  GroundSpriteList list(sprites);
+  for (unsigned int tid : tiles) {
+    draw_landscape_tile(*map, get_tile_pos(tid % horiz_tiles,
+                                           tid / horiz_tiles),
+                        0, 0, MAP_TILE_COLS*MAP_TILE_WIDTH,
+                        MAP_TILE_ROWS*MAP_TILE_HEIGHT, &list);
+  }
+}
+
+/* Request tiles that are about to scroll into view from background tasks.
+   Each task draws from its own copy of the landscape. */
+void
+Viewport::prefetch_tiles() {
+  int dx = offset_x - prefetch_offset_x;
+  int dy = offset_y - prefetch_offset_y;
+  prefetch_offset_x = offset_x;
+  prefetch_offset_y = offset_y;
+  if ((dx == 0 && dy == 0) || (width <= 0) || (height <= 0)) return;
+
+  int tile_width = MAP_TILE_COLS*MAP_TILE_WIDTH;
+  int tile_height = MAP_TILE_ROWS*MAP_TILE_HEIGHT;
+  int ahead_x = (dx > 0) ? tile_width : ((dx < 0) ? -tile_width : 0);
+  int ahead_y = (dy > 0) ? tile_height : ((dy < 0) ? -tile_height : 0);
+
+  std::vector<unsigned int> tiles;
+  get_tiles_in_view(offset_x + ahead_x, offset_y + ahead_y, &tiles);
+
+  if (!prefetch) {
+    prefetch = std::make_shared<LandscapePrefetch>(data_source);
+  }
+
+  int horiz_tiles = map->get_cols()/MAP_TILE_COLS;
+
+  for (unsigned int tid : tiles) {
+    if (prefetch_pending.size() >= LANDSCAPE_PREFETCH_MAX) break;
+    if (landscape_tiles.contains(tid) ||
+        (prefetch_pending.find(tid) != prefetch_pending.end())) {
+      continue;
+    }
+
+    unsigned int generation = ++prefetch_generation;
+    prefetch_pending[tid] = generation;
+
+    auto snapshot = std::make_shared<LandscapeSnapshot>(
+                      *map, get_tile_pos(tid % horiz_tiles, tid / horiz_tiles));
+    std::shared_ptr<LandscapePrefetch> state = prefetch;
+    ThreadPool::get_instance().run([state, snapshot, tid, generation,
+                                    tile_width, tile_height]() {
+      LandscapePrefetch::Tile tile;
+      tile.tid = tid;
+      tile.generation = generation;
+      try {
+        LandscapeCanvas canvas(state.get(), tile_width, tile_height);
+        draw_landscape_tile(*snapshot, snapshot->get_first_pos(), 0, 0,
+                            tile_width, tile_height, &canvas);
+        tile.pixels = canvas.get_pixels();
+      } catch (...) {
+        /* Left to be drawn when it comes into view */
+      }
+
+      std::unique_lock<std::mutex> lock(state->mutex);
+      state->ready.push_back(std::move(tile));
+    });
+  }
+}
+
+/* Turn prefetched tiles into frames, as long as time budget of this frame
+   allows. Tiles that changed since they were requested are dropped. */
+void
+Viewport::upload_prefetched_tiles() {
+  if (!prefetch) return;
+
+  int tile_width = MAP_TILE_COLS*MAP_TILE_WIDTH;
+  int tile_height = MAP_TILE_ROWS*MAP_TILE_HEIGHT;
+
+  auto start = std::chrono::steady_clock::now();
+  while (true) {
+    LandscapePrefetch::Tile tile;
+    {
+      std::unique_lock<std::mutex> lock(prefetch->mutex);
+      if (prefetch->ready.empty()) break;
+      tile = std::move(prefetch->ready.front());
+      prefetch->ready.pop_front();
+    }
+
+    PrefetchPending::iterator it = prefetch_pending.find(tile.tid);
+    if ((it == prefetch_pending.end()) || (it->second != tile.generation)) {
+      continue;
+    }
+    prefetch_pending.erase(it);
+
+    if (!tile.pixels || landscape_tiles.contains(tile.tid)) continue;
+
+    std::unique_ptr<Frame> tile_frame(
+      Graphics::get_instance().create_frame(tile_width, tile_height));
+    tile_frame->draw_sprite(0, 0, tile.pixels);
+    landscape_tiles.insert(tile.tid, std::move(tile_frame),
+                           tile_width*tile_height*4);
+
+    std::chrono::duration<double, std::micro> elapsed =
+                                   std::chrono::steady_clock::now() - start;
+    if (elapsed.count() >= LANDSCAPE_UPLOAD_BUDGET_US) break;
+  }
+}
+
+
+/* Draw the map area of the given size at map pixel x,y to memory. Paths,
+   borders and objects are recorded as if the viewport showed the area,
+   then each part of the area inside one landscape tile is drawn by its
+   own task, the landscape from a copy and the recorded sprites on top. */
+Data::PSprite
+Viewport::render_area(int x, int y, int area_width, int area_height,
+                      unsigned int area_layers) {
+  if (!prefetch) {
+    prefetch = std::make_shared<LandscapePrefetch>(data_source);
+  }
+
+  DrawList commands;
+  int view_x = offset_x;
+  int view_y = offset_y;
+  int view_width = width;
+  int view_height = height;
+  offset_x = x;
+  offset_y = y;
+  width = area_width;
+  height = area_height;
+  recording = &commands;
+  if (area_layers & LayerPaths) {
+    draw_paths_and_borders();
+  }
+  draw_game_objects(area_layers);
+  recording = nullptr;
+  offset_x = view_x;
+  offset_y = view_y;
+  width = view_width;
+  height = view_height;
+
+  /* Sprites are looked up here, the tasks only read them. */
+  class Placed {
+   public:
+    Data::PSprite sprite;
+    int x, y;
+    int y_off;
+  };
+  std::vector<Placed> placed;
+  for (const DrawCommand &command : commands) {
+    Placed item;
+    item.x = command.x;
+    item.y = command.y;
+    item.y_off = 0;
+    bool use_off = true;
+    switch (command.type) {
+      case DrawCommand::TypeRelativeSprite: {
+        Data::PSprite relative_to = prefetch->get_sprite(command.mask_res,
+                                                         command.mask_index,
+                                                         {0, 0, 0, 0});
+        if (!relative_to) continue;
+        item.x += relative_to->get_delta_x();
+        item.y += relative_to->get_delta_y();
+        item.sprite = prefetch->get_sprite(command.res, command.index,
+                                           {0, 0, 0, 0});
+        break;
+      }
+      case DrawCommand::TypeSprite: {
+        const Color &c = command.color;
+        item.sprite = prefetch->get_sprite(command.res, command.index,
+                                           {c.get_blue(), c.get_green(),
+                                            c.get_red(), c.get_alpha()});
+        use_off = command.use_off;
+        if (item.sprite) {
+          int h = static_cast<int>(item.sprite->get_height());
+          item.y_off = h - static_cast<int>(h * command.progress);
+        }
+        break;
+      }
+      case DrawCommand::TypeMaskedSprite:
+        try {
+          item.sprite = prefetch->get_masked_sprite(command.mask_res,
+                                                    command.mask_index,
+                                                    command.res,
+                                                    command.index);
+        } catch (ExceptionFreeserf &e) {
+          continue;
+        }
+        break;
+      default:
+        /* Debug text is left out */
+        continue;
+    }
+    if (!item.sprite) continue;
+    if (use_off) {
+      item.x += item.sprite->get_offset_x();
+      item.y += item.sprite->get_offset_y();
+    }
+    placed.push_back(std::move(item));
+  }
+
+  /* Split the area at landscape tile borders, as draw_landscape() does. */
+  class Part {
+   public:
+    int lx, ly;
+    int tx, ty;
+    int w, h;
+    std::shared_ptr<LandscapeSnapshot> landscape;
+  };
+  std::vector<Part> parts;
+
+  int horiz_tiles = map->get_cols()/MAP_TILE_COLS;
+  int vert_tiles = map->get_rows()/MAP_TILE_ROWS;
+
+  int tile_width = MAP_TILE_COLS*MAP_TILE_WIDTH;
+  int tile_height = MAP_TILE_ROWS*MAP_TILE_HEIGHT;
+
+  int map_width = map->get_cols()*MAP_TILE_WIDTH;
+  int map_height = map->get_rows()*MAP_TILE_HEIGHT;
+  int wrap_shift = (map->get_rows()*MAP_TILE_WIDTH)/2;
+
+  while (y < 0) {
+    y += map_height;
+    x -= wrap_shift;
+  }
+
+  int my = y;
+  int ly = 0;
+  int x_base = 0;
+  while (ly < area_height) {
     while (my >= map_height) {
       my -= map_height;
-      x_base += (map->get_rows()*MAP_TILE_WIDTH)/2;
+      x_base += wrap_shift;
     }
 
-    int ty = my % tile_height;
-
+    int mx = ((x + x_base) % map_width + map_width) % map_width;
     int lx = 0;
-    int mx = (offset_x + x_base) % map_width;
-    while (lx < width) {
-      int tx = mx % tile_width;
+    while (lx < area_width) {
+      Part part;
+      part.lx = lx;
+      part.ly = ly;
+      part.tx = mx % tile_width;
+      part.ty = my % tile_height;
+      part.w = std::min(tile_width - part.tx, area_width - lx);
+      part.h = std::min(tile_height - part.ty, area_height - ly);
+      if (area_layers & LayerLandscape) {
+        int tc = (mx / tile_width) % horiz_tiles;
+        int tr = (my / tile_height) % vert_tiles;
+        part.landscape = std::make_shared<LandscapeSnapshot>(
+                                                *map, get_tile_pos(tc, tr));
+      }
+      parts.push_back(part);
 
-      int tc = (mx / tile_width) % horiz_tiles;
-      int tr = (my / tile_height) % vert_tiles;
-      int tid = tc + horiz_tiles*tr;
+      lx += tile_width - part.tx;
+      mx += tile_width - part.tx;
+    }
 
-      Frame *tile_frame = get_tile_frame(tid, tc, tr);
+    ly += tile_height - (my % tile_height);
+    my += tile_height - (my % tile_height);
+  }
 
-      int w = tile_width - tx;
-      if (lx+w > width) {
-        w = width - lx;
-      }
-      int h = tile_height - ty;
-      if (ly+h > height) {
-        h = height - ly;
+  Data::PSprite result = std::make_shared<SpriteBase>(area_width,
+                                                      area_height);
+  uint32_t *result_pixels = reinterpret_cast<uint32_t*>(result->get_data());
+  LandscapePrefetch *state = prefetch.get();
+  ThreadPool::get_instance().parallel_for(parts.size(), [&](size_t i) {
+    const Part &part = parts[i];
+    LandscapeCanvas canvas(state, part.w, part.h);
+    if (part.landscape) {
+      draw_landscape_tile(*part.landscape, part.landscape->get_first_pos(),
+                          part.tx, part.ty, part.w, part.h, &canvas);
+    } else {
+      canvas.fill_rect(0, 0, part.w, part.h, Color::black);
+    }
+
+    for (const Placed &item : placed) {
+      int w = static_cast<int>(item.sprite->get_width());
+      int h = static_cast<int>(item.sprite->get_height());
+      if (item.x + w <= part.lx || item.x >= part.lx + part.w ||
+          item.y + h <= part.ly || item.y + item.y_off >= part.ly + part.h) {
+        continue;
       }
+      canvas.draw_sprite(item.x - part.lx, item.y - part.ly, item.sprite,
+                         item.y_off);
+    }
 
-      frame->draw_frame(lx, ly, tx, ty, tile_frame, w, h);
-      lx += tile_width - tx;
-      mx += tile_width - tx;
+    const uint32_t *src =
+                reinterpret_cast<uint32_t*>(canvas.get_pixels()->get_data());
+    for (int row = 0; row < part.h; row++) {
+      std::copy(src + row*part.w, src + (row + 1)*part.w,
+                result_pixels + (part.ly + row)*area_width + part.lx);
     }
+  });
 
-    ly += tile_height - ty;
-    my += tile_height - ty;
-  }
+  return result;
 }
 
-
 void
 Viewport::draw_path_segment(int lx, int ly, MapPos pos, Direction dir) {
   int h1 = map->get_height(pos);
@@ -450,9 +1368,9 @@ Viewport::draw_path_segment(int lx, int ly, MapPos pos, Direction dir) {
     sprite += 3;
   }
 
-  frame->draw_masked_sprite(lx, ly,
-                            Data::AssetPathMask, mask,
-                            Data::AssetPathGround, sprite);
+  draw_masked_sprite(lx, ly,
+                     Data::AssetPathMask, mask,
+                     Data::AssetPathGround, sprite);
 }
 
 void
@@ -516,7 +1434,7 @@ Viewport::draw_border_segment(int lx, int ly, MapPos pos, Direction dir) {
     sprite += 3;
   }
 
-  frame->draw_sprite(lx, ly, Data::AssetMapBorder, sprite, false);
+  draw_sprite(lx, ly, Data::AssetMapBorder, sprite, false);
 }
 
 MapPos
@@ -598,9 +1516,11 @@ Viewport::draw_paths_and_borders() {
 
     base_pos = map->move_right(base_pos);
   }
+}
 
-  /* If we're in road construction mode, also draw
-     the temporarily placed roads. */
+/* If we're in road construction mode, draw the temporarily placed roads. */
+void
+Viewport::draw_building_road() {
   if (interface->is_building_road()) {
     Road road = interface->get_building_road();
     MapPos pos = road.get_source();
@@ -623,34 +1543,291 @@ Viewport::draw_paths_and_borders() {
   }
 }
 
+bool
+Viewport::DrawCommand::operator<(const DrawCommand &other) const {
+  auto key = [](const DrawCommand &c) {
+    return std::tie(c.type, c.y, c.x, c.res, c.index, c.mask_res,
+                    c.mask_index, c.use_off, c.progress, c.number, c.text);
+  };
+  auto color = [](const Color &c) {
+    return (c.get_red() << 24) | (c.get_green() << 16) |
+           (c.get_blue() << 8) | c.get_alpha();
+  };
+
+  if (key(*this) != key(other)) {
+    return key(*this) < key(other);
+  }
+  return color(this->color) < color(other.color);
+}
+
+bool
+Viewport::DrawCommand::operator==(const DrawCommand &other) const {
+  return !(*this < other) && !(other < *this);
+}
+
+/* Add command covering the given screen area to the recorded frame. */
+void
+Viewport::record(DrawCommand *command, int left, int top, int w, int h) {
+  command->left = left;
+  command->top = top;
+  command->right = left + w;
+  command->bottom = top + h;
+  recording->push_back(std::move(*command));
+}
+
+/* Find the areas covered by recorded sprites. The images are only looked
+   up by the thread drawing the frame, sprites without image are dropped. */
+void
+Viewport::measure(DrawList *list) {
+  size_t count = 0;
+  for (size_t i = 0; i < list->size(); i++) {
+    DrawCommand &command = (*list)[i];
+    Image *image = nullptr;
+    int lx = command.x;
+    int ly = command.y;
+
+    if (command.type == DrawCommand::TypeRelativeSprite) {
+      Image *relative_to = frame->get_sprite_image(command.mask_res,
+                                                   command.mask_index,
+                                                   Color::transparent);
+      if (relative_to == nullptr) {
+        continue;
+      }
+      command.type = DrawCommand::TypeSprite;
+      command.x += relative_to->get_delta_x();
+      command.y += relative_to->get_delta_y();
+      command.mask_res = Data::AssetNone;
+      command.mask_index = 0;
+      lx = command.x;
+      ly = command.y;
+    }
+
+    if (command.type == DrawCommand::TypeSprite) {
+      image = frame->get_sprite_image(command.res, command.index,
+                                      command.color);
+      if (image == nullptr) {
+        continue;
+      }
+      if (command.use_off) {
+        lx += image->get_offset_x();
+        ly += image->get_offset_y();
+      }
+    } else if (command.type == DrawCommand::TypeMaskedSprite) {
+      image = frame->get_masked_image(command.mask_res, command.mask_index,
+                                      command.res, command.index);
+      if (image == nullptr) {
+        continue;
+      }
+      lx += image->get_offset_x();
+      ly += image->get_offset_y();
+    }
+
+    if (image != nullptr) {
+      command.left = lx;
+      command.top = ly;
+      command.right = lx + image->get_width();
+      command.bottom = ly + image->get_height();
+    }
+    if (count != i) {
+      (*list)[count] = std::move(command);
+    }
+    count++;
+  }
+  list->resize(count);
+}
+
+/* Position reduced 2^level times, rounded down. */
+static int
+reduce_position(int value, unsigned int level) {
+  int scale = 1 << level;
+  return (value >= 0) ? value / scale : -((scale - 1 - value) / scale);
+}
+
+/* Draw recorded command to target, moved by x,y, with sprites reduced
+   2^level times. Debug text is left out of reduced views. */
+void
+Viewport::play(const DrawCommand &command, Frame *target, int x, int y,
+               unsigned int level) {
+  int lx = reduce_position(command.x + x, level);
+  int ly = reduce_position(command.y + y, level);
+  switch (command.type) {
+    case DrawCommand::TypeSprite:
+      target->draw_sprite(lx, ly, command.res, command.index, command.use_off,
+                          command.color, command.progress, level);
+      break;
+    case DrawCommand::TypeMaskedSprite:
+      target->draw_masked_sprite(lx, ly, command.mask_res, command.mask_index,
+                                 command.res, command.index, level);
+      break;
+    case DrawCommand::TypeNumber:
+      if (level > 0) break;
+      target->draw_number(lx, ly, command.number, command.color);
+      break;
+    case DrawCommand::TypeString:
+      if (level > 0) break;
+      target->draw_string(lx, ly, command.text, command.color);
+      break;
+    case DrawCommand::TypeRelativeSprite:
+      break;
+  }
+}
+
+/* The following functions draw to the frame, or add to the recorded
+   frame while the animated layers are drawn. */
+void
+Viewport::draw_sprite(int lx, int ly, Data::Resource res, unsigned int index,
+                      bool use_off, const Color &color, float progress) {
+  if (recording == nullptr) {
+    frame->draw_sprite(lx, ly, res, index, use_off, color, progress);
+    return;
+  }
+
+  DrawCommand command;
+  command.type = DrawCommand::TypeSprite;
+  command.x = lx;
+  command.y = ly;
+  command.res = res;
+  command.index = index;
+  command.use_off = use_off;
+  command.color = color;
+  command.progress = progress;
+  recording->push_back(std::move(command));
+}
+
+void
+Viewport::draw_sprite_relatively(int lx, int ly, Data::Resource res,
+                                 unsigned int index,
+                                 Data::Resource relative_to_res,
+                                 unsigned int relative_to_index) {
+  if (recording != nullptr) {
+    DrawCommand command;
+    command.type = DrawCommand::TypeRelativeSprite;
+    command.x = lx;
+    command.y = ly;
+    command.res = res;
+    command.index = index;
+    command.mask_res = relative_to_res;
+    command.mask_index = relative_to_index;
+    command.use_off = true;
+    recording->push_back(std::move(command));
+    return;
+  }
+
+  Image *relative_to = frame->get_sprite_image(relative_to_res,
+                                               relative_to_index,
+                                               Color::transparent);
+  if (relative_to == nullptr) {
+    return;
+  }
+
+  draw_sprite(lx + relative_to->get_delta_x(),
+              ly + relative_to->get_delta_y(), res, index, true);
+}
+
+void
+Viewport::draw_masked_sprite(int lx, int ly, Data::Resource mask_res,
+                             unsigned int mask_index, Data::Resource res,
+                             unsigned int index) {
+  if (recording == nullptr) {
+    frame->draw_masked_sprite(lx, ly, mask_res, mask_index, res, index);
+    return;
+  }
+
+  DrawCommand command;
+  command.type = DrawCommand::TypeMaskedSprite;
+  command.x = lx;
+  command.y = ly;
+  command.res = res;
+  command.index = index;
+  command.mask_res = mask_res;
+  command.mask_index = mask_index;
+  recording->push_back(std::move(command));
+}
+
+void
+Viewport::draw_number(int lx, int ly, int value, const Color &color) {
+  if (recording == nullptr) {
+    frame->draw_number(lx, ly, value, color);
+    return;
+  }
+
+  DrawCommand command;
+  command.type = DrawCommand::TypeNumber;
+  command.x = lx;
+  command.y = ly;
+  command.color = color;
+  command.number = value;
+
+  int chars = (value <= 0) ? 1 : 0;
+  for (int rest = value; rest != 0; rest /= 10) {
+    chars++;
+  }
+  record(&command, lx, ly, 8*chars, 8);
+}
+
+void
+Viewport::draw_string(int lx, int ly, const std::string &str,
+                      const Color &color) {
+  if (recording == nullptr) {
+    frame->draw_string(lx, ly, str, color);
+    return;
+  }
+
+  DrawCommand command;
+  command.type = DrawCommand::TypeString;
+  command.x = lx;
+  command.y = ly;
+  command.color = color;
+  command.text = str;
+
+  /* Same layout as Frame::draw_string() */
+  int cols = 0;
+  int max_cols = 0;
+  int lines = 1;
+  for (char c : str) {
+    if (c == '\t') {
+      cols += 2;
+    } else if (c == '\n') {
+      lines++;
+      cols = 0;
+    } else {
+      cols++;
+    }
+    max_cols = std::max(max_cols, cols);
+  }
+  record(&command, lx, ly, 8*max_cols, 8*lines);
+}
+
 void
 Viewport::draw_game_sprite(int lx, int ly, int index) {
-  frame->draw_sprite(lx, ly, Data::AssetGameObject, index-1, true);
+  draw_sprite(lx, ly, Data::AssetGameObject, index-1, true);
 }
 
 void
 Viewport::draw_serf(int lx, int ly, const Color &color, int head, int body) {
-  frame->draw_sprite(lx, ly, Data::AssetSerfTorso, body, true, color);
+  draw_sprite(lx, ly, Data::AssetSerfTorso, body, true, color);
 
   if (head >= 0) {
-    frame->draw_sprite_relatively(lx, ly, Data::AssetSerfHead, head,
-                                  Data::AssetSerfTorso, body);
+    draw_sprite_relatively(lx, ly, Data::AssetSerfHead, head,
+                           Data::AssetSerfTorso, body);
   }
 }
 
 void
 Viewport::draw_shadow_and_building_sprite(int lx, int ly, int index,
                                           const Color &color) {
-  frame->draw_sprite(lx, ly, Data::AssetMapShadow, index, true);
-  frame->draw_sprite(lx, ly, Data::AssetMapObject, index, true, color);
+  draw_sprite(lx, ly, Data::AssetMapShadow, index, true);
+  draw_sprite(lx, ly, Data::AssetMapObject, index, true, color);
 }
 
 void
 Viewport::draw_shadow_and_building_unfinished(int lx, int ly, int index,
                                               int progress) {
   float p = static_cast<float>(progress) / static_cast<float>(0xFFFF);
-  frame->draw_sprite(lx, ly, Data::AssetMapShadow, index, true, p);
-  frame->draw_sprite(lx, ly, Data::AssetMapObject, index, true, p);
+  draw_sprite(lx, ly, Data::AssetMapShadow, index, true, Color::transparent,
+              p);
+  draw_sprite(lx, ly, Data::AssetMapObject, index, true, Color::transparent,
+              p);
 }
 
 static const int map_building_frame_sprite[] = {
@@ -1157,14 +2334,14 @@ Viewport::draw_water_waves(MapPos pos, int lx, int ly) {
 
   if (map->type_down(pos) <= Map::TerrainWater3 &&
       map->type_up(pos) <= Map::TerrainWater3) {
-    frame->draw_waves_sprite(lx - 16, ly, Data::AssetNone, 0,
-                             Data::AssetMapWaves, sprite);
+    draw_masked_sprite(lx - 16, ly, Data::AssetNone, 0,
+                       Data::AssetMapWaves, sprite);
   } else if (map->type_down(pos) <= Map::TerrainWater3) {
-    frame->draw_waves_sprite(lx, ly + 16, Data::AssetMapMaskDown, 40,
-                             Data::AssetMapWaves, sprite);
+    draw_masked_sprite(lx, ly + 16, Data::AssetMapMaskDown, 40,
+                       Data::AssetMapWaves, sprite);
   } else {
-    frame->draw_waves_sprite(lx - 16, ly, Data::AssetMapMaskUp, 40,
-                             Data::AssetMapWaves, sprite);
+    draw_masked_sprite(lx - 16, ly, Data::AssetMapMaskUp, 40,
+                       Data::AssetMapWaves, sprite);
   }
 }
 
@@ -1333,7 +2510,7 @@ Viewport::draw_row_serf(int lx, int ly, bool shadow, const Color &color,
 
   /* Shadow */
   if (shadow) {
-    frame->draw_sprite(lx, ly, Data::AssetSerfShadow, 0, true);
+    draw_sprite(lx, ly, Data::AssetSerfShadow, 0, true);
   }
 
   int hi = ((body >> 8) & 0xff) * 2;
@@ -1887,8 +3064,8 @@ Viewport::draw_active_serf(Serf *serf, MapPos pos, int x_base, int y_base) {
     Color color = interface->get_player_color(serf->get_owner());
     draw_row_serf(lx, ly, true, color, body);
     if (layers & Layer::LayerGrid) {
-      frame->draw_number(lx, ly, serf->get_index(), Color(0, 0, 128));
-      frame->draw_string(lx, ly + 8, serf->print_state(),  Color(0, 0, 128));
+      draw_number(lx, ly, serf->get_index(), Color(0, 0, 128));
+      draw_string(lx, ly + 8, serf->print_state(),  Color(0, 0, 128));
     }
   }
 
@@ -2114,6 +3291,45 @@ Viewport::draw_game_objects(int layers_) {
   }
 }
 
+/* Record the game objects of the current view into snapshot. */
+void
+Viewport::capture_objects(ObjectsSnapshot *snapshot) {
+  snapshot->commands.clear();
+  snapshot->captured = true;
+  snapshot->measured = false;
+  snapshot->offset_x = offset_x;
+  snapshot->offset_y = offset_y;
+  snapshot->width = width;
+  snapshot->height = height;
+  snapshot->layers = layers;
+  snapshot->tick = interface->get_game()->get_tick();
+
+  recording = &snapshot->commands;
+  draw_game_objects(layers);
+  recording = nullptr;
+}
+
+/* Objects of the latest tick, recorded again here when the view or the game
+   changed since the simulation recorded them. */
+Viewport::ObjectsSnapshot *
+Viewport::get_objects() {
+  objects.take();
+  ObjectsSnapshot *snapshot = objects.get_front();
+  if (objects_outdated || !snapshot->captured ||
+      snapshot->offset_x != offset_x || snapshot->offset_y != offset_y ||
+      snapshot->width != width || snapshot->height != height ||
+      snapshot->layers != layers ||
+      snapshot->tick != interface->get_game()->get_tick()) {
+    capture_objects(snapshot);
+    objects_outdated = false;
+  }
+  if (!snapshot->measured) {
+    measure(&snapshot->commands);
+    snapshot->measured = true;
+  }
+  return snapshot;
+}
+
 void
 Viewport::draw_map_cursor_sprite(MapPos pos, int sprite) {
   int sx, sy;
@@ -2128,7 +3344,8 @@ Viewport::draw_map_cursor_possible_build() {
   int y_off = 0;
   MapPos base_pos = get_offset(&x_off, &y_off);
 
-  PGame game = interface->get_game();
+  MapBuildability *buildability = interface->get_game()->get_buildability();
+  const Player *player = interface->get_player();
 
   for (int x_base = x_off; x_base < width + MAP_TILE_WIDTH;
        x_base += MAP_TILE_WIDTH) {
@@ -2149,20 +3366,19 @@ Viewport::draw_map_cursor_possible_build() {
 
       /* Draw possible building */
       int sprite = -1;
-      if (game->can_build_castle(pos, interface->get_player())) {
-        sprite = 50;
-      } else if (game->can_player_build(pos, interface->get_player()) &&
-                 Map::map_space_from_obj[map->get_obj(pos)] == Map::SpaceOpen &&
-                 (game->can_build_flag(map->move_down_right(pos),
-                                       interface->get_player()) ||
-                 map->has_flag(map->move_down_right(pos)))) {
-        if (game->can_build_mine(pos)) {
-          sprite = 48;
-        } else if (game->can_build_large(pos)) {
+      switch (buildability->get(pos, player)) {
+        case MapBuildability::BuildabilityCastle:
+        case MapBuildability::BuildabilityLarge:
           sprite = 50;
-        } else if (game->can_build_small(pos)) {
+          break;
+        case MapBuildability::BuildabilityMine:
+          sprite = 48;
+          break;
+        case MapBuildability::BuildabilitySmall:
           sprite = 49;
-        }
+          break;
+        default:
+          break;
       }
 
       if (sprite >= 0) {
@@ -2269,10 +3485,29 @@ Viewport::draw_height_grid_overlay(const Color &color) {
   }
 }
 
+/* Draw the layers that are kept in the background frame, for the part of
+   the screen from left,top to right,bottom. Parts are drawn with a margin
+   in the compose frame, as if the viewport was that large, and then copied
+   without the margin. */
 void
-Viewport::internal_draw() {
-  if (map == NULL) {
-    return;
+Viewport::draw_background(int left, int top, int right, int bottom) {
+  Frame *screen = frame;
+  int screen_width = width;
+  int screen_height = height;
+  int screen_offset_x = offset_x;
+  int screen_offset_y = offset_y;
+
+  bool whole = (left <= 0 && top <= 0 &&
+                right >= screen_width && bottom >= screen_height);
+  if (whole) {
+    frame = background.get();
+  } else {
+    frame = compose_frame.get();
+    width = right - left + 2*BACKGROUND_MARGIN_X;
+    height = bottom - top + 2*BACKGROUND_MARGIN_Y;
+    offset_x += left - BACKGROUND_MARGIN_X;
+    offset_y += top - BACKGROUND_MARGIN_Y;
+    wrap_offset(&offset_x, &offset_y);
   }
 
   if (layers & LayerLandscape) {
@@ -2285,10 +3520,339 @@ Viewport::internal_draw() {
   if (layers & LayerPaths) {
     draw_paths_and_borders();
   }
-  draw_game_objects(layers);
+
+  frame = screen;
+  width = screen_width;
+  height = screen_height;
+  offset_x = screen_offset_x;
+  offset_y = screen_offset_y;
+
+  if (!whole) {
+    background->draw_frame(left, top, BACKGROUND_MARGIN_X,
+                           BACKGROUND_MARGIN_Y, compose_frame.get(),
+                           right - left, bottom - top);
+  }
+}
+
+/* Add the screen area where the landscape or paths around a map position
+   are drawn to the part of the background to draw again. */
+void
+Viewport::mark_background_dirty(MapPos pos) {
+  if (!background_valid) return;
+
+  int lwidth = map->get_cols()*MAP_TILE_WIDTH;
+  int lheight = map->get_rows()*MAP_TILE_HEIGHT;
+
+  int mx, my;
+  map_pix_from_map_coord(pos, 0, &mx, &my);
+  int sx, sy;
+  screen_pix_from_map_pix(mx, my, &sx, &sy);
+
+  /* Positions just above the screen reach into it. */
+  if (sy >= lheight - 2*MAP_TILE_HEIGHT) {
+    sy -= lheight;
+    sx += (map->get_rows()*MAP_TILE_WIDTH)/2;
+    while (sx >= lwidth) sx -= lwidth;
+  }
+  if (sx >= lwidth - MAP_TILE_WIDTH) sx -= lwidth;
+
+  int left = std::max(sx - MAP_TILE_WIDTH, 0);
+  int top = std::max(sy - 2*MAP_TILE_HEIGHT - 4*MAP_MAX_HEIGHT, 0);
+  int right = std::min(sx + MAP_TILE_WIDTH, width);
+  int bottom = std::min(sy + 2*MAP_TILE_HEIGHT, height);
+  if (left >= right || top >= bottom) return;
+
+  DirtyArea &area = background_dirty;
+  if (area.left >= area.right) {
+    area.left = left;
+    area.top = top;
+    area.right = right;
+    area.bottom = bottom;
+  } else {
+    area.left = std::min(area.left, left);
+    area.top = std::min(area.top, top);
+    area.right = std::max(area.right, right);
+    area.bottom = std::max(area.bottom, bottom);
+  }
+
+  set_redraw();
+}
+
+/* Mark the screen cells touching the area to be composed again. Cells of
+   views reduced 2^level times are in reduced pixels, the area is widened by
+   a reduced pixel to cover rounding of reduced sprite positions. */
+void
+Viewport::mark_screen_dirty(int left, int top, int right, int bottom,
+                            unsigned int level) {
+  int cells_width = width;
+  int cells_height = height;
+  if (level > 0) {
+    int scale = 1 << level;
+    cells_width = (width + scale - 1) >> level;
+    cells_height = (height + scale - 1) >> level;
+    left = reduce_position(left, level) - 1;
+    top = reduce_position(top, level) - 1;
+    right = reduce_position(right - 1, level) + 2;
+    bottom = reduce_position(bottom - 1, level) + 2;
+  }
+
+  left = std::max(left, 0);
+  top = std::max(top, 0);
+  right = std::min(right, cells_width);
+  bottom = std::min(bottom, cells_height);
+  if (left >= right || top >= bottom) return;
+
+  int cols = (cells_width + DIRTY_CELL_SIZE - 1) / DIRTY_CELL_SIZE;
+  for (int r = top / DIRTY_CELL_SIZE; r*DIRTY_CELL_SIZE < bottom; r++) {
+    for (int c = left / DIRTY_CELL_SIZE; c*DIRTY_CELL_SIZE < right; c++) {
+      dirty_cells[r*cols + c] = true;
+    }
+  }
+}
+
+/* Compose runs of dirty cells in each row of cells from the background and
+   the recorded commands reaching into them. Reduced views are composed from
+   the reduced background and enlarged to the frame. */
+void
+Viewport::compose_dirty_cells(unsigned int level) {
+  int scale = 1 << level;
+  int cells_width = (width + scale - 1) >> level;
+  int cells_height = (height + scale - 1) >> level;
+  Frame *base = (level > 0) ? lod_background.get() : background.get();
+  Frame *target = (level > 0) ? lod_frame.get() : compose_frame.get();
+
+  int cols = (cells_width + DIRTY_CELL_SIZE - 1) / DIRTY_CELL_SIZE;
+  int rows = (cells_height + DIRTY_CELL_SIZE - 1) / DIRTY_CELL_SIZE;
+
+  for (int r = 0; r < rows; r++) {
+    int c = 0;
+    while (c < cols) {
+      if (!dirty_cells[r*cols + c]) {
+        c++;
+        continue;
+      }
+
+      int c_end = c;
+      while (c_end < cols && dirty_cells[r*cols + c_end]) {
+        dirty_cells[r*cols + c_end] = false;
+        c_end++;
+      }
+
+      int left = c*DIRTY_CELL_SIZE;
+      int top = r*DIRTY_CELL_SIZE;
+      int right = std::min(c_end*DIRTY_CELL_SIZE, cells_width);
+      int bottom = std::min(top + DIRTY_CELL_SIZE, cells_height);
+
+      /* Commands are measured in screen pixels. */
+      int margin = (level > 0) ? 1 : 0;
+      int screen_left = (left - margin)*scale;
+      int screen_top = (top - margin)*scale;
+      int screen_right = (right + margin)*scale;
+      int screen_bottom = (bottom + margin)*scale;
+
+      target->draw_frame(0, 0, left, top, base, right - left, bottom - top);
+      for (const DrawCommand &command : draw_list) {
+        if (command.right > screen_left && command.left < screen_right &&
+            command.bottom > screen_top && command.top < screen_bottom) {
+          play(command, target, -left*scale, -top*scale, level);
+        }
+      }
+      if (level > 0) {
+        frame->draw_frame_scaled(left*scale, top*scale, 0, 0, target,
+                                 right - left, bottom - top, scale);
+      } else {
+        frame->draw_frame(left, top, 0, 0, target, right - left,
+                          bottom - top);
+      }
+
+      redrawn_pixels += (right - left)*(bottom - top);
+      c = c_end;
+    }
+  }
+}
+
+/* Draw the recorded commands over the background, only where they differ
+   from the last frame unless the whole background was drawn. Views reduced
+   2^level times are composed reduced and enlarged to the frame. */
+void
+Viewport::compose(DrawList *commands, bool whole, unsigned int level) {
+  redrawn_pixels = 0;
+  if (whole && (level > 0)) {
+    int scale = 1 << level;
+    int lod_width = (width + scale - 1) >> level;
+    int lod_height = (height + scale - 1) >> level;
+    lod_frame->draw_frame(0, 0, 0, 0, lod_background.get(), lod_width,
+                          lod_height);
+    for (const DrawCommand &command : *commands) {
+      play(command, lod_frame.get(), 0, 0, level);
+    }
+    frame->draw_frame_scaled(0, 0, 0, 0, lod_frame.get(), lod_width,
+                             lod_height, scale);
+    std::fill(dirty_cells.begin(), dirty_cells.end(), false);
+    redrawn_pixels = lod_width*lod_height;
+  } else if (whole) {
+    frame->draw_frame(0, 0, 0, 0, background.get(), width, height);
+    for (const DrawCommand &command : *commands) {
+      play(command, frame, 0, 0);
+    }
+    std::fill(dirty_cells.begin(), dirty_cells.end(), false);
+    redrawn_pixels = width*height;
+  } else {
+    /* Commands of only one of the frames mark where the screen changed. */
+    std::vector<const DrawCommand*> last;
+    for (const DrawCommand &command : draw_list) last.push_back(&command);
+    std::vector<const DrawCommand*> next;
+    for (const DrawCommand &command : *commands) next.push_back(&command);
+
+    auto less = [](const DrawCommand *a, const DrawCommand *b) {
+      return *a < *b;
+    };
+    std::sort(last.begin(), last.end(), less);
+    std::sort(next.begin(), next.end(), less);
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < last.size() || j < next.size()) {
+      const DrawCommand *changed = nullptr;
+      if (j == next.size() || (i < last.size() && *last[i] < *next[j])) {
+        changed = last[i++];
+      } else if (i == last.size() || *next[j] < *last[i]) {
+        changed = next[j++];
+      } else {
+        i++;
+        j++;
+        continue;
+      }
+      mark_screen_dirty(changed->left, changed->top, changed->right,
+                        changed->bottom, level);
+    }
+  }
+
+  draw_list.swap(*commands);
+  if (!whole) {
+    compose_dirty_cells(level);
+  }
+}
+
+void
+Viewport::internal_draw() {
+  if (map == NULL) {
+    return;
+  }
+
+  apply_map_changes();
+
+  unsigned int level = get_lod_level();
+  if ((level > 0) && (layers & LayerLandscape)) {
+    draw_lod(level);
+    return;
+  }
+
+  /* Background and cells of the reduced view are of no use at full size. */
+  if (lod_level != 0) {
+    lod_background.reset();
+    lod_frame.reset();
+    lod_level = 0;
+    background_valid = false;
+    draw_list.clear();
+  }
+
+  /* Without landscape there is nothing to compose the other layers on, as
+     whatever is behind the viewport shows through. */
+  if (!(layers & LayerLandscape)) {
+    if (layers & LayerGrid) {
+      draw_base_grid_overlay(Color(0xcf, 0x63, 0x63));
+      draw_height_grid_overlay(Color(0xef, 0xef, 0x8f));
+    }
+    if (layers & LayerPaths) {
+      draw_paths_and_borders();
+      draw_building_road();
+    }
+    draw_game_objects(layers);
+    if (layers & LayerCursor) {
+      draw_map_cursor();
+    }
+
+    background_valid = false;
+    draw_list.clear();
+    redrawn_pixels = width*height;
+    return;
+  }
+
+  if (!background) {
+    background.reset(Graphics::get_instance().create_frame(width, height));
+    compose_frame.reset(Graphics::get_instance().create_frame(width,
+                                                              height));
+    background_valid = false;
+  }
+
+  int cols = (width + DIRTY_CELL_SIZE - 1) / DIRTY_CELL_SIZE;
+  int rows = (height + DIRTY_CELL_SIZE - 1) / DIRTY_CELL_SIZE;
+  dirty_cells.resize(cols*rows, false);
+
+  /* Changed parts of the background, unless they are too large to be
+     drawn with the margin. */
+  bool whole = !background_valid;
+  DirtyArea &area = background_dirty;
+  if (!whole && area.left < area.right) {
+    if (area.right - area.left + 2*BACKGROUND_MARGIN_X > width ||
+        area.bottom - area.top + 2*BACKGROUND_MARGIN_Y > height) {
+      whole = true;
+    } else {
+      draw_background(area.left, area.top, area.right, area.bottom);
+      mark_screen_dirty(area.left, area.top, area.right, area.bottom);
+    }
+  }
+  if (whole) {
+    draw_background(0, 0, width, height);
+  }
+  background_valid = true;
+  area = DirtyArea();
+
+  DrawList commands;
+  recording = &commands;
+  if (layers & LayerPaths) {
+    draw_building_road();
+  }
+  recording = nullptr;
+  measure(&commands);
+
+  const DrawList &objects_commands = get_objects()->commands;
+  commands.insert(commands.end(), objects_commands.begin(),
+                  objects_commands.end());
+
   if (layers & LayerCursor) {
+    DrawList cursor;
+    recording = &cursor;
     draw_map_cursor();
+    recording = nullptr;
+    measure(&cursor);
+    commands.insert(commands.end(), cursor.begin(), cursor.end());
+  }
+
+  {
+    /* Composing does not need the game, the simulation goes on meanwhile.
+       Map changes it reports are queued until the next update or draw. */
+    Simulation::Unlock unlock(interface->get_simulation());
+    compose(&commands, whole);
   }
+
+  Log::Verbose["viewport"] << "redrawn pixels: " << redrawn_pixels;
+
+  prefetch_tiles();
+}
+
+
+void
+Viewport::layout() {
+  background.reset();
+  compose_frame.reset();
+  lod_background.reset();
+  lod_frame.reset();
+  lod_level = 0;
+  background_valid = false;
+  draw_list.clear();
+  dirty_cells.clear();
 }
 
 bool
@@ -2501,7 +4065,18 @@ Viewport::handle_drag(int lx, int ly) {
 }
 
 Viewport::Viewport(Interface *_interface, PMap _map)
-  : interface(_interface)
+  : landscape_tiles(LANDSCAPE_TILES_MEMORY)
+  , lod_tiles(LOD_TILES_MEMORY)
+  , lod_level(0)
+  , prefetch_generation(0)
+  , prefetch_offset_x(0)
+  , prefetch_offset_y(0)
+  , recording(nullptr)
+  , objects_outdated(true)
+  , background_valid(false)
+  , background_dirty()
+  , redrawn_pixels(0)
+  , interface(_interface)
   , map(_map) {
   map->add_change_handler(this);
   layers = LayerAll;
@@ -2520,16 +4095,56 @@ Viewport::~Viewport() {
 
 void
 Viewport::on_height_changed(MapPos pos) {
-  redraw_map_pos(pos);
+  report_map_change(pos, MapChangeHeight);
 }
 
 void
 Viewport::on_object_changed(MapPos pos) {
-  if (interface->get_map_cursor_pos() == pos) {
-    interface->update_map_cursor_pos(pos);
+  report_map_change(pos, MapChangeObject);
+}
+
+void
+Viewport::on_owner_changed(MapPos pos) {
+  report_map_change(pos, MapChangeObject);
+}
+
+void
+Viewport::report_map_change(MapPos pos, MapChange change) {
+  std::unique_lock<std::mutex> lock(map_changes_mutex);
+  map_changes.push_back(std::make_pair(pos, change));
+}
+
+/* Mark what the reported map changes touch for drawing again. Called by the
+   interface while the game is locked. */
+void
+Viewport::apply_map_changes() {
+  MapChanges changes;
+  {
+    std::unique_lock<std::mutex> lock(map_changes_mutex);
+    changes.swap(map_changes);
+  }
+
+  for (const auto &change : changes) {
+    MapPos pos = change.first;
+    if (change.second == MapChangeHeight) {
+      redraw_map_pos(pos);
+      continue;
+    }
+    if (layers & LayerPaths) {
+      mark_background_dirty(pos);
+    }
+    if (interface->get_map_cursor_pos() == pos) {
+      interface->update_map_cursor_pos(pos);
+    }
   }
 }
 
+void
+Viewport::on_game_updated() {
+  capture_objects(objects.get_back());
+  objects.publish();
+}
+
 /* Space transformations. */
 /* The game world space is a three dimensional space with the axes
    named "column", "row" and "height". The (column, row) coordinate
@@ -2686,36 +4301,45 @@ Viewport::move_to_map_pos(MapPos pos) {
 
   offset_x = mx;
   offset_y = my;
+  background_valid = false;
 
   set_redraw();
 }
 
 void
 Viewport::move_by_pixels(int lx, int ly) {
-  int lwidth = map->get_cols() * MAP_TILE_WIDTH;
-  int lheight = map->get_rows() * MAP_TILE_HEIGHT;
-
   offset_x += lx;
   offset_y += ly;
-
-  if (offset_y < 0) {
-    offset_y += lheight;
-    offset_x -= (map->get_rows()*MAP_TILE_WIDTH)/2;
-  } else if (offset_y >= lheight) {
-    offset_y -= lheight;
-    offset_x += (map->get_rows()*MAP_TILE_WIDTH)/2;
-  }
-
-  if (offset_x >= lwidth) offset_x -= lwidth;
-  else if (offset_x < 0) offset_x += lwidth;
+  wrap_offset(&offset_x, &offset_y);
+  background_valid = false;
 
   set_redraw();
 }
 
+/* Bring map pixel offset that was moved off the map back onto it. */
+void
+Viewport::wrap_offset(int *x, int *y) const {
+  int lwidth = map->get_cols() * MAP_TILE_WIDTH;
+  int lheight = map->get_rows() * MAP_TILE_HEIGHT;
+
+  while (*y < 0) {
+    *y += lheight;
+    *x -= (map->get_rows()*MAP_TILE_WIDTH)/2;
+  }
+  while (*y >= lheight) {
+    *y -= lheight;
+    *x += (map->get_rows()*MAP_TILE_WIDTH)/2;
+  }
+
+  while (*x >= lwidth) *x -= lwidth;
+  while (*x < 0) *x += lwidth;
+}
 
 /* Called periodically when the game progresses. */
 void
 Viewport::update() {
+  apply_map_changes();
+
   int tick_xor = interface->get_game()->get_tick() ^ last_tick;
   last_tick = interface->get_game()->get_tick();
 
@@ -22,17 +22,26 @@
 #ifndef SRC_VIEWPORT_H_
 #define SRC_VIEWPORT_H_
 
-#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "src/gui.h"
+#include "src/lru-cache.h"
 #include "src/map.h"
 #include "src/building.h"
+#include "src/simulation.h"
+#include "src/snapshot-buffer.h"
 
 class Interface;
 class DataSource;
+class LandscapePrefetch;
 
-class Viewport : public GuiObject, public Map::Handler {
+class Viewport : public GuiObject, public Map::Handler,
+                 public Simulation::Handler {
  public:
   typedef enum Layer {
     LayerLandscape = 1<<0,
@@ -51,8 +60,113 @@ class Viewport : public GuiObject, public Map::Handler {
 
  protected:
   /* Cache prerendered tiles of the landscape. */
-  typedef std::map<unsigned int, std::unique_ptr<Frame>> TilesMap;
-  TilesMap landscape_tiles;
+  typedef LruCache<unsigned int, Frame> TilesCache;
+  TilesCache landscape_tiles;
+
+  /* Parts of cached tiles to render again, in tile pixels. */
+  class DirtyArea {
+   public:
+    int left, top, right, bottom;
+  };
+  typedef std::unordered_map<unsigned int, DirtyArea> DirtyTiles;
+  DirtyTiles dirty_tiles;
+  std::unique_ptr<Frame> patch_frame;
+
+  /* Far zoomed out views are drawn reduced 2^level times from reduced
+     tiles and sprites, then enlarged to the frame. The reduced background
+     is kept like the full size one, level 0 while drawing at full size. */
+  TilesCache lod_tiles;
+  std::unique_ptr<Frame> lod_background;
+  std::unique_ptr<Frame> lod_frame;
+  unsigned int lod_level;
+
+  /* Tiles ahead of the scroll direction drawn by background tasks,
+     generation of the request by tile. */
+  std::shared_ptr<LandscapePrefetch> prefetch;
+  typedef std::unordered_map<unsigned int, unsigned int> PrefetchPending;
+  PrefetchPending prefetch_pending;
+  unsigned int prefetch_generation;
+  int prefetch_offset_x, prefetch_offset_y;
+
+  /* Sprites of the animated layers, recorded while drawing so that only
+     the areas where they changed since the last frame are composed again
+     over the cached background of landscape, grid and paths. */
+  class DrawCommand {
+   public:
+    typedef enum Type {
+      TypeSprite,
+      TypeMaskedSprite,
+      TypeNumber,
+      TypeString,
+      TypeRelativeSprite,  /* Sprite placed relative to the one given by
+                              mask_res and mask_index, until measured */
+    } Type;
+
+    Type type;
+    int x, y;
+    Data::Resource res;
+    unsigned int index;
+    Data::Resource mask_res;
+    unsigned int mask_index;
+    bool use_off;
+    Color color;
+    float progress;
+    int number;
+    std::string text;
+    /* Covered area in screen pixels, sprites are measured on the thread
+       that draws them */
+    int left, top, right, bottom;
+
+    DrawCommand()
+      : type(TypeSprite), x(0), y(0), res(Data::AssetNone), index(0)
+      , mask_res(Data::AssetNone), mask_index(0), use_off(false)
+      , progress(1.f), number(0), left(0), top(0), right(0), bottom(0) {}
+
+    bool operator<(const DrawCommand &other) const;
+    bool operator==(const DrawCommand &other) const;
+  };
+  typedef std::vector<DrawCommand> DrawList;
+
+  DrawList draw_list;
+  DrawList *recording;
+
+  /* Game objects and serfs as recorded for one tick and view. They are
+     recorded on the simulation thread at the end of every tick and taken
+     by the drawing without waiting for the game. */
+  class ObjectsSnapshot {
+   public:
+    DrawList commands;
+    bool captured;
+    bool measured;
+    int offset_x, offset_y;
+    int width, height;
+    unsigned int layers;
+    unsigned int tick;
+
+    ObjectsSnapshot()
+      : captured(false), measured(false), offset_x(0), offset_y(0)
+      , width(0), height(0), layers(0), tick(0) {}
+  };
+  SnapshotBuffer<ObjectsSnapshot> objects;
+  bool objects_outdated;
+
+  /* Map changes reported by the game, on the simulation thread during
+     ticks. They are applied to the tiles, background and cursor by the
+     interface, so that the viewport can compose while the game goes on. */
+  typedef enum MapChange {
+    MapChangeHeight,
+    MapChangeObject,
+  } MapChange;
+  typedef std::vector<std::pair<MapPos, MapChange>> MapChanges;
+  std::mutex map_changes_mutex;
+  MapChanges map_changes;
+
+  std::unique_ptr<Frame> background;
+  std::unique_ptr<Frame> compose_frame;
+  bool background_valid;
+  DirtyArea background_dirty;
+  std::vector<bool> dirty_cells;
+  unsigned int redrawn_pixels;
 
   int offset_x, offset_y;
   unsigned int layers;
@@ -66,7 +180,10 @@ class Viewport : public GuiObject, public Map::Handler {
   Viewport(Interface *interface, PMap map);
   virtual ~Viewport();
 
-  void switch_layer(Layer layer) { layers ^= layer; }
+  void switch_layer(Layer layer) {
+    layers ^= layer;
+    background_valid = false;
+  }
 
   void move_to_map_pos(MapPos pos);
   void move_by_pixels(int x, int y);
@@ -78,22 +195,71 @@ class Viewport : public GuiObject, public Map::Handler {
   MapPos map_pos_from_screen_pix(int x, int y);
 
   void redraw_map_pos(MapPos pos);
+  void set_tile_cache_budget(size_t budget) {
+    landscape_tiles.set_memory_budget(budget); }
 
   void update();
 
+  /* Game changed outside of the simulation, objects are recorded again. */
+  void invalidate_objects() { objects_outdated = true; }
+
+  /* Number of pixels composed again by the last draw */
+  unsigned int get_redrawn_pixels() const { return redrawn_pixels; }
+
+  /* Draw the map area of the given size at map pixel x,y to memory, as
+     the viewport would show it with the given layers but without cursor.
+     The game is only read by the calling thread, parts of the area are
+     rasterised by the thread pool. */
+  Data::PSprite render_area(int x, int y, int area_width, int area_height,
+                            unsigned int area_layers);
+
+  /* Masked ground sprites that the landscape in view is drawn from, each
+     once. To be decoded ahead by Graphics::warm_up(). */
+  void get_ground_sprites(Graphics::MaskedSprites *sprites);
+
  protected:
-  void draw_triangle_up(int x, int y, int m, int left, int right, MapPos pos,
-                        Frame *frame);
-  void draw_triangle_down(int x, int y, int m, int left, int right,
-                          MapPos pos, Frame *frame);
-  void draw_up_tile_col(MapPos pos, int x_base, int y_base, int max_y,
-                        Frame *frame);
-  void draw_down_tile_col(MapPos pos, int x_base, int y_base, int max_y,
-                          Frame *frame);
+  void draw_tile(int tc, int tr, int left, int top, int w, int h,
+                 Frame *frame);
+  MapPos get_tile_pos(int tc, int tr);
+  void get_tiles_in_view(int x, int y, std::vector<unsigned int> *tiles);
+  void mark_tiles_dirty(int left, int top, int right, int bottom);
+  void redraw_dirty_tiles();
+  void prefetch_tiles();
+  void upload_prefetched_tiles();
   void draw_landscape();
+  unsigned int get_lod_level() const;
+  void draw_landscape_lod(unsigned int level, int lod_width, int lod_height);
+  void draw_lod(unsigned int level);
+  void draw_background(int left, int top, int right, int bottom);
+  void mark_background_dirty(MapPos pos);
+  void report_map_change(MapPos pos, MapChange change);
+  void apply_map_changes();
+  void mark_screen_dirty(int left, int top, int right, int bottom,
+                         unsigned int level = 0);
+  void compose_dirty_cells(unsigned int level = 0);
+  void compose(DrawList *commands, bool whole, unsigned int level = 0);
+  void wrap_offset(int *x, int *y) const;
+  void record(DrawCommand *command, int left, int top, int width,
+              int height);
+  void measure(DrawList *list);
+  void play(const DrawCommand &command, Frame *target, int x, int y,
+            unsigned int level = 0);
+  void draw_sprite(int x, int y, Data::Resource res, unsigned int index,
+                   bool use_off, const Color &color = Color::transparent,
+                   float progress = 1.f);
+  void draw_sprite_relatively(int x, int y, Data::Resource res,
+                              unsigned int index,
+                              Data::Resource relative_to_res,
+                              unsigned int relative_to_index);
+  void draw_masked_sprite(int x, int y, Data::Resource mask_res,
+                          unsigned int mask_index, Data::Resource res,
+                          unsigned int index);
+  void draw_number(int x, int y, int value, const Color &color);
+  void draw_string(int x, int y, const std::string &str, const Color &color);
   void draw_path_segment(int x, int y, MapPos pos, Direction dir);
   void draw_border_segment(int x, int y, MapPos pos, Direction dir);
   void draw_paths_and_borders();
+  void draw_building_road();
   void draw_game_sprite(int x, int y, int index);
   void draw_serf(int x, int y, const Color &color, int head, int body);
   void draw_shadow_and_building_sprite(int x, int y, int index,
@@ -116,6 +282,8 @@ class Viewport : public GuiObject, public Map::Handler {
   void draw_serf_row(MapPos pos, int y_base, int cols, int x_base);
   void draw_serf_row_behind(MapPos pos, int y_base, int cols, int x_base);
   void draw_game_objects(int layers);
+  void capture_objects(ObjectsSnapshot *snapshot);
+  ObjectsSnapshot *get_objects();
   void draw_map_cursor_sprite(MapPos pos, int sprite);
   void draw_map_cursor_possible_build();
   void draw_map_cursor();
@@ -133,8 +301,13 @@ class Viewport : public GuiObject, public Map::Handler {
   Frame *get_tile_frame(unsigned int tid, int tc, int tr);
 
  public:
+  /* Map::Handler, queues the change for the interface */
   virtual void on_height_changed(MapPos pos);
   virtual void on_object_changed(MapPos pos);
+  virtual void on_owner_changed(MapPos pos);
+
+  /* Simulation::Handler, called on the simulation thread */
+  virtual void on_game_updated();
 };
 
 #endif  // SRC_VIEWPORT_H_
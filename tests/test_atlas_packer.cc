@@ -0,0 +1,167 @@
+/*
+ * test_atlas_packer.cc - Atlas page placement tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "src/atlas-packer.h"
+
+class Placed {
+ public:
+  size_t page;
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// Images placed on a packer, checked to stay on their page and apart from
+// each other by the padding.
+class Atlas {
+ public:
+  AtlasPacker packer;
+  std::deque<Placed> placed;
+
+  Atlas(int page_size, int padding) : packer(page_size, padding) {}
+
+  bool add(int width, int height, bool add_pages) {
+    Placed image = { 0, 0, 0, width, height };
+    if (!packer.allocate(width, height, &image.page, &image.x, &image.y)) {
+      if (!add_pages) {
+        return false;
+      }
+      packer.add_page();
+      if (!packer.allocate(width, height, &image.page, &image.x,
+                           &image.y)) {
+        ADD_FAILURE() << "No room on a new page";
+        return false;
+      }
+    }
+    check(image);
+    placed.push_back(image);
+    return true;
+  }
+
+  void remove(size_t index) {
+    const Placed &image = placed[index];
+    packer.release(image.page, image.x, image.y, image.width, image.height);
+    placed.erase(placed.begin() + index);
+  }
+
+  void check(const Placed &image) const {
+    int size = packer.get_page_size();
+    EXPECT_GE(image.x, 0);
+    EXPECT_GE(image.y, 0);
+    EXPECT_LE(image.x + image.width + 1, size);
+    EXPECT_LE(image.y + image.height + 1, size);
+    for (const Placed &other : placed) {
+      if (other.page != image.page) continue;
+      bool apart = (image.x >= other.x + other.width + 1) ||
+                   (other.x >= image.x + image.width + 1) ||
+                   (image.y >= other.y + other.height + 1) ||
+                   (other.y >= image.y + image.height + 1);
+      EXPECT_TRUE(apart) << image.x << "," << image.y << " overlaps "
+                         << other.x << "," << other.y;
+    }
+  }
+};
+
+TEST(AtlasPacker, PlacesApart) {
+  std::mt19937 generator(1);
+  Atlas atlas(256, 1);
+  atlas.packer.add_page();
+  while (atlas.add(generator() % 40 + 1, generator() % 40 + 1, false)) {}
+  EXPECT_EQ(1u, atlas.packer.get_page_count());
+  EXPECT_GT(atlas.placed.size(), 30u);
+  EXPECT_EQ(atlas.placed.size(), atlas.packer.get_images(0));
+
+  EXPECT_FALSE(atlas.packer.fits(256, 10));
+  EXPECT_TRUE(atlas.packer.fits(255, 255));
+}
+
+TEST(AtlasPacker, ReusesReleasedSpace) {
+  Atlas atlas(64, 1);
+  atlas.packer.add_page();
+  while (atlas.add(15, 15, false)) {}
+  ASSERT_EQ(16u, atlas.placed.size());
+
+  // Two neighbours released make room for one twice as wide.
+  Placed first = atlas.placed[5];
+  atlas.remove(5);
+  atlas.remove(5);
+  EXPECT_TRUE(atlas.add(31, 15, false));
+  EXPECT_EQ(first.x, atlas.placed.back().x);
+  EXPECT_EQ(first.y, atlas.placed.back().y);
+  EXPECT_FALSE(atlas.add(15, 15, false));
+
+  // Emptied shelves at the bottom are taken by images of another height.
+  while (atlas.placed.size() > 4) atlas.remove(4);
+  EXPECT_TRUE(atlas.add(30, 40, false));
+  EXPECT_EQ(16, atlas.placed.back().y);
+
+  while (!atlas.placed.empty()) atlas.remove(0);
+  EXPECT_EQ(0u, atlas.packer.get_images(0));
+  EXPECT_EQ(0., atlas.packer.get_fill(0));
+  EXPECT_TRUE(atlas.add(63, 63, false));
+}
+
+// Images of cached strings and sprites come and go in least recently used
+// order while the amount of them stays the same, as with the image cache.
+TEST(AtlasPacker, KeepsPagesUnderChurn) {
+  std::mt19937 generator(2);
+  Atlas atlas(1024, 1);
+  size_t live_area = 0;
+  const size_t target_area = 1024 * 1024 * 3 / 2;
+  for (int i = 0; i < 100000; i++) {
+    int width;
+    int height;
+    if (generator() % 2) {
+      width = generator() % 200 + 8;   // String
+      height = 9;
+    } else {
+      width = generator() % 64 + 8;    // Sprite
+      height = generator() % 64 + 8;
+    }
+    atlas.add(width, height, true);
+    live_area += (width + 1) * (height + 1);
+    while (live_area > target_area) {
+      const Placed &image = atlas.placed.front();
+      live_area -= (image.width + 1) * (image.height + 1);
+      atlas.remove(0);
+    }
+  }
+
+  double fill = 0;
+  for (size_t page = 0; page < atlas.packer.get_page_count(); page++) {
+    fill += atlas.packer.get_fill(page);
+  }
+  fill /= atlas.packer.get_page_count();
+  RecordProperty("pages", static_cast<int>(atlas.packer.get_page_count()));
+  RecordProperty("fill_percent", static_cast<int>(fill * 100));
+  std::cout << "[ atlas ] " << atlas.packer.get_page_count()
+            << " pages, " << static_cast<int>(fill * 100) << "% filled"
+            << std::endl;
+  EXPECT_LE(atlas.packer.get_page_count(), 4u);
+}
@@ -0,0 +1,132 @@
+/*
+ * test_buffer.cc - Buffer tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/buffer.h"
+#include "src/debug.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+class MappedBufferTest : public ::testing::Test {
+ protected:
+  std::string path;
+  Bytes content;
+
+  virtual void SetUp() {
+    path = ::testing::TempDir() + "mapped_buffer_test";
+    for (size_t i = 0; i < 10000; i++) {
+      content.push_back(static_cast<uint8_t>(i * 7 + i / 256));
+    }
+    write_file(content);
+  }
+
+  virtual void TearDown() {
+    std::remove(path.c_str());
+  }
+
+  void write_file(const Bytes &bytes) {
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  }
+
+  Bytes read_file() {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    return Bytes((std::istreambuf_iterator<char>(file)),
+                 std::istreambuf_iterator<char>());
+  }
+
+  static Bytes get_bytes(PBuffer buffer) {
+    uint8_t *data = reinterpret_cast<uint8_t*>(buffer->get_data());
+    return Bytes(data, data + buffer->get_size());
+  }
+};
+
+TEST_F(MappedBufferTest, MapsFile) {
+  auto buffer = std::make_shared<MappedBuffer>(path, Buffer::EndianessBig);
+  EXPECT_TRUE(buffer->is_mapped());
+  ASSERT_EQ(content, get_bytes(buffer));
+
+  EXPECT_EQ((content[0] << 8) | content[1], buffer->pop<uint16_t>());
+  buffer->set_endianess(Buffer::EndianessLittle);
+  EXPECT_EQ((content[3] << 8) | content[2], buffer->pop<uint16_t>());
+}
+
+TEST_F(MappedBufferTest, FallsBackToReading) {
+  // Empty files can not be mapped.
+  write_file(Bytes());
+  auto buffer = std::make_shared<MappedBuffer>(path);
+  EXPECT_FALSE(buffer->is_mapped());
+  EXPECT_EQ(0u, buffer->get_size());
+  EXPECT_FALSE(buffer->readable());
+  ::free(buffer->unfix());
+
+  std::remove(path.c_str());
+  EXPECT_THROW(MappedBuffer missing(path), ExceptionFreeserf);
+}
+
+TEST_F(MappedBufferTest, ViewsMapping) {
+  auto buffer = std::make_shared<MappedBuffer>(path);
+  uint8_t *data = reinterpret_cast<uint8_t*>(buffer->get_data());
+
+  PBuffer sub = buffer->get_subbuffer(100, 1000);
+  EXPECT_EQ(data + 100, sub->get_data());
+  EXPECT_EQ(Bytes(content.begin() + 100, content.begin() + 1100),
+            get_bytes(sub));
+
+  buffer->pop(10);
+  PBuffer popped = buffer->pop(20);
+  EXPECT_EQ(data + 10, popped->get_data());
+  PBuffer tail = buffer->pop_tail();
+  EXPECT_EQ(Bytes(content.begin() + 30, content.end()), get_bytes(tail));
+
+  // Views keep the mapping alive.
+  buffer.reset();
+  EXPECT_EQ(Bytes(content.begin() + 10, content.begin() + 30),
+            get_bytes(popped));
+
+  // Mapping is private, writes never reach the file.
+  reinterpret_cast<uint8_t*>(sub->get_data())[0] ^= 0xFF;
+  EXPECT_EQ(content, read_file());
+}
+
+TEST_F(MappedBufferTest, UnfixCopiesData) {
+  MappedBuffer buffer(path);
+  ASSERT_TRUE(buffer.is_mapped());
+  uint8_t *data = reinterpret_cast<uint8_t*>(buffer.unfix());
+  ASSERT_NE(nullptr, data);
+  EXPECT_EQ(content, Bytes(data, data + content.size()));
+  EXPECT_FALSE(buffer.is_mapped());
+  EXPECT_EQ(0u, buffer.get_size());
+  EXPECT_EQ(nullptr, buffer.get_data());
+
+  // The copy belongs to the caller and outlives the buffer.
+  data[0] ^= 0xFF;
+  ::free(data);
+}
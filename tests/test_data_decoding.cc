@@ -0,0 +1,211 @@
+/*
+ * test_data_decoding.cc - original game data decoding benchmark
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "src/data-source-amiga.h"
+#include "src/data-source-dos.h"
+#include "src/debug.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// The original game data is not distributed with the sources, the tests
+// look for it in the directory given by FREESERF_DATA_PATH.
+static std::string
+get_data_path() {
+  const char *path = std::getenv("FREESERF_DATA_PATH");
+  return (path != nullptr) ? path : ".";
+}
+
+// Gives the tests access to the unpacking and the bitplane conversion of
+// the decoders.
+class AmigaDecoder : public DataSourceAmiga {
+ public:
+  AmigaDecoder() : DataSourceAmiga(get_data_path()) {}
+
+  using DataSourceAmiga::unpack;
+  using DataSourceAmiga::planar_to_chunky;
+};
+
+// Color indices of planned sprite data, decoded one bit at a time as the
+// decoders did before planar_to_chunky.
+static std::vector<uint8_t>
+decode_bit_by_bit(const uint8_t *src, size_t bps, uint8_t compression,
+                  uint8_t filling) {
+  std::vector<uint8_t> indices;
+  for (size_t i = 0; i < bps; i++) {
+    for (int k = 7; k >= 0; k--) {
+      uint8_t color = 0;
+      int n = 0;
+      for (size_t b = 0; b < 5; b++) {
+        color = color << 1;
+        if ((compression >> b) & 0x01) {
+          if ((filling >> b) & 0x01) {
+            color |= 0x01;
+          }
+        } else {
+          color |= ((*(src+(n*bps)) >> k) & 0x01);
+          n++;
+        }
+      }
+      indices.push_back(color);
+    }
+    src++;
+  }
+  return indices;
+}
+
+static double
+get_elapsed_ms(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double, std::milli> elapsed =
+                                      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Load the source and decode every sprite it has, as the game does on the
+// way to the first frame without an asset pack.
+static void
+decode_all(Data::PSource source) {
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(source->load());
+  double load_ms = get_elapsed_ms(start);
+
+  start = std::chrono::steady_clock::now();
+  size_t sprites = 0;
+  size_t pixels = 0;
+  for (int r = Data::AssetArtLandscape; r <= Data::AssetCursor; r++) {
+    Data::Resource res = static_cast<Data::Resource>(r);
+    if (Data::get_resource_type(res) != Data::TypeSprite) continue;
+    for (size_t i = 0; i < Data::get_resource_count(res); i++) {
+      Data::MaskImage parts = source->get_sprite_parts(res, i);
+      for (Data::PSprite sprite : {std::get<0>(parts), std::get<1>(parts)}) {
+        if (sprite) {
+          sprites++;
+          pixels += sprite->get_width() * sprite->get_height();
+        }
+      }
+    }
+  }
+  double decode_ms = get_elapsed_ms(start);
+
+  ::testing::Test::RecordProperty("load_us",
+                                  static_cast<int>(load_ms * 1000));
+  ::testing::Test::RecordProperty("decode_us",
+                                  static_cast<int>(decode_ms * 1000));
+  ::testing::Test::RecordProperty("pixels", static_cast<int>(pixels));
+  std::cout << "[ " << source->get_name() << " ] load " << load_ms
+            << " ms, " << sprites << " sprites with " << pixels
+            << " pixels decoded in " << decode_ms << " ms" << std::endl;
+}
+
+TEST(DataDecoding, Amiga) {
+  Data::PSource source = std::make_shared<DataSourceAmiga>(get_data_path());
+  if (!source->check()) {
+    GTEST_SKIP() << "No Amiga data in '" << get_data_path() << "'";
+  }
+  decode_all(source);
+}
+
+TEST(DataDecoding, DOS) {
+  Data::PSource source = std::make_shared<DataSourceDOS>(get_data_path());
+  if (!source->check()) {
+    GTEST_SKIP() << "No DOS data in '" << get_data_path() << "'";
+  }
+  decode_all(source);
+}
+
+TEST(DataDecoding, PlanarToChunky) {
+  Data::Sprite::Color colors[32];
+  for (uint8_t index = 0; index < 32; index++) {
+    colors[index].red = index;
+    colors[index].green = static_cast<uint8_t>(index * 7);
+    colors[index].blue = 0;
+    colors[index].alpha = 0xFF;
+  }
+
+  std::mt19937 generator(1);
+  for (size_t width : {1, 2, 3, 5, 8, 40}) {
+    for (size_t height : {1, 7, 16}) {
+      uint8_t compression = generator() & 0x1F;
+      uint8_t filling = generator() & 0x1F;
+      size_t bps = width * height;
+      std::vector<uint8_t> data(bps * 5);
+      for (uint8_t &byte : data) {
+        byte = static_cast<uint8_t>(generator());
+      }
+
+      const uint8_t *planes[5];
+      unsigned int shifts[5];
+      size_t count = 0;
+      uint8_t constant = 0;
+      for (unsigned int b = 0; b < 5; b++) {
+        if ((compression >> b) & 0x01) {
+          if ((filling >> b) & 0x01) {
+            constant |= 0x10 >> b;
+          }
+        } else {
+          planes[count] = data.data() + count * bps;
+          shifts[count++] = 4 - b;
+        }
+      }
+
+      std::vector<Data::Sprite::Color> res(bps * 8);
+      AmigaDecoder::planar_to_chunky(planes, shifts, count, constant, colors,
+                                     bps, res.data());
+
+      std::vector<uint8_t> expected = decode_bit_by_bit(data.data(), bps,
+                                                        compression, filling);
+      ASSERT_EQ(expected.size(), res.size());
+      for (size_t i = 0; i < res.size(); i++) {
+        ASSERT_EQ(expected[i], res[i].red) << "width " << width
+                                           << ", height " << height
+                                           << ", pixel " << i;
+        ASSERT_EQ(colors[expected[i]].green, res[i].green);
+      }
+    }
+  }
+}
+
+TEST(DataDecoding, UnpacksRuns) {
+  AmigaDecoder decoder;
+  Bytes packed = { 0xAA, 0x01, 0xAA, 0x03, 0x07, 0x02 };
+  PBuffer result = decoder.unpack(std::make_shared<Buffer>(packed.data(),
+                                                           packed.size()));
+  uint8_t *data = reinterpret_cast<uint8_t*>(result->get_data());
+  EXPECT_EQ(Bytes({ 0x01, 0x07, 0x07, 0x07, 0x07, 0x02 }),
+            Bytes(data, data + result->get_size()));
+
+  // Run markers cut off by the end of data.
+  for (size_t size : {3, 4}) {
+    EXPECT_THROW(decoder.unpack(std::make_shared<Buffer>(packed.data(),
+                                                         size)),
+                 ExceptionFreeserf) << size << " bytes";
+  }
+}
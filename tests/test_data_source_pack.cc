@@ -0,0 +1,242 @@
+/*
+ * test_data_source_pack.cc - asset pack round trip tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "src/buffer.h"
+#include "src/data-source-pack.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Source with small generated sprites, every odd one with a mask.
+class DataSourceTest : public DataSourceBase {
+ public:
+  std::vector<std::string> files;
+
+  DataSourceTest() : DataSourceBase("test") {}
+
+  virtual std::string get_name() const { return "Test"; }
+  virtual unsigned int get_scale() const { return 2; }
+  virtual unsigned int get_bpp() const { return 8; }
+  virtual Data::MusicFormat get_music_format() {
+    return Data::MusicFormatMidi;
+  }
+
+  virtual bool check() { return true; }
+  virtual std::vector<std::string> get_files() const { return files; }
+  virtual bool load() {
+    for (size_t i = 0; i < Data::get_resource_count(Data::AssetAnimation);
+         i++) {
+      std::vector<Data::Animation> animations;
+      for (size_t j = 0; j < i % 4; j++) {
+        Data::Animation animation;
+        animation.sprite = static_cast<uint8_t>(i + j);
+        animation.x = -static_cast<int>(j);
+        animation.y = static_cast<int>(i);
+        animations.push_back(animation);
+      }
+      animation_table.push_back(animations);
+    }
+    loaded = true;
+    return true;
+  }
+
+  virtual Data::MaskImage get_sprite_parts(Data::Resource res, size_t index) {
+    Data::PSprite image = create_sprite(res, index);
+    Data::PSprite mask = (index & 1) ? create_sprite(res, index + 1) : nullptr;
+    return std::make_tuple(mask, image);
+  }
+
+  virtual PBuffer get_sound(size_t index) { return create_buffer(index); }
+  virtual PBuffer get_music(size_t index) { return create_buffer(index + 1); }
+
+ protected:
+  class SpriteTest : public SpriteBase {
+   public:
+    SpriteTest(unsigned int w, unsigned int h, int seed) : SpriteBase(w, h) {
+      delta_x = seed % 7;
+      delta_y = -seed % 5;
+      offset_x = -seed % 3;
+      offset_y = seed % 11;
+      for (size_t i = 0; i < w * h * 4; i++) {
+        data[i] = static_cast<uint8_t>(seed + i);
+      }
+    }
+  };
+
+  static Data::PSprite create_sprite(Data::Resource res, size_t index) {
+    int seed = static_cast<int>(res * 31 + index);
+    return std::make_shared<SpriteTest>(1 + index % 5, 1 + res % 3, seed);
+  }
+
+  static PBuffer create_buffer(size_t size) {
+    PMutableBuffer buffer =
+                    std::make_shared<MutableBuffer>(Buffer::EndianessLittle);
+    buffer->push<uint8_t>(static_cast<uint8_t>(size), size + 1);
+    return buffer;
+  }
+};
+
+static void
+expect_same_sprite(Data::PSprite expected, Data::PSprite actual) {
+  ASSERT_EQ(expected == nullptr, actual == nullptr);
+  if (!expected) return;
+  EXPECT_EQ(expected->get_width(), actual->get_width());
+  EXPECT_EQ(expected->get_height(), actual->get_height());
+  EXPECT_EQ(expected->get_delta_x(), actual->get_delta_x());
+  EXPECT_EQ(expected->get_delta_y(), actual->get_delta_y());
+  EXPECT_EQ(expected->get_offset_x(), actual->get_offset_x());
+  EXPECT_EQ(expected->get_offset_y(), actual->get_offset_y());
+  size_t size = expected->get_width() * expected->get_height() * 4;
+  EXPECT_EQ(std::string(expected->get_data(), expected->get_data() + size),
+            std::string(actual->get_data(), actual->get_data() + size));
+}
+
+class DataSourcePackTest : public ::testing::Test {
+ protected:
+  std::shared_ptr<DataSourceTest> source;
+  std::shared_ptr<DataSourcePack> pack;
+  std::string pack_path;
+  std::string data_path;
+
+  std::string dir;
+
+  // Tests run in parallel processes, each gets a directory of its own.
+  virtual void SetUp() {
+    const ::testing::TestInfo *info =
+                   ::testing::UnitTest::GetInstance()->current_test_info();
+    dir = ::testing::TempDir() + "freeserf_" + info->test_suite_name() +
+          "_" + info->name();
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), S_IRWXU);
+#endif
+    data_path = dir + "/data_source_test.dat";
+    write_data("original data");
+
+    source = std::make_shared<DataSourceTest>();
+    source->files.push_back(data_path);
+    ASSERT_TRUE(source->load());
+
+    pack_path = dir + "/" + DataSourcePack::file_name;
+    ASSERT_TRUE(DataSourcePack::create(source, pack_path));
+
+    pack = std::make_shared<DataSourcePack>(dir);
+    ASSERT_TRUE(pack->check());
+    ASSERT_TRUE(pack->load());
+  }
+
+  virtual void TearDown() {
+    pack = nullptr;
+    std::remove(pack_path.c_str());
+    std::remove(data_path.c_str());
+#ifdef _WIN32
+    _rmdir(dir.c_str());
+#else
+    rmdir(dir.c_str());
+#endif
+  }
+
+  void write_data(const std::string &data) {
+    std::ofstream file(data_path.c_str(), std::ios::binary | std::ios::trunc);
+    file << data;
+  }
+};
+
+TEST_F(DataSourcePackTest, KeepsSourceProperties) {
+  EXPECT_EQ(source->get_name(), pack->get_name());
+  EXPECT_EQ(source->get_scale(), pack->get_scale());
+  EXPECT_EQ(source->get_bpp(), pack->get_bpp());
+  EXPECT_EQ(source->get_music_format(), pack->get_music_format());
+}
+
+TEST_F(DataSourcePackTest, KnowsSourceFiles) {
+  EXPECT_TRUE(pack->is_built_from(source));
+
+  std::shared_ptr<DataSourceTest> other = std::make_shared<DataSourceTest>();
+  EXPECT_FALSE(pack->is_built_from(other));
+
+  // Data replaced after the pack was built makes it stale.
+  write_data("other data, not the same size");
+  EXPECT_FALSE(pack->is_built_from(source));
+}
+
+TEST_F(DataSourcePackTest, ServesSameSprites) {
+  for (int r = Data::AssetArtLandscape; r <= Data::AssetCursor; r++) {
+    Data::Resource res = static_cast<Data::Resource>(r);
+    if (Data::get_resource_type(res) != Data::TypeSprite) continue;
+    for (size_t i = 0; i < Data::get_resource_count(res); i++) {
+      SCOPED_TRACE(Data::get_resource_name(res) + " #" + std::to_string(i));
+      Data::MaskImage expected = source->get_sprite_parts(res, i);
+      Data::MaskImage actual = pack->get_sprite_parts(res, i);
+      expect_same_sprite(std::get<0>(expected), std::get<0>(actual));
+      expect_same_sprite(std::get<1>(expected), std::get<1>(actual));
+    }
+  }
+}
+
+TEST_F(DataSourcePackTest, ModificationDoesNotChangePack) {
+  Data::Sprite::Color color = { 1, 2, 3, 4 };
+  Data::PSprite colored = pack->get_sprite(Data::AssetSerfTorso, 1, color);
+  ASSERT_NE(nullptr, colored);
+
+  Data::MaskImage expected = source->get_sprite_parts(Data::AssetSerfTorso, 1);
+  Data::MaskImage actual = pack->get_sprite_parts(Data::AssetSerfTorso, 1);
+  expect_same_sprite(std::get<0>(expected), std::get<0>(actual));
+}
+
+TEST_F(DataSourcePackTest, ServesSameAnimationsAndSounds) {
+  for (size_t i = 0; i < Data::get_resource_count(Data::AssetAnimation); i++) {
+    ASSERT_EQ(source->get_animation_phase_count(i),
+              pack->get_animation_phase_count(i));
+    for (size_t j = 0; j < source->get_animation_phase_count(i); j++) {
+      Data::Animation expected = source->get_animation(i, j);
+      Data::Animation actual = pack->get_animation(i, j);
+      EXPECT_EQ(expected.sprite, actual.sprite);
+      EXPECT_EQ(expected.x, actual.x);
+      EXPECT_EQ(expected.y, actual.y);
+    }
+  }
+
+  for (size_t i = 0; i < Data::get_resource_count(Data::AssetSound); i++) {
+    PBuffer sound = pack->get_sound(i);
+    ASSERT_NE(nullptr, sound);
+    EXPECT_EQ(std::string(*source->get_sound(i)), std::string(*sound));
+  }
+  for (size_t i = 0; i < Data::get_resource_count(Data::AssetMusic); i++) {
+    PBuffer music = pack->get_music(i);
+    ASSERT_NE(nullptr, music);
+    EXPECT_EQ(std::string(*source->get_music(i)), std::string(*music));
+  }
+}
@@ -0,0 +1,177 @@
+/*
+ * test_image_writer.cc - Image file writer tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/image-writer.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+static Bytes
+create_pixels(unsigned int width, unsigned int height) {
+  Bytes pixels(3 * width * height);
+  for (size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = static_cast<uint8_t>(i * 7 + i / 3);
+  }
+  return pixels;
+}
+
+// Write pixels in bands of the given number of rows and read the file back.
+static Bytes
+write_image(ImageWriter::Format format, unsigned int width,
+            unsigned int height, unsigned int band, const Bytes &pixels) {
+  // Tests run in parallel processes, each writes a file of its own.
+  const ::testing::TestInfo *info =
+                   ::testing::UnitTest::GetInstance()->current_test_info();
+  std::string path = ::testing::TempDir() + "image_writer_test_" +
+                     info->name();
+  std::unique_ptr<ImageWriter> writer = ImageWriter::create(format, path,
+                                                            width, height);
+  EXPECT_TRUE(writer);
+  if (!writer) return Bytes();
+  for (unsigned int y = 0; y < height; y += band) {
+    unsigned int rows = std::min(band, height - y);
+    EXPECT_TRUE(writer->write_rows(&pixels[3 * width * y], rows));
+  }
+  EXPECT_TRUE(writer->finish());
+  writer.reset();
+
+  std::ifstream file(path.c_str(), std::ios::binary);
+  Bytes content((std::istreambuf_iterator<char>(file)),
+                std::istreambuf_iterator<char>());
+  std::remove(path.c_str());
+  return content;
+}
+
+static uint32_t
+get_be32(const Bytes &data, size_t offset) {
+  return (data[offset] << 24) | (data[offset + 1] << 16) |
+         (data[offset + 2] << 8) | data[offset + 3];
+}
+
+// Rows of the image, from the stored deflate blocks of all IDAT chunks.
+static Bytes
+read_png(const Bytes &file, unsigned int *width, unsigned int *height) {
+  Bytes stream;
+  size_t offset = 8;
+  while (offset + 12 <= file.size()) {
+    uint32_t size = get_be32(file, offset);
+    std::string type(file.begin() + offset + 4, file.begin() + offset + 8);
+    if (type == "IHDR") {
+      *width = get_be32(file, offset + 8);
+      *height = get_be32(file, offset + 12);
+    } else if (type == "IDAT") {
+      stream.insert(stream.end(), file.begin() + offset + 8,
+                    file.begin() + offset + 8 + size);
+    } else if (type == "IEND") {
+      // Constant CRC of the empty end chunk
+      EXPECT_EQ(0xAE426082u, get_be32(file, offset + 8));
+    }
+    offset += size + 12;
+  }
+  EXPECT_EQ(file.size(), offset);
+
+  Bytes rows;
+  EXPECT_EQ(0x78, stream[0]);
+  size_t pos = 2;
+  bool final = false;
+  while (!final && pos + 5 <= stream.size()) {
+    final = (stream[pos] & 1) != 0;
+    EXPECT_EQ(0, stream[pos] & 6);
+    size_t len = stream[pos + 1] | (stream[pos + 2] << 8);
+    size_t nlen = stream[pos + 3] | (stream[pos + 4] << 8);
+    EXPECT_EQ(len, nlen ^ 0xFFFF);
+    rows.insert(rows.end(), stream.begin() + pos + 5,
+                stream.begin() + pos + 5 + len);
+    pos += 5 + len;
+  }
+  EXPECT_TRUE(final);
+
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (uint8_t value : rows) {
+    a = (a + value) % 65521;
+    b = (b + a) % 65521;
+  }
+  EXPECT_EQ(pos + 4, stream.size());
+  EXPECT_EQ((b << 16) | a, get_be32(stream, pos));
+
+  Bytes pixels;
+  size_t row_size = 3 * *width;
+  for (size_t row = 0; row + row_size < rows.size(); row += row_size + 1) {
+    EXPECT_EQ(0, rows[row]);
+    pixels.insert(pixels.end(), rows.begin() + row + 1,
+                  rows.begin() + row + 1 + row_size);
+  }
+  return pixels;
+}
+
+TEST(ImageWriter, PNG) {
+  // Bands of more than one deflate block and of odd sizes
+  for (unsigned int band : {1, 7, 400}) {
+    SCOPED_TRACE("bands of " + std::to_string(band) + " rows");
+    Bytes pixels = create_pixels(123, 401);
+    Bytes file = write_image(ImageWriter::FormatPNG, 123, 401, band, pixels);
+    ASSERT_GT(file.size(), 8u);
+    EXPECT_EQ(Bytes({0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'}),
+              Bytes(file.begin(), file.begin() + 8));
+
+    unsigned int width = 0;
+    unsigned int height = 0;
+    Bytes result = read_png(file, &width, &height);
+    EXPECT_EQ(123u, width);
+    EXPECT_EQ(401u, height);
+    EXPECT_EQ(pixels, result);
+  }
+}
+
+TEST(ImageWriter, PPM) {
+  Bytes pixels = create_pixels(5, 3);
+  Bytes file = write_image(ImageWriter::FormatPPM, 5, 3, 2, pixels);
+  std::string header = "P6\n5 3\n255\n";
+  Bytes expected(header.begin(), header.end());
+  expected.insert(expected.end(), pixels.begin(), pixels.end());
+  EXPECT_EQ(expected, file);
+}
+
+TEST(ImageWriter, ChecksRowCount) {
+  std::string path = ::testing::TempDir() + "image_writer_rows";
+  Bytes pixels = create_pixels(4, 4);
+  std::unique_ptr<ImageWriter> writer =
+                   ImageWriter::create(ImageWriter::FormatPNG, path, 4, 2);
+  ASSERT_TRUE(writer);
+  EXPECT_TRUE(writer->write_rows(pixels.data(), 1));
+  EXPECT_FALSE(writer->finish());
+  EXPECT_FALSE(writer->write_rows(pixels.data(), 2));
+  writer.reset();
+  std::remove(path.c_str());
+
+  EXPECT_FALSE(ImageWriter::create(ImageWriter::FormatPNG,
+                                   ::testing::TempDir() + "no/such/dir/x",
+                                   4, 4));
+}
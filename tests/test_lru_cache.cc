@@ -0,0 +1,110 @@
+/*
+ * test_lru_cache.cc - LruCache tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+
+#include "src/lru-cache.h"
+#include "src/random.h"
+
+typedef LruCache<uint64_t, int> IntCache;
+
+static std::unique_ptr<int>
+make_value(int value) {
+  return std::unique_ptr<int>(new int(value));
+}
+
+TEST(LruCache, EvictsLeastRecentlyUsed) {
+  IntCache cache(3);
+  cache.insert(1, make_value(10), 1);
+  cache.insert(2, make_value(20), 1);
+  cache.insert(3, make_value(30), 1);
+
+  // Touch 1, so that 2 is the least recently used.
+  ASSERT_NE(nullptr, cache.get(1));
+  cache.insert(4, make_value(40), 1);
+
+  EXPECT_TRUE(cache.contains(1));
+  EXPECT_FALSE(cache.contains(2));
+  EXPECT_TRUE(cache.contains(3));
+  EXPECT_TRUE(cache.contains(4));
+  EXPECT_EQ(3u, cache.get_count());
+  EXPECT_EQ(3u, cache.get_memory_used());
+  EXPECT_EQ(1u, cache.get_evictions());
+
+  EXPECT_EQ(nullptr, cache.get(2));
+  EXPECT_EQ(1u, cache.get_misses());
+  EXPECT_EQ(1u, cache.get_hits());
+}
+
+TEST(LruCache, KeepsLastInserted) {
+  IntCache cache(2);
+  cache.insert(1, make_value(10), 1);
+  cache.insert(2, make_value(20), 5);
+
+  EXPECT_FALSE(cache.contains(1));
+  ASSERT_NE(nullptr, cache.peek(2));
+  EXPECT_EQ(20, *cache.peek(2));
+
+  cache.set_memory_budget(10);
+  cache.insert(3, make_value(30), 5);
+  EXPECT_TRUE(cache.contains(2));
+  EXPECT_TRUE(cache.contains(3));
+}
+
+// Compare against std::map under random inserts, lookups and erases, with
+// keys colliding often enough to exercise probing and deletion.
+TEST(LruCache, MatchesReferenceMap) {
+  IntCache cache(1000000);
+  std::map<uint64_t, int> reference;
+  Random random("8667715887436237");
+
+  for (int i = 0; i < 20000; i++) {
+    uint64_t key = (random.random() % 512) << 16;
+    switch (random.random() % 3) {
+      case 0:
+        cache.insert(key, make_value(i), 1);
+        reference[key] = i;
+        break;
+      case 1:
+        cache.erase(key);
+        reference.erase(key);
+        break;
+      default: {
+        int *value = cache.get(key);
+        auto it = reference.find(key);
+        ASSERT_EQ(it != reference.end(), value != nullptr) << "key " << key;
+        if (value != nullptr) {
+          EXPECT_EQ(it->second, *value);
+        }
+        break;
+      }
+    }
+    ASSERT_EQ(reference.size(), cache.get_count());
+  }
+
+  for (const auto &entry : reference) {
+    ASSERT_NE(nullptr, cache.peek(entry.first));
+    EXPECT_EQ(entry.second, *cache.peek(entry.first));
+  }
+}
@@ -26,7 +26,9 @@
 #include <vector>
 #include <iterator>
 
+#include "src/game.h"
 #include "src/map.h"
+#include "src/map-buildability.h"
 #include "src/map-generator.h"
 #include "src/map-geometry.h"
 #include "src/random.h"
@@ -126,3 +128,75 @@ TEST(Map, ClassicMissionMapGenerator) {
     }
   }
 }
+
+TEST(Map, IncrementalBuildability) {
+  Game game;
+  ASSERT_TRUE(game.init(3, Random("8667715887436237")));
+  PMap map = game.get_map();
+
+  std::vector<Player*> players;
+  for (unsigned int i = 0; i < 2; i++) {
+    game.add_player(35, 30, 40);
+    players.push_back(game.get_player(i));
+  }
+
+  MapBuildability *buildability = game.get_buildability();
+  unsigned int size = map->get_cols() * map->get_rows();
+
+  // Place castles through the plane, so that it goes stale on castle state.
+  for (Player *player : players) {
+    for (MapPos pos = 0; pos < size; pos++) {
+      if (buildability->get(pos, player) ==
+            MapBuildability::BuildabilityCastle) {
+        ASSERT_TRUE(game.build_castle(pos, player));
+        break;
+      }
+    }
+    ASSERT_TRUE(player->has_castle());
+  }
+
+  std::vector<MapPos> built;
+  for (int round = 0; round < 10; round++) {
+    // Make every value known, then change the map under the plane.
+    for (Player *player : players) {
+      for (MapPos pos = 0; pos < size; pos++) {
+        buildability->get(pos, player);
+      }
+    }
+
+    for (Player *player : players) {
+      for (MapPos pos = 0; pos < size; pos++) {
+        MapBuildability::Buildability value = buildability->get(pos, player);
+        if (value == MapBuildability::BuildabilityLarge &&
+            game.build_building(pos, Building::TypeFortress, player)) {
+          built.push_back(pos);
+          break;
+        } else if (value == MapBuildability::BuildabilitySmall &&
+                   game.build_building(pos, Building::TypeLumberjack,
+                                       player)) {
+          built.push_back(pos);
+          break;
+        }
+      }
+    }
+    if ((round % 3) == 2 && !built.empty()) {
+      MapPos pos = built.front();
+      built.erase(built.begin());
+      game.demolish_building(pos, players[map->get_owner(pos)]);
+    }
+
+    for (int i = 0; i < 500; i++) {
+      game.update();
+    }
+
+    for (Player *player : players) {
+      for (MapPos pos = 0; pos < size; pos++) {
+        ASSERT_EQ(buildability->calculate(pos, player),
+                  buildability->get(pos, player))
+          << "Stale value at " << map->pos_col(pos) << ","
+          << map->pos_row(pos) << " in round " << round;
+      }
+    }
+  }
+  EXPECT_FALSE(built.empty());
+}
@@ -0,0 +1,152 @@
+/*
+ * test_pixel_kernels.cc - sprite pixel loop tests and benchmark
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/pixel-kernels.h"
+
+typedef std::vector<uint32_t> Pixels;
+
+// Width and height of sprites: icon, serf, map object, building, map tile
+// and full screen frame. Odd sizes to exercise the loop tails.
+static const unsigned int sprite_sizes[][2] = {
+  { 16, 16 }, { 11, 23 }, { 33, 31 }, { 64, 65 }, { 32, 41 }, { 320, 200 }
+};
+
+// Pixels mixing transparent, opaque, translucent, full and repeated values,
+// the way sprite data looks.
+static Pixels
+create_pixels(size_t count, unsigned int seed) {
+  std::mt19937 generator(seed);
+  Pixels pixels(count);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t value = generator();
+    switch (generator() % 8) {
+      case 0: value = 0x00000000; break;
+      case 1: value &= 0x00FFFFFF; break;
+      case 2: value = 0xFFFFFFFF; break;
+      case 3:
+      case 4: value |= 0xFF000000; break;
+      case 5: value = (i > 0) ? pixels[i - 1] : value; break;
+      default: break;
+    }
+    pixels[i] = value;
+  }
+  return pixels;
+}
+
+// Run operation of kernels on fresh pixels and return the result.
+typedef std::function<void(const PixelKernels &, Pixels *, const Pixels &,
+                           const Pixels &)> Operation;
+
+static std::vector<std::pair<std::string, Operation>>
+get_operations() {
+  std::vector<std::pair<std::string, Operation>> operations;
+  operations.push_back({"mask", [](const PixelKernels &k, Pixels *dst,
+                                   const Pixels &a, const Pixels &b) {
+    k.mask(dst->data(), a.data(), b.data(), dst->size()); }});
+  operations.push_back({"compare", [](const PixelKernels &k, Pixels *dst,
+                                      const Pixels &a, const Pixels &b) {
+    k.compare(dst->data(), a.data(), b.data(), dst->size()); }});
+  operations.push_back({"fill_masked", [](const PixelKernels &k, Pixels *dst,
+                                          const Pixels & /*a*/,
+                                          const Pixels & /*b*/) {
+    k.fill_masked(dst->data(), 0xFF336699, dst->size()); }});
+  operations.push_back({"add", [](const PixelKernels &k, Pixels *dst,
+                                  const Pixels &a, const Pixels & /*b*/) {
+    k.add(dst->data(), a.data(), dst->size()); }});
+  operations.push_back({"del", [](const PixelKernels &k, Pixels *dst,
+                                  const Pixels &a, const Pixels & /*b*/) {
+    k.del(dst->data(), a.data(), dst->size()); }});
+  operations.push_back({"blend", [](const PixelKernels &k, Pixels *dst,
+                                    const Pixels &a, const Pixels & /*b*/) {
+    k.blend(dst->data(), a.data(), dst->size()); }});
+  operations.push_back({"alpha_mask", [](const PixelKernels &k, Pixels *dst,
+                                         const Pixels & /*a*/,
+                                         const Pixels & /*b*/) {
+    k.alpha_mask(dst->data(), dst->size()); }});
+  return operations;
+}
+
+TEST(PixelKernels, MatchScalar) {
+  const PixelKernels &scalar = PixelKernels::get_scalar();
+  for (const PixelKernels *kernels : PixelKernels::get_available()) {
+    for (const auto &operation : get_operations()) {
+      for (const auto &size : sprite_sizes) {
+        size_t count = size[0] * size[1];
+        SCOPED_TRACE(std::string(kernels->name) + " " + operation.first +
+                     " " + std::to_string(size[0]) + "x" +
+                     std::to_string(size[1]));
+        Pixels a = create_pixels(count, 1);
+        Pixels b = create_pixels(count, 2);
+        Pixels expected = create_pixels(count, 3);
+        // Same values in places, as for the mask of identical sprites.
+        for (size_t i = 0; i < count; i += 3) b[i] = a[i];
+        Pixels actual = expected;
+        operation.second(scalar, &expected, a, b);
+        operation.second(*kernels, &actual, a, b);
+        ASSERT_EQ(expected, actual);
+      }
+    }
+  }
+}
+
+TEST(PixelKernels, Throughput) {
+  const size_t pixels_per_run = 20000000;
+  for (const PixelKernels *kernels : PixelKernels::get_available()) {
+    for (const auto &operation : get_operations()) {
+      double total_ms = 0;
+      size_t total_pixels = 0;
+      for (const auto &size : sprite_sizes) {
+        size_t count = size[0] * size[1];
+        Pixels a = create_pixels(count, 1);
+        Pixels b = create_pixels(count, 2);
+        Pixels source = create_pixels(count, 3);
+        Pixels dst = source;
+        size_t runs = pixels_per_run / count / sizeof(sprite_sizes) *
+                      sizeof(sprite_sizes[0]);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < runs; i++) {
+          operation.second(*kernels, &dst, a, b);
+        }
+        std::chrono::duration<double, std::milli> elapsed =
+                                     std::chrono::steady_clock::now() - start;
+        total_ms += elapsed.count();
+        total_pixels += runs * count;
+      }
+      double mpixels = total_pixels / (total_ms * 1000.);
+      RecordProperty(std::string(kernels->name) + "_" + operation.first,
+                     static_cast<int>(mpixels));
+      std::cout << "[ " << kernels->name << " ] " << operation.first << ": "
+                << mpixels << " Mpixel/s" << std::endl;
+    }
+  }
+  std::cout << "[ selected ] " << PixelKernels::get_instance().name
+            << std::endl;
+}
@@ -24,11 +24,14 @@
 #include <iostream>
 #include <sstream>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "src/game.h"
 #include "src/random.h"
 #include "src/savegame.h"
 #include "src/mission.h"
+#include "src/game-checkpoint.h"
 
 
 TEST(SaveGame, RandomMapSaveGame) {
@@ -77,3 +80,188 @@ TEST(SaveGame, RandomMapSaveGame) {
   // Check player land area
   EXPECT_EQ(player_0->get_land_area(), loaded_player_0->get_land_area());
 }
+
+TEST(SaveGame, LargeMapSaveGame) {
+  // Multi-megabyte save with several players exercises parallel loading
+  std::unique_ptr<Game> game(new Game());
+  game->init(8, Random("8667715887436237"));
+
+  PMap map = game->get_map();
+  for (unsigned int i = 0; i < 4; i++) {
+    game->add_player(35, 30, 40);
+    Player *player = game->get_player(i);
+    ASSERT_TRUE(player != NULL);
+
+    // Find a castle spot in each quarter of the map
+    int col_base = (i & 1) * map->get_cols() / 2;
+    int row_base = (i >> 1) * map->get_rows() / 2;
+    bool built = false;
+    for (unsigned int j = 0; j < map->get_cols() / 2 && !built; j++) {
+      MapPos pos = map->pos(col_base + j, row_base + j);
+      if (game->can_build_castle(pos, player)) {
+        built = game->build_castle(pos, player);
+      }
+    }
+    ASSERT_TRUE(built) << "Player " << i << " was not able to build castle";
+  }
+
+  for (int i = 0; i < 2000; i++) game->update();
+
+  std::stringstream str;
+  ASSERT_TRUE(GameStore::get_instance().write(&str, game.get()));
+  std::string saved = str.str();
+  ASSERT_GT(saved.size(), 1024u * 1024u);
+
+  std::unique_ptr<Game> loaded_game(new Game());
+  ASSERT_TRUE(GameStore::get_instance().read(&str, loaded_game.get()));
+
+  EXPECT_EQ(*game->get_map(), *loaded_game->get_map());
+
+  // Saving the loaded game reproduces every object
+  std::stringstream str_loaded;
+  ASSERT_TRUE(GameStore::get_instance().write(&str_loaded, loaded_game.get()));
+  EXPECT_EQ(saved, str_loaded.str());
+}
+
+TEST(SaveGame, CheckpointRestore) {
+  std::unique_ptr<Game> game(new Game());
+  game->init(3, Random("8667715887436237"));
+  game->add_player(35, 30, 40);
+
+  Player *player_0 = game->get_player(0);
+  ASSERT_TRUE(player_0 != NULL);
+
+  bool r = game->build_castle(game->get_map()->pos(6, 6), player_0);
+  ASSERT_TRUE(r) << "Player was not able to build castle";
+
+  // Capture checkpoints while running and keep reference saves
+  GameCheckpoints checkpoints(100, 64*1024*1024);
+  std::vector<std::string> states;
+  for (int i = 0; i < 1000; i++) {
+    game->update();
+    if (checkpoints.update(game.get())) {
+      std::stringstream str;
+      GameStore::get_instance().write(&str, game.get());
+      states.push_back(str.str());
+    }
+  }
+
+  ASSERT_GT(checkpoints.get_count(), 2u);
+  ASSERT_EQ(checkpoints.get_count(), states.size());
+
+  // Every checkpoint restores the exact state it was captured from
+  for (size_t i = 0; i < checkpoints.get_count(); i++) {
+    PGame restored = checkpoints.restore(i);
+    ASSERT_TRUE(restored != nullptr);
+    EXPECT_EQ(checkpoints.get_tick(i), restored->get_tick());
+
+    std::stringstream str;
+    GameStore::get_instance().write(&str, restored.get());
+    EXPECT_EQ(states[i], str.str()) << "Checkpoint " << i << " differs";
+  }
+
+  // Shrinking the budget folds old checkpoints into the new base
+  size_t count = checkpoints.get_count();
+  unsigned int last_tick = checkpoints.get_tick(count - 1);
+  checkpoints.set_memory_budget(checkpoints.get_memory_used() / 2);
+  ASSERT_LT(checkpoints.get_count(), count);
+  ASSERT_EQ(last_tick, checkpoints.get_tick(checkpoints.get_count() - 1));
+
+  PGame restored = checkpoints.restore(checkpoints.get_count() - 1);
+  ASSERT_TRUE(restored != nullptr);
+  std::stringstream str;
+  GameStore::get_instance().write(&str, restored.get());
+  EXPECT_EQ(states.back(), str.str());
+
+  restored = checkpoints.restore_tick(last_tick + 1);
+  ASSERT_TRUE(restored != nullptr);
+  EXPECT_EQ(last_tick, restored->get_tick());
+
+  // The last checkpoint is kept whole, as base and as sections to compare
+  // the next one with, both count.
+  checkpoints.set_memory_budget(0);
+  ASSERT_EQ(1u, checkpoints.get_count());
+  EXPECT_GT(checkpoints.get_memory_used(), states.back().size() * 3 / 2);
+}
+
+TEST(SaveGame, KeepsThreatLevels) {
+  std::unique_ptr<Game> game(new Game());
+  game->init(3, Random("8667715887436237"));
+  game->add_player(35, 30, 40);
+  game->add_player(35, 30, 40);
+
+  // Castles close enough to see the border of each other
+  PMap map = game->get_map();
+  bool r = game->build_castle(map->pos(6, 6), game->get_player(0));
+  ASSERT_TRUE(r) << "Player was not able to build castle";
+  Building *castle = game->get_building_at_pos(map->pos(6, 6));
+  ASSERT_TRUE(castle != NULL);
+  for (unsigned int col = 12; col < 30 && castle->get_threat_level() == 0;
+       col++) {
+    MapPos pos = map->pos(col, 6);
+    if (game->can_build_castle(pos, game->get_player(1))) {
+      game->build_castle(pos, game->get_player(1));
+      castle->update_military_flag_state();
+    }
+  }
+  for (int i = 0; i < 500; i++) game->update();
+  ASSERT_TRUE(castle->is_done());
+  ASSERT_GT(castle->get_threat_level(), 0u);
+
+  // Saved threat level differs from the one land ownership gives on load
+  castle->set_threat_level(0);
+
+  std::stringstream str;
+  ASSERT_TRUE(GameStore::get_instance().write(&str, game.get()));
+  std::unique_ptr<Game> loaded_game(new Game());
+  ASSERT_TRUE(GameStore::get_instance().read(&str, loaded_game.get()));
+
+  Building *loaded_castle = loaded_game->get_building_at_pos(map->pos(6, 6));
+  ASSERT_TRUE(loaded_castle != NULL);
+  EXPECT_EQ(0u, loaded_castle->get_threat_level());
+}
+
+TEST(SaveGame, LegacyLayoutValidation) {
+  // Minimal legacy save: map of size 3 without players and objects
+  MapGeometry geom(3);
+  size_t size = SaveLayoutBinary::header_size +
+                4 * SaveLayoutBinary::player_size +
+                SaveLayoutBinary::map_tile_size * geom.cols() * geom.rows();
+  std::vector<uint8_t> data(size, 0);
+  data[190] = 3;  // Map size, little endian
+
+  SaveReaderBinary reader(&data[0], data.size());
+  SaveLayoutBinary layout;
+  ASSERT_TRUE(layout.validate(reader)) << layout.get_error_message();
+  EXPECT_EQ(3u, layout.map_size);
+
+  std::unique_ptr<Game> game(new Game());
+  ASSERT_NO_THROW(reader >> *game);
+  EXPECT_EQ(geom.cols(), game->get_map()->get_cols());
+
+  // Truncated map section is reported before anything is loaded
+  SaveReaderBinary short_reader(&data[0], data.size() - 1);
+  SaveLayoutBinary short_layout;
+  EXPECT_FALSE(short_layout.validate(short_reader));
+  EXPECT_EQ(SaveLayoutBinary::ErrorTruncated, short_layout.get_error());
+  EXPECT_NE(std::string::npos,
+            short_layout.get_error_message().find("\"map\""));
+
+  // Loading reports the failing section and its offset without throwing
+  SaveLayoutBinary load_layout;
+  std::unique_ptr<Game> short_game(new Game());
+  EXPECT_FALSE(short_game->load_legacy(&short_reader, &load_layout));
+  EXPECT_EQ(SaveLayoutBinary::ErrorTruncated, load_layout.get_error());
+  EXPECT_EQ("map", load_layout.get_error_section());
+  EXPECT_EQ(SaveLayoutBinary::header_size + 4 * SaveLayoutBinary::player_size,
+            load_layout.get_error_offset());
+
+  // Invalid map size
+  data[190] = 42;
+  SaveReaderBinary bad_reader(&data[0], data.size());
+  SaveLayoutBinary bad_layout;
+  EXPECT_FALSE(bad_layout.validate(bad_reader));
+  EXPECT_EQ(SaveLayoutBinary::ErrorInvalidMapSize, bad_layout.get_error());
+  std::unique_ptr<Game> bad_game(new Game());
+  EXPECT_THROW(bad_reader >> *bad_game, ExceptionFreeserf);
+}
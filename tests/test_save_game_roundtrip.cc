@@ -0,0 +1,215 @@
+/*
+ * test_save_game_roundtrip.cc - save/load performance and fidelity tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#include "src/game.h"
+#include "src/game-checkpoint.h"
+#include "src/random.h"
+#include "src/savegame.h"
+
+typedef GameCheckpoints::Sections Sections;
+
+// Heap use is counted by replacing the global allocation functions. The
+// peak is measured from a reset, so every case gets its own figure.
+static std::atomic<size_t> allocated_bytes(0);
+static std::atomic<size_t> peak_bytes(0);
+
+static const size_t alloc_header = alignof(std::max_align_t);
+
+static void *
+counted_alloc(size_t size) {
+  void *block = std::malloc(size + alloc_header);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  *reinterpret_cast<size_t*>(block) = size;
+  size_t now = allocated_bytes += size;
+  size_t peak = peak_bytes;
+  while ((now > peak) && !peak_bytes.compare_exchange_weak(peak, now)) {}
+  return reinterpret_cast<char*>(block) + alloc_header;
+}
+
+static void
+counted_free(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  char *block = reinterpret_cast<char*>(ptr) - alloc_header;
+  allocated_bytes -= *reinterpret_cast<size_t*>(block);
+  std::free(block);
+}
+
+void *operator new(size_t size) {
+  void *ptr = counted_alloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t&) noexcept {
+  return counted_alloc(size);
+}
+void *operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return counted_alloc(size);
+}
+void operator delete(void *ptr) noexcept { counted_free(ptr); }
+void operator delete[](void *ptr) noexcept { counted_free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept {
+  counted_free(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept {
+  counted_free(ptr);
+}
+
+// Start measuring the peak heap growth from the current heap use.
+static size_t
+reset_peak_memory() {
+  size_t now = allocated_bytes;
+  peak_bytes = now;
+  return now;
+}
+
+// Peak heap growth since reset_peak_memory() in kilobytes.
+static size_t
+get_peak_memory(size_t base) {
+  return (peak_bytes - base) / 1024;
+}
+
+static double
+get_elapsed_ms(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double, std::milli> elapsed =
+                                      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Random game with four players, each with a castle in its own quarter.
+static std::unique_ptr<Game>
+create_game(unsigned int map_size) {
+  std::unique_ptr<Game> game(new Game());
+  if (!game->init(map_size, Random("8667715887436237"))) {
+    return nullptr;
+  }
+
+  PMap map = game->get_map();
+  for (unsigned int i = 0; i < 4; i++) {
+    game->add_player(35, 30, 40);
+    Player *player = game->get_player(i);
+    int col_base = (i & 1) * map->get_cols() / 2;
+    int row_base = (i >> 1) * map->get_rows() / 2;
+    bool built = false;
+    for (unsigned int j = 0; j < map->get_cols() / 2 && !built; j++) {
+      MapPos pos = map->pos(col_base + j, row_base + j);
+      if (game->can_build_castle(pos, player)) {
+        built = game->build_castle(pos, player);
+      }
+    }
+    if (!built) {
+      return nullptr;
+    }
+  }
+
+  return game;
+}
+
+// Parameters are map size and game tick to advance to.
+class SaveGameRoundTrip
+  : public ::testing::TestWithParam<std::tuple<unsigned int, unsigned int>> {
+};
+
+TEST_P(SaveGameRoundTrip, TextFormat) {
+  unsigned int map_size = std::get<0>(GetParam());
+  unsigned int ticks = std::get<1>(GetParam());
+
+  std::unique_ptr<Game> game = create_game(map_size);
+  ASSERT_TRUE(game != nullptr) << "Failed to set up game";
+  while (game->get_tick() < ticks) {
+    game->update();
+  }
+
+  // Save
+  size_t memory_before = reset_peak_memory();
+  auto start = std::chrono::steady_clock::now();
+  std::stringstream str;
+  ASSERT_TRUE(GameStore::get_instance().write(&str, game.get()));
+  std::string saved = str.str();
+  double save_ms = get_elapsed_ms(start);
+  size_t save_memory = get_peak_memory(memory_before);
+
+  // Load
+  memory_before = reset_peak_memory();
+  start = std::chrono::steady_clock::now();
+  std::unique_ptr<Game> loaded_game(new Game());
+  ASSERT_TRUE(GameStore::get_instance().read(&str, loaded_game.get()));
+  double load_ms = get_elapsed_ms(start);
+  size_t load_memory = get_peak_memory(memory_before);
+
+  RecordProperty("map_size", map_size);
+  RecordProperty("ticks", ticks);
+  RecordProperty("file_size", static_cast<int>(saved.size()));
+  RecordProperty("save_us", static_cast<int>(save_ms * 1000));
+  RecordProperty("load_us", static_cast<int>(load_ms * 1000));
+  RecordProperty("save_peak_kb", static_cast<int>(save_memory));
+  RecordProperty("load_peak_kb", static_cast<int>(load_memory));
+  std::cout << "[ text     ] map size " << map_size << ", tick " << ticks
+            << ": " << saved.size() << " bytes, save " << save_ms
+            << " ms, load " << load_ms << " ms, peak memory growth "
+            << save_memory << "/" << load_memory << " KB" << std::endl;
+
+  // State equality: the map directly, every object through its section
+  EXPECT_EQ(*game->get_map(), *loaded_game->get_map());
+  EXPECT_EQ(game->get_tick(), loaded_game->get_tick());
+  EXPECT_EQ(game->get_gold_total(), loaded_game->get_gold_total());
+
+  std::stringstream str_loaded;
+  ASSERT_TRUE(GameStore::get_instance().write(&str_loaded, loaded_game.get()));
+  Sections expected;
+  GameCheckpoints::split_sections(saved, &expected);
+  Sections actual;
+  GameCheckpoints::split_sections(str_loaded.str(), &actual);
+  ASSERT_GT(expected.size(), 1u);
+  for (const auto &section : expected) {
+    Sections::const_iterator it = actual.find(section.first);
+    ASSERT_TRUE(it != actual.end()) << "Missing [" << section.first << "]";
+    EXPECT_EQ(section.second, it->second) << "Differs [" << section.first
+                                          << "]";
+  }
+  for (const auto &section : actual) {
+    EXPECT_TRUE(expected.find(section.first) != expected.end())
+      << "Unexpected [" << section.first << "]";
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(MapSizes, SaveGameRoundTrip,
+                        ::testing::Combine(::testing::Values(3u, 5u, 7u),
+                                           ::testing::Values(10000u, 50000u)));
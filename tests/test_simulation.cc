@@ -0,0 +1,162 @@
+/*
+ * test_simulation.cc - Simulation thread and snapshot hand over tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "src/game.h"
+#include "src/random.h"
+#include "src/simulation.h"
+#include "src/snapshot-buffer.h"
+
+// Snapshot as filled by the writer, all values equal to the serial.
+class Values {
+ public:
+  std::vector<unsigned int> values;
+};
+
+TEST(SnapshotBuffer, TakesLatestPublished) {
+  SnapshotBuffer<Values> buffer;
+  EXPECT_FALSE(buffer.take());
+
+  for (unsigned int serial = 1; serial <= 3; serial++) {
+    buffer.get_back()->values.assign(1, serial);
+    buffer.publish();
+  }
+  ASSERT_TRUE(buffer.take());
+  EXPECT_EQ(3u, buffer.get_front()->values[0]);
+  EXPECT_FALSE(buffer.take());
+  EXPECT_EQ(3u, buffer.get_front()->values[0]);
+}
+
+TEST(SnapshotBuffer, ReaderNeverSeesPartialSnapshots) {
+  const unsigned int snapshots = 20000;
+  SnapshotBuffer<Values> buffer;
+
+  std::thread writer([&buffer, snapshots]() {
+    for (unsigned int serial = 1; serial <= snapshots; serial++) {
+      buffer.get_back()->values.assign(64, serial);
+      buffer.publish();
+    }
+  });
+
+  unsigned int last = 0;
+  while (last < snapshots) {
+    if (!buffer.take()) {
+      std::this_thread::yield();
+      continue;
+    }
+    const std::vector<unsigned int> &values = buffer.get_front()->values;
+    ASSERT_EQ(64u, values.size());
+    for (unsigned int value : values) {
+      ASSERT_EQ(values[0], value);
+    }
+    ASSERT_GT(values[0], last);
+    last = values[0];
+  }
+  writer.join();
+}
+
+class TickCounter : public Simulation::Handler {
+ public:
+  std::atomic<unsigned int> ticks;
+
+  TickCounter() : ticks(0) {}
+  virtual void on_game_updated() { ticks++; }
+};
+
+static void
+wait_for_ticks(const TickCounter &counter, unsigned int ticks) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (counter.ticks < ticks &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+TEST(Simulation, RunsTicksAndCommands) {
+  PGame game = std::make_shared<Game>();
+  game->init(3, Random("8667715887436237"));
+  TickCounter counter;
+
+  PSimulation simulation = std::make_shared<Simulation>(game);
+  simulation->add_handler(&counter);
+  simulation->post([game]() { game->pause(); });
+  simulation->start();
+  wait_for_ticks(counter, 3);
+
+  Simulation::Lock lock(simulation);
+  EXPECT_LE(3u, counter.ticks);
+  EXPECT_EQ(counter.ticks, game->get_const_tick());
+  // Paused by the command before the first tick
+  EXPECT_EQ(0u, game->get_tick());
+}
+
+TEST(Simulation, LockHoldsTicks) {
+  PGame game = std::make_shared<Game>();
+  game->init(3, Random("8667715887436237"));
+  TickCounter counter;
+
+  PSimulation simulation = std::make_shared<Simulation>(game);
+  simulation->add_handler(&counter);
+  simulation->start();
+  wait_for_ticks(counter, 1);
+
+  {
+    Simulation::Lock lock(simulation);
+    unsigned int ticks = counter.ticks;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(ticks, counter.ticks);
+    EXPECT_EQ(ticks, game->get_const_tick());
+
+    // Stopping does not wait for the lock
+    simulation->stop();
+  }
+  EXPECT_FALSE(simulation->is_running());
+}
+
+TEST(Simulation, UnlockLetsTicksRun) {
+  PGame game = std::make_shared<Game>();
+  game->init(3, Random("8667715887436237"));
+  TickCounter counter;
+
+  PSimulation simulation = std::make_shared<Simulation>(game);
+  simulation->add_handler(&counter);
+  simulation->start();
+  wait_for_ticks(counter, 1);
+
+  Simulation::Lock lock(simulation);
+  unsigned int ticks = counter.ticks;
+  {
+    Simulation::Unlock unlock(simulation);
+    wait_for_ticks(counter, ticks + 2);
+  }
+  ticks = counter.ticks;
+  EXPECT_EQ(ticks, game->get_const_tick());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(ticks, counter.ticks);
+  EXPECT_LE(3u, ticks);
+}
@@ -0,0 +1,86 @@
+/*
+ * test_sprite.cc - Sprite operation tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "src/data-source.h"
+
+class SpriteTest : public SpriteBase {
+ public:
+  SpriteTest(unsigned int w, unsigned int h, int off_x, int off_y)
+    : SpriteBase(w, h) {
+    offset_x = off_x;
+    offset_y = off_y;
+    delta_x = off_x;
+    delta_y = off_y;
+    for (size_t i = 0; i < w * h; i++) {
+      set_pixel(i, 0x00000000);
+    }
+  }
+
+  void set_pixel(size_t i, uint32_t value) {
+    reinterpret_cast<uint32_t*>(data)[i] = value;
+  }
+};
+
+static uint32_t
+get_pixel(Data::PSprite sprite, size_t x, size_t y) {
+  return reinterpret_cast<uint32_t*>(sprite->get_data())[
+                                                y * sprite->get_width() + x];
+}
+
+TEST(Sprite, ReducesSize) {
+  auto sprite = std::make_shared<SpriteTest>(5, 3, -3, 4);
+  Data::PSprite reduced = sprite->get_reduced(1);
+  EXPECT_EQ(3u, reduced->get_width());
+  EXPECT_EQ(2u, reduced->get_height());
+  EXPECT_EQ(-2, reduced->get_offset_x());
+  EXPECT_EQ(2, reduced->get_offset_y());
+  EXPECT_EQ(-2, reduced->get_delta_x());
+  EXPECT_EQ(2, reduced->get_delta_y());
+
+  reduced = sprite->get_reduced(2);
+  EXPECT_EQ(2u, reduced->get_width());
+  EXPECT_EQ(1u, reduced->get_height());
+  EXPECT_EQ(-1, reduced->get_offset_x());
+  EXPECT_EQ(1, reduced->get_offset_y());
+}
+
+TEST(Sprite, ReducesByAlpha) {
+  auto sprite = std::make_shared<SpriteTest>(3, 2, 0, 0);
+  // Transparent pixels do not darken the opaque ones next to them.
+  sprite->set_pixel(0, 0xFF204060);
+  sprite->set_pixel(1, 0xFF406080);
+  sprite->set_pixel(3, 0x00FFFFFF);
+  sprite->set_pixel(4, 0xFF000000);
+  // Right column is half past the edge of the sprite.
+  sprite->set_pixel(2, 0xFF102030);
+  sprite->set_pixel(5, 0xFF102030);
+
+  Data::PSprite reduced = sprite->get_reduced(1);
+  ASSERT_EQ(2u, reduced->get_width());
+  ASSERT_EQ(1u, reduced->get_height());
+  EXPECT_EQ(0xBF20354Au, get_pixel(reduced, 0, 0));
+  EXPECT_EQ(0x7F102030u, get_pixel(reduced, 1, 0));
+}
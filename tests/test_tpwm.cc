@@ -0,0 +1,191 @@
+/*
+ * test_tpwm.cc - TPWM unpacker tests and benchmark
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/tpwm.h"
+#include "src/debug.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// Packed stream together with the content it unpacks to.
+class Stream {
+ public:
+  PMutableBuffer packed;
+  Bytes content;
+
+  PBuffer get_buffer() const {
+    return std::make_shared<Buffer>(packed->get_data(), packed->get_size(),
+                                    Buffer::EndianessBig);
+  }
+};
+
+// Random mix of literals and stamps. Short stamp offsets make stamps
+// overlap the bytes they produce.
+static Stream
+create_stream(size_t size, unsigned int seed) {
+  std::mt19937 generator(seed);
+  Stream stream;
+  stream.packed = std::make_shared<MutableBuffer>(Buffer::EndianessBig);
+  stream.packed->push("TPWM");
+  stream.packed->push<uint16_t>(static_cast<uint16_t>(size));
+
+  Bytes items;
+  uint8_t flag = 0;
+  size_t flag_items = 0;
+
+  while (stream.content.size() < size) {
+    size_t left = size - stream.content.size();
+    bool stamp = (stream.content.size() > 0) && (left >= 3) &&
+                 (generator() % 3 != 0);
+    flag <<= 1;
+    if (stamp) {
+      size_t max_offset = std::min<size_t>(stream.content.size(), 0xFFF);
+      size_t offset = (generator() % 4 == 0) ? generator() % 3 + 1 :
+                                               generator() % 0xFFF + 1;
+      offset = std::min(offset, max_offset);
+      size_t stamp_size = std::min<size_t>(generator() % 16 + 3, left);
+      items.push_back(static_cast<uint8_t>(((offset >> 4) & 0xF0) |
+                                           (stamp_size - 3)));
+      items.push_back(static_cast<uint8_t>(offset & 0xFF));
+      size_t from = stream.content.size() - offset;
+      for (size_t i = 0; i < stamp_size; i++) {
+        stream.content.push_back(stream.content[from + i]);
+      }
+      flag |= 1;
+    } else {
+      uint8_t value = (generator() % 2) ? 0 : generator() & 0xFF;
+      items.push_back(value);
+      stream.content.push_back(value);
+    }
+
+    if (++flag_items == 8 || stream.content.size() == size) {
+      flag <<= 8 - flag_items;
+      items.insert(items.begin(), flag);
+      stream.packed->push(static_cast<const void*>(items.data()),
+                          items.size());
+      items.clear();
+      flag = 0;
+      flag_items = 0;
+    }
+  }
+
+  return stream;
+}
+
+static Bytes
+unpack(PBuffer buffer) {
+  UnpackerTPWM unpacker(buffer);
+  PBuffer result = unpacker.convert();
+  uint8_t *data = reinterpret_cast<uint8_t*>(result->get_data());
+  return Bytes(data, data + result->get_size());
+}
+
+TEST(TPWM, MatchesContent) {
+  for (size_t size : {1, 7, 8, 9, 100, 4096, 65535}) {
+    for (unsigned int seed = 0; seed < 4; seed++) {
+      SCOPED_TRACE(std::to_string(size) + " bytes, seed " +
+                   std::to_string(seed));
+      Stream stream = create_stream(size, seed);
+      ASSERT_EQ(stream.content, unpack(stream.get_buffer()));
+    }
+  }
+}
+
+TEST(TPWM, RejectsCorruptedData) {
+  Stream stream = create_stream(1000, 1);
+
+  PBuffer truncated = stream.get_buffer()->get_subbuffer(0,
+                                               stream.packed->get_size() / 2);
+  EXPECT_THROW(unpack(truncated), ExceptionFreeserf);
+
+  // Streams cut anywhere in their last groups, stamp markers among them.
+  for (unsigned int seed = 0; seed < 4; seed++) {
+    Stream short_stream = create_stream(100, seed);
+    for (size_t cut = 1; cut <= 20; cut++) {
+      PBuffer cut_off = short_stream.get_buffer()->get_subbuffer(0,
+                                        short_stream.packed->get_size() - cut);
+      EXPECT_THROW(unpack(cut_off), ExceptionFreeserf) << "seed " << seed
+                                                       << ", cut " << cut;
+    }
+  }
+
+  // Last item is a stamp with the second byte of its marker missing.
+  MutableBuffer marker(Buffer::EndianessBig);
+  marker.push("TPWM");
+  marker.push<uint16_t>(6);
+  marker.push<uint8_t>(0x10);
+  marker.push<uint8_t>(0x01);
+  marker.push<uint8_t>(0x02);
+  marker.push<uint8_t>(0x03);
+  marker.push<uint8_t>(0x00);
+  EXPECT_THROW(unpack(std::make_shared<Buffer>(marker.get_data(),
+                                               marker.get_size(),
+                                               Buffer::EndianessBig)),
+               ExceptionFreeserf);
+  marker.push<uint8_t>(0x03);
+  EXPECT_EQ(Bytes({1, 2, 3, 1, 2, 3}),
+            unpack(std::make_shared<Buffer>(marker.get_data(),
+                                            marker.get_size(),
+                                            Buffer::EndianessBig)));
+
+  // First item is a stamp reaching before the beginning of the content.
+  MutableBuffer packed(Buffer::EndianessBig);
+  packed.push("TPWM");
+  packed.push<uint16_t>(8);
+  packed.push<uint8_t>(0x80);
+  packed.push<uint8_t>(0x05);
+  packed.push<uint8_t>(0x01);
+  EXPECT_THROW(unpack(std::make_shared<Buffer>(packed.get_data(),
+                                               packed.get_size(),
+                                               Buffer::EndianessBig)),
+               ExceptionFreeserf);
+
+  PBuffer other = std::make_shared<Buffer>(packed.get_data(), 4,
+                                           Buffer::EndianessBig);
+  EXPECT_THROW(UnpackerTPWM unpacker(other), ExceptionFreeserf);
+}
+
+TEST(TPWM, Throughput) {
+  const size_t bytes_per_run = 200000000;
+  Stream stream = create_stream(65535, 5);
+  size_t runs = bytes_per_run / stream.content.size();
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < runs; i++) {
+    UnpackerTPWM unpacker(stream.get_buffer());
+    unpacker.convert();
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+                                     std::chrono::steady_clock::now() - start;
+
+  double mbytes = runs * stream.content.size() / (elapsed.count() * 1000.);
+  RecordProperty("unpack", static_cast<int>(mbytes));
+  std::cout << "[ TPWM ] unpack: " << mbytes << " MB/s" << std::endl;
+}
@@ -0,0 +1,293 @@
+/*
+ * test_video_headless.cc - Offscreen video tests
+ *
+ * Copyright (C) 2018  Wicked_Digger <wicked_digger@mail.ru>
+ *
+ * This file is part of freeserf.
+ *
+ * freeserf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * freeserf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with freeserf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/video-headless.h"
+#include "src/buffer.h"
+#include "src/data-source.h"
+#include "src/data-source-pack.h"
+#include "src/gfx.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint32_t
+get_pixel(const Video::Frame *frame, unsigned int x, unsigned int y) {
+  return frame->pixels[y * frame->width + x];
+}
+
+TEST(VideoHeadless, BlendsImages) {
+  Video &video = Video::get_instance();
+  Video::Frame *frame = video.create_frame(4, 1);
+  Video::Color red = { 0xFF, 0x00, 0x00, 0xFF };
+  video.fill_rect(0, 0, 4, 1, red, frame);
+
+  std::vector<uint32_t> pixels = { 0x00FFFFFF, 0xFF0000FF,
+                                   0x800000FF, 0x80FFFFFF };
+  Video::Image *image = video.create_image(pixels.data(), 4, 1);
+  video.draw_image(image, 0, 0, 0, frame);
+
+  EXPECT_EQ(0xFFFF0000u, get_pixel(frame, 0, 0));
+  EXPECT_EQ(0xFF0000FFu, get_pixel(frame, 1, 0));
+  EXPECT_EQ(0xFF7F0080u, get_pixel(frame, 2, 0));
+  EXPECT_EQ(0xFFFF8080u, get_pixel(frame, 3, 0));
+
+  video.destroy_image(image);
+  video.destroy_frame(frame);
+}
+
+TEST(VideoHeadless, ClipsToFrame) {
+  Video &video = Video::get_instance();
+  Video::Frame *frame = video.create_frame(3, 3);
+  Video::Color white = { 0xFF, 0xFF, 0xFF, 0xFF };
+  video.fill_rect(-2, 1, 10, 10, white, frame);
+  video.draw_line(-1, -1, 5, 5, white, frame);
+
+  const uint32_t expected[3][3] = {
+    { 0xFFFFFFFF, 0x00000000, 0x00000000 },
+    { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF },
+    { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF }
+  };
+  for (unsigned int y = 0; y < 3; y++) {
+    for (unsigned int x = 0; x < 3; x++) {
+      EXPECT_EQ(expected[y][x], get_pixel(frame, x, y)) << x << "," << y;
+    }
+  }
+
+  std::vector<uint32_t> pixels(4 * 4, 0xFF00FF00);
+  Video::Image *image = video.create_image(pixels.data(), 4, 4);
+  video.draw_image(image, 2, 2, 0, frame);
+  EXPECT_EQ(0xFF00FF00u, get_pixel(frame, 2, 2));
+  EXPECT_EQ(0xFFFFFFFFu, get_pixel(frame, 1, 2));
+
+  video.destroy_image(image);
+  video.destroy_frame(frame);
+}
+
+TEST(VideoHeadless, CopiesOverlappingFrame) {
+  Video &video = Video::get_instance();
+  Video::Frame *frame = video.create_frame(4, 1);
+  for (unsigned int i = 0; i < 4; i++) {
+    frame->pixels[i] = 0xFF000000 | i;
+  }
+
+  video.draw_frame(1, 0, frame, 0, 0, frame, 3, 1);
+
+  EXPECT_EQ(0xFF000000u, get_pixel(frame, 0, 0));
+  EXPECT_EQ(0xFF000000u, get_pixel(frame, 1, 0));
+  EXPECT_EQ(0xFF000001u, get_pixel(frame, 2, 0));
+  EXPECT_EQ(0xFF000002u, get_pixel(frame, 3, 0));
+
+  video.destroy_frame(frame);
+}
+
+TEST(VideoHeadless, EnlargesFrame) {
+  Video &video = Video::get_instance();
+  Video::Frame *src = video.create_frame(2, 1);
+  src->pixels[0] = 0xFF0000FF;
+  src->pixels[1] = 0xFF00FF00;
+  Video::Frame *dest = video.create_frame(5, 3);
+
+  video.draw_frame_scaled(1, 0, dest, 0, 0, src, 2, 1, 2);
+
+  const uint32_t expected[3][5] = {
+    { 0x00000000, 0xFF0000FF, 0xFF0000FF, 0xFF00FF00, 0xFF00FF00 },
+    { 0x00000000, 0xFF0000FF, 0xFF0000FF, 0xFF00FF00, 0xFF00FF00 },
+    { 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000 }
+  };
+  for (unsigned int y = 0; y < 3; y++) {
+    for (unsigned int x = 0; x < 5; x++) {
+      EXPECT_EQ(expected[y][x], get_pixel(dest, x, y)) << x << "," << y;
+    }
+  }
+
+  video.destroy_frame(dest);
+  video.destroy_frame(src);
+}
+
+// Source of font glyphs with clear, translucent and opaque pixels. Shadows
+// are translucent only where the glyph over them is clear or opaque.
+class DataSourceFont : public DataSourceBase {
+ public:
+  DataSourceFont() : DataSourceBase("font") {}
+
+  virtual std::string get_name() const { return "Font"; }
+  virtual unsigned int get_scale() const { return 1; }
+  virtual unsigned int get_bpp() const { return 8; }
+  virtual Data::MusicFormat get_music_format() {
+    return Data::MusicFormatNone;
+  }
+
+  virtual bool check() { return true; }
+  virtual bool load() {
+    animation_table.resize(Data::get_resource_count(Data::AssetAnimation));
+    loaded = true;
+    return true;
+  }
+
+  virtual Data::MaskImage get_sprite_parts(Data::Resource res, size_t index) {
+    if (res == Data::AssetFont) {
+      return std::make_tuple(nullptr, create_glyph(index));
+    }
+    if (res == Data::AssetFontShadow) {
+      return std::make_tuple(nullptr, create_shadow(index));
+    }
+    return std::make_tuple(nullptr, nullptr);
+  }
+
+  virtual PBuffer get_sound(size_t /*index*/) { return create_buffer(); }
+  virtual PBuffer get_music(size_t /*index*/) { return create_buffer(); }
+
+ protected:
+  static uint8_t get_glyph_alpha(size_t index, unsigned int x,
+                                 unsigned int y) {
+    if (x >= 7 || y >= 7) return 0x00;
+    const uint8_t alphas[] = { 0x00, 0x40, 0x80, 0xFF };
+    return alphas[(index * 7 + x * 3 + y * 5 + x * y) % 4];
+  }
+
+  static Data::PSprite create_glyph(size_t index) {
+    Data::PSprite glyph = std::make_shared<SpriteBase>(7, 7);
+    std::mt19937 generator(static_cast<unsigned int>(index));
+    Data::Sprite::Color *pixels =
+                  reinterpret_cast<Data::Sprite::Color*>(glyph->get_data());
+    for (unsigned int y = 0; y < 7; y++) {
+      for (unsigned int x = 0; x < 7; x++) {
+        Data::Sprite::Color &pixel = pixels[y * 7 + x];
+        pixel.blue = static_cast<uint8_t>(generator());
+        pixel.green = static_cast<uint8_t>(generator());
+        pixel.red = static_cast<uint8_t>(generator());
+        pixel.alpha = get_glyph_alpha(index, x, y);
+      }
+    }
+    return glyph;
+  }
+
+  static Data::PSprite create_shadow(size_t index) {
+    Data::PSprite shadow = std::make_shared<SpriteBase>(8, 8);
+    std::mt19937 generator(static_cast<unsigned int>(index + 1000));
+    Data::Sprite::Color *pixels =
+                 reinterpret_cast<Data::Sprite::Color*>(shadow->get_data());
+    for (unsigned int y = 0; y < 8; y++) {
+      for (unsigned int x = 0; x < 8; x++) {
+        Data::Sprite::Color &pixel = pixels[y * 8 + x];
+        pixel.blue = static_cast<uint8_t>(generator());
+        pixel.green = static_cast<uint8_t>(generator());
+        pixel.red = static_cast<uint8_t>(generator());
+        uint8_t glyph = get_glyph_alpha(index, x, y);
+        bool translucent = (glyph == 0x00 || glyph == 0xFF) &&
+                           (generator() % 3 == 0);
+        pixel.alpha = translucent ? 0x60 : (generator() % 2) ? 0xFF : 0x00;
+      }
+    }
+    return shadow;
+  }
+
+  static PBuffer create_buffer() {
+    PMutableBuffer buffer =
+                    std::make_shared<MutableBuffer>(Buffer::EndianessLittle);
+    buffer->push<uint8_t>(0);
+    return buffer;
+  }
+};
+
+// Strings drawn from text images look as if drawn glyph by glyph, each
+// over its shadow.
+TEST(VideoHeadless, DrawsTextAsGlyphs) {
+  // Tests run in parallel processes, the pack gets a directory of its own.
+  std::string dir = ::testing::TempDir() + "freeserf_DrawsTextAsGlyphs";
+#ifdef _WIN32
+  _mkdir(dir.c_str());
+#else
+  mkdir(dir.c_str(), S_IRWXU);
+#endif
+  std::string pack_path = dir + "/" + DataSourcePack::file_name;
+  Data::PSource source = std::make_shared<DataSourceFont>();
+  ASSERT_TRUE(source->load());
+  ASSERT_TRUE(DataSourcePack::create(source, pack_path));
+  ASSERT_TRUE(Data::get_instance().load(dir));
+  std::remove(pack_path.c_str());
+#ifdef _WIN32
+  _rmdir(dir.c_str());
+#else
+  rmdir(dir.c_str());
+#endif
+
+  const std::string str = "FREE 09\tSERF\nAZ 123";
+  const Color color(0x20, 0xC0, 0x40);
+  const Color shadow = Color::black;
+  const Video::Color background = { 0x35, 0x8A, 0xC7, 0xFF };
+
+  Video &video = Video::get_instance();
+  ImageCache image_cache(1024 * 1024);
+  TextCache text_cache(1024 * 1024);
+  Video::Frame *text_frame = video.create_frame(200, 20);
+  Video::Frame *glyphs_frame = video.create_frame(200, 20);
+  video.fill_rect(0, 0, 200, 20, background, text_frame);
+  video.fill_rect(0, 0, 200, 20, background, glyphs_frame);
+
+  {
+    Frame text(&video, &image_cache, &text_cache, text_frame);
+    text.draw_string(3, 2, str, color, shadow);
+
+    Frame glyphs(&video, &image_cache, &text_cache, glyphs_frame);
+    int cx = 3;
+    int cy = 2;
+    for (char c : str) {
+      if (c == '\t') {
+        cx += 8 * 2;
+      } else if (c == '\n') {
+        cy += 8;
+        cx = 3;
+      } else {
+        if (c != ' ') {
+          unsigned int index = (c >= 'A') ? c - 'A' : 29 + (c - '0');
+          glyphs.draw_sprite(cx, cy, Data::AssetFontShadow, index, false,
+                             shadow);
+          glyphs.draw_sprite(cx, cy, Data::AssetFont, index, false, color);
+        }
+        cx += 8;
+      }
+    }
+  }
+
+  for (unsigned int y = 0; y < 20; y++) {
+    for (unsigned int x = 0; x < 200; x++) {
+      ASSERT_EQ(get_pixel(glyphs_frame, x, y), get_pixel(text_frame, x, y))
+        << x << "," << y;
+    }
+  }
+
+  video.destroy_frame(text_frame);
+  video.destroy_frame(glyphs_frame);
+}